@@ -96,6 +96,19 @@ fp_src = open("px4_parameters.c", "w")
 tree = ET.parse(os.sys.argv[1])
 root = tree.getroot()
 
+# Collect the parameters in scope. The table is sorted by name, param_find()
+# relies on that for a binary search.
+params = []
+for group in root:
+	if group.tag == "group" and "no_code_generation" not in group.attrib:
+		for param in group:
+			scope_ = param.find('scope').text
+			if not scope.Has(scope_):
+				continue
+			params.append((param, group.attrib["name"]))
+
+params.sort(key=lambda p: p[0].attrib["name"])
+
 # Generate the header file content
 header = """
 #include <stdint.h>
@@ -108,26 +121,10 @@ __BEGIN_DECLS
 
 struct px4_parameters_t {
 """
-start_name = ""
-end_name = ""
 
-for group in root:
-	if group.tag == "group" and "no_code_generation" not in group.attrib:
-		section = """
-	/*****************************************************************
-	 * %s
-	 ****************************************************************/""" % group.attrib["name"]
-		for param in group:
-			scope_ = param.find('scope').text
-			if not scope.Has(scope_):
-				continue
-			if not start_name:
-				start_name = param.attrib["name"]
-			end_name = param.attrib["name"]
-			header += section
-			section =""
-			header += """
-	const struct param_info_s __param__%s;""" % param.attrib["name"]
+for param, group_name in params:
+	header += """
+	const struct param_info_s __param__%s; /* %s */""" % (param.attrib["name"], group_name)
 header += """
 	const unsigned int param_count;
 };
@@ -148,29 +145,13 @@ __attribute__((used, section("__param")))
 #endif
 struct px4_parameters_t px4_parameters = {
 """
-i=0
-for group in root:
-	if group.tag == "group" and "no_code_generation" not in group.attrib:
-		section = """
-	/*****************************************************************
-	 * %s
-	 ****************************************************************/""" % group.attrib["name"]
-		for param in group:
-			scope_ = param.find('scope').text
-			if not scope.Has(scope_):
-				continue
-			if not start_name:
-				start_name = param.attrib["name"]
-			end_name = param.attrib["name"]
-			val_str = "#error UNKNOWN PARAM TYPE, FIX px_generate_params.py"
-			if (param.attrib["type"] == "FLOAT"):
-				val_str = ".val.f = "
-			elif (param.attrib["type"] == "INT32"):
-				val_str = ".val.i = "
-			i+=1
-			src += section
-			section =""
-			src += """
+for param, group_name in params:
+	val_str = "#error UNKNOWN PARAM TYPE, FIX px_generate_params.py"
+	if (param.attrib["type"] == "FLOAT"):
+		val_str = ".val.f = "
+	elif (param.attrib["type"] == "INT32"):
+		val_str = ".val.i = "
+	src += """
 	{
 		"%s",
 		PARAM_TYPE_%s,
@@ -185,7 +166,7 @@ src += """
 
 __END_DECLS
 
-""" % i
+""" % len(params)
 
 fp_header.write(header)
 fp_src.write(src)
@@ -0,0 +1,124 @@
+#!/usr/bin/env python
+############################################################################
+#
+#   Copyright (C) 2016 PX4 Development Team. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in
+#    the documentation and/or other materials provided with the
+#    distribution.
+# 3. Neither the name PX4 nor the names of its contributors may be
+#    used to endorse or promote products derived from this software
+#    without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+# OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+# AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+# ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+
+"""Decode a block compressed ULog file (.ulz) into a plain ULog file (.ulg)
+
+Usage: python ulog_decompress.py input.ulz [output.ulg]
+
+The file format is described in src/modules/logger/ulog_compression.h"""
+
+from __future__ import print_function
+
+import struct
+import sys
+
+MAGIC = b'ULogZ\x01\x12\x35'
+FRAME_STORED = 0x8000
+
+
+def decompress_block(src, raw_size):
+    """Decode one frame in the LZ4 block format"""
+    dst = bytearray()
+    ip = 0
+    while ip < len(src):
+        token = src[ip]
+        ip += 1
+        length = token >> 4
+        if length == 15:
+            while True:
+                b = src[ip]
+                ip += 1
+                length += b
+                if b != 255:
+                    break
+        dst += src[ip:ip + length]
+        ip += length
+        if ip >= len(src):
+            break
+        offset = src[ip] | (src[ip + 1] << 8)
+        ip += 2
+        if offset == 0 or offset > len(dst):
+            raise ValueError('invalid match offset')
+        length = token & 0xf
+        if length == 15:
+            while True:
+                b = src[ip]
+                ip += 1
+                length += b
+                if b != 255:
+                    break
+        length += 4
+        start = len(dst) - offset
+        # overlapping matches repeat the last offset bytes
+        for i in range(length):
+            dst.append(dst[start + i])
+    if len(dst) != raw_size:
+        raise ValueError('corrupt frame')
+    return dst
+
+
+def decompress(in_file, out_file):
+    if in_file.read(len(MAGIC)) != MAGIC:
+        raise ValueError('not a compressed ULog file')
+    while True:
+        header = in_file.read(4)
+        if len(header) < 4:
+            break
+        data_size, raw_size = struct.unpack('<HH', header)
+        data = bytearray(in_file.read(data_size & ~FRAME_STORED))
+        if len(data) < data_size & ~FRAME_STORED:
+            print('warning: truncated frame, log was not closed properly', file=sys.stderr)
+            break
+        if data_size & FRAME_STORED:
+            out_file.write(data)
+        else:
+            out_file.write(decompress_block(data, raw_size))
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+    in_name = sys.argv[1]
+    if len(sys.argv) > 2:
+        out_name = sys.argv[2]
+    elif in_name.endswith('.ulz'):
+        out_name = in_name[:-4] + '.ulg'
+    else:
+        out_name = in_name + '.ulg'
+    with open(in_name, 'rb') as in_file, open(out_name, 'wb') as out_file:
+        decompress(in_file, out_file)
+
+
+if __name__ == '__main__':
+    main()
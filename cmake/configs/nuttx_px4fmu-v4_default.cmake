@@ -4,6 +4,10 @@ set(CMAKE_TOOLCHAIN_FILE ${PX4_SOURCE_DIR}/cmake/toolchains/Toolchain-arm-none-e
 
 set(config_uavcan_num_ifaces 1)
 
+# For an airframe that never changes its mixer, compile the mixer of the fmu
+# outputs into the firmware. Mixer files loaded at boot are then ignored.
+#set(config_mixer_static ${PX4_SOURCE_DIR}/ROMFS/px4fmu_common/mixers/quad_x.main.mix)
+
 set(config_module_list
 	#
 	# Board support modules
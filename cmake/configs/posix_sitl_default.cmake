@@ -30,6 +30,7 @@ set(config_module_list
 	systemcmds/topic_listener
 	systemcmds/ver
 	systemcmds/top
+	systemcmds/trace
 	systemcmds/motor_ramp
 
 	modules/attitude_estimator_ekf
@@ -88,6 +89,8 @@ set(config_module_list
 	modules/unit_test
 	modules/uORB/uORB_tests
 	systemcmds/tests
+	platforms/posix/tests/sim_report
+	platforms/posix/tests/lockstep
 
 	)
 
@@ -247,7 +247,7 @@ Airspeed::ioctl(struct file *filp, int cmd, unsigned long arg)
 			return SENSOR_POLLRATE_MANUAL;
 		}
 
-		return (1000 / _measure_ticks);
+		return (1000000 / USEC_PER_TICK / _measure_ticks);
 
 	case SENSORIOCSQUEUEDEPTH: {
 			/* lower bound is mandatory, upper bound is a sanity check */
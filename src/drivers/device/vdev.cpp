@@ -44,6 +44,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <string>
+#include <unordered_map>
 
 #include "DevMgr.hpp"
 
@@ -73,6 +75,43 @@ private:
 static px4_dev_t *devmap[PX4_MAX_DEV];
 pthread_mutex_t devmutex = PTHREAD_MUTEX_INITIALIZER;
 
+/*
+ * Lookup by name goes through a hash index into devmap. devmap itself is kept
+ * for the index based iteration of topicList() and devList().
+ * All of these are protected by devmutex.
+ */
+static std::unordered_map<std::string, int> devindex;
+static int devmap_free[PX4_MAX_DEV]; ///< stack of released devmap slots
+static int devmap_free_count = 0;
+static int devmap_used = 0; ///< slots at and above this index have never been used
+
+static int devmap_find(const char *name)
+{
+	auto iter = devindex.find(name);
+	return (iter != devindex.end()) ? iter->second : -1;
+}
+
+static int devmap_alloc()
+{
+	if (devmap_free_count > 0) {
+		return devmap_free[--devmap_free_count];
+	}
+
+	if (devmap_used < PX4_MAX_DEV) {
+		return devmap_used++;
+	}
+
+	return -1;
+}
+
+static void devmap_release(int i)
+{
+	devindex.erase(devmap[i]->name);
+	delete devmap[i];
+	devmap[i] = NULL;
+	devmap_free[devmap_free_count++] = i;
+}
+
 /*
  * The standard NuttX operation dispatch table can't call C++ member functions
  * directly, so we have to bounce them through this dispatch table.
@@ -145,25 +184,21 @@ VDev::register_driver(const char *name, void *data)
 		return -EINVAL;
 	}
 
-	// Make sure the device does not already exist
-	// FIXME - convert this to a map for efficiency
-
 	pthread_mutex_lock(&devmutex);
 
-	for (int i = 0; i < PX4_MAX_DEV; ++i) {
-		if (devmap[i] && (strcmp(devmap[i]->name, name) == 0)) {
-			pthread_mutex_unlock(&devmutex);
-			return -EEXIST;
-		}
+	// Make sure the device does not already exist
+	if (devmap_find(name) >= 0) {
+		pthread_mutex_unlock(&devmutex);
+		return -EEXIST;
 	}
 
-	for (int i = 0; i < PX4_MAX_DEV; ++i) {
-		if (devmap[i] == NULL) {
-			devmap[i] = new px4_dev_t(name, (void *)data);
-			PX4_DEBUG("Registered DEV %s", name);
-			ret = PX4_OK;
-			break;
-		}
+	int i = devmap_alloc();
+
+	if (i >= 0) {
+		devmap[i] = new px4_dev_t(name, (void *)data);
+		devindex[devmap[i]->name] = i;
+		PX4_DEBUG("Registered DEV %s", name);
+		ret = PX4_OK;
 	}
 
 	pthread_mutex_unlock(&devmutex);
@@ -187,14 +222,12 @@ VDev::unregister_driver(const char *name)
 
 	pthread_mutex_lock(&devmutex);
 
-	for (int i = 0; i < PX4_MAX_DEV; ++i) {
-		if (devmap[i] && (strcmp(name, devmap[i]->name) == 0)) {
-			delete devmap[i];
-			devmap[i] = NULL;
-			PX4_DEBUG("Unregistered DEV %s", name);
-			ret = PX4_OK;
-			break;
-		}
+	int i = devmap_find(name);
+
+	if (i >= 0) {
+		devmap_release(i);
+		PX4_DEBUG("Unregistered DEV %s", name);
+		ret = PX4_OK;
 	}
 
 	pthread_mutex_unlock(&devmutex);
@@ -211,14 +244,13 @@ VDev::unregister_class_devname(const char *class_devname, unsigned class_instanc
 
 	pthread_mutex_lock(&devmutex);
 
-	for (int i = 0; i < PX4_MAX_DEV; ++i) {
-		if (devmap[i] && strcmp(devmap[i]->name, name) == 0) {
-			delete devmap[i];
-			PX4_DEBUG("Unregistered class DEV %s", name);
-			devmap[i] = NULL;
-			pthread_mutex_unlock(&devmutex);
-			return PX4_OK;
-		}
+	int i = devmap_find(name);
+
+	if (i >= 0) {
+		devmap_release(i);
+		PX4_DEBUG("Unregistered class DEV %s", name);
+		pthread_mutex_unlock(&devmutex);
+		return PX4_OK;
 	}
 
 	pthread_mutex_unlock(&devmutex);
@@ -296,6 +328,13 @@ VDev::close(file_t *filep)
 
 	lock();
 
+	/* drop poll waiters that were left registered on this file */
+	for (unsigned i = 0; i < _max_pollwaiters; i++) {
+		if (nullptr != _pollset[i] && _pollset[i]->priv == (void *)filep) {
+			_pollset[i] = nullptr;
+		}
+	}
+
 	if (_open_count > 0) {
 		/* decrement the open count */
 		_open_count--;
@@ -406,11 +445,12 @@ VDev::poll(file_t *filep, px4_pollfd_struct_t *fds, bool setup)
 			 * Check to see whether we should send a poll notification
 			 * immediately.
 			 */
-			fds->revents |= fds->events & poll_state(filep);
+			pollevent_t revents = fds->events & poll_state(filep);
 
 			/* yes? post the notification */
-			if (fds->revents != 0) {
-				px4_sem_post(fds->sem);
+			if (revents != 0) {
+				__atomic_fetch_or(&fds->revents, revents, __ATOMIC_RELAXED);
+				px4_waitset_notify(fds->waitset);
 			}
 
 		} else {
@@ -449,21 +489,35 @@ void
 VDev::poll_notify_one(px4_pollfd_struct_t *fds, pollevent_t events)
 {
 	PX4_DEBUG("VDev::poll_notify_one");
-	int value;
-	px4_sem_getvalue(fds->sem, &value);
 
-	/* update the reported event set */
-	fds->revents |= fds->events & events;
+	/*
+	 * Update the reported event set. The waiter clears it without holding
+	 * our lock, so this has to be an atomic update.
+	 */
+	pollevent_t revents = __atomic_or_fetch(&fds->revents, fds->events & events, __ATOMIC_RELAXED);
 
-	PX4_DEBUG(" Events fds=%p %0x %0x %0x %d", fds, fds->revents, fds->events, events, value);
+	PX4_DEBUG(" Events fds=%p %0x %0x %0x", fds, revents, fds->events, events);
 
-	/* if the state is now interesting, wake the waiter if it's still asleep */
-	/* XXX semcount check here is a vile hack; counting semphores should not be abused as cvars */
-	if ((fds->revents != 0) && (value <= 0)) {
-		px4_sem_post(fds->sem);
+	/* if the state is now interesting, wake the waiter; this is a no-op unless it sleeps */
+	if (revents != 0) {
+		px4_waitset_notify(fds->waitset);
 	}
 }
 
+void
+VDev::poll_rearm(file_t *filep, px4_pollfd_struct_t *fds)
+{
+	lock();
+
+	pollevent_t revents = fds->events & poll_state(filep);
+
+	if (revents != 0) {
+		__atomic_fetch_or(&fds->revents, revents, __ATOMIC_RELAXED);
+	}
+
+	unlock();
+}
+
 pollevent_t
 VDev::poll_state(file_t *filep)
 {
@@ -511,26 +565,51 @@ VDev::remove_poll_waiter(px4_pollfd_struct_t *fds)
 	return -EINVAL;
 }
 
+bool
+VDev::poll_sleeping(file_t *filep)
+{
+	for (unsigned i = 0; i < _max_pollwaiters; i++) {
+		px4_pollfd_struct_t *fds = _pollset[i];
+
+		if (fds != nullptr && fds->priv == filep && fds->waitset != nullptr &&
+		    __atomic_load_n(&fds->waitset->sleeping, __ATOMIC_SEQ_CST)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool
+VDev::poll_registered(file_t *filep)
+{
+	for (unsigned i = 0; i < _max_pollwaiters; i++) {
+		px4_pollfd_struct_t *fds = _pollset[i];
+
+		if (fds != nullptr && fds->priv == filep) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 VDev *VDev::getDev(const char *path)
 {
 	PX4_DEBUG("VDev::getDev");
-	int i = 0;
+	VDev *dev = NULL;
 
 	pthread_mutex_lock(&devmutex);
 
-	for (; i < PX4_MAX_DEV; ++i) {
-		//if (devmap[i]) {
-		//	printf("%s %s\n", devmap[i]->name, path);
-		//}
-		if (devmap[i] && (strcmp(devmap[i]->name, path) == 0)) {
-			pthread_mutex_unlock(&devmutex);
-			return (VDev *)(devmap[i]->cdev);
-		}
+	int i = devmap_find(path);
+
+	if (i >= 0) {
+		dev = (VDev *)(devmap[i]->cdev);
 	}
 
 	pthread_mutex_unlock(&devmutex);
 
-	return NULL;
+	return dev;
 }
 
 void VDev::showDevices()
@@ -240,6 +240,18 @@ public:
 	 */
 	virtual int	poll(file_t *filep, px4_pollfd_struct_t *fds, bool setup);
 
+	/**
+	 * Re-check the poll state for a registered poll waiter.
+	 *
+	 * Wait sets call this for descriptors that stay registered across waits,
+	 * so an event that was reported but not consumed is reported again, the
+	 * same as it would be by a fresh poll() setup.
+	 *
+	 * @param filep	Pointer to the internal file structure.
+	 * @param fds		Registered poll descriptor.
+	 */
+	void		poll_rearm(file_t *filep, px4_pollfd_struct_t *fds);
+
 	/**
 	 * Test whether the device is currently open.
 	 *
@@ -377,6 +389,26 @@ protected:
 	 */
 	virtual void	poll_notify_one(px4_pollfd_struct_t *fds, pollevent_t events);
 
+	/**
+	 * Check whether a file has a poll waiter that is blocked in its wait set.
+	 *
+	 * Lock must already be held when calling this.
+	 *
+	 * @param filep		Pointer to the internal file structure.
+	 * @return		true if the owner of the file is waiting for events.
+	 */
+	bool		poll_sleeping(file_t *filep);
+
+	/**
+	 * Check whether a file is registered with a poll waiter, blocked or not.
+	 *
+	 * Lock must already be held when calling this.
+	 *
+	 * @param filep		Pointer to the internal file structure.
+	 * @return		true if the owner of the file polls it.
+	 */
+	bool		poll_registered(file_t *filep);
+
 	/**
 	 * Notification of the first open.
 	 *
@@ -40,28 +40,62 @@
 #include <px4_log.h>
 #include <px4_posix.h>
 #include <px4_time.h>
+#include <px4_trace.h>
 #include "device.h"
 #include "vfile.h"
 
 #include <hrt_work.h>
+#include <drivers/drv_hrt.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <pthread.h>
 #include <unistd.h>
 
+#ifdef __PX4_LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
 using namespace device;
 
 pthread_mutex_t filemutex = PTHREAD_MUTEX_INITIALIZER;
 px4_sem_t lockstep_sem;
 bool sim_lockstep = false;
 bool sim_delay = false;
+static pthread_mutex_t sim_delay_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sim_delay_cond = PTHREAD_COND_INITIALIZER;
+static bool poll_semaphore = false; ///< px4_poll() with a semaphore per call, see px4_poll_use_semaphore()
 
 extern "C" {
 
 #define PX4_MAX_FD 300
 	static device::file_t *filemap[PX4_MAX_FD] = {};
 
+	/* free file descriptors, protected by filemutex */
+	static int filemap_free[PX4_MAX_FD]; ///< stack of closed file descriptors
+	static int filemap_free_count = 0;
+	static int filemap_used = 0; ///< fds at and above this one have never been used
+
+	static int filemap_alloc()
+	{
+		if (filemap_free_count > 0) {
+			return filemap_free[--filemap_free_count];
+		}
+
+		if (filemap_used < PX4_MAX_FD) {
+			return filemap_used++;
+		}
+
+		return PX4_MAX_FD;
+	}
+
+	static void filemap_release(int fd)
+	{
+		filemap[fd] = nullptr;
+		filemap_free[filemap_free_count++] = fd;
+	}
+
 	int px4_errno;
 
 	inline bool valid_fd(int fd)
@@ -114,11 +148,10 @@ extern "C" {
 
 			pthread_mutex_lock(&filemutex);
 
-			for (i = 0; i < PX4_MAX_FD; ++i) {
-				if (filemap[i] == 0) {
-					filemap[i] = new device::file_t(flags, dev, i);
-					break;
-				}
+			i = filemap_alloc();
+
+			if (i < PX4_MAX_FD) {
+				filemap[i] = new device::file_t(flags, dev, i);
 			}
 
 			pthread_mutex_unlock(&filemutex);
@@ -168,7 +201,7 @@ extern "C" {
 		if (dev) {
 			pthread_mutex_lock(&filemutex);
 			ret = dev->close(filemap[fd]);
-			filemap[fd] = nullptr;
+			filemap_release(fd);
 			pthread_mutex_unlock(&filemutex);
 			PX4_DEBUG("px4_close fd = %d", fd);
 
@@ -249,13 +282,377 @@ extern "C" {
 		return ret;
 	}
 
-	int px4_poll(px4_pollfd_struct_t *fds, nfds_t nfds, int timeout)
+	/**
+	 * Look up the open file behind a descriptor, or nullptr if it is not open.
+	 */
+	static file_t *get_file(int fd)
 	{
-		if (nfds == 0) {
-			PX4_WARN("px4_poll with no fds");
-			return -1;
+		pthread_mutex_lock(&filemutex);
+		file_t *filep = (fd < PX4_MAX_FD && fd >= 0) ? filemap[fd] : nullptr;
+		pthread_mutex_unlock(&filemutex);
+		return filep;
+	}
+
+	/**
+	 * Register a pollfd with the driver of its descriptor. The pollfd must
+	 * stay at the same address until waitset_teardown() is called on it.
+	 */
+	static int waitset_setup(px4_waitset_t *ws, px4_pollfd_struct_t *fds)
+	{
+		fds->waitset = ws;
+		fds->revents = 0;
+		fds->priv    = nullptr;
+
+		file_t *filep = get_file(fds->fd);
+
+		if (filep == nullptr) {
+			return -EBADF;
+		}
+
+		int ret = ((VDev *)filep->vdev)->poll(filep, fds, true);
+
+		if (ret < 0) {
+			fds->priv = nullptr;
 		}
 
+		return ret;
+	}
+
+	/**
+	 * Undo waitset_setup(). A descriptor that was closed while registered has
+	 * already been dropped by its driver, so there is nothing left to do.
+	 */
+	static int waitset_teardown(px4_pollfd_struct_t *fds)
+	{
+		file_t *filep = (file_t *)fds->priv;
+
+		if (filep == nullptr || get_file(fds->fd) != filep) {
+			return PX4_OK;
+		}
+
+		return ((VDev *)filep->vdev)->poll(filep, fds, false);
+	}
+
+	/**
+	 * Count the registered descriptors with pending events.
+	 */
+	static int waitset_ready(const px4_waitset_t *ws)
+	{
+		int ready = 0;
+
+		for (unsigned i = 0; i < ws->count; i++) {
+			if (ws->fds[i].fd >= 0 && __atomic_load_n(&ws->fds[i].revents, __ATOMIC_RELAXED) != 0) {
+				ready++;
+			}
+		}
+
+		return ready;
+	}
+
+#ifdef __PX4_LINUX
+#define WAITSET_CLOCK CLOCK_MONOTONIC
+#else
+	// FIXME: check if QURT should probably be using CLOCK_MONOTONIC
+#define WAITSET_CLOCK CLOCK_REALTIME
+#endif
+
+	static void waitset_timeout(void *arg)
+	{
+		px4_waitset_notify((px4_waitset_t *)arg);
+	}
+
+	/**
+	 * Block until a registered descriptor has pending events or the timeout
+	 * expires.
+	 *
+	 * @param timeout	Timeout in ms, 0 to only check and a negative value
+	 *			to wait forever.
+	 * @return		The number of descriptors with pending events.
+	 */
+	static int waitset_block(px4_waitset_t *ws, int timeout)
+	{
+		const int64_t billion = (1000 * 1000 * 1000);
+		struct timespec deadline = {};
+		struct hrt_external_wait external_wait;
+
+		/* while the HRT follows the simulator or a replay the timeout does too */
+		bool external = timeout > 0 && hrt_external_wait_start(&external_wait, (hrt_abstime)timeout * 1000,
+				waitset_timeout, ws);
+
+		if (timeout > 0 && !external) {
+			px4_clock_gettime(WAITSET_CLOCK, &deadline);
+			int64_t nsecs = deadline.tv_nsec + (int64_t)timeout * 1000 * 1000;
+			deadline.tv_sec += nsecs / billion;
+			deadline.tv_nsec = nsecs % billion;
+		}
+
+		int ready;
+
+		for (;;) {
+			/*
+			 * Announce that we are about to sleep before looking at the events:
+			 * a notifier either sees the flag and wakes us, or it bumped the
+			 * counter before we sampled it and the wait returns immediately.
+			 */
+			__atomic_store_n(&ws->sleeping, 1, __ATOMIC_SEQ_CST);
+			int wakeups = __atomic_load_n(&ws->wakeups, __ATOMIC_SEQ_CST);
+
+			ready = waitset_ready(ws);
+
+			if (ready > 0 || timeout == 0) {
+				break;
+			}
+
+			struct timespec remaining = {};
+
+			if (external) {
+				/* set before the notification, which bumps the counter */
+				if (__atomic_load_n(&external_wait.expired, __ATOMIC_ACQUIRE)) {
+					break;
+				}
+
+			} else if (timeout > 0) {
+				struct timespec now;
+				px4_clock_gettime(WAITSET_CLOCK, &now);
+				int64_t nsecs = (deadline.tv_sec - now.tv_sec) * billion + (deadline.tv_nsec - now.tv_nsec);
+
+				if (nsecs <= 0) {
+					break;
+				}
+
+				remaining.tv_sec = nsecs / billion;
+				remaining.tv_nsec = nsecs % billion;
+			}
+
+#ifdef __PX4_LINUX
+			syscall(SYS_futex, &ws->wakeups, FUTEX_WAIT_PRIVATE, wakeups,
+				(timeout > 0 && !external) ? &remaining : nullptr, nullptr, 0);
+#else
+			(void)wakeups;
+
+			if (timeout > 0 && !external) {
+				px4_sem_timedwait(&ws->sem, &deadline);
+
+			} else {
+				px4_sem_wait(&ws->sem);
+			}
+
+#endif
+		}
+
+		__atomic_store_n(&ws->sleeping, 0, __ATOMIC_SEQ_CST);
+
+		if (external) {
+			(void)hrt_external_wait_stop(&external_wait);
+		}
+
+		return ready;
+	}
+
+	static void waitset_prepare(px4_waitset_t *ws, px4_pollfd_struct_t *fds, unsigned count)
+	{
+		ws->wakeups = 0;
+		ws->sleeping = 0;
+#ifndef __PX4_LINUX
+		px4_sem_init(&ws->sem, 0, 0);
+#endif
+		ws->poll_sem = nullptr;
+		ws->fds = fds;
+		ws->revents = nullptr;
+		ws->count = count;
+		ws->capacity = count;
+	}
+
+	void px4_waitset_notify(px4_waitset_t *ws)
+	{
+		if (ws == nullptr) {
+			return;
+		}
+
+		if (ws->poll_sem != nullptr) {
+			/* the semaphore based px4_poll(), which only posts if the waiter is still asleep */
+			int value;
+			px4_sem_getvalue(ws->poll_sem, &value);
+
+			if (value <= 0) {
+				px4_sem_post(ws->poll_sem);
+			}
+
+			return;
+		}
+
+		__atomic_fetch_add(&ws->wakeups, 1, __ATOMIC_SEQ_CST);
+
+		/* only the first notifier after the owner went to sleep pays for a wakeup */
+		if (__atomic_exchange_n(&ws->sleeping, 0, __ATOMIC_SEQ_CST)) {
+#ifdef __PX4_LINUX
+			syscall(SYS_futex, &ws->wakeups, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#else
+			px4_sem_post(&ws->sem);
+#endif
+		}
+	}
+
+	int px4_waitset_init(px4_waitset_t *ws, unsigned capacity)
+	{
+		px4_pollfd_struct_t *fds = new px4_pollfd_struct_t[capacity];
+		pollevent_t *revents = new pollevent_t[capacity];
+
+		if (fds == nullptr || revents == nullptr) {
+			delete[] fds;
+			delete[] revents;
+			px4_errno = ENOMEM;
+			return PX4_ERROR;
+		}
+
+		waitset_prepare(ws, fds, 0);
+		ws->revents = revents;
+		ws->capacity = capacity;
+
+		return PX4_OK;
+	}
+
+	void px4_waitset_deinit(px4_waitset_t *ws)
+	{
+		for (unsigned i = 0; i < ws->count; i++) {
+			if (ws->fds[i].fd >= 0) {
+				waitset_teardown(&ws->fds[i]);
+			}
+		}
+
+#ifndef __PX4_LINUX
+		px4_sem_destroy(&ws->sem);
+#endif
+		delete[] ws->fds;
+		delete[] ws->revents;
+		ws->fds = nullptr;
+		ws->revents = nullptr;
+		ws->count = 0;
+		ws->capacity = 0;
+	}
+
+	int px4_waitset_add(px4_waitset_t *ws, int fd, pollevent_t events)
+	{
+		unsigned i;
+
+		/* reuse a removed slot: registered slots must not move */
+		for (i = 0; i < ws->count; i++) {
+			if (ws->fds[i].fd < 0) {
+				break;
+			}
+		}
+
+		if (i == ws->count) {
+			if (ws->count == ws->capacity) {
+				px4_errno = ENOMEM;
+				return PX4_ERROR;
+			}
+
+			ws->count++;
+		}
+
+		ws->fds[i].fd = fd;
+		ws->fds[i].events = events;
+		ws->revents[i] = 0;
+
+		int ret = waitset_setup(ws, &ws->fds[i]);
+
+		if (ret < 0) {
+			ws->fds[i].fd = -1;
+			px4_errno = -ret;
+			return PX4_ERROR;
+		}
+
+		return i;
+	}
+
+	int px4_waitset_remove(px4_waitset_t *ws, int fd)
+	{
+		for (unsigned i = 0; i < ws->count; i++) {
+			if (ws->fds[i].fd == fd) {
+				int ret = waitset_teardown(&ws->fds[i]);
+				ws->fds[i].fd = -1;
+				ws->revents[i] = 0;
+
+				if (ret < 0) {
+					px4_errno = -ret;
+					return PX4_ERROR;
+				}
+
+				return PX4_OK;
+			}
+		}
+
+		px4_errno = EINVAL;
+		return PX4_ERROR;
+	}
+
+	int px4_waitset_wait(px4_waitset_t *ws, int timeout)
+	{
+		px4_sim_delay_wait();
+
+		/*
+		 * Events reported by the previous wait were cleared; if they were not
+		 * consumed (e.g. the topic was not copied), report them again like
+		 * px4_poll() would.
+		 */
+		for (unsigned i = 0; i < ws->count; i++) {
+			if (ws->fds[i].fd >= 0 && ws->revents[i] != 0) {
+				file_t *filep = (file_t *)ws->fds[i].priv;
+
+				if (filep != nullptr && get_file(ws->fds[i].fd) == filep) {
+					((VDev *)filep->vdev)->poll_rearm(filep, &ws->fds[i]);
+				}
+			}
+		}
+
+		waitset_block(ws, timeout);
+
+		int ready = 0;
+
+		for (unsigned i = 0; i < ws->count; i++) {
+			ws->revents[i] = (ws->fds[i].fd >= 0) ? __atomic_exchange_n(&ws->fds[i].revents, 0, __ATOMIC_RELAXED) : 0;
+
+			if (ws->revents[i] != 0) {
+				ready++;
+			}
+		}
+
+		return ready;
+	}
+
+	pollevent_t px4_waitset_revents(const px4_waitset_t *ws, int index)
+	{
+		if (index < 0 || (unsigned)index >= ws->count) {
+			return 0;
+		}
+
+		return ws->revents[index];
+	}
+
+#if defined(__PX4_POSIX) && !defined(__PX4_QURT)
+	/** @return the name of the first device with events, to trace poll wakeups */
+	static const char *poll_ready_devname(px4_pollfd_struct_t *fds, unsigned count)
+	{
+		for (unsigned i = 0; i < count; ++i) {
+			VDev *dev = fds[i].revents ? get_vdev(fds[i].fd) : nullptr;
+
+			if (dev != nullptr) {
+				return dev->get_devname();
+			}
+		}
+
+		return nullptr;
+	}
+#endif
+
+	/**
+	 * The px4_poll() implementation from before wait sets: a semaphore, a
+	 * thread name lookup and a driver setup and teardown of every fd per call.
+	 * It is only kept to compare the two, see px4_poll_use_semaphore().
+	 */
+	static int poll_with_semaphore(px4_pollfd_struct_t *fds, nfds_t nfds, int timeout)
+	{
 		px4_sem_t sem;
 		int count = 0;
 		int ret = -1;
@@ -273,38 +670,36 @@ extern "C" {
 
 #endif
 
-		while (sim_delay) {
-			usleep(100);
-		}
-
-		PX4_DEBUG("Called px4_poll timeout = %d", timeout);
 		px4_sem_init(&sem, 0, 0);
 
+		/* a wait set only to carry the semaphore to the drivers */
+		px4_waitset_t ws;
+		waitset_prepare(&ws, fds, nfds);
+		ws.poll_sem = &sem;
+
 		// Go through all fds and check them for a pollable state
 		bool fd_pollable = false;
 
 		for (i = 0; i < nfds; ++i) {
-			fds[i].sem     = &sem;
-			fds[i].revents = 0;
-			fds[i].priv    = NULL;
+			ret = waitset_setup(&ws, &fds[i]);
 
-			VDev *dev = get_vdev(fds[i].fd);
+			if (ret == -EBADF) {
+				continue;
+			}
 
-			// If fd is valid
-			if (dev) {
-				PX4_DEBUG("%s: px4_poll: VDev->poll(setup) %d", thread_name, fds[i].fd);
-				ret = dev->poll(filemap[fds[i].fd], &fds[i], true);
+			if (ret < 0) {
+				PX4_WARN("%s: px4_poll() error: %s", thread_name, strerror(-ret));
+				break;
+			}
 
-				if (ret < 0) {
-					PX4_WARN("%s: px4_poll() error: %s",
-						 thread_name, strerror(errno));
-					break;
-				}
+			fd_pollable = true;
+		}
 
-				if (ret >= 0) {
-					fd_pollable = true;
-				}
-			}
+		const unsigned int nsetup = i;
+
+		for (; i < nfds; ++i) {
+			fds[i].revents = 0;
+			fds[i].priv    = nullptr;
 		}
 
 		// If any FD can be polled, lock the semaphore and
@@ -319,11 +714,9 @@ extern "C" {
 
 				// Calculate an absolute time in the future
 				const unsigned billion = (1000 * 1000 * 1000);
-				unsigned tdiff = timeout;
-				uint64_t nsecs = ts.tv_nsec + (tdiff * 1000 * 1000);
+				uint64_t nsecs = ts.tv_nsec + ((uint64_t)timeout * 1000 * 1000);
 				ts.tv_sec += nsecs / billion;
-				nsecs -= (nsecs / billion) * billion;
-				ts.tv_nsec = nsecs;
+				ts.tv_nsec = nsecs % billion;
 
 				// Execute a blocking wait for that time in the future
 				errno = 0;
@@ -332,12 +725,7 @@ extern "C" {
 				ret = errno;
 #endif
 
-				// Ensure ret is negative on failure
-				if (ret > 0) {
-					ret = -ret;
-				}
-
-				if (ret && ret != -ETIMEDOUT) {
+				if (ret && ret != ETIMEDOUT) {
 					PX4_WARN("%s: px4_poll() sem error", thread_name);
 				}
 
@@ -347,32 +735,118 @@ extern "C" {
 
 			// We have waited now (or not, depending on timeout),
 			// go through all fds and count how many have data
-			for (i = 0; i < nfds; ++i) {
+			for (i = 0; i < nsetup; ++i) {
+				if (fds[i].priv == nullptr) {
+					continue;
+				}
+
+				if (waitset_teardown(&fds[i]) < 0) {
+					PX4_WARN("%s: px4_poll() 2nd poll fail", thread_name);
+				}
+
+				if (fds[i].revents) {
+					count += 1;
+				}
+			}
+		}
+
+#ifndef __PX4_LINUX
+		px4_sem_destroy(&ws.sem);
+#endif
+		px4_sem_destroy(&sem);
+
+		// Return the count of ready fds, or an error if nothing could be polled
+		return fd_pollable ? count : -1;
+	}
+
+	void px4_poll_use_semaphore(bool enable)
+	{
+		__atomic_store_n(&poll_semaphore, enable, __ATOMIC_RELAXED);
+	}
+
+	int px4_poll(px4_pollfd_struct_t *fds, nfds_t nfds, int timeout)
+	{
+		if (nfds == 0) {
+			if (timeout < 0) {
+				PX4_WARN("px4_poll with no fds");
+				return -1;
+			}
+
+			usleep(timeout * 1000);
+			return 0;
+		}
+
+		px4_sim_delay_wait();
+
+		PX4_DEBUG("Called px4_poll timeout = %d", timeout);
+
+		if (__atomic_load_n(&poll_semaphore, __ATOMIC_RELAXED)) {
+			return poll_with_semaphore(fds, nfds, timeout);
+		}
+
+		/*
+		 * A one-shot wait set on the caller's pollfds. On Linux its wakeup is a
+		 * futex word on our stack, so there is no semaphore to create per call.
+		 */
+		px4_waitset_t ws;
+		waitset_prepare(&ws, fds, nfds);
+
+		// Go through all fds and check them for a pollable state
+		bool fd_pollable = false;
+		unsigned int i;
+
+		for (i = 0; i < nfds; ++i) {
+			int ret = waitset_setup(&ws, &fds[i]);
+
+			if (ret == -EBADF) {
+				continue;
+			}
+
+			if (ret < 0) {
+				PX4_WARN("px4_poll() error: %s", strerror(-ret));
+				break;
+			}
+
+			fd_pollable = true;
+		}
+
+		const unsigned int nsetup = i;
 
-				VDev *dev = get_vdev(fds[i].fd);
+		for (; i < nfds; ++i) {
+			fds[i].revents = 0;
+			fds[i].priv    = nullptr;
+		}
+
+		int count = 0;
 
-				// If fd is valid
-				if (dev) {
-					PX4_DEBUG("%s: px4_poll: VDev->poll(teardown) %d", thread_name, fds[i].fd);
-					ret = dev->poll(filemap[fds[i].fd], &fds[i], false);
+		if (fd_pollable) {
+			waitset_block(&ws, timeout);
 
-					if (ret < 0) {
-						PX4_WARN("%s: px4_poll() 2nd poll fail", thread_name);
-						break;
-					}
+			// We have waited now (or not, depending on timeout),
+			// go through all fds and count how many have data
+			for (i = 0; i < nsetup; ++i) {
+				if (fds[i].priv == nullptr) {
+					continue;
+				}
 
-					if (fds[i].revents) {
-						count += 1;
-					}
+				if (waitset_teardown(&fds[i]) < 0) {
+					PX4_WARN("px4_poll() 2nd poll fail");
+				}
+
+				if (fds[i].revents) {
+					count += 1;
 				}
 			}
+
+			PX4_TRACE(PX4_TRACE_POLL_WAKEUP, poll_ready_devname(fds, nsetup), count);
 		}
 
-		px4_sem_destroy(&sem);
+#ifndef __PX4_LINUX
+		px4_sem_destroy(&ws.sem);
+#endif
 
-		// Return the positive count if present,
-		// return the negative error number if failed
-		return (count) ? count : ret;
+		// Return the count of ready fds, or an error if nothing could be polled
+		return fd_pollable ? count : -1;
 	}
 
 	int px4_fsync(int fd)
@@ -410,22 +884,42 @@ extern "C" {
 	{
 		px4_sem_init(&lockstep_sem, 0, 0);
 		sim_lockstep = true;
-		sim_delay = false;
+		px4_sim_stop_delay();
 	}
 
 	void px4_sim_start_delay()
 	{
+		pthread_mutex_lock(&sim_delay_mutex);
 		sim_delay = true;
+		pthread_mutex_unlock(&sim_delay_mutex);
 	}
 
 	void px4_sim_stop_delay()
 	{
+		pthread_mutex_lock(&sim_delay_mutex);
 		sim_delay = false;
+		pthread_cond_broadcast(&sim_delay_cond);
+		pthread_mutex_unlock(&sim_delay_mutex);
 	}
 
 	bool px4_sim_delay_enabled()
 	{
-		return sim_delay;
+		return __atomic_load_n(&sim_delay, __ATOMIC_RELAXED);
+	}
+
+	void px4_sim_delay_wait()
+	{
+		if (!px4_sim_delay_enabled()) {
+			return;
+		}
+
+		pthread_mutex_lock(&sim_delay_mutex);
+
+		while (sim_delay) {
+			pthread_cond_wait(&sim_delay_cond, &sim_delay_mutex);
+		}
+
+		pthread_mutex_unlock(&sim_delay_mutex);
 	}
 
 	const char *px4_get_device_names(unsigned int *handle)
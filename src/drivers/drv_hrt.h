@@ -186,6 +186,58 @@ __EXPORT extern	void	hrt_start_delay(void);
  */
 __EXPORT extern void	hrt_stop_delay(void);
 
+/**
+ * Drive the HRT from an external clock, e.g. from the log time during a
+ * lockstep replay.
+ *
+ * From the first call on, hrt_absolute_time() returns the last time passed
+ * in here instead of the system time, and callouts that are due at that time
+ * are run. The time can jump back once when switching the clock source, and
+ * must not decrease afterwards.
+ */
+__EXPORT extern void	hrt_set_external_time(hrt_abstime time);
+
+/**
+ * Return the HRT to the system clock after hrt_set_external_time().
+ *
+ * hrt_absolute_time() continues from the last external time, unless that is
+ * ahead of the system clock, then the time jumps back once. Timeouts still
+ * waiting for the external clock expire.
+ */
+__EXPORT extern void	hrt_clear_external_time(void);
+
+/**
+ * A timeout measured with the external clock, see hrt_external_wait_start().
+ */
+struct hrt_external_wait {
+	hrt_abstime			deadline;
+	void				(*wakeup)(void *arg);
+	void				*arg;
+	struct hrt_external_wait	*next;
+	bool				expired;
+};
+
+/**
+ * Start a timeout on the external clock.
+ *
+ * Blocking calls use this so their timeouts follow the simulated or replayed
+ * time instead of the system time. Once the external time has advanced by
+ * timeout, expired is set and wakeup(arg) is called from the thread setting
+ * the time, so it must not block. It is called right away if timeout is 0.
+ *
+ * @return false if the HRT follows the system clock, or if the calling thread
+ *	sets the external time itself. The caller then waits on the system clock.
+ */
+__EXPORT extern bool	hrt_external_wait_start(struct hrt_external_wait *wait, hrt_abstime timeout,
+		void (*wakeup)(void *arg), void *arg);
+
+/**
+ * Stop a timeout started with hrt_external_wait_start().
+ *
+ * @return true if the timeout expired
+ */
+__EXPORT extern bool	hrt_external_wait_stop(struct hrt_external_wait *wait);
+
 #endif
 
 __END_DECLS
@@ -433,7 +433,7 @@ HC_SR04::ioctl(struct file *filp, int cmd, unsigned long arg)
 			return SENSOR_POLLRATE_MANUAL;
 		}
 
-		return (1000 / _measure_ticks);
+		return (1000000 / USEC_PER_TICK / _measure_ticks);
 
 	case SENSORIOCSQUEUEDEPTH: {
 			/* lower bound is mandatory, upper bound is a sanity check */
@@ -146,7 +146,7 @@ int LidarLite::ioctl(struct file *filp, int cmd, unsigned long arg)
 			return SENSOR_POLLRATE_MANUAL;
 		}
 
-		return (1000 / _measure_ticks);
+		return (1000000 / USEC_PER_TICK / _measure_ticks);
 
 	case SENSORIOCRESET:
 		reset_sensor();
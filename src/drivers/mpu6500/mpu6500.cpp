@@ -527,7 +527,7 @@ MPU6500::MPU6500(int bus, const char *path_accel, const char *path_gyro, spi_dev
 	_reset_retries(perf_alloc(PC_COUNT, "mpu6500_reset_retries")),
 	_duplicates(perf_alloc(PC_COUNT, "mpu6500_duplicates")),
 	_system_latency_perf(perf_alloc_once(PC_ELAPSED, "sys_latency")),
-	_controller_latency_perf(perf_alloc_once(PC_ELAPSED, "ctrl_latency")),
+	_controller_latency_perf(perf_alloc_once(PC_HISTOGRAM, "ctrl_latency")),
 	_register_wait(0),
 	_reset_wait(0),
 	_accel_filter_x(MPU6500_ACCEL_DEFAULT_RATE, MPU6500_ACCEL_DEFAULT_DRIVER_FILTER_FREQ),
@@ -75,6 +75,7 @@
 
 #include <systemlib/systemlib.h>
 #include <systemlib/mixer/mixer.h>
+#include <systemlib/control_latency.h>
 
 #include <uORB/topics/actuator_controls.h>
 #include <uORB/topics/actuator_armed.h>
@@ -134,6 +135,8 @@ private:
 	actuator_controls_s _controls[actuator_controls_s::NUM_ACTUATOR_CONTROL_GROUPS];
 	orb_id_t	_control_topics[actuator_controls_s::NUM_ACTUATOR_CONTROL_GROUPS];
 
+	ControlLatency	_control_latency;
+
 	static void	task_main_trampoline(int argc, char *argv[]);
 	void		task_main();
 
@@ -191,7 +194,8 @@ PWMSim::PWMSim() :
 	_groups_required(0),
 	_groups_subscribed(0),
 	_task_should_exit(false),
-	_mixers(nullptr)
+	_mixers(nullptr),
+	_control_latency("sim_ctrl_latency")
 {
 	_debug_enabled = true;
 	memset(_controls, 0, sizeof(_controls));
@@ -481,6 +485,15 @@ PWMSim::task_main()
 			outputs.noutputs = num_outputs;
 			outputs.timestamp = hrt_absolute_time();
 
+			/* the newest gyro sample any of the mixed groups is based on */
+			outputs.timestamp_sample = 0;
+
+			for (unsigned i = 0; i < actuator_controls_s::NUM_ACTUATOR_CONTROL_GROUPS; i++) {
+				if (_control_subs[i] >= 0 && _controls[i].timestamp_sample > outputs.timestamp_sample) {
+					outputs.timestamp_sample = _controls[i].timestamp_sample;
+				}
+			}
+
 			/* disable unused ports by setting their output to NaN */
 			for (size_t i = 0; i < sizeof(outputs.output) / sizeof(outputs.output[0]); i++) {
 				if (i >= num_outputs) {
@@ -511,6 +524,8 @@ PWMSim::task_main()
 
 			/* and publish for anyone that cares to see */
 			orb_publish(ORB_ID(actuator_outputs), _outputs_pub, &outputs);
+
+			_control_latency.update(outputs.timestamp_sample, outputs.timestamp);
 		}
 
 		/* how about an arming update? */
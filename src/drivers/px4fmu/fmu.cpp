@@ -67,7 +67,11 @@
 #include <systemlib/systemlib.h>
 #include <systemlib/err.h>
 #include <systemlib/mixer/mixer.h>
+#if defined(MIXER_STATIC)
+#include <systemlib/mixer/mixer_static.generated.h>
+#endif
 #include <systemlib/pwm_limit/pwm_limit.h>
+#include <systemlib/control_latency.h>
 #include <systemlib/board_serial.h>
 #include <systemlib/param/param.h>
 #include <drivers/drv_mixer.h>
@@ -198,13 +202,18 @@ private:
 	uint32_t	_pwm_mask;
 	bool		_pwm_initialized;
 
+#if defined(MIXER_STATIC)
+	MixerStatic	_mixer_static;	/**< compiled in from config_mixer_static, replaces loaded mixers */
+#else
 	MixerGroup	*_mixers;
+#endif
 
 	uint32_t	_groups_required;
 	uint32_t	_groups_subscribed;
 	int		_control_subs[actuator_controls_s::NUM_ACTUATOR_CONTROL_GROUPS];
 	actuator_controls_s _controls[actuator_controls_s::NUM_ACTUATOR_CONTROL_GROUPS];
 	orb_id_t	_control_topics[actuator_controls_s::NUM_ACTUATOR_CONTROL_GROUPS];
+	ControlLatency	_control_latency;
 	pollfd	_poll_fds[actuator_controls_s::NUM_ACTUATOR_CONTROL_GROUPS];
 	unsigned	_poll_fds_num;
 
@@ -241,7 +250,7 @@ private:
 	int		set_pwm_rate(unsigned rate_map, unsigned default_rate, unsigned alt_rate);
 	int		pwm_ioctl(file *filp, int cmd, unsigned long arg);
 	void		update_pwm_rev_mask();
-	void		publish_pwm_outputs(uint16_t *values, size_t numvalues);
+	void		publish_pwm_outputs(uint16_t *values, size_t numvalues, hrt_abstime timestamp_sample);
 	void		update_pwm_out_state(bool on);
 	void		pwm_output_set(unsigned i, unsigned value);
 
@@ -316,10 +325,16 @@ PX4FMU::PX4FMU() :
 	_pwm_on(false),
 	_pwm_mask(0),
 	_pwm_initialized(false),
+#if defined(MIXER_STATIC)
+	_mixer_static(control_callback, (uintptr_t)_controls),
+	_groups_required(MixerStatic::groups_required),
+#else
 	_mixers(nullptr),
 	_groups_required(0),
+#endif
 	_groups_subscribed(0),
 	_control_subs{ -1},
+	_control_latency("fmu_ctrl_latency"),
 	_poll_fds_num(0),
 	_failsafe_pwm{0},
 	_disarmed_pwm{0},
@@ -340,6 +355,10 @@ PX4FMU::PX4FMU() :
 	_control_topics[2] = ORB_ID(actuator_controls_2);
 	_control_topics[3] = ORB_ID(actuator_controls_3);
 
+	for (unsigned i = 0; i < actuator_controls_s::NUM_ACTUATOR_CONTROL_GROUPS; i++) {
+		_control_subs[i] = -1;
+	}
+
 	memset(_controls, 0, sizeof(_controls));
 	memset(_poll_fds, 0, sizeof(_poll_fds));
 
@@ -706,7 +725,7 @@ PX4FMU::subscribe()
 			_control_subs[i] = -1;
 		}
 
-		if (_control_subs[i] > 0) {
+		if (_control_subs[i] >= 0) {
 			_poll_fds[_poll_fds_num].fd = _control_subs[i];
 			_poll_fds[_poll_fds_num].events = POLLIN;
 			_poll_fds_num++;
@@ -735,11 +754,12 @@ PX4FMU::update_pwm_rev_mask()
 }
 
 void
-PX4FMU::publish_pwm_outputs(uint16_t *values, size_t numvalues)
+PX4FMU::publish_pwm_outputs(uint16_t *values, size_t numvalues, hrt_abstime timestamp_sample)
 {
 	actuator_outputs_s outputs = {};
 	outputs.noutputs = numvalues;
 	outputs.timestamp = hrt_absolute_time();
+	outputs.timestamp_sample = timestamp_sample;
 
 	for (size_t i = 0; i < _max_actuators; ++i) {
 		outputs.output[i] = i < numvalues ? (float)values[i] : 0;
@@ -752,6 +772,8 @@ PX4FMU::publish_pwm_outputs(uint16_t *values, size_t numvalues)
 	} else {
 		orb_publish(ORB_ID(actuator_outputs), _outputs_pub, &outputs);
 	}
+
+	_control_latency.update(outputs.timestamp_sample, outputs.timestamp);
 }
 
 
@@ -946,7 +968,7 @@ PX4FMU::cycle()
 		DEVICE_DEBUG("adjusted actuator update interval to %ums", update_rate_in_ms);
 
 		for (unsigned i = 0; i < actuator_controls_s::NUM_ACTUATOR_CONTROL_GROUPS; i++) {
-			if (_control_subs[i] > 0) {
+			if (_control_subs[i] >= 0) {
 				orb_set_interval(_control_subs[i], update_rate_in_ms);
 			}
 		}
@@ -975,7 +997,7 @@ PX4FMU::cycle()
 		unsigned poll_id = 0;
 
 		for (unsigned i = 0; i < actuator_controls_s::NUM_ACTUATOR_CONTROL_GROUPS; i++) {
-			if (_control_subs[i] > 0) {
+			if (_control_subs[i] >= 0) {
 				if (_poll_fds[poll_id].revents & POLLIN) {
 					orb_copy(_control_topics[i], _control_subs[i], &_controls[i]);
 
@@ -1013,7 +1035,11 @@ PX4FMU::cycle()
 		}
 
 		/* can we mix? */
+#if defined(MIXER_STATIC)
+		{
+#else
 		if (_mixers != nullptr) {
+#endif
 
 			size_t num_outputs;
 
@@ -1047,7 +1073,11 @@ PX4FMU::cycle()
 
 			/* do mixing */
 			float outputs[_max_actuators];
+#if defined(MIXER_STATIC)
+			num_outputs = _mixer_static.mix(outputs, num_outputs, NULL);
+#else
 			num_outputs = _mixers->mix(outputs, num_outputs, NULL);
+#endif
 
 			/* disable unused ports by setting their output to NaN */
 			for (size_t i = 0; i < sizeof(outputs) / sizeof(outputs[0]); i++) {
@@ -1075,7 +1105,16 @@ PX4FMU::cycle()
 				pwm_output_set(i, pwm_limited[i]);
 			}
 
-			publish_pwm_outputs(pwm_limited, num_outputs);
+			/* the newest gyro sample any of the mixed groups is based on */
+			hrt_abstime timestamp_sample = 0;
+
+			for (unsigned i = 0; i < actuator_controls_s::NUM_ACTUATOR_CONTROL_GROUPS; i++) {
+				if (_control_subs[i] >= 0 && _controls[i].timestamp_sample > timestamp_sample) {
+					timestamp_sample = _controls[i].timestamp_sample;
+				}
+			}
+
+			publish_pwm_outputs(pwm_limited, num_outputs, timestamp_sample);
 		}
 	}
 
@@ -1433,7 +1472,7 @@ void PX4FMU::work_stop()
 	work_cancel(HPWORK, &_work);
 
 	for (unsigned i = 0; i < actuator_controls_s::NUM_ACTUATOR_CONTROL_GROUPS; i++) {
-		if (_control_subs[i] > 0) {
+		if (_control_subs[i] >= 0) {
 			::close(_control_subs[i]);
 			_control_subs[i] = -1;
 		}
@@ -2049,6 +2088,19 @@ PX4FMU::pwm_ioctl(file *filp, int cmd, unsigned long arg)
 		break;
 #endif
 
+#if defined(MIXER_STATIC)
+
+	case MIXERIOCRESET:
+		break;
+
+	case MIXERIOCADDSIMPLE:
+	case MIXERIOCLOADBUF:
+		/* the mixer is compiled in, keep it */
+		warnx("using mixer %s compiled in, not loading", MixerStatic::source());
+		break;
+
+#else
+
 	case MIXERIOCRESET:
 		if (_mixers != nullptr) {
 			delete _mixers;
@@ -2113,6 +2165,8 @@ PX4FMU::pwm_ioctl(file *filp, int cmd, unsigned long arg)
 			break;
 		}
 
+#endif
+
 	default:
 		ret = -ENOTTY;
 		break;
@@ -75,6 +75,7 @@
 #include <systemlib/circuit_breaker.h>
 #include <systemlib/mavlink_log.h>
 #include <systemlib/battery.h>
+#include <systemlib/control_latency.h>
 
 #include <uORB/topics/actuator_controls.h>
 #include <uORB/topics/actuator_outputs.h>
@@ -303,6 +304,8 @@ private:
 	orb_advert_t 		_to_mixer_status; 	///< mixer status flags
 
 	actuator_outputs_s	_outputs;		///< mixed outputs
+	hrt_abstime		_last_timestamp_sample;	///< gyro sample timestamp of the last controls sent to IO
+	ControlLatency		_control_latency;	///< sample to output latency statistics
 	servorail_status_s	_servorail_status;	///< servorail status
 
 	bool			_primary_pwm_device;	///< true if we are the default PWM output
@@ -544,6 +547,8 @@ PX4IO::PX4IO(device::Device *interface) :
 	_to_safety(nullptr),
 	_to_mixer_status(nullptr),
 	_outputs{},
+	_last_timestamp_sample(0),
+	_control_latency("io_ctrl_latency"),
 	_servorail_status{},
 	_primary_pwm_device(false),
 	_lockdown_override(false),
@@ -1363,7 +1368,14 @@ PX4IO::io_set_control_state(unsigned group)
 
 	if (!_test_fmu_fail) {
 		/* copy values to registers in IO */
-		return io_reg_set(PX4IO_PAGE_CONTROLS, group * PX4IO_PROTOCOL_MAX_CONTROL_COUNT, regs, _max_controls);
+		int ret = io_reg_set(PX4IO_PAGE_CONTROLS, group * PX4IO_PROTOCOL_MAX_CONTROL_COUNT, regs, _max_controls);
+
+		if (ret == OK && group == 0) {
+			_last_timestamp_sample = controls.timestamp_sample;
+			_control_latency.update(controls.timestamp_sample, hrt_absolute_time());
+		}
+
+		return ret;
 
 	} else {
 		return OK;
@@ -1959,6 +1971,7 @@ PX4IO::io_publish_pwm_outputs()
 	multirotor_motor_limits_s motor_limits;
 
 	outputs.timestamp = hrt_absolute_time();
+	outputs.timestamp_sample = _last_timestamp_sample;
 
 	/* get servo values from IO */
 	uint16_t ctl[_max_actuators];
@@ -499,6 +499,7 @@ void AttitudeEstimatorQ::task_main()
 			struct control_state_s ctrl_state = {};
 
 			ctrl_state.timestamp = sensors.timestamp;
+			ctrl_state.timestamp_sample = sensors.timestamp;
 
 			/* attitude quaternions for control state */
 			ctrl_state.q[0] = _q(0);
@@ -52,6 +52,7 @@
 #include <string.h>
 #include <semaphore.h>
 #include <unistd.h>
+#include <drivers/drv_hrt.h>
 
 #include "dataman.h"
 #include <systemlib/param/param.h>
@@ -70,6 +71,7 @@ __EXPORT int dm_clear(dm_item_t item);
 __EXPORT void dm_lock(dm_item_t item);
 __EXPORT void dm_unlock(dm_item_t item);
 __EXPORT int dm_restart(dm_reset_reason restart_type);
+__EXPORT int dm_flush(void);
 
 /** Types of function calls supported by the worker task */
 typedef enum {
@@ -77,6 +79,7 @@ typedef enum {
 	dm_read_func,
 	dm_clear_func,
 	dm_restart_func,
+	dm_flush_func,
 	dm_number_of_funcs
 } dm_function_t;
 
@@ -161,6 +164,29 @@ static bool g_task_should_exit;	/**< if true, dataman task should exit */
 #define DM_SECTOR_HDR_SIZE 4	/* data manager per item header overhead */
 static const unsigned k_sector_size = DM_MAX_DATA_SIZE + DM_SECTOR_HDR_SIZE; /* total item sorage space */
 
+/* The RAM image of the data manager file. When it is allocated, reads are served from it in the caller's
+ * context and writes only update it and mark the sector dirty. The worker thread writes dirty sectors back
+ * to the file in batches with a single fsync. If it is NULL every request goes to the file through the worker. */
+static unsigned char *g_ram = NULL;
+static unsigned char *g_dirty = NULL;	/* one bit per sector that is newer in RAM than in the file */
+static unsigned g_num_sectors;
+static bool g_flush_pending;		/* the worker has dirty sectors to write back */
+static px4_sem_t g_ram_mutex;		/* protects g_ram, g_dirty and g_flush_pending, lives as long as the module */
+static bool g_ram_mutex_initialized = false;
+
+#ifdef __PX4_NUTTX
+/* The image needs all of the file in RAM (about 100 KB), make it opt-in on flight controllers */
+static bool g_use_ram_cache = false;
+#else
+static bool g_use_ram_cache = true;
+#endif
+
+/* Time the worker waits for more writes before writing back the dirty sectors */
+#define DM_WRITEBACK_DELAY_MS 50
+
+static unsigned g_sectors_written;
+static unsigned g_fsyncs;
+
 static void init_q(work_q_t *q)
 {
 	sq_init(&(q->q));		/* Initialize the NuttX queue structure */
@@ -267,6 +293,15 @@ dequeue_work_item(void)
 	return work;
 }
 
+static inline bool
+work_queue_empty(void)
+{
+	lock_queue(&g_work_q);
+	bool empty = g_work_q.size == 0;
+	unlock_queue(&g_work_q);
+	return empty;
+}
+
 static int
 enqueue_work_item_and_wait_for_result(work_q_item_t *item)
 {
@@ -545,6 +580,219 @@ _restart(dm_reset_reason reason)
 	return result;
 }
 
+static inline void
+lock_ram(void)
+{
+	px4_sem_wait(&g_ram_mutex);
+}
+
+static inline void
+unlock_ram(void)
+{
+	px4_sem_post(&g_ram_mutex);
+}
+
+static inline void
+mark_dirty(unsigned sector)
+{
+	g_dirty[sector >> 3] |= (1 << (sector & 7));
+}
+
+/* Write to the RAM image, the worker writes the sector back to the file later. Called with the RAM image locked */
+static ssize_t
+_ram_write(dm_item_t item, unsigned char index, dm_persitence_t persistence, const void *buf, size_t count)
+{
+	int offset = calculate_offset(item, index);
+
+	if (offset < 0 || count > DM_MAX_DATA_SIZE) {
+		return -1;
+	}
+
+	unsigned char *sector = g_ram + offset;
+	sector[0] = count;
+	sector[1] = persistence;
+	sector[2] = 0;
+	sector[3] = 0;
+
+	if (count > 0) {
+		memcpy(sector + DM_SECTOR_HDR_SIZE, buf, count);
+	}
+
+	mark_dirty(offset / k_sector_size);
+	g_func_counts[dm_write_func]++;
+	g_flush_pending = true;
+
+	return count;
+}
+
+/* Retrieve from the RAM image. Called with the RAM image locked */
+static ssize_t
+_ram_read(dm_item_t item, unsigned char index, void *buf, size_t count)
+{
+	int offset = calculate_offset(item, index);
+
+	if (offset < 0 || count > DM_MAX_DATA_SIZE) {
+		return -1;
+	}
+
+	ssize_t result;
+
+	const unsigned char *sector = g_ram + offset;
+	result = sector[0];
+
+	if (result > (ssize_t)count) {
+		/* We got more than requested!!! */
+		result = -1;
+
+	} else if (result > 0) {
+		memcpy(buf, sector + DM_SECTOR_HDR_SIZE, result);
+	}
+
+	g_func_counts[dm_read_func]++;
+
+	return result;
+}
+
+/* Invalidate the items of one type in the RAM image */
+static int
+_ram_clear(dm_item_t item)
+{
+	int offset = calculate_offset(item, 0);
+
+	if (offset < 0) {
+		return -1;
+	}
+
+	lock_ram();
+
+	for (unsigned i = 0; i < g_per_item_max_index[item]; i++) {
+		/* Avoid SD flash wear by only writing back items that actually change */
+		if (g_ram[offset]) {
+			g_ram[offset] = 0;
+			mark_dirty(offset / k_sector_size);
+		}
+
+		offset += k_sector_size;
+	}
+
+	unlock_ram();
+	return 0;
+}
+
+/* Invalidate the items in the RAM image that do not persist after the last reset */
+static int
+_ram_restart(dm_reset_reason reason)
+{
+	dm_persitence_t max_persistence = (reason == DM_INIT_REASON_POWER_ON) ? DM_PERSIST_POWER_ON_RESET :
+					  DM_PERSIST_IN_FLIGHT_RESET;
+
+	lock_ram();
+
+	for (unsigned i = 0; i < g_num_sectors; i++) {
+		unsigned char *sector = g_ram + i * k_sector_size;
+
+		if (sector[0] && sector[1] > max_persistence) {
+			sector[0] = 0;
+			mark_dirty(i);
+		}
+	}
+
+	unlock_ram();
+	return 0;
+}
+
+/* Write all dirty sectors of the RAM image back to the file, followed by a single fsync */
+static int
+_flush(void)
+{
+	unsigned char buffer[k_sector_size];
+	unsigned written = 0;
+	int result = 0;
+
+	lock_ram();
+	g_flush_pending = false;
+	unlock_ram();
+
+	for (unsigned i = 0; i < g_num_sectors; i++) {
+		/* copy the sector so that callers are not blocked during the file write */
+		lock_ram();
+		bool dirty = g_dirty[i >> 3] & (1 << (i & 7));
+
+		if (dirty) {
+			memcpy(buffer, g_ram + i * k_sector_size, k_sector_size);
+			g_dirty[i >> 3] &= ~(1 << (i & 7));
+		}
+
+		unlock_ram();
+
+		if (!dirty) {
+			continue;
+		}
+
+		int offset = i * k_sector_size;
+
+		if (lseek(g_task_fd, offset, SEEK_SET) != offset ||
+		    write(g_task_fd, buffer, k_sector_size) != (ssize_t)k_sector_size) {
+			/* keep it dirty, it is retried with the next flush */
+			lock_ram();
+			mark_dirty(i);
+			unlock_ram();
+			result = -1;
+			continue;
+		}
+
+		written++;
+	}
+
+	if (written > 0) {
+		/* Make sure data is written to physical media */
+		fsync(g_task_fd);
+		g_fsyncs++;
+		g_sectors_written += written;
+	}
+
+	return result;
+}
+
+/* Load the data manager file into a newly allocated RAM image */
+static int
+_ram_load(unsigned max_offset)
+{
+	g_num_sectors = max_offset / k_sector_size;
+	g_ram = (unsigned char *)malloc(max_offset);
+	g_dirty = (unsigned char *)calloc((g_num_sectors + 7) / 8, 1);
+
+	if (g_ram == NULL || g_dirty == NULL) {
+		free(g_ram);
+		free(g_dirty);
+		g_ram = NULL;
+		g_dirty = NULL;
+		return -1;
+	}
+
+	/* A file shorter than the image reads as empty items */
+	memset(g_ram, 0, max_offset);
+	g_flush_pending = false;
+
+	if (lseek(g_task_fd, 0, SEEK_SET) != 0) {
+		return 0;
+	}
+
+	unsigned offset = 0;
+
+	while (offset < max_offset) {
+		ssize_t len = read(g_task_fd, g_ram + offset, max_offset - offset);
+
+		if (len <= 0) {
+			break;
+		}
+
+		offset += len;
+	}
+
+	return 0;
+}
+
 /** Write to the data manager file */
 __EXPORT ssize_t
 dm_write(dm_item_t item, unsigned char index, dm_persitence_t persistence, const void *buf, size_t count)
@@ -556,6 +804,28 @@ dm_write(dm_item_t item, unsigned char index, dm_persitence_t persistence, const
 		return -1;
 	}
 
+	/* The mission state commits a mission, it goes through the worker so that all items written before it
+	 * are on physical media first */
+	if (item != DM_KEY_MISSION_STATE) {
+		/* the worker frees the image on exit, so only use it with the lock held */
+		lock_ram();
+
+		if (g_ram) {
+			/* only the first write of a batch needs to wake the worker */
+			bool wakeup_worker = !g_flush_pending;
+			ssize_t result = _ram_write(item, index, persistence, buf, count);
+
+			if (wakeup_worker) {
+				px4_sem_post(&g_work_queued_sema);
+			}
+
+			unlock_ram();
+			return result;
+		}
+
+		unlock_ram();
+	}
+
 	/* get a work item and queue up a write request */
 	if ((work = create_work_item()) == NULL) {
 		return -1;
@@ -583,6 +853,17 @@ dm_read(dm_item_t item, unsigned char index, void *buf, size_t count)
 		return -1;
 	}
 
+	/* the worker frees the image on exit, so only use it with the lock held */
+	lock_ram();
+
+	if (g_ram) {
+		ssize_t result = _ram_read(item, index, buf, count);
+		unlock_ram();
+		return result;
+	}
+
+	unlock_ram();
+
 	/* get a work item and queue up a read request */
 	if ((work = create_work_item()) == NULL) {
 		return -1;
@@ -654,6 +935,28 @@ dm_unlock(dm_item_t item)
 	}
 }
 
+/* Wait until all previous writes are on physical media */
+__EXPORT int
+dm_flush(void)
+{
+	work_q_item_t *work;
+
+	/* Make sure data manager has been started and is not shutting down */
+	if ((g_fd < 0) || g_task_should_exit) {
+		return -1;
+	}
+
+	/* get a work item and queue up a flush request */
+	if ((work = create_work_item()) == NULL) {
+		return -1;
+	}
+
+	work->func = dm_flush_func;
+
+	/* Enqueue the item on the work queue and wait for the worker thread to complete processing it */
+	return enqueue_work_item_and_wait_for_result(work);
+}
+
 /* Tell the data manager about the type of the last reset */
 __EXPORT int
 dm_restart(dm_reset_reason reason)
@@ -711,6 +1014,13 @@ task_main(int argc, char *argv[])
 
 	px4_sem_init(&g_work_queued_sema, 1, 0);
 
+	/* Callers take the RAM image lock even without an image, so that they never race with its teardown.
+	 * It is never destroyed, as a caller that passed the checks in dm_read() or dm_write() may still use it */
+	if (!g_ram_mutex_initialized) {
+		px4_sem_init(&g_ram_mutex, 1, 1);
+		g_ram_mutex_initialized = true;
+	}
+
 	/* See if the data manage file exists and is a multiple of the sector size */
 	g_task_fd = open(k_data_manager_device_path, O_RDONLY | O_BINARY);
 
@@ -754,6 +1064,10 @@ task_main(int argc, char *argv[])
 
 	fsync(g_task_fd);
 
+	if (g_use_ram_cache && _ram_load(max_offset) != 0) {
+		PX4_WARN("Could not allocate data manager RAM image, using the file directly");
+	}
+
 	/* see if we need to erase any items based on restart type */
 	int sys_restart_val;
 
@@ -762,21 +1076,25 @@ task_main(int argc, char *argv[])
 	if (param_get(param_find("SYS_RESTART_TYPE"), &sys_restart_val) == OK) {
 		if (sys_restart_val == DM_INIT_REASON_POWER_ON) {
 			restart_type_str = "Power on restart";
-			_restart(DM_INIT_REASON_POWER_ON);
+			g_ram ? _ram_restart(DM_INIT_REASON_POWER_ON) : _restart(DM_INIT_REASON_POWER_ON);
 
 		} else if (sys_restart_val == DM_INIT_REASON_IN_FLIGHT) {
 			restart_type_str = "In flight restart";
-			_restart(DM_INIT_REASON_IN_FLIGHT);
+			g_ram ? _ram_restart(DM_INIT_REASON_IN_FLIGHT) : _restart(DM_INIT_REASON_IN_FLIGHT);
 		}
 	}
 
+	if (g_ram) {
+		_flush();
+	}
+
 	/* We use two file descriptors, one for the caller context and one for the worker thread */
 	/* They are actually the same but we need to some way to reject caller request while the */
 	/* worker thread is shutting down but still processing requests */
 	g_fd = g_task_fd;
 
-	PX4_INFO("%s, data manager file '%s' size is %d bytes",
-		 restart_type_str, k_data_manager_device_path, max_offset);
+	PX4_INFO("%s, data manager file '%s' size is %d bytes%s",
+		 restart_type_str, k_data_manager_device_path, max_offset, g_ram ? " (RAM cached)" : "");
 
 	/* Tell startup that the worker thread has completed its initialization */
 	px4_sem_post(&g_init_sema);
@@ -801,6 +1119,24 @@ task_main(int argc, char *argv[])
 			/* handle each work item with the appropriate handler */
 			switch (work->func) {
 			case dm_write_func:
+				if (g_ram) {
+					/* write back everything before this item, then the item itself */
+					work->result = _flush();
+
+					if (work->result == 0) {
+						lock_ram();
+						work->result = _ram_write(work->write_params.item, work->write_params.index, work->write_params.persistence,
+									  work->write_params.buf, work->write_params.count);
+						unlock_ram();
+					}
+
+					if (work->result >= 0 && _flush() != 0) {
+						work->result = -1;
+					}
+
+					break;
+				}
+
 				g_func_counts[dm_write_func]++;
 				work->result =
 					_write(work->write_params.item, work->write_params.index, work->write_params.persistence, work->write_params.buf,
@@ -815,12 +1151,39 @@ task_main(int argc, char *argv[])
 
 			case dm_clear_func:
 				g_func_counts[dm_clear_func]++;
-				work->result = _clear(work->clear_params.item);
+
+				if (g_ram) {
+					work->result = _ram_clear(work->clear_params.item);
+
+					if (work->result == 0) {
+						work->result = _flush();
+					}
+
+				} else {
+					work->result = _clear(work->clear_params.item);
+				}
+
 				break;
 
 			case dm_restart_func:
 				g_func_counts[dm_restart_func]++;
-				work->result = _restart(work->restart_params.reason);
+
+				if (g_ram) {
+					work->result = _ram_restart(work->restart_params.reason);
+
+					if (work->result == 0) {
+						work->result = _flush();
+					}
+
+				} else {
+					work->result = _restart(work->restart_params.reason);
+				}
+
+				break;
+
+			case dm_flush_func:
+				g_func_counts[dm_flush_func]++;
+				work->result = g_ram ? _flush() : 0;
 				break;
 
 			default: /* should never happen */
@@ -832,12 +1195,39 @@ task_main(int argc, char *argv[])
 			px4_sem_post(&work->wait_sem);
 		}
 
+		lock_ram();
+		bool flush_pending = g_ram && g_flush_pending;
+		unlock_ram();
+
+		if (flush_pending) {
+			/* Let writers batch up more items unless a caller is waiting for the worker */
+			for (unsigned i = 0; i < DM_WRITEBACK_DELAY_MS / 5 && work_queue_empty() && !g_task_should_exit; i++) {
+				usleep(5000);
+			}
+
+			if (work_queue_empty()) {
+				_flush();
+			}
+		}
+
 		/* time to go???? */
 		if ((g_task_should_exit) && (g_fd < 0)) {
 			break;
 		}
 	}
 
+	if (g_ram) {
+		_flush();
+
+		/* callers check for the image with the lock held */
+		lock_ram();
+		free(g_ram);
+		free(g_dirty);
+		g_ram = NULL;
+		g_dirty = NULL;
+		unlock_ram();
+	}
+
 	close(g_task_fd);
 	g_task_fd = -1;
 
@@ -888,7 +1278,58 @@ status(void)
 	PX4_INFO("Reads    %d", g_func_counts[dm_read_func]);
 	PX4_INFO("Clears   %d", g_func_counts[dm_clear_func]);
 	PX4_INFO("Restarts %d", g_func_counts[dm_restart_func]);
+	PX4_INFO("Flushes  %d", g_func_counts[dm_flush_func]);
 	PX4_INFO("Max Q lengths work %d, free %d", g_work_q.max_size, g_free_q.max_size);
+
+	if (g_ram) {
+		PX4_INFO("RAM image: %d sectors written back, %d fsyncs", g_sectors_written, g_fsyncs);
+	}
+}
+
+/* Time a mission upload (writes until they are on physical media) and its readback */
+static void
+bench(unsigned count)
+{
+	struct mission_item_s item;
+	memset(&item, 0, sizeof(item));
+
+	if (count == 0 || count > DM_KEY_WAYPOINTS_ONBOARD_MAX) {
+		count = DM_KEY_WAYPOINTS_ONBOARD_MAX;
+	}
+
+	hrt_abstime start = hrt_absolute_time();
+
+	for (unsigned i = 0; i < count; i++) {
+		item.lat = 47.397742 + i * 1e-5;
+		item.lon = 8.545594;
+		item.altitude = 10.f + i;
+		item.nav_cmd = NAV_CMD_WAYPOINT;
+
+		if (dm_write(DM_KEY_WAYPOINTS_ONBOARD, i, DM_PERSIST_POWER_ON_RESET, &item, sizeof(item)) != sizeof(item)) {
+			PX4_ERR("write of item %d failed", i);
+			return;
+		}
+	}
+
+	dm_flush();
+
+	hrt_abstime upload = hrt_elapsed_time(&start);
+	unsigned errors = 0;
+	start = hrt_absolute_time();
+
+	for (unsigned i = 0; i < count; i++) {
+		if (dm_read(DM_KEY_WAYPOINTS_ONBOARD, i, &item, sizeof(item)) != sizeof(item) ||
+		    (int)item.altitude != (int)(10 + i)) {
+			errors++;
+		}
+	}
+
+	hrt_abstime readback = hrt_elapsed_time(&start);
+
+	dm_clear(DM_KEY_WAYPOINTS_ONBOARD);
+
+	PX4_INFO("%d items: upload %.3f ms (%.1f us/item), readback %.3f ms (%.1f us/item), %d errors",
+		 count, (double)upload / 1e3, (double)upload / count, (double)readback / 1e3, (double)readback / count, errors);
 }
 
 static void
@@ -902,7 +1343,9 @@ stop(void)
 static void
 usage(void)
 {
-	PX4_INFO("usage: dataman {start [-f datafile]|stop|status|poweronrestart|inflightrestart}");
+	PX4_INFO("usage: dataman {start [-f datafile] [-r|-n]|stop|status|poweronrestart|inflightrestart|bench [count]}");
+	PX4_INFO("       -r/-n: enable/disable the RAM image of the data manager file");
+	PX4_INFO("       bench: overwrites and clears the onboard mission items");
 }
 
 int
@@ -920,14 +1363,27 @@ dataman_main(int argc, char *argv[])
 			return -1;
 		}
 
-		if (argc == 4 && strcmp(argv[2], "-f") == 0) {
-			k_data_manager_device_path = strdup(argv[3]);
-			PX4_INFO("dataman file set to: %s", k_data_manager_device_path);
+		const char *path = default_device_path;
+
+		for (int i = 2; i < argc; i++) {
+			if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+				path = argv[++i];
+				PX4_INFO("dataman file set to: %s", path);
 
-		} else {
-			k_data_manager_device_path = strdup(default_device_path);
+			} else if (strcmp(argv[i], "-r") == 0) {
+				g_use_ram_cache = true;
+
+			} else if (strcmp(argv[i], "-n") == 0) {
+				g_use_ram_cache = false;
+
+			} else {
+				usage();
+				return -1;
+			}
 		}
 
+		k_data_manager_device_path = strdup(path);
+
 		start();
 
 		if (g_fd < 0) {
@@ -961,6 +1417,9 @@ dataman_main(int argc, char *argv[])
 	} else if (!strcmp(argv[1], "inflightrestart")) {
 		dm_restart(DM_INIT_REASON_IN_FLIGHT);
 
+	} else if (!strcmp(argv[1], "bench")) {
+		bench(argc > 2 ? strtoul(argv[2], NULL, 10) : 0);
+
 	} else {
 		usage();
 		return -1;
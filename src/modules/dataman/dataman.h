@@ -100,7 +100,13 @@ dm_read(
 	size_t buflen			/* Length in bytes of data to retrieve */
 );
 
-/** write to the data manager store */
+/**
+ * write to the data manager store
+ *
+ * With the RAM image enabled the item is on physical media after at most a few 10 ms, and before
+ * dm_flush(), dm_clear(), dm_restart() or any write of DM_KEY_MISSION_STATE returns. Writes of
+ * DM_KEY_MISSION_STATE are only started after all items written before them are on physical media.
+ */
 __EXPORT ssize_t
 dm_write(
 	dm_item_t  item,		/* The item type to store */
@@ -134,6 +140,10 @@ dm_restart(
 	dm_reset_reason restart_type	/* The last reset type */
 );
 
+/** Wait until all previous writes are on physical media */
+__EXPORT int
+dm_flush(void);
+
 #ifdef __cplusplus
 }
 #endif
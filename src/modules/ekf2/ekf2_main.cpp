@@ -57,6 +57,7 @@
 #include <arch/board/board.h>
 #include <systemlib/param/param.h>
 #include <systemlib/err.h>
+#include <systemlib/perf_counter.h>
 #include <systemlib/systemlib.h>
 #include <mathlib/mathlib.h>
 #include <mathlib/math/filter/LowPassFilter2p.hpp>
@@ -132,6 +133,7 @@ private:
 	int	_control_task = -1;		// task handle for task
 	bool 	_replay_mode;			// should we use replay data from a log
 	int 	_publish_replay_mode;		// defines if we should publish replay messages
+	perf_counter_t _update_perf;		// distribution of the EKF update time
 	float	_default_ev_pos_noise = 0.05f;	// external vision position noise used when an invalid value is supplied
 	float	_default_ev_ang_noise = 0.05f;	// external vision angle noise used when an invalid value is supplied
 
@@ -282,6 +284,7 @@ Ekf2::Ekf2():
 	SuperBlock(NULL, "EKF"),
 	_replay_mode(false),
 	_publish_replay_mode(0),
+	_update_perf(perf_alloc(PC_HISTOGRAM, "ekf2_update")),
 	_att_pub(nullptr),
 	_lpos_pub(nullptr),
 	_control_state_pub(nullptr),
@@ -377,13 +380,14 @@ Ekf2::Ekf2():
 
 Ekf2::~Ekf2()
 {
-
+	perf_free(_update_perf);
 }
 
 void Ekf2::print_status()
 {
 	warnx("local position OK %s", (_ekf.local_position_is_valid()) ? "[YES]" : "[NO]");
 	warnx("global position OK %s", (_ekf.global_position_is_valid()) ? "[YES]" : "[NO]");
+	perf_print_counter(_update_perf);
 }
 
 void Ekf2::task_main()
@@ -623,7 +627,11 @@ void Ekf2::task_main()
 		}
 
 		// run the EKF update and output
-		if (_ekf.update()) {
+		perf_begin(_update_perf);
+		bool updated = _ekf.update();
+		perf_end(_update_perf);
+
+		if (updated) {
 			// generate vehicle attitude quaternion data
 			struct vehicle_attitude_s att = {};
 			_ekf.copy_quaternion(att.q);
@@ -634,6 +642,7 @@ void Ekf2::task_main()
 			float gyro_bias[3] = {};
 			_ekf.get_gyro_bias(gyro_bias);
 			ctrl_state.timestamp = hrt_absolute_time();
+			ctrl_state.timestamp_sample = sensors.timestamp;
 			float gyro_rad[3];
 			gyro_rad[0] = sensors.gyro_rad[0] - gyro_bias[0];
 			gyro_rad[1] = sensors.gyro_rad[1] - gyro_bias[1];
@@ -899,6 +899,7 @@ void AttitudePositionEstimatorEKF::publishControlState()
 
 	/* Attitude */
 	_ctrl_state.timestamp = _last_sensor_timestamp;
+	_ctrl_state.timestamp_sample = _last_sensor_timestamp;
 	_ctrl_state.q[0] = _ekf->states[0];
 	_ctrl_state.q[1] = _ekf->states[1];
 	_ctrl_state.q[2] = _ekf->states[2];
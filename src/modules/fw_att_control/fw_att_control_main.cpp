@@ -1155,6 +1155,7 @@ FixedwingAttitudeControl::task_main()
 				_rates_sp.yaw = _yaw_ctrl.get_desired_rate();
 
 				_rates_sp.timestamp = hrt_absolute_time();
+				_rates_sp.timestamp_sample = _ctrl_state.timestamp_sample;
 
 				if (_rate_sp_pub != nullptr) {
 					/* publish the attitude rates setpoint */
@@ -1181,9 +1182,9 @@ FixedwingAttitudeControl::task_main()
 
 			/* lazily publish the setpoint only once available */
 			_actuators.timestamp = hrt_absolute_time();
-			_actuators.timestamp_sample = _ctrl_state.timestamp;
+			_actuators.timestamp_sample = _ctrl_state.timestamp_sample;
 			_actuators_airframe.timestamp = hrt_absolute_time();
-			_actuators_airframe.timestamp_sample = _ctrl_state.timestamp;
+			_actuators_airframe.timestamp_sample = _ctrl_state.timestamp_sample;
 
 			/* Only publish if any of the proper modes are enabled */
 			if (_vcontrol_mode.flag_control_rates_enabled ||
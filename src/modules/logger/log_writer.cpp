@@ -33,6 +33,7 @@
 
 #include "log_writer.h"
 #include "messages.h"
+#include "ulog_compression.h"
 #include <fcntl.h>
 #include <string.h>
 
@@ -55,17 +56,35 @@ LogWriter::LogWriter(size_t buffer_size) :
 	/* allocate write performance counters */
 	_perf_write = perf_alloc(PC_ELAPSED, "sd write");
 	_perf_fsync = perf_alloc(PC_ELAPSED, "sd fsync");
+	_perf_compress = perf_alloc(PC_ELAPSED, "log compress");
 }
 
-bool LogWriter::init()
+bool LogWriter::init(size_t max_reserve, bool compress)
 {
 	if (_buffer) {
-		return true;
+		return max_reserve <= _max_reserve && compress == _compress;
 	}
 
-	_buffer = new uint8_t[_buffer_size];
+	_max_reserve = max_reserve;
+	_buffer = new uint8_t[_buffer_size + _max_reserve];
 
-	return _buffer;
+	if (!_buffer) {
+		return false;
+	}
+
+	if (compress) {
+		// a frame is added while less than _min_write_chunk bytes are pending
+		_frame_buffer = new uint8_t[_min_write_chunk + sizeof(ulog_compressed_frame_header_s) + ULOG_COMPRESSED_FRAME_MAX];
+		_hash_table = new uint16_t[ULOG_COMPRESSED_HASH_SIZE];
+
+		if (!_frame_buffer || !_hash_table) {
+			return false;
+		}
+
+		_compress = true;
+	}
+
+	return true;
 }
 
 LogWriter::~LogWriter()
@@ -74,10 +93,29 @@ LogWriter::~LogWriter()
 	pthread_cond_destroy(&_cv);
 	perf_free(_perf_write);
 	perf_free(_perf_fsync);
+	perf_free(_perf_compress);
 
 	if (_buffer) {
 		delete[] _buffer;
 	}
+
+	if (_frame_buffer) {
+		delete[] _frame_buffer;
+	}
+
+	if (_hash_table) {
+		delete[] _hash_table;
+	}
+}
+
+void LogWriter::print_perf_counters()
+{
+	perf_print_counter(_perf_write);
+	perf_print_counter(_perf_fsync);
+
+	if (_compress) {
+		perf_print_counter(_perf_compress);
+	}
 }
 
 void LogWriter::start_log(const char *filename)
@@ -96,10 +134,13 @@ void LogWriter::start_log(const char *filename)
 		_running = true;
 	}
 
-	// Clear buffer and counters
+	// Clear buffer and counters. The writer thread is idle until notified.
 	_head = 0;
-	_count = 0;
+	_tail = 0;
+	__atomic_store_n(&_count, 0, __ATOMIC_RELEASE);
 	_total_written = 0;
+	_total_logged = 0;
+	_frame_fill = 0;
 	notify();
 }
 
@@ -162,13 +203,18 @@ void LogWriter::run()
 		int poll_count = 0;
 		int written = 0;
 
+		if (_compress && write_file(ulog_compressed_magic, sizeof(ulog_compressed_magic)) < 0) {
+			PX4_WARN("error writing log file");
+			_should_run = false;
+		}
+
 		while (true) {
 			size_t available = 0;
 			void *read_ptr = nullptr;
 			bool is_part = false;
 
-			/* lock _buffer
-			 * wait for sufficient data, cycle on notify()
+			/* wait for sufficient data, cycle on notify()
+			 * the mutex only protects the wait, not the buffer
 			 */
 			pthread_mutex_lock(&_mtx);
 
@@ -191,9 +237,14 @@ void LogWriter::run()
 			written = 0;
 
 			if (available > 0) {
-				perf_begin(_perf_write);
-				written = ::write(_fd, read_ptr, available);
-				perf_end(_perf_write);
+				if (_compress) {
+					// one frame per chunk
+					available = math::min(available, (size_t)ULOG_COMPRESSED_FRAME_MAX);
+					written = compress_frame((const uint8_t *)read_ptr, available);
+
+				} else {
+					written = write_file(read_ptr, available);
+				}
 
 				/* call fsync periodically to minimize potential loss of data */
 				if (++poll_count >= 100) {
@@ -210,19 +261,19 @@ void LogWriter::run()
 					break;
 				}
 
-				pthread_mutex_lock(&_mtx);
 				/* subtract bytes written from number in _buffer (_count -= written) */
 				mark_read(written);
-				pthread_mutex_unlock(&_mtx);
 
-				_total_written += written;
+				_total_logged += written;
 			}
 
-			if (!_should_run && written == static_cast<int>(available) && !is_part) {
+			if (!_should_run && get_buffer_fill_count() == 0) {
 				// Stop only when all data written
 				_running = false;
-				_head = 0;
-				_count = 0;
+
+				if (_compress && flush_frames(true)) {
+					PX4_WARN("error writing log file");
+				}
 
 				if (_fd >= 0) {
 					int res = ::close(_fd);
@@ -242,18 +293,81 @@ void LogWriter::run()
 	}
 }
 
-bool LogWriter::write(void *ptr, size_t size, uint64_t dropout_start)
+ssize_t LogWriter::write_file(const void *ptr, size_t size)
 {
+	perf_begin(_perf_write);
+	ssize_t written = ::write(_fd, ptr, size);
+	perf_end(_perf_write);
+
+	if (written > 0) {
+		_total_written += written;
+	}
+
+	return written;
+}
+
+int LogWriter::compress_frame(const uint8_t *ptr, size_t size)
+{
+	perf_begin(_perf_compress);
+
+	ulog_compressed_frame_header_s header;
+	uint8_t *data = &_frame_buffer[_frame_fill + sizeof(header)];
+
+	// only keep the compressed data if it is smaller
+	int compressed = ulog_compress_block(ptr, size, data, size - 1, _hash_table);
+
+	if (compressed > 0) {
+		header.data_size = compressed;
+
+	} else {
+		memcpy(data, ptr, size);
+		header.data_size = size | ULOG_COMPRESSED_FRAME_STORED;
+	}
+
+	header.raw_size = size;
+	memcpy(&_frame_buffer[_frame_fill], &header, sizeof(header));
+	_frame_fill += sizeof(header) + (header.data_size & ~ULOG_COMPRESSED_FRAME_STORED);
 
-	// Bytes available to write
-	size_t available = _buffer_size - _count;
+	perf_end(_perf_compress);
+
+	while (_frame_fill >= _min_write_chunk) {
+		if (flush_frames(false)) {
+			return -1;
+		}
+	}
+
+	return size;
+}
+
+int LogWriter::flush_frames(bool all)
+{
+	const size_t size = all ? _frame_fill : _min_write_chunk;
+	size_t offset = 0;
+
+	while (offset < size) {
+		ssize_t written = write_file(&_frame_buffer[offset], size - offset);
+
+		if (written <= 0) {
+			return -1;
+		}
+
+		offset += written;
+	}
+
+	_frame_fill -= size;
+	memmove(_frame_buffer, &_frame_buffer[size], _frame_fill);
+	return 0;
+}
+
+bool LogWriter::write_dropout(uint64_t dropout_start, size_t size)
+{
 	size_t dropout_size = 0;
 
 	if (dropout_start) {
 		dropout_size = sizeof(ulog_message_dropout_s);
 	}
 
-	if (size + dropout_size > available) {
+	if (size + dropout_size > available()) {
 		// buffer overflow
 		return false;
 	}
@@ -265,10 +379,40 @@ bool LogWriter::write(void *ptr, size_t size, uint64_t dropout_start)
 		write_no_check(&dropout_msg, sizeof(dropout_msg));
 	}
 
+	return true;
+}
+
+bool LogWriter::write(void *ptr, size_t size, uint64_t dropout_start)
+{
+	if (!write_dropout(dropout_start, size)) {
+		return false;
+	}
+
 	write_no_check(ptr, size);
 	return true;
 }
 
+uint8_t *LogWriter::reserve(size_t size, uint64_t dropout_start)
+{
+	if (size > _max_reserve || !write_dropout(dropout_start, size)) {
+		return nullptr;
+	}
+
+	return &_buffer[_head];
+}
+
+void LogWriter::commit(size_t size)
+{
+	size_t n = _buffer_size - _head;	// bytes to end of the buffer
+
+	if (size > n) {
+		// the message was written past the end of the buffer: move that part to the start
+		memcpy(_buffer, &_buffer[_buffer_size], size - n);
+	}
+
+	publish(size);
+}
+
 void LogWriter::write_no_check(void *ptr, size_t size)
 {
 	size_t n = _buffer_size - _head;	// bytes to end of the buffer
@@ -278,34 +422,29 @@ void LogWriter::write_no_check(void *ptr, size_t size)
 	if (size > n) {
 		// Message goes over the end of the buffer
 		memcpy(&(_buffer[_head]), buffer_c, n);
-		_head = 0;
+		memcpy(_buffer, &(buffer_c[n]), size - n);
 
 	} else {
-		n = 0;
+		memcpy(&(_buffer[_head]), buffer_c, size);
 	}
 
-	// now: n = bytes already written
-	size_t p = size - n;	// number of bytes to write
-	memcpy(&(_buffer[_head]), &(buffer_c[n]), p);
-	_head = (_head + p) % _buffer_size;
-	_count += size;
+	publish(size);
 }
 
 size_t LogWriter::get_read_ptr(void **ptr, bool *is_part)
 {
 	// bytes available to read
-	int read_ptr = _head - _count;
+	size_t count = __atomic_load_n(&_count, __ATOMIC_ACQUIRE);
+
+	*ptr = &_buffer[_tail];
 
-	if (read_ptr < 0) {
-		read_ptr += _buffer_size;
-		*ptr = &_buffer[read_ptr];
+	if (_tail + count > _buffer_size) {
 		*is_part = true;
-		return _buffer_size - read_ptr;
+		return _buffer_size - _tail;
 
 	} else {
-		*ptr = &_buffer[read_ptr];
 		*is_part = false;
-		return _count;
+		return count;
 	}
 }
 
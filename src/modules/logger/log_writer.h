@@ -44,13 +44,25 @@ namespace px4
 namespace logger
 {
 
+/**
+ * Byte ring buffer between the logger thread (the only producer) and the
+ * writer thread (the only consumer). Both sides run without a lock: the
+ * producer owns _head, the consumer owns _tail and _count is updated
+ * atomically by both. The mutex and condition variable are only used to put
+ * the writer thread to sleep.
+ */
 class LogWriter
 {
 public:
 	LogWriter(size_t buffer_size);
 	~LogWriter();
 
-	bool init();
+	/**
+	 * Allocate the buffer.
+	 * @param max_reserve largest size that will be passed to reserve()
+	 * @param compress write block compressed logs (@see ulog_compression.h)
+	 */
+	bool init(size_t max_reserve, bool compress = false);
 
 	/**
 	 * start the thread
@@ -66,32 +78,57 @@ public:
 	void stop_log();
 
 	/**
-	 * Write data to be logged. The caller must call lock() before calling this.
+	 * Write data to be logged. Must only be called from the logger thread.
 	 * @param dropout_start timestamp when lastest dropout occured. 0 if no dropout at the moment.
 	 * @return true on success, false if not enough space in the buffer left
 	 */
 	bool write(void *ptr, size_t size, uint64_t dropout_start = 0);
 
-	void lock()
+	/**
+	 * Reserve contiguous space for a message, so it can be written in place
+	 * (e.g. with orb_copy()). Nothing is visible to the writer thread until
+	 * commit() is called. Must only be called from the logger thread.
+	 * @param size maximum message size, at most the max_reserve passed to init()
+	 * @param dropout_start timestamp when lastest dropout occured. 0 if no dropout at the moment.
+	 * @return start of the reserved space, nullptr if not enough space in the buffer left
+	 */
+	uint8_t *reserve(size_t size, uint64_t dropout_start = 0);
+
+	/**
+	 * Hand the first size bytes of the last reservation to the writer thread.
+	 */
+	void commit(size_t size);
+
+	void notify()
 	{
 		pthread_mutex_lock(&_mtx);
+		pthread_cond_broadcast(&_cv);
+		pthread_mutex_unlock(&_mtx);
 	}
 
-	void unlock()
+	/**
+	 * @return number of bytes written to the file
+	 */
+	size_t get_total_written() const
 	{
-		pthread_mutex_unlock(&_mtx);
+		return _total_written;
 	}
 
-	void notify()
+	/**
+	 * @return number of ULog bytes written, before compression
+	 */
+	size_t get_total_logged() const
 	{
-		pthread_cond_broadcast(&_cv);
+		return _total_logged;
 	}
 
-	size_t get_total_written() const
+	bool is_compressed() const
 	{
-		return _total_written;
+		return _compress;
 	}
 
+	void print_perf_counters();
+
 	size_t get_buffer_size() const
 	{
 		return _buffer_size;
@@ -99,7 +136,7 @@ public:
 
 	size_t get_buffer_fill_count() const
 	{
-		return _count;
+		return __atomic_load_n(&_count, __ATOMIC_RELAXED);
 	}
 
 private:
@@ -111,9 +148,45 @@ private:
 
 	void mark_read(size_t n)
 	{
-		_count -= n;
+		_tail = (_tail + n) % _buffer_size;
+		__atomic_fetch_sub(&_count, n, __ATOMIC_RELEASE);
+	}
+
+	size_t available() const
+	{
+		return _buffer_size - __atomic_load_n(&_count, __ATOMIC_ACQUIRE);
+	}
+
+	/**
+	 * Make size bytes at _head visible to the writer thread
+	 */
+	void publish(size_t size)
+	{
+		_head = (_head + size) % _buffer_size;
+		__atomic_fetch_add(&_count, size, __ATOMIC_RELEASE);
 	}
 
+	bool write_dropout(uint64_t dropout_start, size_t size);
+
+	/**
+	 * Write to the file and count the written bytes
+	 */
+	ssize_t write_file(const void *ptr, size_t size);
+
+	/**
+	 * Compress one frame into _frame_buffer, and write out _frame_buffer
+	 * in _min_write_chunk units.
+	 * @return size on success, -1 on write error
+	 */
+	int compress_frame(const uint8_t *ptr, size_t size);
+
+	/**
+	 * Write out _frame_buffer.
+	 * @param all write all of it, otherwise only the first _min_write_chunk bytes
+	 * @return 0 on success, -1 on write error
+	 */
+	int flush_frames(bool all);
+
 	/**
 	 * Write to the buffer but assuming there is enough space
 	 */
@@ -124,11 +197,18 @@ private:
 
 	char		_filename[64];
 	int			_fd = -1;
-	uint8_t 	*_buffer = nullptr;
+	uint8_t 	*_buffer = nullptr; ///< _buffer_size bytes, followed by _max_reserve bytes for reservations that wrap
 	const size_t	_buffer_size;
-	size_t			_head = 0; ///< next position to write to
+	size_t		_max_reserve = 0;
+	size_t			_head = 0; ///< next position to write to (logger thread)
+	size_t			_tail = 0; ///< next position to read from (writer thread)
 	size_t			_count = 0; ///< number of bytes in _buffer to be written
 	size_t		_total_written = 0;
+	size_t		_total_logged = 0;
+	bool		_compress = false;
+	uint8_t		*_frame_buffer = nullptr; ///< compressed frames not yet written to the file
+	size_t		_frame_fill = 0;
+	uint16_t	*_hash_table = nullptr; ///< compressor scratch space
 	bool		_should_run = false;
 	bool		_running = false;
 	bool 		_exit_thread = false;
@@ -136,6 +216,7 @@ private:
 	pthread_cond_t		_cv;
 	perf_counter_t _perf_write;
 	perf_counter_t _perf_fsync;
+	perf_counter_t _perf_compress;
 };
 
 }
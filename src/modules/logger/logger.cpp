@@ -43,6 +43,7 @@
 #include <uORB/uORB.h>
 #include <uORB/uORBTopics.h>
 #include <uORB/Subscription.hpp>
+#include <uORB/topics/logger_bench.h>
 #include <uORB/topics/mavlink_log.h>
 #include <uORB/topics/parameter_update.h>
 #include <uORB/topics/vehicle_status.h>
@@ -53,6 +54,7 @@
 #include <px4_getopt.h>
 #include <px4_log.h>
 #include <px4_sem.h>
+#include <mathlib/mathlib.h>
 #include <systemlib/mavlink_log.h>
 #include <replay/definitions.hpp>
 
@@ -81,18 +83,15 @@
 
 using namespace px4::logger;
 
+static const orb_metadata *const bench_topics[] = {
+	ORB_ID(logger_bench_0), ORB_ID(logger_bench_1), ORB_ID(logger_bench_2), ORB_ID(logger_bench_3),
+	ORB_ID(logger_bench_4), ORB_ID(logger_bench_5), ORB_ID(logger_bench_6), ORB_ID(logger_bench_7)
+};
+
 static Logger *logger_ptr = nullptr;
 static int logger_task = -1;
 static pthread_t writer_thread;
 
-/* This is used to schedule work for the logger (periodic scan for updated topics) */
-static void timer_callback(void *arg)
-{
-	px4_sem_t *semaphore = (px4_sem_t *)arg;
-	px4_sem_post(semaphore);
-}
-
-
 int logger_main(int argc, char *argv[])
 {
 	// logger currently assumes little endian
@@ -129,6 +128,21 @@ int logger_main(int argc, char *argv[])
 		return 0;
 	}
 
+	if (!strcmp(argv[1], "bench")) {
+
+		if (logger_ptr != nullptr) {
+			PX4_INFO("already running");
+			return 1;
+		}
+
+		if (OK != Logger::start((char *const *)argv)) {
+			PX4_WARN("start failed");
+			return 1;
+		}
+
+		return 0;
+	}
+
 	if (!strcmp(argv[1], "on")) {
 		if (logger_ptr != nullptr) {
 			logger_ptr->set_arm_override(true);
@@ -178,6 +192,7 @@ namespace px4
 {
 namespace logger
 {
+constexpr unsigned Logger::MAX_BENCH_INSTANCES;
 
 void Logger::usage(const char *reason)
 {
@@ -185,12 +200,17 @@ void Logger::usage(const char *reason)
 		PX4_WARN("%s\n", reason);
 	}
 
-	PX4_INFO("usage: logger {start|stop|on|off|status} [-r <log rate>] [-b <buffer size>] -e -a -t -x\n"
+	PX4_INFO("usage: logger {start|stop|on|off|status|bench} [-r <log rate>] [-b <buffer size>] -e -a -t -x -z\n"
 		 "\t-r\tLog rate in Hz, 0 means unlimited rate\n"
 		 "\t-b\tLog buffer size in KiB, default is 12\n"
 		 "\t-e\tEnable logging right after start until disarm (otherwise only when armed)\n"
 		 "\t-f\tLog until shutdown (implies -e)\n"
-		 "\t-t\tUse date/time for naming log directories and files");
+		 "\t-t\tUse date/time for naming log directories and files\n"
+		 "\t-z\tWrite block compressed logs (.ulz)\n"
+		 "bench: log only synthetic topics, then report throughput, dropouts and write cost (use -z to compare compression)\n"
+		 "\t-n\tNumber of topic instances, default is 8 (max %u)\n"
+		 "\t-p\tPublication rate of each instance in Hz, default is 250\n"
+		 "\t-d\tDuration in seconds, default is 10", MAX_BENCH_INSTANCES);
 }
 
 int Logger::start(char *const *argv)
@@ -222,6 +242,19 @@ void Logger::status()
 	} else {
 		PX4_INFO("Running");
 		print_statistics();
+		print_topic_statistics();
+	}
+}
+
+void Logger::print_topic_statistics()
+{
+	float seconds = ((float)(hrt_absolute_time() - _start_time)) / 1000000.0f;
+
+	PX4_INFO("%-32s %8s %10s %9s %8s", "topic", "msgs", "KiB", "rate [Hz]", "cap [ms]");
+
+	for (const LoggerSubscription &sub : _subscriptions) {
+		PX4_INFO("%-32s %8u %10.1f %9.1f %8u", sub.metadata->o_name, (unsigned)sub.messages,
+			 (double)(sub.bytes / 1024.0f), (double)(sub.messages / seconds), (unsigned)sub.interval);
 	}
 }
 void Logger::print_statistics()
@@ -235,6 +268,12 @@ void Logger::print_statistics()
 	float seconds = ((float)(hrt_absolute_time() - _start_time)) / 1000000.0f;
 
 	PX4_INFO("Wrote %4.2f MiB (avg %5.2f KiB/s)", (double)mebibytes, (double)(kibibytes / seconds));
+
+	if (_writer.is_compressed() && _writer.get_total_written() > 0) {
+		PX4_INFO("Compressed %4.2f MiB of log data (ratio %.2f)", (double)(_writer.get_total_logged() / 1024.f / 1024.f),
+			 (double)((float)_writer.get_total_logged() / _writer.get_total_written()));
+	}
+
 	PX4_INFO("Since last status: dropouts: %zu (max len: %.3f s), max used buffer: %zu / %zu B",
 		 _write_dropouts, (double)_max_dropout_duration, _high_water, _writer.get_buffer_size());
 	_high_water = 0;
@@ -250,12 +289,16 @@ void Logger::run_trampoline(int argc, char *argv[])
 	bool log_until_shutdown = false;
 	bool error_flag = false;
 	bool log_name_timestamp = false;
+	bool log_compressed = false;
+	unsigned bench_instances = 8;
+	unsigned bench_rate = 250;
+	unsigned bench_duration = 10;
 
 	int myoptind = 1;
 	int ch;
 	const char *myoptarg = NULL;
 
-	while ((ch = px4_getopt(argc, argv, "r:b:etf", &myoptind, &myoptarg)) != EOF) {
+	while ((ch = px4_getopt(argc, argv, "r:b:etfzn:p:d:", &myoptind, &myoptarg)) != EOF) {
 		switch (ch) {
 		case 'r': {
 				unsigned long r = strtoul(myoptarg, NULL, 10);
@@ -292,6 +335,22 @@ void Logger::run_trampoline(int argc, char *argv[])
 			log_until_shutdown = true;
 			break;
 
+		case 'z':
+			log_compressed = true;
+			break;
+
+		case 'n':
+			bench_instances = math::constrain((unsigned)strtoul(myoptarg, NULL, 10), 1u, MAX_BENCH_INSTANCES);
+			break;
+
+		case 'p':
+			bench_rate = math::max((unsigned)strtoul(myoptarg, NULL, 10), 1u);
+			break;
+
+		case 'd':
+			bench_duration = strtoul(myoptarg, NULL, 10);
+			break;
+
 		case '?':
 			error_flag = true;
 			break;
@@ -308,8 +367,22 @@ void Logger::run_trampoline(int argc, char *argv[])
 		return;
 	}
 
+	// non-option arguments were moved to the end by px4_getopt
+	bool benchmark = false;
+
+	for (int i = myoptind; i < argc; i++) {
+		if (!strcmp(argv[i], "bench")) {
+			benchmark = true;
+		}
+	}
+
+	if (benchmark) {
+		log_on_start = true;
+		log_until_shutdown = true;
+	}
+
 	logger_ptr = new Logger(log_buffer_size, log_interval, log_on_start,
-				log_until_shutdown, log_name_timestamp);
+				log_until_shutdown, log_name_timestamp, log_compressed);
 
 #if defined(DBGPRINT) && defined(__PX4_NUTTX)
 	struct mallinfo alloc_info = mallinfo();
@@ -328,6 +401,10 @@ void Logger::run_trampoline(int argc, char *argv[])
 			logger_ptr->setReplayFile(logfile);
 		}
 
+		if (benchmark) {
+			logger_ptr->set_benchmark(bench_instances, bench_rate, bench_duration);
+		}
+
 		logger_ptr->run();
 	}
 
@@ -336,11 +413,12 @@ void Logger::run_trampoline(int argc, char *argv[])
 
 
 Logger::Logger(size_t buffer_size, uint32_t log_interval, bool log_on_start,
-	       bool log_until_shutdown, bool log_name_timestamp) :
+	       bool log_until_shutdown, bool log_name_timestamp, bool log_compressed) :
 	_arm_override(false),
 	_log_on_start(log_on_start),
 	_log_until_shutdown(log_until_shutdown),
 	_log_name_timestamp(log_name_timestamp),
+	_log_compressed(log_compressed),
 	_writer(buffer_size),
 	_log_interval(log_interval)
 {
@@ -373,9 +451,6 @@ Logger::~Logger()
 		free(_replay_file_name);
 	}
 
-	if (_msg_buffer) {
-		delete[](_msg_buffer);
-	}
 }
 
 int Logger::add_topic(const orb_metadata *topic)
@@ -420,53 +495,264 @@ int Logger::add_topic(const char *name, unsigned interval = 0)
 	}
 
 	if (fd >= 0 && interval != 0) {
+		_subscriptions[_subscriptions.size() - 1].interval = interval;
 		orb_set_interval(fd, interval);
 	}
 
 	return fd;
 }
 
-bool Logger::copy_if_updated_multi(LoggerSubscription &sub, int multi_instance, void *buffer)
+void Logger::subscribe_new_instances()
 {
-	bool updated = false;
-	int &handle = sub.fd[multi_instance];
+	// only check after a certain interval to avoid high cpu usage
+	if (_time_tried_subscribe != 0 && hrt_elapsed_time(&_time_tried_subscribe) < TRY_SUBSCRIBE_INTERVAL) {
+		return;
+	}
 
-	// only try to subscribe to topic if this is the first time
-	// after that just check after a certain interval to avoid high cpu usage
-	if (handle < 0 && (sub.time_tried_subscribe == 0 ||
-			   hrt_elapsed_time(&sub.time_tried_subscribe) > TRY_SUBSCRIBE_INTERVAL)) {
-		sub.time_tried_subscribe = hrt_absolute_time();
+	_time_tried_subscribe = hrt_absolute_time();
 
-		if (OK == orb_exists(sub.metadata, multi_instance)) {
-			handle = orb_subscribe_multi(sub.metadata, multi_instance);
+	for (size_t i = 0; i < _subscriptions.size(); i++) {
+		LoggerSubscription &sub = _subscriptions[i];
 
-			//PX4_INFO("subscribed to instance %d of topic %s", multi_instance, topic->o_name);
+		for (int instance = 1; instance < ORB_MULTI_MAX_INSTANCES; instance++) {
+			if (sub.fd[instance] >= 0 || OK != orb_exists(sub.metadata, instance)) {
+				continue;
+			}
 
-			/* copy first data */
-			if (handle >= 0) {
-				write_add_logged_msg(sub, multi_instance);
+			sub.fd[instance] = orb_subscribe_multi(sub.metadata, instance);
 
-				/* set to the same interval as the first instance */
-				unsigned int interval;
+			//PX4_INFO("subscribed to instance %d of topic %s", instance, sub.metadata->o_name);
+
+			if (sub.fd[instance] >= 0) {
+				if (_enabled) {
+					write_add_logged_msg(sub, instance);
+				}
 
-				if (orb_get_interval(sub.fd[0], &interval) == 0 && interval > 0) {
-					orb_set_interval(handle, interval);
+				/* set to the same interval as the first instance */
+				if (sub.interval > 0) {
+					orb_set_interval(sub.fd[instance], sub.interval);
 				}
 
-				orb_copy(sub.metadata, handle, buffer);
-				updated = true;
+				/* the first data is reported by the next poll */
+				poll_add(sub.fd[instance], i * ORB_MULTI_MAX_INSTANCES + instance);
+			}
+		}
+	}
+}
+
+bool Logger::write_topic(LoggerSubscription &sub, int instance)
+{
+	/* each message consists of a header followed by an orb data object
+	 */
+	size_t msg_size = sizeof(ulog_message_data_header_s) + sub.metadata->o_size_no_padding;
+
+	//orb_copy writes o_size bytes, only msg_size of them are committed
+	uint8_t *buffer = reserve(sizeof(ulog_message_data_header_s) + sub.metadata->o_size);
+
+	if (!buffer) {
+		return false;
+	}
+
+	orb_copy(sub.metadata, sub.fd[instance], buffer + sizeof(ulog_message_data_header_s));
+
+	uint16_t write_msg_size = static_cast<uint16_t>(msg_size - ULOG_MSG_HEADER_LEN);
+	//write one byte after another (necessary because of alignment)
+	buffer[0] = (uint8_t)write_msg_size;
+	buffer[1] = (uint8_t)(write_msg_size >> 8);
+	buffer[2] = static_cast<uint8_t>(ULogMessageType::DATA);
+	uint16_t write_msg_id = sub.msg_ids[instance];
+	buffer[3] = (uint8_t)write_msg_id;
+	buffer[4] = (uint8_t)(write_msg_id >> 8);
+
+	//PX4_INFO("topic: %s, size = %zu, out_size = %zu", sub.metadata->o_name, sub.metadata->o_size, msg_size);
+
+	_writer.commit(msg_size);
+
+	++sub.messages;
+	sub.bytes += msg_size;
+
+	return true;
+}
+
+bool Logger::poll_init(unsigned capacity)
+{
+	_poll_targets = new uint16_t[capacity];
+
+	if (_poll_targets == nullptr) {
+		return false;
+	}
+
+#ifdef __PX4_POSIX
+
+	if (px4_waitset_init(&_poll_set, capacity) != PX4_OK) {
+		return false;
+	}
+
+#else
+	_poll_fds = new px4_pollfd_struct_t[capacity];
+
+	if (_poll_fds == nullptr) {
+		return false;
+	}
+
+#endif
+
+	_poll_capacity = capacity;
+	_poll_count = 0;
+	return true;
+}
+
+void Logger::poll_deinit()
+{
+#ifdef __PX4_POSIX
+
+	if (_poll_capacity > 0) {
+		px4_waitset_deinit(&_poll_set);
+	}
+
+#else
+
+	if (_poll_fds) {
+		delete[] _poll_fds;
+		_poll_fds = nullptr;
+	}
+
+#endif
+
+	if (_poll_targets) {
+		delete[] _poll_targets;
+		_poll_targets = nullptr;
+	}
+
+	_poll_capacity = 0;
+	_poll_count = 0;
+}
+
+void Logger::poll_add(int fd, uint16_t target)
+{
+	if (fd < 0 || _poll_count >= _poll_capacity) {
+		return;
+	}
+
+#ifdef __PX4_POSIX
+
+	/* fds are never removed, so the wait set hands out consecutive indexes */
+	if (px4_waitset_add(&_poll_set, fd, POLLIN) < 0) {
+		PX4_WARN("failed to poll fd %i", fd);
+		return;
+	}
+
+#else
+	_poll_fds[_poll_count].fd = fd;
+	_poll_fds[_poll_count].events = POLLIN;
+	_poll_fds[_poll_count].revents = 0;
+#endif
+
+	_poll_targets[_poll_count++] = target;
+}
+
+int Logger::poll_wait(int timeout)
+{
+#ifdef __PX4_POSIX
+	return px4_waitset_wait(&_poll_set, timeout);
+#else
+	return px4_poll(_poll_fds, _poll_count, timeout);
+#endif
+}
+
+uint16_t Logger::poll_target(unsigned index) const
+{
+#ifdef __PX4_POSIX
+	pollevent_t revents = px4_waitset_revents(&_poll_set, index);
+#else
+	pollevent_t revents = _poll_fds[index].revents;
+#endif
+
+	return (revents & POLLIN) ? _poll_targets[index] : POLL_TARGET_NONE;
+}
+
+void Logger::set_benchmark(unsigned instances, unsigned rate, unsigned duration)
+{
+	_bench_instances = instances;
+	_bench_rate = rate;
+	_bench_duration = duration;
+}
+
+void Logger::add_bench_topics()
+{
+	const unsigned num_topics = (_bench_instances + ORB_MULTI_MAX_INSTANCES - 1) / ORB_MULTI_MAX_INSTANCES;
+
+	for (unsigned i = 0; i < num_topics; i++) {
+		add_topic(bench_topics[i]);
+	}
+}
+
+void *Logger::bench_publisher_helper(void *context)
+{
+	px4_prctl(PR_SET_NAME, "log_bench", px4_getpid());
+
+	reinterpret_cast<Logger *>(context)->bench_publisher();
+	return nullptr;
+}
+
+void Logger::bench_publisher()
+{
+	orb_advert_t adverts[MAX_BENCH_INSTANCES] = {};
+	logger_bench_s data = {};
+	const hrt_abstime interval = 1000000 / _bench_rate;
+	hrt_abstime next = hrt_absolute_time();
+
+	_bench_published = 0;
+
+	while (!_task_should_exit) {
+		for (unsigned i = 0; i < _bench_instances; i++) {
+			data.timestamp = hrt_absolute_time();
+			data.sequence++;
+
+			// slowly changing values with some noise, similar to sensor data
+			for (unsigned j = 0; j < sizeof(data.data) / sizeof(data.data[0]); j++) {
+				data.data[j] = j + (data.sequence % 1000) * 0.001f + (rand() % 100) * 1e-6f;
+			}
+
+			if (adverts[i] == nullptr) {
+				int instance;
+				adverts[i] = orb_advertise_multi(bench_topics[i / ORB_MULTI_MAX_INSTANCES], &data, &instance, ORB_PRIO_DEFAULT);
+
+			} else {
+				orb_publish(bench_topics[i / ORB_MULTI_MAX_INSTANCES], adverts[i], &data);
 			}
 		}
 
-	} else if (handle >= 0) {
-		orb_check(handle, &updated);
+		_bench_published += _bench_instances;
+
+		next += interval;
+		hrt_abstime now = hrt_absolute_time();
 
-		if (updated) {
-			orb_copy(sub.metadata, handle, buffer);
+		if (next > now) {
+			usleep(next - now);
+
+		} else {
+			next = now;
 		}
 	}
 
-	return updated;
+	for (unsigned i = 0; i < _bench_instances; i++) {
+		if (adverts[i] != nullptr) {
+			orb_unadvertise(adverts[i]);
+		}
+	}
+}
+
+void Logger::print_bench_statistics()
+{
+	const float seconds = hrt_elapsed_time(&_start_time) / 1e6f;
+	const size_t msg_size = sizeof(ulog_message_data_header_s) + bench_topics[0]->o_size_no_padding;
+	const float offered = _bench_published * msg_size / 1024.f / seconds;
+
+	PX4_INFO("benchmark: %u instances at %u Hz, offered %.2f KiB/s%s", _bench_instances, _bench_rate, (double)offered,
+		 _log_compressed ? ", compressed" : "");
+	print_statistics();
+	_writer.print_perf_counters();
 }
 
 void Logger::add_default_topics()
@@ -503,6 +789,7 @@ void Logger::add_default_topics()
 	add_topic("tecs_status", 20);
 	add_topic("wind_estimate", 100);
 	add_topic("control_state", 20);
+	add_topic("control_latency");
 	add_topic("camera_trigger");
 	add_topic("cpuload");
 	add_topic("gps_dump"); //this will only be published if GPS_DUMP_COMM is set
@@ -585,17 +872,22 @@ void Logger::run()
 	uORB::Subscription<parameter_update_s> parameter_update_sub(ORB_ID(parameter_update));
 	uORB::Subscription<mavlink_log_s> mavlink_log_sub(ORB_ID(mavlink_log));
 
-	int ntopics = add_topics_from_file(PX4_ROOTFSDIR "/fs/microsd/etc/logging/logger_topics.txt");
-
-	if (ntopics > 0) {
-		PX4_INFO("logging %d topics from logger_topics.txt", ntopics);
+	if (_bench_instances > 0) {
+		add_bench_topics();
 
 	} else {
-		add_default_topics();
+		int ntopics = add_topics_from_file(PX4_ROOTFSDIR "/fs/microsd/etc/logging/logger_topics.txt");
+
+		if (ntopics > 0) {
+			PX4_INFO("logging %d topics from logger_topics.txt", ntopics);
+
+		} else {
+			add_default_topics();
+		}
 	}
 
-	//all topics added. Get required message buffer size
-	int max_msg_size = 0;
+	//all topics added. Get the largest message that is written in place
+	size_t max_msg_size = 0;
 
 	for (const auto &subscription : _subscriptions) {
 		//use o_size, because that's what orb_copy will use
@@ -610,26 +902,24 @@ void Logger::run()
 		max_msg_size = sizeof(ulog_message_logging_s);
 	}
 
-	if (max_msg_size > _msg_buffer_len) {
-		if (_msg_buffer) {
-			delete[](_msg_buffer);
-		}
-
-		_msg_buffer_len = max_msg_size;
-		_msg_buffer = new uint8_t[_msg_buffer_len];
-
-		if (!_msg_buffer) {
-			PX4_ERR("failed to alloc message buffer");
-			return;
-		}
+	if (!_writer.init(max_msg_size, _log_compressed)) {
+		PX4_ERR("init of writer failed (alloc failed)");
+		return;
 	}
 
-
-	if (!_writer.init()) {
-		PX4_ERR("init of writer failed (alloc failed)");
+	//wait on every instance of every topic, plus parameter and log message updates
+	if (!poll_init(_subscriptions.size() * ORB_MULTI_MAX_INSTANCES + 2)) {
+		PX4_ERR("failed to alloc poll set");
 		return;
 	}
 
+	for (size_t i = 0; i < _subscriptions.size(); i++) {
+		poll_add(_subscriptions[i].fd[0], i * ORB_MULTI_MAX_INSTANCES);
+	}
+
+	poll_add(parameter_update_sub.getHandle(), POLL_TARGET_OTHER);
+	poll_add(mavlink_log_sub.getHandle(), POLL_TARGET_OTHER);
+
 	int ret = _writer.thread_start(writer_thread);
 
 	if (ret) {
@@ -639,6 +929,22 @@ void Logger::run()
 
 	_task_should_exit = false;
 
+	pthread_t bench_thread;
+
+	if (_bench_instances > 0) {
+		// advertise before logging starts, so all instances are subscribed right away
+		ret = pthread_create(&bench_thread, nullptr, &Logger::bench_publisher_helper, this);
+
+		if (ret) {
+			PX4_ERR("failed to create benchmark thread (%i)", ret);
+			_bench_instances = 0;
+			_task_should_exit = true;
+
+		} else {
+			usleep(100 * 1000);
+		}
+	}
+
 #ifdef DBGPRINT
 	hrt_abstime	timer_start = 0;
 	uint32_t	total_bytes = 0;
@@ -650,14 +956,27 @@ void Logger::run()
 		start_log();
 	}
 
-	/* init the update timer */
-	struct hrt_call timer_call;
-	px4_sem_t timer_semaphore;
-	px4_sem_init(&timer_semaphore, 0, 0);
-	hrt_call_every(&timer_call, _log_interval, _log_interval, timer_callback, &timer_semaphore);
+	while (!_task_should_exit) {
 
+		const hrt_abstime pass_start = hrt_absolute_time();
 
-	while (!_task_should_exit) {
+		/*
+		 * Sleep until a logged topic is updated. While not logging, only wait for
+		 * vehicle status updates: unread topic updates would wake us right away.
+		 * The timeout bounds the reaction time to 'logger on' and exit requests.
+		 */
+		int ready;
+
+		if (_enabled) {
+			ready = poll_wait(POLL_TIMEOUT_MS);
+
+		} else {
+			px4_pollfd_struct_t fds[1];
+			fds[0].fd = vehicle_status_sub.getHandle();
+			fds[0].events = POLLIN;
+			px4_poll(fds, 1, POLL_TIMEOUT_MS);
+			ready = 0;
+		}
 
 		// Start/stop logging when system arm/disarm
 		if (vehicle_status_sub.check_updated()) {
@@ -694,63 +1013,50 @@ void Logger::run()
 				write_changed_parameters();
 			}
 
-			/* wait for lock on log buffer */
-			_writer.lock();
-
-			for (LoggerSubscription &sub : _subscriptions) {
-				/* each message consists of a header followed by an orb data object
-				 */
-				size_t msg_size = sizeof(ulog_message_data_header_s) + sub.metadata->o_size_no_padding;
-
-				/* if this topic has been updated, copy the new data into the message buffer
-				 * and write a message to the log
-				 */
-				for (uint8_t instance = 0; instance < ORB_MULTI_MAX_INSTANCES; instance++) {
-					if (copy_if_updated_multi(sub, instance, _msg_buffer + sizeof(ulog_message_data_header_s))) {
+			/* copy exactly the topic instances that were updated straight into the
+			 * log buffer and hand the messages to the writer thread
+			 */
+			for (unsigned i = 0; ready > 0 && i < _poll_count; i++) {
+				const uint16_t target = poll_target(i);
 
-						uint16_t write_msg_size = static_cast<uint16_t>(msg_size - ULOG_MSG_HEADER_LEN);
-						//write one byte after another (necessary because of alignment)
-						_msg_buffer[0] = (uint8_t)write_msg_size;
-						_msg_buffer[1] = (uint8_t)(write_msg_size >> 8);
-						_msg_buffer[2] = static_cast<uint8_t>(ULogMessageType::DATA);
-						uint16_t write_msg_id = sub.msg_ids[instance];
-						_msg_buffer[3] = (uint8_t)write_msg_id;
-						_msg_buffer[4] = (uint8_t)(write_msg_id >> 8);
+				if (target == POLL_TARGET_OTHER || target == POLL_TARGET_NONE) {
+					continue;
+				}
 
-						//PX4_INFO("topic: %s, size = %zu, out_size = %zu", sub.metadata->o_name, sub.metadata->o_size, msg_size);
+				LoggerSubscription &sub = _subscriptions[target / ORB_MULTI_MAX_INSTANCES];
 
-						if (write(_msg_buffer, msg_size)) {
+				if (!write_topic(sub, target % ORB_MULTI_MAX_INSTANCES)) {
+					break;	// Write buffer overflow, the remaining updates stay pending
+				}
 
 #ifdef DBGPRINT
-							total_bytes += msg_size;
+				total_bytes += sizeof(ulog_message_data_header_s) + sub.metadata->o_size_no_padding;
 #endif /* DBGPRINT */
 
-							data_written = true;
-
-						} else {
-							break;	// Write buffer overflow, skip this record
-						}
-					}
-				}
+				data_written = true;
 			}
 
+			subscribe_new_instances();
+
 			//check for new mavlink log message
 			if (mavlink_log_sub.check_updated()) {
 				mavlink_log_sub.update();
 				const char *message = (const char *)mavlink_log_sub.get().text;
 				int message_len = strlen(message);
 
-				if (message_len > 0) {
+				uint8_t *buffer;
+
+				if (message_len > 0 && (buffer = reserve(sizeof(ulog_message_logging_s))) != nullptr) {
 					uint16_t write_msg_size = sizeof(ulog_message_logging_s) - sizeof(ulog_message_logging_s::message)
 								  - ULOG_MSG_HEADER_LEN + message_len;
-					_msg_buffer[0] = (uint8_t)write_msg_size;
-					_msg_buffer[1] = (uint8_t)(write_msg_size >> 8);
-					_msg_buffer[2] = static_cast<uint8_t>(ULogMessageType::LOGGING);
-					_msg_buffer[3] = mavlink_log_sub.get().severity + '0';
-					memcpy(_msg_buffer + 4, &mavlink_log_sub.get().timestamp, sizeof(ulog_message_logging_s::timestamp));
-					strncpy((char *)(_msg_buffer + 12), message, sizeof(ulog_message_logging_s::message));
-
-					write(_msg_buffer, write_msg_size + ULOG_MSG_HEADER_LEN);
+					buffer[0] = (uint8_t)write_msg_size;
+					buffer[1] = (uint8_t)(write_msg_size >> 8);
+					buffer[2] = static_cast<uint8_t>(ULogMessageType::LOGGING);
+					buffer[3] = mavlink_log_sub.get().severity + '0';
+					memcpy(buffer + 4, &mavlink_log_sub.get().timestamp, sizeof(ulog_message_logging_s::timestamp));
+					strncpy((char *)(buffer + 12), message, sizeof(ulog_message_logging_s::message));
+
+					_writer.commit(write_msg_size + ULOG_MSG_HEADER_LEN);
 				}
 			}
 
@@ -758,9 +1064,6 @@ void Logger::run()
 				_high_water = _writer.get_buffer_fill_count();
 			}
 
-			/* release the log buffer */
-			_writer.unlock();
-
 			/* notify the writer thread if data is available */
 			if (data_written) {
 				_writer.notify();
@@ -784,20 +1087,27 @@ void Logger::run()
 
 #endif /* DBGPRINT */
 
+			if (_bench_instances > 0 && hrt_elapsed_time(&_start_time) > _bench_duration * 1000000ull) {
+				print_bench_statistics();
+				_task_should_exit = true;
+			}
 		}
 
 		/*
-		 * We wait on the semaphore, which periodically gets updated by a high-resolution timer.
-		 * The simpler alternative would be:
-		 *   usleep(max(300, _log_interval - elapsed_time_since_loop_start));
-		 * And on linux this is quite accurate as well, but under NuttX it is not accurate,
-		 * because usleep() has only a granularity of CONFIG_MSEC_PER_TICK (=1ms).
+		 * Limit the rate of passes, so that fast topics are batched into fewer
+		 * wakeups. Under NuttX usleep() has only a granularity of
+		 * CONFIG_MSEC_PER_TICK (=1ms), which only makes the batches a bit larger.
 		 */
-		while (px4_sem_wait(&timer_semaphore) != 0);
+		const hrt_abstime pass_time = hrt_elapsed_time(&pass_start);
+
+		if (_enabled && pass_time < _log_interval) {
+			usleep(_log_interval - pass_time);
+		}
 	}
 
-	hrt_cancel(&timer_call);
-	px4_sem_destroy(&timer_semaphore);
+	if (_bench_instances > 0) {
+		pthread_join(bench_thread, NULL);
+	}
 
 	// stop the writer thread
 	_writer.thread_stop();
@@ -811,6 +1121,8 @@ void Logger::run()
 		PX4_WARN("join failed: %d", ret);
 	}
 
+	poll_deinit();
+
 	//unsubscribe
 	for (LoggerSubscription &sub : _subscriptions) {
 		for (uint8_t instance = 0; instance < ORB_MULTI_MAX_INSTANCES; instance++) {
@@ -829,7 +1141,19 @@ void Logger::run()
 
 bool Logger::write(void *ptr, size_t size)
 {
-	if (_writer.write(ptr, size, _dropout_start)) {
+	return update_dropout(_writer.write(ptr, size, _dropout_start));
+}
+
+uint8_t *Logger::reserve(size_t size)
+{
+	uint8_t *buffer = _writer.reserve(size, _dropout_start);
+	update_dropout(buffer != nullptr);
+	return buffer;
+}
+
+bool Logger::update_dropout(bool written)
+{
+	if (written) {
 
 		if (_dropout_start) {
 			float dropout_duration = (float)(hrt_elapsed_time(&_dropout_start) / 1000) / 1.e3f;
@@ -931,6 +1255,7 @@ int Logger::get_log_file_name(char *file_name, size_t file_name_size)
 	}
 
 	const char *replay_suffix = "";
+	const char *extension = _log_compressed ? "ulz" : "ulg";
 
 	if (_replay_file_name) {
 		replay_suffix = "_replayed";
@@ -944,7 +1269,8 @@ int Logger::get_log_file_name(char *file_name, size_t file_name_size)
 
 		char log_file_name[64] = "";
 		strftime(log_file_name, sizeof(log_file_name), "%H_%M_%S", &tt);
-		snprintf(file_name, file_name_size, "%s/%s%s.ulg", _log_dir, log_file_name, replay_suffix);
+		snprintf(file_name, file_name_size, "%s/%s%s.%s", _log_dir, log_file_name, replay_suffix,
+			 extension);
 
 	} else {
 		if (create_log_dir(nullptr)) {
@@ -956,7 +1282,8 @@ int Logger::get_log_file_name(char *file_name, size_t file_name_size)
 		/* look for the next file that does not exist */
 		while (file_number <= MAX_NO_LOGFILE) {
 			/* format log file path: e.g. /fs/microsd/sess001/log001.ulg */
-			snprintf(file_name, file_name_size, "%s/log%03u%s.ulg", _log_dir, file_number, replay_suffix);
+			snprintf(file_name, file_name_size, "%s/log%03u%s.%s", _log_dir, file_number, replay_suffix,
+				 extension);
 
 			if (!file_exist(file_name)) {
 				break;
@@ -1053,6 +1380,11 @@ void Logger::start_log()
 	mavlink_log_info(&_mavlink_log_pub, "[logger] file: %s", file_name);
 	_next_topic_id = 0;
 
+	for (LoggerSubscription &sub : _subscriptions) {
+		sub.messages = 0;
+		sub.bytes = 0;
+	}
+
 	_writer.start_log(file_name);
 	write_header();
 	write_version();
@@ -1077,10 +1409,8 @@ void Logger::stop_log()
 bool Logger::write_wait(void *ptr, size_t size)
 {
 	while (!_writer.write(ptr, size)) {
-		_writer.unlock();
 		_writer.notify();
 		usleep(_log_interval);
-		_writer.lock();
 	}
 
 	return true;
@@ -1088,7 +1418,6 @@ bool Logger::write_wait(void *ptr, size_t size)
 
 void Logger::write_formats()
 {
-	_writer.lock();
 	ulog_message_format_s msg;
 	const orb_metadata **topics = orb_get_topics();
 
@@ -1100,14 +1429,10 @@ void Logger::write_formats()
 
 		write_wait(&msg, msg_size);
 	}
-
-	_writer.unlock();
 }
 
 void Logger::write_all_add_logged_msg()
 {
-	_writer.lock();
-
 	for (LoggerSubscription &sub : _subscriptions) {
 		for (int instance = 0; instance < ORB_MULTI_MAX_INSTANCES; ++instance) {
 			if (sub.fd[instance] >= 0) {
@@ -1115,8 +1440,6 @@ void Logger::write_all_add_logged_msg()
 			}
 		}
 	}
-
-	_writer.unlock();
 }
 
 void Logger::write_add_logged_msg(LoggerSubscription &subscription, int instance)
@@ -1142,7 +1465,6 @@ void Logger::write_add_logged_msg(LoggerSubscription &subscription, int instance
 /* write info message */
 void Logger::write_info(const char *name, const char *value)
 {
-	_writer.lock();
 	uint8_t buffer[sizeof(ulog_message_info_header_s)];
 	ulog_message_info_header_s *msg = reinterpret_cast<ulog_message_info_header_s *>(buffer);
 	msg->msg_type = static_cast<uint8_t>(ULogMessageType::INFO);
@@ -1161,12 +1483,10 @@ void Logger::write_info(const char *name, const char *value)
 
 		write_wait(buffer, msg_size);
 	}
-
-	_writer.unlock();
 }
+
 void Logger::write_info(const char *name, int32_t value)
 {
-	_writer.lock();
 	uint8_t buffer[sizeof(ulog_message_info_header_s)];
 	ulog_message_info_header_s *msg = reinterpret_cast<ulog_message_info_header_s *>(buffer);
 	msg->msg_type = static_cast<uint8_t>(ULogMessageType::INFO);
@@ -1182,8 +1502,6 @@ void Logger::write_info(const char *name, int32_t value)
 	msg->msg_size = msg_size - ULOG_MSG_HEADER_LEN;
 
 	write_wait(buffer, msg_size);
-
-	_writer.unlock();
 }
 
 void Logger::write_header()
@@ -1198,9 +1516,7 @@ void Logger::write_header()
 	header.magic[6] = 0x35;
 	header.magic[7] = 0x00; //file version 0
 	header.timestamp = hrt_absolute_time();
-	_writer.lock();
 	write_wait(&header, sizeof(header));
-	_writer.unlock();
 }
 
 /* write version info messages */
@@ -1223,7 +1539,6 @@ void Logger::write_version()
 
 void Logger::write_parameters()
 {
-	_writer.lock();
 	uint8_t buffer[sizeof(ulog_message_parameter_header_s) + sizeof(param_value_u)];
 	ulog_message_parameter_header_s *msg = reinterpret_cast<ulog_message_parameter_header_s *>(buffer);
 
@@ -1274,13 +1589,11 @@ void Logger::write_parameters()
 		}
 	} while ((param != PARAM_INVALID) && (param_idx < (int) param_count()));
 
-	_writer.unlock();
 	_writer.notify();
 }
 
 void Logger::write_changed_parameters()
 {
-	_writer.lock();
 	uint8_t buffer[sizeof(ulog_message_parameter_header_s) + sizeof(param_value_u)];
 	ulog_message_parameter_header_s *msg = reinterpret_cast<ulog_message_parameter_header_s *>(buffer);
 
@@ -1333,7 +1646,6 @@ void Logger::write_changed_parameters()
 		}
 	} while ((param != PARAM_INVALID) && (param_idx < (int) param_count()));
 
-	_writer.unlock();
 	_writer.notify();
 }
 
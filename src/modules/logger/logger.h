@@ -61,8 +61,10 @@ namespace logger
 struct LoggerSubscription {
 	int fd[ORB_MULTI_MAX_INSTANCES];
 	uint16_t msg_ids[ORB_MULTI_MAX_INSTANCES];
-	uint64_t time_tried_subscribe;	// captures the time at which we checked last time if this instance existed
 	const orb_metadata *metadata = nullptr;
+	uint32_t interval = 0;	// minimum time between logged samples [ms], 0 for every update
+	uint32_t messages = 0;	// number of messages written since the log was started (all instances)
+	uint64_t bytes = 0;	// number of bytes written since the log was started (all instances)
 
 	LoggerSubscription() {}
 
@@ -70,7 +72,6 @@ struct LoggerSubscription {
 		metadata(metadata_)
 	{
 		fd[0] = fd_;
-		time_tried_subscribe = 0;
 
 		for (int i = 1; i < ORB_MULTI_MAX_INSTANCES; i++) {
 			fd[i] = -1;
@@ -82,7 +83,7 @@ class Logger
 {
 public:
 	Logger(size_t buffer_size, uint32_t log_interval, bool log_on_start,
-	       bool log_until_shutdown, bool log_name_timestamp);
+	       bool log_until_shutdown, bool log_name_timestamp, bool log_compressed);
 
 	~Logger();
 
@@ -113,9 +114,21 @@ public:
 
 	void status();
 	void print_statistics();
+	void print_topic_statistics();
 
 	void set_arm_override(bool override) { _arm_override = override; }
 
+	/**
+	 * Log only synthetic topics published by the logger itself. This must be
+	 * called before starting the logger.
+	 * @param instances number of topic instances to publish
+	 * @param rate publication rate of each instance [Hz]
+	 * @param duration time after which the statistics are printed and the logger exits [s]
+	 */
+	void set_benchmark(unsigned instances, unsigned rate, unsigned duration);
+
+	static constexpr unsigned	MAX_BENCH_INSTANCES = 8 * ORB_MULTI_MAX_INSTANCES; /**< Maximum number of synthetic topic instances */
+
 private:
 	static void run_trampoline(int argc, char *argv[]);
 
@@ -128,7 +141,6 @@ private:
 
 	/**
 	 * Write an ADD_LOGGED_MSG to the log for a given subscription and instance.
-	 * _writer.lock() must be held when calling this.
 	 */
 	void write_add_logged_msg(LoggerSubscription &subscription, int instance);
 
@@ -172,21 +184,61 @@ private:
 
 	void write_changed_parameters();
 
-	bool copy_if_updated_multi(LoggerSubscription &sub, int multi_instance, void *buffer);
+	/**
+	 * Subscribe to topic instances that were advertised since the last check
+	 * and add them to the poll set.
+	 */
+	void subscribe_new_instances();
+
+	/**
+	 * Copy a topic instance into the log buffer.
+	 * @return true if data written, false otherwise (on overflow)
+	 */
+	bool write_topic(LoggerSubscription &sub, int instance);
+
+	/**
+	 * The set of fds the logger waits on. On POSIX this is a wait set, so the
+	 * fds are only registered once; on NuttX it is a pollfd array for px4_poll().
+	 */
+	bool poll_init(unsigned capacity);
+	void poll_deinit();
+
+	/**
+	 * @param target index of the subscription * ORB_MULTI_MAX_INSTANCES + instance,
+	 *               or POLL_TARGET_OTHER for fds that only need to wake up the logger
+	 */
+	void poll_add(int fd, uint16_t target);
+	int poll_wait(int timeout);
+
+	/**
+	 * @return the target of an fd that has data after poll_wait(), POLL_TARGET_NONE otherwise
+	 */
+	uint16_t poll_target(unsigned index) const;
 
 	/**
 	 * Write data to the logger. Waits if buffer is full until all data is written.
-	 * Must be called with _writer.lock() held.
 	 */
 	bool write_wait(void *ptr, size_t size);
 
 	/**
 	 * Write data to the logger and handle dropouts.
-	 * Must be called with _writer.lock() held.
 	 * @return true if data written, false otherwise (on overflow)
 	 */
 	bool write(void *ptr, size_t size);
 
+	/**
+	 * Reserve space for a message in the log buffer and handle dropouts.
+	 * The message is logged with _writer.commit().
+	 * @return start of the message, nullptr on overflow
+	 */
+	uint8_t *reserve(size_t size);
+
+	/**
+	 * Update the dropout statistics after a write or reservation.
+	 * @return written
+	 */
+	bool update_dropout(bool written);
+
 	/**
 	 * Get the time for log file name
 	 * @param tt returned time
@@ -204,7 +256,18 @@ private:
 
 	void add_default_topics();
 
+	void add_bench_topics();
+
+	static void *bench_publisher_helper(void *context);
+
+	void bench_publisher();
+
+	void print_bench_statistics();
+
 	static constexpr size_t 	MAX_TOPICS_NUM = 64; /**< Maximum number of logged topics */
+	static constexpr int		POLL_TIMEOUT_MS = 100; /**< Maximum time to wait for topic updates */
+	static constexpr uint16_t	POLL_TARGET_OTHER = 0xfffe;
+	static constexpr uint16_t	POLL_TARGET_NONE = 0xffff;
 	static constexpr unsigned	MAX_NO_LOGFOLDER = 999;	/**< Maximum number of log dirs */
 	static constexpr unsigned	MAX_NO_LOGFILE = 999;	/**< Maximum number of log files */
 #ifdef __PX4_POSIX_EAGLE
@@ -213,8 +276,6 @@ private:
 	static constexpr const char 	*LOG_ROOT = PX4_ROOTFSDIR"/fs/microsd/log";
 #endif
 
-	uint8_t						*_msg_buffer = nullptr;
-	int						_msg_buffer_len = 0;
 	bool						_task_should_exit = true;
 	char 						_log_dir[LOG_DIR_LEN];
 	bool						_has_log_dir = false;
@@ -233,6 +294,7 @@ private:
 	const bool 					_log_on_start;
 	const bool 					_log_until_shutdown;
 	const bool					_log_name_timestamp;
+	const bool					_log_compressed;
 	Array<LoggerSubscription, MAX_TOPICS_NUM>	_subscriptions;
 	LogWriter					_writer;
 	uint32_t					_log_interval;
@@ -240,6 +302,22 @@ private:
 	orb_advert_t					_mavlink_log_pub = nullptr;
 	uint16_t					_next_topic_id; ///< id of next subscribed topic
 	char						*_replay_file_name = nullptr;
+	hrt_abstime					_time_tried_subscribe = 0; ///< last time we checked for new topic instances
+
+#ifdef __PX4_POSIX
+	px4_waitset_t					_poll_set;
+#else
+	px4_pollfd_struct_t				*_poll_fds = nullptr;
+#endif
+	uint16_t					*_poll_targets = nullptr;
+	unsigned					_poll_count = 0;
+	unsigned					_poll_capacity = 0;
+
+	// benchmark mode
+	unsigned					_bench_instances = 0; ///< number of synthetic topic instances (0 = no benchmark)
+	unsigned					_bench_rate = 0; ///< publication rate of each instance [Hz]
+	unsigned					_bench_duration = 0; ///< [s]
+	volatile uint32_t				_bench_published = 0; ///< number of synthetic messages published
 };
 
 } //namespace logger
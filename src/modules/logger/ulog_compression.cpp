@@ -0,0 +1,157 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#include "ulog_compression.h"
+
+namespace
+{
+
+static constexpr int MIN_MATCH = 4;
+static constexpr int LAST_LITERALS = 5; ///< the block must end with at least this many literals
+static constexpr int MATCH_START_LIMIT = 12; ///< no match may start within this many bytes of the end
+
+inline uint32_t read32(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+inline uint32_t hash(uint32_t sequence)
+{
+	return (sequence * 2654435761u) >> (32 - ULOG_COMPRESSED_HASH_BITS);
+}
+
+inline int write_length(uint8_t *dst, int length)
+{
+	int n = 0;
+
+	for (; length >= 255; length -= 255) {
+		dst[n++] = 255;
+	}
+
+	dst[n++] = length;
+	return n;
+}
+
+/**
+ * Append a sequence: literals followed by an optional match (match_length == 0 for the last sequence)
+ * @return new output position, -1 if it does not fit
+ */
+inline int write_sequence(uint8_t *dst, int op, int dst_size, const uint8_t *literals, int literal_length,
+			  int offset, int match_length)
+{
+	// worst case: token, literal length, literals, offset, match length
+	int size = 1 + literal_length / 255 + 1 + literal_length;
+
+	if (match_length > 0) {
+		size += 2 + match_length / 255 + 1;
+	}
+
+	if (op + size > dst_size) {
+		return -1;
+	}
+
+	uint8_t &token = dst[op++];
+	token = (literal_length < 15 ? literal_length : 15) << 4;
+
+	if (literal_length >= 15) {
+		op += write_length(&dst[op], literal_length - 15);
+	}
+
+	memcpy(&dst[op], literals, literal_length);
+	op += literal_length;
+
+	if (match_length > 0) {
+		dst[op++] = offset & 0xff;
+		dst[op++] = offset >> 8;
+
+		match_length -= MIN_MATCH;
+		token |= match_length < 15 ? match_length : 15;
+
+		if (match_length >= 15) {
+			op += write_length(&dst[op], match_length - 15);
+		}
+	}
+
+	return op;
+}
+
+} // namespace
+
+int ulog_compress_block(const uint8_t *src, int src_size, uint8_t *dst, int dst_size, uint16_t *table)
+{
+	static_assert(ULOG_COMPRESSED_FRAME_MAX <= 0xffff, "positions must fit into the table");
+
+	int op = 0;
+	int anchor = 0; // start of the pending literals
+
+	if (src_size > MATCH_START_LIMIT) {
+		memset(table, 0, ULOG_COMPRESSED_HASH_SIZE * sizeof(uint16_t));
+
+		const int match_start_limit = src_size - MATCH_START_LIMIT;
+		const int match_end_limit = src_size - LAST_LITERALS;
+		int ip = 0;
+
+		while (ip < match_start_limit) {
+			const uint32_t sequence = read32(&src[ip]);
+			const uint32_t h = hash(sequence);
+			const int ref = table[h];
+			table[h] = ip;
+
+			if (ref >= ip || read32(&src[ref]) != sequence) {
+				++ip;
+				continue;
+			}
+
+			int length = MIN_MATCH;
+
+			while (ip + length < match_end_limit && src[ref + length] == src[ip + length]) {
+				++length;
+			}
+
+			op = write_sequence(dst, op, dst_size, &src[anchor], ip - anchor, ip - ref, length);
+
+			if (op < 0) {
+				return 0;
+			}
+
+			ip += length;
+			anchor = ip;
+		}
+	}
+
+	op = write_sequence(dst, op, dst_size, &src[anchor], src_size - anchor, 0, 0);
+
+	return op < 0 ? 0 : op;
+}
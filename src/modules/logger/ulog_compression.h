@@ -0,0 +1,161 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file ulog_compression.h
+ * Block compressed ULog files.
+ *
+ * A compressed log starts with ulog_compressed_file_header_s, followed by a
+ * sequence of frames, each a ulog_compressed_frame_header_s and the frame
+ * data. Decoding all frames in order yields the plain ULog byte stream,
+ * including its file header, so the message framing is unchanged. Frames are
+ * independent of each other and decode to at most ULOG_COMPRESSED_FRAME_MAX
+ * bytes. The frame data uses the LZ4 block format.
+ *
+ * The decoder is kept in this header so replay and other readers do not
+ * depend on the logger.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#define ULOG_COMPRESSED_FRAME_MAX 4096
+#define ULOG_COMPRESSED_FRAME_STORED 0x8000 ///< data_size flag: the frame data is not compressed
+#define ULOG_COMPRESSED_HASH_BITS 10
+#define ULOG_COMPRESSED_HASH_SIZE (1 << ULOG_COMPRESSED_HASH_BITS) ///< number of entries in the compressor hash table
+
+#pragma pack(push, 1)
+
+/** first bytes of a compressed file */
+struct ulog_compressed_file_header_s {
+	uint8_t magic[8];
+};
+
+struct ulog_compressed_frame_header_s {
+	uint16_t data_size; ///< size of the frame data following the header, plus the STORED flag
+	uint16_t raw_size; ///< size of the frame after decoding
+};
+
+#pragma pack(pop)
+
+static const uint8_t ulog_compressed_magic[8] = {'U', 'L', 'o', 'g', 'Z', 0x01, 0x12, 0x35};
+
+/**
+ * Compress a block of at most ULOG_COMPRESSED_FRAME_MAX bytes.
+ * @param table ULOG_COMPRESSED_HASH_SIZE entries of scratch space
+ * @return compressed size, 0 if the result does not fit into dst_size bytes
+ */
+int ulog_compress_block(const uint8_t *src, int src_size, uint8_t *dst, int dst_size, uint16_t *table);
+
+/**
+ * Decompress a block.
+ * @return decompressed size, -1 if the data is corrupt or does not fit into dst_size bytes
+ */
+static inline int ulog_decompress_block(const uint8_t *src, int src_size, uint8_t *dst, int dst_size)
+{
+	int ip = 0;
+	int op = 0;
+
+	while (ip < src_size) {
+		const uint8_t token = src[ip++];
+		int length = token >> 4;
+
+		if (length == 15) {
+			uint8_t b;
+
+			do {
+				if (ip >= src_size) {
+					return -1;
+				}
+
+				b = src[ip++];
+				length += b;
+			} while (b == 255);
+		}
+
+		if (ip + length > src_size || op + length > dst_size) {
+			return -1;
+		}
+
+		memcpy(&dst[op], &src[ip], length);
+		ip += length;
+		op += length;
+
+		if (ip == src_size) {
+			// the last sequence only has literals
+			break;
+		}
+
+		if (ip + 2 > src_size) {
+			return -1;
+		}
+
+		const int offset = src[ip] | (src[ip + 1] << 8);
+		ip += 2;
+
+		if (offset == 0 || offset > op) {
+			return -1;
+		}
+
+		length = token & 0xf;
+
+		if (length == 15) {
+			uint8_t b;
+
+			do {
+				if (ip >= src_size) {
+					return -1;
+				}
+
+				b = src[ip++];
+				length += b;
+			} while (b == 255);
+		}
+
+		length += 4;
+
+		if (op + length > dst_size) {
+			return -1;
+		}
+
+		// the match can overlap with the output, so copy byte-wise
+		for (int i = 0; i < length; ++i, ++op) {
+			dst[op] = dst[op - offset];
+		}
+	}
+
+	return op;
+}
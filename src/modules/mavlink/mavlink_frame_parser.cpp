@@ -0,0 +1,177 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavlink_frame_parser.cpp
+ * Parser for buffers holding whole MAVLink frames.
+ */
+
+#include <string.h>
+
+#include "mavlink_frame_parser.h"
+
+bool
+MavlinkFrameParser::next(mavlink_message_t *msg)
+{
+	while (_pos < _len) {
+		if (parse_frame(msg)) {
+			return true;
+		}
+
+		uint8_t c = _buf[_pos++];
+		uint8_t result = mavlink_frame_char_buffer(&_rxmsg, &_rxstatus, c, msg, &_status);
+
+		if (result == MAVLINK_FRAMING_OK) {
+			return true;
+		}
+
+		/* frames with a bad CRC or signature are dropped, and like mavlink_parse_char() does,
+		 * counted as a parse error and a start byte in the last CRC byte begins the next frame */
+		if (result == MAVLINK_FRAMING_BAD_CRC || result == MAVLINK_FRAMING_BAD_SIGNATURE) {
+			_rxstatus.parse_error++;
+			_rxstatus.msg_received = MAVLINK_FRAMING_INCOMPLETE;
+			_rxstatus.parse_state = MAVLINK_PARSE_STATE_IDLE;
+
+			if (c == MAVLINK_STX) {
+				_rxstatus.parse_state = MAVLINK_PARSE_STATE_GOT_STX;
+				_rxmsg.len = 0;
+				mavlink_start_checksum(&_rxmsg);
+			}
+		}
+	}
+
+	return false;
+}
+
+bool
+MavlinkFrameParser::parse_frame(mavlink_message_t *msg)
+{
+	/* the state machine is in the middle of a frame */
+	if (_rxstatus.parse_state > MAVLINK_PARSE_STATE_IDLE) {
+		return false;
+	}
+
+	const uint8_t *frame = &_buf[_pos];
+	size_t left = _len - _pos;
+	size_t header_len;
+
+	if (frame[0] == MAVLINK_STX_MAVLINK1) {
+		header_len = MAVLINK_CORE_HEADER_MAVLINK1_LEN + 1;
+
+	} else if (frame[0] == MAVLINK_STX) {
+		header_len = MAVLINK_CORE_HEADER_LEN + 1;
+
+	} else {
+		return false;
+	}
+
+	if (left < header_len) {
+		return false;
+	}
+
+	uint8_t payload_len = frame[1];
+	size_t frame_len = header_len + payload_len + MAVLINK_NUM_CHECKSUM_BYTES;
+
+	/* incompatibility flags: signed or something we do not know */
+	if (frame_len > left || (frame[0] == MAVLINK_STX && frame[2] != 0)) {
+		return false;
+	}
+
+	uint32_t msgid;
+
+	if (frame[0] == MAVLINK_STX_MAVLINK1) {
+		msgid = frame[5];
+
+	} else {
+		msgid = frame[7] | (frame[8] << 8) | ((uint32_t)frame[9] << 16);
+	}
+
+	/* an unknown message can not be checked, the state machine drops it */
+	const mavlink_msg_entry_t *entry = mavlink_get_msg_entry(msgid);
+
+	if (entry == nullptr) {
+		return false;
+	}
+
+	uint16_t crc;
+	crc_init(&crc);
+	crc_accumulate_buffer(&crc, (const char *)&frame[1], header_len - 1 + payload_len);
+	crc_accumulate(entry->crc_extra, &crc);
+
+	const uint8_t *ck = &frame[header_len + payload_len];
+
+	if (ck[0] != (crc & 0xff) || ck[1] != (crc >> 8)) {
+		return false;
+	}
+
+	msg->checksum = crc;
+	msg->magic = frame[0];
+	msg->len = payload_len;
+	msg->msgid = msgid;
+
+	if (frame[0] == MAVLINK_STX_MAVLINK1) {
+		msg->incompat_flags = 0;
+		msg->compat_flags = 0;
+		msg->seq = frame[2];
+		msg->sysid = frame[3];
+		msg->compid = frame[4];
+		_rxstatus.flags |= MAVLINK_STATUS_FLAG_IN_MAVLINK1;
+
+	} else {
+		msg->incompat_flags = frame[2];
+		msg->compat_flags = frame[3];
+		msg->seq = frame[4];
+		msg->sysid = frame[5];
+		msg->compid = frame[6];
+		_rxstatus.flags &= ~MAVLINK_STATUS_FLAG_IN_MAVLINK1;
+	}
+
+	/* zero fill truncated payloads like the state machine does */
+	memcpy(_MAV_PAYLOAD_NON_CONST(msg), &frame[header_len], payload_len);
+	memset(_MAV_PAYLOAD_NON_CONST(msg) + payload_len, 0, MAVLINK_MAX_PAYLOAD_LEN - payload_len);
+	msg->ck[0] = ck[0];
+	msg->ck[1] = ck[1];
+
+	/* same bookkeeping as for a frame from the state machine */
+	_rxstatus.msg_received = MAVLINK_FRAMING_OK;
+	_rxstatus.current_rx_seq = msg->seq;
+
+	if (_rxstatus.packet_rx_success_count == 0) {
+		_rxstatus.packet_rx_drop_count = 0;
+	}
+
+	_rxstatus.packet_rx_success_count++;
+
+	_pos += frame_len;
+	return true;
+}
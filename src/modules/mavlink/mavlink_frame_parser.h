@@ -0,0 +1,115 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavlink_frame_parser.h
+ * Parser for buffers holding whole MAVLink frames.
+ */
+
+#ifndef MAVLINK_FRAME_PARSER_H_
+#define MAVLINK_FRAME_PARSER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mavlink_bridge_header.h"
+
+/**
+ * Splits buffers into MAVLink messages.
+ *
+ * A UDP datagram holds whole frames, so a frame is located by its length
+ * byte and checked with one CRC pass over its contiguous span, instead of
+ * running every byte through the mavlink_frame_char_buffer() state machine.
+ *
+ * Bytes which do not start a complete, valid, unsigned frame still go
+ * through the state machine, so frames split over two buffers (serial
+ * ports), garbage and signed frames are handled as by mavlink_parse_char(),
+ * including its resynchronization after a bad CRC. The parser keeps its own
+ * state instead of the one of a channel. mavlink_tests compares both.
+ */
+class MavlinkFrameParser
+{
+public:
+	MavlinkFrameParser() :
+		_buf(nullptr),
+		_len(0),
+		_pos(0),
+		_rxmsg{},
+		_rxstatus{},
+		_status{}
+	{}
+
+	/**
+	 * Start parsing a new buffer, it has to stay valid until next() returned false.
+	 */
+	void set_buffer(const uint8_t *buf, size_t len)
+	{
+		_buf = buf;
+		_len = len;
+		_pos = 0;
+	}
+
+	/**
+	 * Get the next message from the buffer.
+	 *
+	 * @param msg message to fill
+	 * @return false once the whole buffer has been parsed
+	 */
+	bool next(mavlink_message_t *msg);
+
+	/**
+	 * Parse state and statistics, like the channel status of mavlink_parse_char().
+	 */
+	const mavlink_status_t &get_status() const { return _rxstatus; }
+
+private:
+	const uint8_t		*_buf;
+	size_t			_len;
+	size_t			_pos;		///< first byte not parsed yet
+	mavlink_message_t	_rxmsg;		///< frame being assembled by the state machine
+	mavlink_status_t	_rxstatus;	///< state machine and statistics
+	mavlink_status_t	_status;	///< status copy returned by the state machine
+
+	/**
+	 * Take a whole frame starting at _pos.
+	 *
+	 * @return false if there is none, nothing has been consumed then
+	 */
+	bool parse_frame(mavlink_message_t *msg);
+
+	/* do not allow copying this class */
+	MavlinkFrameParser(const MavlinkFrameParser &);
+	MavlinkFrameParser &operator=(const MavlinkFrameParser &);
+};
+
+#endif /* MAVLINK_FRAME_PARSER_H_ */
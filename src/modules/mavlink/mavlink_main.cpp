@@ -177,10 +177,12 @@ Mavlink::Mavlink() :
 	_forward_externalsp(false),
 	_is_usb_uart(false),
 	_wait_to_transmit(false),
+	_fixed_loop(false),
 	_received_messages(false),
 	_main_loop_delay(1000),
 	_subscriptions(nullptr),
 	_streams(nullptr),
+	_stream_scheduler(),
 	_mission_manager(nullptr),
 	_parameters_manager(nullptr),
 	_mavlink_ftp(nullptr),
@@ -218,6 +220,10 @@ Mavlink::Mavlink() :
 	_rate_tx(0.0f),
 	_rate_txerr(0.0f),
 	_rate_rx(0.0f),
+	_cpu_time(0),
+	_wakeups(0),
+	_cpu_load(0.0f),
+	_wakeup_rate(0.0f),
 #ifdef __PX4_POSIX
 	_myaddr{},
 	_src_addr{},
@@ -228,6 +234,11 @@ Mavlink::Mavlink() :
 	_broadcast_failed_warned(false),
 	_network_buf{},
 	_network_buf_len(0),
+	_network_packet_len{},
+	_network_packet_broadcast{},
+	_network_queued(0),
+	_network_msgs{},
+	_network_iov{},
 #endif
 	_socket_fd(-1),
 	_protocol(SERIAL),
@@ -251,7 +262,8 @@ Mavlink::Mavlink() :
 
 	/* performance counters */
 	_loop_perf(perf_alloc(PC_ELAPSED, "mavlink_el")),
-	_txerr_perf(perf_alloc(PC_COUNT, "mavlink_txe"))
+	_txerr_perf(perf_alloc(PC_COUNT, "mavlink_txe")),
+	_send_late_perf(perf_alloc(PC_HISTOGRAM, "mavlink_late"))
 {
 	_instance_id = Mavlink::instance_count();
 
@@ -304,6 +316,7 @@ Mavlink::~Mavlink()
 {
 	perf_free(_loop_perf);
 	perf_free(_txerr_perf);
+	perf_free(_send_late_perf);
 
 	if (_task_running) {
 		/* task wakes up every 10ms or so at the longest */
@@ -894,18 +907,18 @@ Mavlink::send_packet()
 
 #ifdef __PX4_POSIX
 
+	pthread_mutex_lock(&_send_mutex);
+
 	/* Only send packets if there is something in the buffer. */
 	if (_network_buf_len == 0) {
+		pthread_mutex_unlock(&_send_mutex);
 		return 0;
 	}
 
 	if (get_protocol() == UDP) {
 
-
-		ret = sendto(_socket_fd, _network_buf, _network_buf_len, 0,
-			     (struct sockaddr *)&_src_addr, sizeof(_src_addr));
-
 		struct telemetry_status_s &tstatus = get_rx_status();
+		bool broadcast = false;
 
 		/* resend message via broadcast if no valid connection exists */
 		if ((_mode != MAVLINK_MODE_ONBOARD) && broadcast_enabled() &&
@@ -916,20 +929,17 @@ Mavlink::send_packet()
 				find_broadcast_address();
 			}
 
-			if (_broadcast_address_found && _network_buf_len > 0) {
+			broadcast = _broadcast_address_found;
+		}
 
-				int bret = sendto(_socket_fd, _network_buf, _network_buf_len, 0,
-						  (struct sockaddr *)&_bcast_addr, sizeof(_bcast_addr));
+		_network_packet_len[_network_queued] = _network_buf_len;
+		_network_packet_broadcast[_network_queued] = broadcast;
+		_network_queued++;
 
-				if (bret <= 0) {
-					if (!_broadcast_failed_warned) {
-						PX4_ERR("sending broadcast failed, errno: %d: %s", errno, strerror(errno));
-						_broadcast_failed_warned = true;
-					}
-				} else {
-					_broadcast_failed_warned = false;
-				}
-			}
+		ret = _network_buf_len;
+
+		if (_network_queued == NETWORK_BATCH) {
+			send_network_queue();
 		}
 
 	} else if (get_protocol() == TCP) {
@@ -938,11 +948,89 @@ Mavlink::send_packet()
 	}
 
 	_network_buf_len = 0;
+
+	pthread_mutex_unlock(&_send_mutex);
 #endif
 
 	return ret;
 }
 
+void
+Mavlink::flush_network()
+{
+#ifdef __PX4_POSIX
+	pthread_mutex_lock(&_send_mutex);
+	send_network_queue();
+	pthread_mutex_unlock(&_send_mutex);
+#endif
+}
+
+#ifdef __PX4_POSIX
+void
+Mavlink::send_network_queue()
+{
+	if (_network_queued == 0) {
+		return;
+	}
+
+	/* each packet goes to the partner and maybe to the broadcast address */
+	struct mmsghdr *msgs = _network_msgs;
+	unsigned count = 0;
+
+	for (unsigned i = 0; i < _network_queued; i++) {
+		_network_iov[i].iov_base = _network_buf[i];
+		_network_iov[i].iov_len = _network_packet_len[i];
+
+		msgs[count].msg_hdr.msg_name = &_src_addr;
+		msgs[count].msg_hdr.msg_namelen = sizeof(_src_addr);
+		msgs[count].msg_hdr.msg_iov = &_network_iov[i];
+		msgs[count].msg_hdr.msg_iovlen = 1;
+		count++;
+
+		if (_network_packet_broadcast[i]) {
+			msgs[count].msg_hdr.msg_name = &_bcast_addr;
+			msgs[count].msg_hdr.msg_namelen = sizeof(_bcast_addr);
+			msgs[count].msg_hdr.msg_iov = &_network_iov[i];
+			msgs[count].msg_hdr.msg_iovlen = 1;
+			count++;
+		}
+	}
+
+	_network_queued = 0;
+
+	unsigned sent = 0;
+
+	while (sent < count) {
+#ifdef __PX4_LINUX
+		int ret = sendmmsg(_socket_fd, &msgs[sent], count - sent, 0);
+#else
+		const struct msghdr &hdr = msgs[sent].msg_hdr;
+		int ret = (sendto(_socket_fd, hdr.msg_iov->iov_base, hdr.msg_iov->iov_len, 0,
+				  (struct sockaddr *)hdr.msg_name, hdr.msg_namelen) > 0) ? 1 : -1;
+#endif
+
+		if (ret > 0) {
+			for (unsigned i = sent; i < sent + ret; i++) {
+				if (msgs[i].msg_hdr.msg_name == &_bcast_addr) {
+					_broadcast_failed_warned = false;
+				}
+			}
+
+			sent += ret;
+			continue;
+		}
+
+		/* the first remaining datagram failed, skip it and go on with the others */
+		if (msgs[sent].msg_hdr.msg_name == &_bcast_addr && !_broadcast_failed_warned) {
+			PX4_ERR("sending broadcast failed, errno: %d: %s", errno, strerror(errno));
+			_broadcast_failed_warned = true;
+		}
+
+		sent++;
+	}
+}
+#endif
+
 void
 Mavlink::send_bytes(const uint8_t *buf, unsigned packet_len)
 {
@@ -982,8 +1070,8 @@ Mavlink::send_bytes(const uint8_t *buf, unsigned packet_len)
 #ifdef __PX4_POSIX
 
 	else {
-		if (_network_buf_len + packet_len < sizeof(_network_buf) / sizeof(_network_buf[0])) {
-			memcpy(&_network_buf[_network_buf_len], buf, packet_len);
+		if (_network_buf_len + packet_len < sizeof(_network_buf[0])) {
+			memcpy(&_network_buf[_network_queued][_network_buf_len], buf, packet_len);
 			_network_buf_len += packet_len;
 
 			ret = packet_len;
@@ -1300,6 +1388,7 @@ Mavlink::configure_stream(const char *stream_name, const float rate)
 				delete stream;
 			}
 
+			_stream_scheduler.invalidate();
 			return OK;
 		}
 	}
@@ -1317,6 +1406,7 @@ Mavlink::configure_stream(const char *stream_name, const float rate)
 			stream = streams_list[i]->new_instance(this);
 			stream->set_interval(interval);
 			LL_APPEND(_streams, stream);
+			_stream_scheduler.invalidate();
 
 			return OK;
 		}
@@ -1351,6 +1441,8 @@ Mavlink::adjust_stream_rates(const float multiplier)
 		/* set new interval */
 		stream->set_interval(interval * multiplier);
 	}
+
+	_stream_scheduler.invalidate();
 }
 
 void
@@ -1651,7 +1743,7 @@ Mavlink::task_main(int argc, char *argv[])
 	int temp_int_arg;
 #endif
 
-	while ((ch = px4_getopt(argc, argv, "b:r:d:u:o:m:t:fpvwx", &myoptind, &myoptarg)) != EOF) {
+	while ((ch = px4_getopt(argc, argv, "b:r:d:u:o:m:t:flpvwx", &myoptind, &myoptarg)) != EOF) {
 		switch (ch) {
 		case 'b':
 			_baudrate = strtoul(myoptarg, NULL, 10);
@@ -1750,6 +1842,10 @@ Mavlink::task_main(int argc, char *argv[])
 			_forwarding_on = true;
 			break;
 
+		case 'l':
+			_fixed_loop = true;
+			break;
+
 		case 'v':
 			_verbose = true;
 			break;
@@ -2026,13 +2122,61 @@ Mavlink::task_main(int argc, char *argv[])
 		send_autopilot_capabilites();
 	}
 
+	/* command acks and log messages are sent as soon as they are published */
+	MavlinkOrbSubscription *const event_subs[] = { ack_sub, mavlink_log_sub };
+	hrt_abstime next_housekeeping = 0;
+
 	while (!_task_should_exit) {
-		/* main loop */
-		usleep(_main_loop_delay);
+		/* send what the last loop queued before sleeping */
+		flush_network();
+
+		bool events;
+
+		if (_fixed_loop) {
+			/* the loop from before the stream scheduler, to compare both with 'mavlink status' */
+			usleep(_main_loop_delay);
+			events = true;
+
+		} else {
+			/* main loop, sleep until the next stream is due */
+			events = _stream_scheduler.wait(_streams, _main_loop_delay, next_housekeeping,
+							event_subs, sizeof(event_subs) / sizeof(event_subs[0]));
+		}
 
 		perf_begin(_loop_perf);
 
 		hrt_abstime t = hrt_absolute_time();
+		_wakeups++;
+
+		/* update streams */
+		if (_fixed_loop) {
+			MavlinkStream *stream;
+			LL_FOREACH(_streams, stream) {
+				hrt_abstime deadline = stream->get_deadline();
+
+				if (stream->update(t) == 0 && deadline > 0) {
+					perf_set_elapsed(_send_late_perf, t - deadline);
+				}
+			}
+
+		} else {
+			_stream_scheduler.update(_streams, t, _send_late_perf);
+		}
+
+		if (!events && t < next_housekeeping) {
+			/* only streams were due */
+			_cpu_time += hrt_elapsed_time(&t);
+			perf_end(_loop_perf);
+			continue;
+		}
+
+		/* forwarding, FTP and the shell are polled, everything else only needs a regular check */
+		if (_forwarding_on || _ftp_on || _mavlink_shell) {
+			next_housekeeping = t + _main_loop_delay;
+
+		} else {
+			next_housekeeping = t + MAIN_LOOP_DELAY;
+		}
 
 		update_rate_mult();
 
@@ -2150,12 +2294,6 @@ Mavlink::task_main(int argc, char *argv[])
 			_subscribe_to_stream = nullptr;
 		}
 
-		/* update streams */
-		MavlinkStream *stream;
-		LL_FOREACH(_streams, stream) {
-			stream->update(t);
-		}
-
 		/* pass messages from other UARTs or FTP worker */
 		if (_forwarding_on || _ftp_on) {
 
@@ -2214,11 +2352,18 @@ Mavlink::task_main(int argc, char *argv[])
 				_bytes_tx = 0;
 				_bytes_txerr = 0;
 				_bytes_rx = 0;
+
+				_cpu_load = _cpu_time / (dt * 1000.0f);
+				_wakeup_rate = _wakeups / (dt / 1000.0f);
 			}
 
+			_cpu_time = 0;
+			_wakeups = 0;
+
 			_bytes_timestamp = t;
 		}
 
+		_cpu_time += hrt_elapsed_time(&t);
 		perf_end(_loop_perf);
 
 		/* confirm task running only once fully initialized */
@@ -2397,6 +2542,8 @@ Mavlink::display_status()
 	printf("\ttxerr: %.3f kB/s\n", (double)_rate_txerr);
 	printf("\trx: %.3f kB/s\n", (double)_rate_rx);
 	printf("\trate mult: %.3f\n", (double)_rate_mult);
+	printf("\tcpu: %.1f %%, %.0f wakeups/s\n", (double)(_cpu_load * 100.0f), (double)_wakeup_rate);
+	perf_print_counter(_send_late_perf);
 	printf("\taccepting commands: %s\n", (accepting_commands()) ? "YES" : "NO");
 }
 
@@ -2530,6 +2677,7 @@ static void usage()
 	PX4_INFO("    [-m mode]");
 	PX4_INFO("    [-s stream]");
 	PX4_INFO("    [-f]");
+	PX4_INFO("    [-l]");
 	PX4_INFO("    [-p]");
 	PX4_INFO("    [-v]");
 	PX4_INFO("    [-w]");
@@ -49,6 +49,13 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <drivers/device/device.h>
+#ifndef __PX4_LINUX
+/* sendmmsg() and recvmmsg() are Linux only, elsewhere the messages are handled one by one */
+struct mmsghdr {
+	struct msghdr msg_hdr;
+	unsigned int msg_len;
+};
+#endif
 #endif
 #include <systemlib/param/param.h>
 #include <systemlib/perf_counter.h>
@@ -64,6 +71,7 @@
 #include "mavlink_bridge_header.h"
 #include "mavlink_orb_subscription.h"
 #include "mavlink_stream.h"
+#include "mavlink_stream_scheduler.h"
 #include "mavlink_messages.h"
 #include "mavlink_mission.h"
 #include "mavlink_parameters.h"
@@ -272,12 +280,22 @@ public:
 	void			send_bytes(const uint8_t *buf, unsigned packet_len);
 
 	/**
-	 * Flush the transmit buffer and send one MAVLink packet
+	 * Finish one MAVLink packet.
+	 *
+	 * On a network port the packet is queued and sent together with others
+	 * by flush_network(), or right away once the queue is full.
 	 *
-	 * @return the number of bytes sent or -1 in case of error
+	 * @return the number of bytes of the packet or -1 in case of error
 	 */
 	int			send_packet();
 
+	/**
+	 * Send all packets queued on a network port with as few system calls as possible.
+	 *
+	 * Has to be called by a thread which sent something before it sleeps.
+	 */
+	void			flush_network();
+
 	/**
 	 * Resend message as is, don't change sequence number and CRC.
 	 */
@@ -447,12 +465,14 @@ private:
 	bool			_forward_externalsp;	/**< Forward external setpoint messages to controllers directly if in offboard mode */
 	bool			_is_usb_uart;		/**< Port is USB */
 	bool			_wait_to_transmit;  	/**< Wait to transmit until received messages. */
+	bool			_fixed_loop;		/**< Update all streams every loop period instead of using the stream scheduler */
 	bool			_received_messages;	/**< Whether we've received valid mavlink messages. */
 
 	unsigned		_main_loop_delay;	/**< mainloop delay, depends on data rate */
 
 	MavlinkOrbSubscription	*_subscriptions;
 	MavlinkStream		*_streams;
+	MavlinkStreamScheduler	_stream_scheduler;
 
 	MavlinkMissionManager		*_mission_manager;
 	MavlinkParametersManager	*_parameters_manager;
@@ -509,6 +529,11 @@ private:
 	float			_rate_txerr;
 	float			_rate_rx;
 
+	hrt_abstime		_cpu_time;		/**< main loop run time since _bytes_timestamp */
+	unsigned		_wakeups;		/**< main loop wakeups since _bytes_timestamp */
+	float			_cpu_load;		/**< share of time spent in the main loop */
+	float			_wakeup_rate;		/**< main loop wakeups per second */
+
 #ifdef __PX4_POSIX
 	struct sockaddr_in _myaddr;
 	struct sockaddr_in _src_addr;
@@ -517,8 +542,14 @@ private:
 	bool _broadcast_address_found;
 	bool _broadcast_address_not_found_warned;
 	bool _broadcast_failed_warned;
-	uint8_t _network_buf[MAVLINK_MAX_PACKET_LEN];
-	unsigned _network_buf_len;
+	static const unsigned NETWORK_BATCH = 32;		///< packets sent by one flush_network() at most
+	uint8_t _network_buf[NETWORK_BATCH][MAVLINK_MAX_PACKET_LEN];
+	unsigned _network_buf_len;				///< length of the packet being assembled
+	uint16_t _network_packet_len[NETWORK_BATCH];		///< length of each queued packet
+	bool _network_packet_broadcast[NETWORK_BATCH];		///< queued packet is sent to the broadcast address as well
+	unsigned _network_queued;				///< number of queued packets
+	struct mmsghdr _network_msgs[NETWORK_BATCH * 2];	///< datagrams of one send_network_queue()
+	struct iovec _network_iov[NETWORK_BATCH];
 #endif
 	int _socket_fd;
 	Protocol	_protocol;
@@ -557,6 +588,7 @@ private:
 
 	perf_counter_t		_loop_perf;			/**< loop performance counter */
 	perf_counter_t		_txerr_perf;			/**< TX error counter */
+	perf_counter_t		_send_late_perf;		/**< time streams sent after their deadline */
 
 	void			mavlink_update_system();
 
@@ -600,6 +632,11 @@ private:
 
 	void find_broadcast_address();
 
+	/**
+	 * Send the queued packets, _send_mutex must be held.
+	 */
+	void send_network_queue();
+
 	void init_udp();
 
 	/**
@@ -499,6 +499,11 @@ public:
 		return 0;	// commands stream is not regular and not predictable
 	}
 
+	MavlinkOrbSubscription *get_trigger()
+	{
+		return _cmd_sub;
+	}
+
 private:
 	MavlinkOrbSubscription *_cmd_sub;
 	uint64_t _cmd_time;
@@ -1291,6 +1296,11 @@ public:
 		return (_trigger_time > 0) ? MAVLINK_MSG_ID_CAMERA_TRIGGER_LEN + MAVLINK_NUM_NON_PAYLOAD_BYTES : 0;
 	}
 
+	MavlinkOrbSubscription *get_trigger()
+	{
+		return _trigger_sub;
+	}
+
 private:
 	MavlinkOrbSubscription *_trigger_sub;
 	uint64_t _trigger_time;
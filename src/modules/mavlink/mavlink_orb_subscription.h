@@ -90,6 +90,11 @@ public:
 	orb_id_t get_topic() const;
 	int get_instance() const;
 
+	/**
+	 * Subscription handle, to poll for updates of the topic.
+	 */
+	int get_fd() const { return _fd; }
+
 private:
 	const orb_id_t _topic;		///< topic metadata
 	const int _instance;		///< get topic instance
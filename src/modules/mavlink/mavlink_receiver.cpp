@@ -89,7 +89,7 @@ static const float mg2ms2 = CONSTANTS_ONE_G / 1000.0f;
 
 MavlinkReceiver::MavlinkReceiver(Mavlink *parent) :
 	_mavlink(parent),
-	status{},
+	_parser(),
 	hil_local_pos{},
 	hil_land_detector{},
 	_control_mode{},
@@ -2085,11 +2085,17 @@ MavlinkReceiver::receive_thread(void *arg)
 	const int timeout = 500;
 #ifdef __PX4_POSIX
 	/* 1500 is the Wifi MTU, so we make sure to fit a full packet */
-	uint8_t buf[1600 * 5];
+	const unsigned datagram_size = 1600;
+	/* datagrams received with one system call */
+	const unsigned batch = 8;
 #else
 	/* the serial port buffers internally as well, we just need to fit a small chunk */
-	uint8_t buf[64];
+	const unsigned datagram_size = 64;
+	const unsigned batch = 1;
 #endif
+	uint8_t buf[datagram_size * batch];
+	/* length of each datagram in buf, a serial port read fills all of buf */
+	ssize_t nread[batch];
 	mavlink_message_t msg;
 
 	struct pollfd fds[1];
@@ -2104,8 +2110,13 @@ MavlinkReceiver::receive_thread(void *arg)
 	}
 
 #ifdef __PX4_POSIX
-	struct sockaddr_in srcaddr = {};
-	socklen_t addrlen = sizeof(srcaddr);
+	struct sockaddr_in srcaddr[batch] = {};
+#ifdef __PX4_LINUX
+	struct iovec iov[batch];
+	struct mmsghdr msgs[batch];
+#else
+	socklen_t addrlen = sizeof(srcaddr[0]);
+#endif
 
 	if (_mavlink->get_protocol() == UDP || _mavlink->get_protocol() == TCP) {
 		// make sure mavlink app has booted before we start using the socket
@@ -2118,10 +2129,12 @@ MavlinkReceiver::receive_thread(void *arg)
 	}
 
 #endif
-	ssize_t nread = 0;
 
 	while (!_mavlink->_task_should_exit) {
 		if (poll(&fds[0], 1, timeout) > 0) {
+			unsigned received = 1;
+			nread[0] = 0;
+
 			if (_mavlink->get_protocol() == SERIAL) {
 
 				/*
@@ -2131,7 +2144,7 @@ MavlinkReceiver::receive_thread(void *arg)
 				const unsigned character_count = 20;
 
 				/* non-blocking read. read may return negative values */
-				if ((nread = ::read(uart_fd, buf, sizeof(buf))) < (ssize_t)character_count) {
+				if ((nread[0] = ::read(uart_fd, buf, sizeof(buf))) < (ssize_t)character_count) {
 					unsigned sleeptime = (1.0f / (_mavlink->get_baudrate() / 10)) * character_count * 1000000;
 					usleep(sleeptime);
 				}
@@ -2141,57 +2154,93 @@ MavlinkReceiver::receive_thread(void *arg)
 
 			if (_mavlink->get_protocol() == UDP) {
 				if (fds[0].revents & POLLIN) {
-					nread = recvfrom(_mavlink->get_socket_fd(), buf, sizeof(buf), 0, (struct sockaddr *)&srcaddr, &addrlen);
+#ifdef __PX4_LINUX
+					memset(msgs, 0, sizeof(msgs));
+
+					for (unsigned i = 0; i < batch; i++) {
+						iov[i].iov_base = &buf[i * datagram_size];
+						iov[i].iov_len = datagram_size;
+						msgs[i].msg_hdr.msg_name = &srcaddr[i];
+						msgs[i].msg_hdr.msg_namelen = sizeof(srcaddr[i]);
+						msgs[i].msg_hdr.msg_iov = &iov[i];
+						msgs[i].msg_hdr.msg_iovlen = 1;
+					}
+
+					/* everything which is queued, without waiting for more */
+					int ret = recvmmsg(_mavlink->get_socket_fd(), msgs, batch, MSG_DONTWAIT, nullptr);
+
+					if (ret > 0) {
+						received = ret;
+
+						for (unsigned i = 0; i < received; i++) {
+							nread[i] = msgs[i].msg_len;
+						}
+
+					} else {
+						nread[0] = ret;
+					}
+
+#else
+					nread[0] = recvfrom(_mavlink->get_socket_fd(), buf, sizeof(buf), 0, (struct sockaddr *)&srcaddr[0], &addrlen);
+#endif
 				}
 
 			} else {
 				// could be TCP or other protocol
 			}
 
-			struct sockaddr_in *srcaddr_last = _mavlink->get_client_source_address();
+#endif
+
+			for (unsigned d = 0; d < received; d++) {
+#ifdef __PX4_POSIX
+				struct sockaddr_in *srcaddr_last = _mavlink->get_client_source_address();
 
-			int localhost = (127 << 24) + 1;
+				int localhost = (127 << 24) + 1;
 
-			if (!_mavlink->get_client_source_initialized()) {
+				if (!_mavlink->get_client_source_initialized()) {
 
-				// set the address either if localhost or if 3 seconds have passed
-				// this ensures that a GCS running on localhost can get a hold of
-				// the system within the first N seconds
-				hrt_abstime stime = _mavlink->get_start_time();
+					// set the address either if localhost or if 3 seconds have passed
+					// this ensures that a GCS running on localhost can get a hold of
+					// the system within the first N seconds
+					hrt_abstime stime = _mavlink->get_start_time();
 
-				if ((stime != 0 && (hrt_elapsed_time(&stime) > 3 * 1000 * 1000))
-				    || (srcaddr_last->sin_addr.s_addr == htonl(localhost))) {
-					srcaddr_last->sin_addr.s_addr = srcaddr.sin_addr.s_addr;
-					srcaddr_last->sin_port = srcaddr.sin_port;
-					_mavlink->set_client_source_initialized();
-					PX4_INFO("partner IP: %s", inet_ntoa(srcaddr.sin_addr));
+					if ((stime != 0 && (hrt_elapsed_time(&stime) > 3 * 1000 * 1000))
+					    || (srcaddr_last->sin_addr.s_addr == htonl(localhost))) {
+						srcaddr_last->sin_addr.s_addr = srcaddr[d].sin_addr.s_addr;
+						srcaddr_last->sin_port = srcaddr[d].sin_port;
+						_mavlink->set_client_source_initialized();
+						PX4_INFO("partner IP: %s", inet_ntoa(srcaddr[d].sin_addr));
+					}
 				}
-			}
 
 #endif
-			// only start accepting messages once we're sure who we talk to
+				// only start accepting messages once we're sure who we talk to
 
-			if (_mavlink->get_client_source_initialized()) {
-				/* if read failed, this loop won't execute */
-				for (ssize_t i = 0; i < nread; i++) {
-					if (mavlink_parse_char(_mavlink->get_channel(), buf[i], &msg, &status)) {
+				if (_mavlink->get_client_source_initialized()) {
+					/* nread will be -1 on read error */
+					if (nread[d] > 0) {
+						_parser.set_buffer(&buf[d * datagram_size], nread[d]);
 
-						/* check if we received version 2 */
-						// XXX todo _mavlink->set_proto_version(2);
+						while (_parser.next(&msg)) {
 
-						/* handle generic messages and commands */
-						handle_message(&msg);
+							/* check if we received version 2 */
+							// XXX todo _mavlink->set_proto_version(2);
 
-						/* handle packet with parent object */
-						_mavlink->handle_message(&msg);
-					}
-				}
+							/* handle generic messages and commands */
+							handle_message(&msg);
+
+							/* handle packet with parent object */
+							_mavlink->handle_message(&msg);
+						}
 
-				/* count received bytes (nread will be -1 on read error) */
-				if (nread > 0) {
-					_mavlink->count_rxbytes(nread);
+						/* count received bytes */
+						_mavlink->count_rxbytes(nread[d]);
+					}
 				}
 			}
+
+			/* send the replies to what has been received */
+			_mavlink->flush_network();
 		}
 	}
 
@@ -79,6 +79,7 @@
 #include <uORB/topics/gps_inject_data.h>
 
 #include "mavlink_ftp.h"
+#include "mavlink_frame_parser.h"
 
 #define PX4_EPOCH_SECS 1234567890ULL
 
@@ -182,7 +183,7 @@ private:
 	bool	evaluate_target_ok(int command, int target_system, int target_component);
 
 	Mavlink	*_mavlink;
-	mavlink_status_t status;
+	MavlinkFrameParser _parser;
 	struct vehicle_local_position_s hil_local_pos;
 	struct vehicle_land_detected_s hil_land_detector;
 	struct vehicle_control_mode_s _control_mode;
@@ -43,11 +43,15 @@
 #include "mavlink_stream.h"
 #include "mavlink_main.h"
 
+#define TRIGGER_TIMEOUT		1000000		///< update triggered streams at least once a second
+
 MavlinkStream::MavlinkStream(Mavlink *mavlink) :
 	next(nullptr),
 	_mavlink(mavlink),
 	_interval(1000000),
-	_last_sent(0)
+	_last_sent(0),
+	_deadline(0),
+	_triggered(false)
 {
 }
 
@@ -62,6 +66,17 @@ void
 MavlinkStream::set_interval(const unsigned int interval)
 {
 	_interval = interval;
+	_deadline = 0;
+}
+
+void
+MavlinkStream::trigger(const hrt_abstime t)
+{
+	_triggered = true;
+
+	if (_deadline > t) {
+		_deadline = t;
+	}
 }
 
 /**
@@ -77,6 +92,11 @@ MavlinkStream::update(const hrt_abstime t)
 		interval /= _mavlink->get_rate_mult();
 	}
 
+	/* never ask to be updated again at the same time */
+	if (interval == 0) {
+		interval = 1;
+	}
+
 	if (dt > 0 && dt >= interval) {
 		/* interval expired, send message */
 #ifndef __PX4_QURT
@@ -90,8 +110,19 @@ MavlinkStream::update(const hrt_abstime t)
 			_last_sent = t;
 		}
 
+		if (get_trigger() != nullptr) {
+			/* wait for the topic, but never longer than the timeout */
+			_deadline = _last_sent + ((interval > TRIGGER_TIMEOUT) ? interval : TRIGGER_TIMEOUT);
+			_triggered = false;
+
+		} else {
+			_deadline = _last_sent + interval;
+		}
+
 		return 0;
 	}
 
+	_deadline = _last_sent + interval;
+
 	return -1;
 }
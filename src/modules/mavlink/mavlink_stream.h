@@ -45,6 +45,7 @@
 
 class Mavlink;
 class MavlinkStream;
+class MavlinkOrbSubscription;
 
 class MavlinkStream
 {
@@ -73,6 +74,36 @@ public:
 	 * @return 0 if updated / sent, -1 if unchanged
 	 */
 	int update(const hrt_abstime t);
+
+	/**
+	 * Get the time the stream wants to be updated next, set by update()
+	 *
+	 * @return the deadline in microseconds, 0 if the stream should be updated right away
+	 */
+	hrt_abstime get_deadline() const { return _deadline; }
+
+	/**
+	 * Get the topic a stream is driven by
+	 *
+	 * A stream which only sends when its topic is published (e.g. commands) can
+	 * return the subscription of that topic. Once it has sent the stream is then
+	 * only updated again when the topic is published, instead of at its interval.
+	 *
+	 * @return the trigger subscription, nullptr for streams updated at their interval
+	 */
+	virtual MavlinkOrbSubscription *get_trigger() { return nullptr; }
+
+	/**
+	 * Mark the trigger topic as published, the stream is updated at t or
+	 * as soon as its interval allows.
+	 */
+	void trigger(const hrt_abstime t);
+
+	/**
+	 * @return true if the stream has been triggered but not yet sent
+	 */
+	bool triggered() const { return _triggered; }
+
 	virtual const char *get_name() const = 0;
 	virtual uint8_t get_id() = 0;
 
@@ -106,6 +137,8 @@ protected:
 
 private:
 	hrt_abstime _last_sent;
+	hrt_abstime _deadline;
+	bool _triggered;
 
 	/* do not allow top copying this class */
 	MavlinkStream(const MavlinkStream &);
@@ -0,0 +1,261 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavlink_stream_scheduler.cpp
+ * Deadline ordered scheduling of the streams of a mavlink instance.
+ */
+
+#include <unistd.h>
+
+#include "mavlink_stream_scheduler.h"
+#include "mavlink_stream.h"
+#include "mavlink_orb_subscription.h"
+
+MavlinkStreamScheduler::MavlinkStreamScheduler() :
+	_heap(nullptr),
+	_count(0),
+	_capacity(0),
+	_fds(nullptr),
+	_fd_streams(nullptr),
+	_fd_capacity(0),
+	_valid(false)
+{
+}
+
+MavlinkStreamScheduler::~MavlinkStreamScheduler()
+{
+	delete[] _heap;
+	delete[] _fds;
+	delete[] _fd_streams;
+}
+
+bool
+MavlinkStreamScheduler::rebuild(MavlinkStream *streams)
+{
+	unsigned count = 0;
+
+	for (MavlinkStream *stream = streams; stream != nullptr; stream = stream->next) {
+		count++;
+	}
+
+	if (count > _capacity) {
+		delete[] _heap;
+		_capacity = 0;
+		_count = 0;
+
+		_heap = new MavlinkStream *[count];
+
+		if (_heap == nullptr) {
+			return false;
+		}
+
+		_capacity = count;
+	}
+
+	_count = 0;
+
+	for (MavlinkStream *stream = streams; stream != nullptr; stream = stream->next) {
+		_heap[_count++] = stream;
+	}
+
+	for (unsigned i = _count / 2; i > 0; i--) {
+		sift_down(i - 1);
+	}
+
+	_valid = true;
+	return true;
+}
+
+bool
+MavlinkStreamScheduler::reserve_fds(unsigned count)
+{
+	if (count <= _fd_capacity) {
+		return true;
+	}
+
+	delete[] _fds;
+	delete[] _fd_streams;
+	_fd_capacity = 0;
+
+	_fds = new px4_pollfd_struct_t[count];
+	_fd_streams = new MavlinkStream *[count];
+
+	if (_fds == nullptr || _fd_streams == nullptr) {
+		return false;
+	}
+
+	_fd_capacity = count;
+	return true;
+}
+
+void
+MavlinkStreamScheduler::sift_down(unsigned index)
+{
+	MavlinkStream *stream = _heap[index];
+	hrt_abstime deadline = stream->get_deadline();
+
+	for (;;) {
+		unsigned child = 2 * index + 1;
+
+		if (child >= _count) {
+			break;
+		}
+
+		if (child + 1 < _count && _heap[child + 1]->get_deadline() < _heap[child]->get_deadline()) {
+			child++;
+		}
+
+		if (_heap[child]->get_deadline() >= deadline) {
+			break;
+		}
+
+		_heap[index] = _heap[child];
+		index = child;
+	}
+
+	_heap[index] = stream;
+}
+
+bool
+MavlinkStreamScheduler::wait(MavlinkStream *streams, unsigned interval, hrt_abstime latest,
+			     MavlinkOrbSubscription *const *subs, unsigned sub_count)
+{
+	if (!_valid) {
+		rebuild(streams);
+	}
+
+	hrt_abstime wakeup = latest;
+	bool triggered = false;
+
+	if (_count > 0 && _heap[0]->get_deadline() < wakeup) {
+		wakeup = _heap[0]->get_deadline();
+		triggered = _heap[0]->triggered();
+	}
+
+	/* data which is waiting to be sent does not wait for the next interval */
+	if (interval > 0 && !triggered) {
+		wakeup = (wakeup + interval - 1) / interval * interval;
+	}
+
+	hrt_abstime now = hrt_absolute_time();
+
+	if (wakeup <= now) {
+		return false;
+	}
+
+	unsigned nfds = 0;
+
+	if (reserve_fds(_count + sub_count)) {
+		for (unsigned i = 0; i < sub_count; i++) {
+			_fds[nfds].fd = subs[i]->get_fd();
+			_fds[nfds].events = POLLIN;
+			_fd_streams[nfds] = nullptr;
+			nfds++;
+		}
+
+		/* streams which sent their last message only need to wake up for new data */
+		for (unsigned i = 0; i < _count; i++) {
+			MavlinkOrbSubscription *trigger = _heap[i]->get_trigger();
+
+			if (trigger != nullptr && !_heap[i]->triggered()) {
+				_fds[nfds].fd = trigger->get_fd();
+				_fds[nfds].events = POLLIN;
+				_fd_streams[nfds] = _heap[i];
+				nfds++;
+			}
+		}
+	}
+
+	if (nfds > 0) {
+		int ret = px4_poll(_fds, nfds, (wakeup - now) / 1000);
+
+		if (ret > 0) {
+			bool events = false;
+			now = hrt_absolute_time();
+
+			for (unsigned i = 0; i < nfds; i++) {
+				if (!(_fds[i].revents & POLLIN)) {
+					continue;
+				}
+
+				if (_fd_streams[i] != nullptr) {
+					_fd_streams[i]->trigger(now);
+					_valid = false;
+
+				} else {
+					events = true;
+				}
+			}
+
+			return events;
+		}
+
+		now = hrt_absolute_time();
+	}
+
+	/* poll only has a millisecond timeout, sleep off the remainder */
+	if (wakeup > now) {
+		usleep(wakeup - now);
+	}
+
+	return false;
+}
+
+unsigned
+MavlinkStreamScheduler::update(MavlinkStream *streams, hrt_abstime t, perf_counter_t late_perf)
+{
+	if (!_valid && !rebuild(streams)) {
+		return 0;
+	}
+
+	unsigned sent = 0;
+
+	/* every update moves the deadline of the stream past t */
+	while (_count > 0 && _heap[0]->get_deadline() <= t) {
+		MavlinkStream *stream = _heap[0];
+		hrt_abstime deadline = stream->get_deadline();
+
+		if (stream->update(t) == 0) {
+			sent++;
+
+			if (deadline > 0) {
+				perf_set_elapsed(late_perf, t - deadline);
+			}
+		}
+
+		sift_down(0);
+	}
+
+	return sent;
+}
@@ -0,0 +1,115 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavlink_stream_scheduler.h
+ * Deadline ordered scheduling of the streams of a mavlink instance.
+ */
+
+#ifndef MAVLINK_STREAM_SCHEDULER_H_
+#define MAVLINK_STREAM_SCHEDULER_H_
+
+#include <px4_posix.h>
+#include <drivers/drv_hrt.h>
+#include <systemlib/perf_counter.h>
+
+class MavlinkStream;
+class MavlinkOrbSubscription;
+
+/**
+ * Keeps the streams in a min-heap ordered by MavlinkStream::get_deadline(),
+ * so that each loop only updates the streams which are due instead of all of
+ * them, and sleeps until the next one is due.
+ */
+class MavlinkStreamScheduler
+{
+public:
+	MavlinkStreamScheduler();
+	~MavlinkStreamScheduler();
+
+	/**
+	 * Rebuild the schedule before the next use, required whenever streams
+	 * were added, removed or changed their interval.
+	 */
+	void invalidate() { _valid = false; }
+
+	/**
+	 * Sleep until the earliest stream deadline, but not after latest.
+	 *
+	 * The wakeup is rounded up to a multiple of interval, so that the streams
+	 * are sent at the same time as by a loop running at that interval, but
+	 * intervals without any stream due are skipped. Triggered streams are
+	 * not rounded.
+	 *
+	 * A publication on the trigger topic of a stream waiting for it or on one
+	 * of the given subscriptions wakes up right away.
+	 *
+	 * @param streams list of streams
+	 * @param interval interval in us the deadlines are rounded to
+	 * @param latest wake up at this time at the latest
+	 * @param subs additional subscriptions to wake up for
+	 * @param sub_count number of subscriptions in subs
+	 * @return true if one of the given subscriptions has been published
+	 */
+	bool wait(MavlinkStream *streams, unsigned interval, hrt_abstime latest,
+		  MavlinkOrbSubscription *const *subs, unsigned sub_count);
+
+	/**
+	 * Update all streams with a deadline up to t.
+	 *
+	 * @param streams list of streams
+	 * @param t current time
+	 * @param late_perf counter for how late (in us) the streams sent after their deadline
+	 * @return number of streams which sent
+	 */
+	unsigned update(MavlinkStream *streams, hrt_abstime t, perf_counter_t late_perf);
+
+private:
+	MavlinkStream		**_heap;	///< streams, the one with the earliest deadline first
+	unsigned		_count;		///< number of streams in the heap
+	unsigned		_capacity;	///< size of _heap
+	px4_pollfd_struct_t	*_fds;		///< poll set of wait()
+	MavlinkStream		**_fd_streams;	///< stream of each fd, nullptr for subscriptions
+	unsigned		_fd_capacity;	///< size of _fds and _fd_streams
+	bool			_valid;		///< heap is up to date with the list of streams
+
+	bool rebuild(MavlinkStream *streams);
+	bool reserve_fds(unsigned count);
+	void sift_down(unsigned index);
+
+	/* do not allow copying this class */
+	MavlinkStreamScheduler(const MavlinkStreamScheduler &);
+	MavlinkStreamScheduler &operator=(const MavlinkStreamScheduler &);
+};
+
+#endif /* MAVLINK_STREAM_SCHEDULER_H_ */
@@ -0,0 +1,306 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file mavlink_frame_parser_test.cpp
+ * Compares MavlinkFrameParser against mavlink_parse_char().
+ */
+
+#include <string.h>
+
+#include "mavlink_frame_parser_test.h"
+#include "mavlink_parse_reference.h"
+#include "../mavlink_frame_parser.h"
+
+namespace
+{
+
+/**
+ * Fill buf with frame number index: heartbeat, attitude, highres IMU and a status text with
+ * start bytes in its payload. Every third frame is MAVLink 1, the others truncate their payload.
+ *
+ * @param msgid message ID to use instead, with a CRC extra of 0, if not 0
+ * @return length of the frame
+ */
+unsigned build_frame(uint8_t *buf, mavlink_status_t *status, unsigned index, uint32_t msgid = 0)
+{
+	mavlink_message_t msg = {};
+
+	if (index % 3 == 1) {
+		status->flags |= MAVLINK_STATUS_FLAG_OUT_MAVLINK1;
+
+	} else {
+		status->flags &= ~MAVLINK_STATUS_FLAG_OUT_MAVLINK1;
+	}
+
+	if (msgid != 0) {
+		status->flags &= ~MAVLINK_STATUS_FLAG_OUT_MAVLINK1;
+		memset(_MAV_PAYLOAD_NON_CONST(&msg), 0x42, 20);
+		msg.msgid = msgid;
+		mavlink_finalize_message_buffer(&msg, 1, 1, status, 20, 20, 0);
+
+	} else if (index % 4 == 0) {
+		mavlink_heartbeat_t hb = {};
+		hb.type = index;
+		hb.mavlink_version = 3;
+		memcpy(_MAV_PAYLOAD_NON_CONST(&msg), &hb, sizeof(hb));
+		msg.msgid = MAVLINK_MSG_ID_HEARTBEAT;
+		mavlink_finalize_message_buffer(&msg, 1, 1, status, MAVLINK_MSG_ID_HEARTBEAT_MIN_LEN,
+						MAVLINK_MSG_ID_HEARTBEAT_LEN, MAVLINK_MSG_ID_HEARTBEAT_CRC);
+
+	} else if (index % 4 == 1) {
+		mavlink_attitude_t att = {};
+		att.time_boot_ms = index;
+		att.roll = 0.1f;
+		memcpy(_MAV_PAYLOAD_NON_CONST(&msg), &att, sizeof(att));
+		msg.msgid = MAVLINK_MSG_ID_ATTITUDE;
+		mavlink_finalize_message_buffer(&msg, 1, 1, status, MAVLINK_MSG_ID_ATTITUDE_MIN_LEN,
+						MAVLINK_MSG_ID_ATTITUDE_LEN, MAVLINK_MSG_ID_ATTITUDE_CRC);
+
+	} else if (index % 4 == 2) {
+		mavlink_highres_imu_t imu = {};
+		imu.time_usec = index;
+		imu.xacc = 9.81f;
+		memcpy(_MAV_PAYLOAD_NON_CONST(&msg), &imu, sizeof(imu));
+		msg.msgid = MAVLINK_MSG_ID_HIGHRES_IMU;
+		mavlink_finalize_message_buffer(&msg, 1, 1, status, MAVLINK_MSG_ID_HIGHRES_IMU_MIN_LEN,
+						MAVLINK_MSG_ID_HIGHRES_IMU_LEN, MAVLINK_MSG_ID_HIGHRES_IMU_CRC);
+
+	} else {
+		mavlink_statustext_t text = {};
+		text.severity = index;
+
+		/* a short text, the start bytes must not resynchronize either parser */
+		for (unsigned i = 0; i < 12; i++) {
+			text.text[i] = (i % 3 == 0) ? MAVLINK_STX : (i % 3 == 1) ? MAVLINK_STX_MAVLINK1 : 'a' + i;
+		}
+
+		memcpy(_MAV_PAYLOAD_NON_CONST(&msg), &text, sizeof(text));
+		msg.msgid = MAVLINK_MSG_ID_STATUSTEXT;
+		mavlink_finalize_message_buffer(&msg, 1, 1, status, MAVLINK_MSG_ID_STATUSTEXT_MIN_LEN,
+						MAVLINK_MSG_ID_STATUSTEXT_LEN, MAVLINK_MSG_ID_STATUSTEXT_CRC);
+	}
+
+	return mavlink_msg_to_send_buffer(buf, &msg);
+}
+
+bool same_message(const mavlink_message_t *a, const mavlink_message_t *b)
+{
+	/* both zero fill the payload up to the length the message is known to have */
+	const mavlink_msg_entry_t *entry = mavlink_get_msg_entry(a->msgid);
+	unsigned payload_len = (entry != nullptr && entry->max_msg_len > a->len) ? entry->max_msg_len : a->len;
+
+	return a->magic == b->magic &&
+	       a->len == b->len &&
+	       a->incompat_flags == b->incompat_flags &&
+	       a->compat_flags == b->compat_flags &&
+	       a->seq == b->seq &&
+	       a->sysid == b->sysid &&
+	       a->compid == b->compid &&
+	       a->msgid == b->msgid &&
+	       a->checksum == b->checksum &&
+	       a->ck[0] == b->ck[0] &&
+	       a->ck[1] == b->ck[1] &&
+	       memcmp(_MAV_PAYLOAD(a), _MAV_PAYLOAD(b), payload_len) == 0;
+}
+
+} // anonymous namespace
+
+MavlinkFrameParserTest::MavlinkFrameParserTest() :
+	_stream_len(0)
+{
+}
+
+MavlinkFrameParserTest::~MavlinkFrameParserTest()
+{
+}
+
+void MavlinkFrameParserTest::_init(void)
+{
+	mavlink_status_t status = {};
+	_stream_len = 0;
+
+	for (unsigned i = 0; i < _frame_count; i++) {
+		_stream_len += build_frame(&_stream[_stream_len], &status, i);
+	}
+}
+
+bool MavlinkFrameParserTest::_compare(const uint8_t *stream, size_t len, unsigned chunk, uint32_t seed,
+				      unsigned *messages)
+{
+	MavlinkFrameParser parser;
+	mavlink_message_t msg;
+	mavlink_message_t ref_msg;
+	mavlink_status_t ref_status;
+	size_t pos = 0;
+	size_t ref_pos = 0;
+
+	*messages = 0;
+	mavlink_parse_reference_reset();
+
+	while (pos < len) {
+		size_t n = chunk;
+
+		if (n == 0) {
+			seed = seed * 1664525u + 1013904223u;
+			n = 1 + (seed >> 16) % 64;
+		}
+
+		if (n > len - pos) {
+			n = len - pos;
+		}
+
+		parser.set_buffer(&stream[pos], n);
+		pos += n;
+
+		while (parser.next(&msg)) {
+			/* mavlink_parse_char() has to find the same message in the bytes handed over so far */
+			bool found = false;
+
+			while (!found && ref_pos < pos) {
+				found = mavlink_parse_reference(stream[ref_pos++], &ref_msg, &ref_status) == MAVLINK_FRAMING_OK;
+			}
+
+			ut_assert("message missed by mavlink_parse_char()", found);
+			ut_assert("messages differ", same_message(&msg, &ref_msg));
+			(*messages)++;
+		}
+	}
+
+	while (ref_pos < len) {
+		ut_assert("message missed by the frame parser",
+			  mavlink_parse_reference(stream[ref_pos++], &ref_msg, &ref_status) != MAVLINK_FRAMING_OK);
+	}
+
+	const mavlink_status_t &status = parser.get_status();
+	const mavlink_status_t *ref = mavlink_parse_reference_status();
+	ut_compare("received", status.packet_rx_success_count, ref->packet_rx_success_count);
+	ut_compare("dropped", status.packet_rx_drop_count, ref->packet_rx_drop_count);
+	ut_compare("parse errors", status.parse_error, ref->parse_error);
+
+	return true;
+}
+
+/// @brief Tests a buffer of whole frames, like a UDP datagram.
+bool MavlinkFrameParserTest::_whole_test(void)
+{
+	unsigned messages;
+
+	ut_assert("compare failed", _compare(_stream, _stream_len, _stream_len, 0, &messages));
+	ut_compare("messages", messages, _frame_count);
+
+	return true;
+}
+
+/// @brief Tests frames split over buffers, like serial reads.
+bool MavlinkFrameParserTest::_chunked_test(void)
+{
+	unsigned messages;
+
+	for (unsigned chunk = 1; chunk <= MAVLINK_MAX_PACKET_LEN + 1; chunk++) {
+		ut_assert("compare failed", _compare(_stream, _stream_len, chunk, 0, &messages));
+		ut_compare("messages", messages, _frame_count);
+	}
+
+	for (uint32_t seed = 1; seed <= 50; seed++) {
+		ut_assert("compare failed", _compare(_stream, _stream_len, 0, seed, &messages));
+		ut_compare("messages", messages, _frame_count);
+	}
+
+	return true;
+}
+
+/// @brief Tests a changed byte at every position, and a start byte instead of it.
+bool MavlinkFrameParserTest::_corrupted_test(void)
+{
+	unsigned messages;
+
+	for (size_t i = 0; i < _stream_len; i++) {
+		for (int variant = 0; variant < 2; variant++) {
+			memcpy(_work, _stream, _stream_len);
+			_work[i] = (variant == 0) ? _work[i] ^ 0x5a : MAVLINK_STX;
+
+			ut_assert("compare failed", _compare(_work, _stream_len, _stream_len, 0, &messages));
+			ut_assert("compare failed", _compare(_work, _stream_len, 0, i, &messages));
+		}
+	}
+
+	return true;
+}
+
+/// @brief Tests garbage and start bytes between frames, truncated frames and an unknown message.
+bool MavlinkFrameParserTest::_garbage_test(void)
+{
+	static const uint8_t garbage[] = { 0x00, MAVLINK_STX, MAVLINK_STX_MAVLINK1, 0x55, MAVLINK_STX, MAVLINK_STX };
+	mavlink_status_t status = {};
+	uint8_t frame[MAVLINK_MAX_PACKET_LEN];
+	size_t len = 0;
+	unsigned messages;
+
+	for (unsigned i = 0; i < _frame_count; i++) {
+		unsigned garbage_len = i % (sizeof(garbage) + 1);
+		unsigned frame_len = build_frame(frame, &status, i, (i == 7) ? 0x00ff01 : 0);
+
+		/* cut off every fifth frame */
+		if (i % 5 == 4) {
+			frame_len /= 2;
+		}
+
+		ut_assert("stream too long", len + garbage_len + frame_len <= sizeof(_work));
+		memcpy(&_work[len], garbage, garbage_len);
+		len += garbage_len;
+		memcpy(&_work[len], frame, frame_len);
+		len += frame_len;
+	}
+
+	ut_assert("compare failed", _compare(_work, len, len, 0, &messages));
+
+	for (uint32_t seed = 1; seed <= 50; seed++) {
+		ut_assert("compare failed", _compare(_work, len, 0, seed, &messages));
+	}
+
+	return true;
+}
+
+bool MavlinkFrameParserTest::run_tests(void)
+{
+	ut_run_test(_whole_test);
+	ut_run_test(_chunked_test);
+	ut_run_test(_corrupted_test);
+	ut_run_test(_garbage_test);
+
+	return (_tests_failed == 0);
+}
+
+ut_declare_test(mavlink_frame_parser_test, MavlinkFrameParserTest)
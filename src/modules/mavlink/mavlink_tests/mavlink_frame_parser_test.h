@@ -0,0 +1,84 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file mavlink_frame_parser_test.h
+ * Compares MavlinkFrameParser against mavlink_parse_char().
+ */
+
+#pragma once
+
+#include <unit_test/unit_test.h>
+#include "../mavlink_bridge_header.h"
+
+class MavlinkFrameParserTest : public UnitTest
+{
+public:
+	MavlinkFrameParserTest();
+	virtual ~MavlinkFrameParserTest();
+
+	virtual bool run_tests(void);
+
+	// We don't want any of these
+	MavlinkFrameParserTest(const MavlinkFrameParserTest &);
+	MavlinkFrameParserTest &operator=(const MavlinkFrameParserTest &);
+
+private:
+	virtual void _init(void);
+
+	bool _whole_test(void);
+	bool _chunked_test(void);
+	bool _corrupted_test(void);
+	bool _garbage_test(void);
+
+	/**
+	 * Parse a stream with MavlinkFrameParser, handing it over in chunks, and with
+	 * mavlink_parse_char() one byte at a time, and check both give the same messages
+	 * and statistics.
+	 *
+	 * @param chunk size of the chunks, 0 for pseudo random sizes from 1 to 64 bytes
+	 * @param seed seed of the pseudo random chunk sizes
+	 * @param messages number of messages parsed
+	 */
+	bool _compare(const uint8_t *stream, size_t len, unsigned chunk, uint32_t seed, unsigned *messages);
+
+	static const unsigned _frame_count = 24;	///< frames in the test stream
+	static const size_t _stream_size = 4096;
+
+	uint8_t		_stream[_stream_size];	///< valid frames, MAVLink 1 and 2 mixed
+	size_t		_stream_len;
+	uint8_t		_work[_stream_size];	///< modified copy of the stream
+};
+
+bool mavlink_frame_parser_test(void);
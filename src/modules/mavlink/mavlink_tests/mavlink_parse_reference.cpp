@@ -0,0 +1,66 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file mavlink_parse_reference.cpp
+ * mavlink_parse_char() on the channel state of the MAVLink library itself.
+ *
+ * The channels of the mavlink module only exist while an instance is running,
+ * so this file includes the library without mavlink_bridge_header.h. Then
+ * mavlink_helpers.h provides the channel status and buffer itself.
+ */
+
+#include <string.h>
+
+#include <v2.0/common/mavlink.h>
+
+#include "mavlink_parse_reference.h"
+
+static const uint8_t reference_channel = MAVLINK_COMM_0;
+
+void mavlink_parse_reference_reset(void)
+{
+	memset(mavlink_get_channel_status(reference_channel), 0, sizeof(mavlink_status_t));
+	memset(mavlink_get_channel_buffer(reference_channel), 0, sizeof(mavlink_message_t));
+}
+
+uint8_t mavlink_parse_reference(uint8_t c, mavlink_message_t *msg, mavlink_status_t *status)
+{
+	return mavlink_parse_char(reference_channel, c, msg, status);
+}
+
+const mavlink_status_t *mavlink_parse_reference_status(void)
+{
+	return mavlink_get_channel_status(reference_channel);
+}
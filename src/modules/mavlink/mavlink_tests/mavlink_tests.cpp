@@ -37,11 +37,26 @@
 
 #include <systemlib/err.h>
 
+#include <string.h>
+
 #include "mavlink_ftp_test.h"
+#include "mavlink_frame_parser_test.h"
+#include "mavlink_udp_bench.h"
 
 extern "C" __EXPORT int mavlink_tests_main(int argc, char *argv[]);
 
 int mavlink_tests_main(int argc, char *argv[])
 {
-	return mavlink_ftp_test() ? 0 : -1;
+	if (argc > 1 && !strcmp(argv[1], "udp_bench")) {
+		return mavlink_udp_bench() ? 0 : -1;
+	}
+
+	if (argc > 1 && !strcmp(argv[1], "parser")) {
+		return mavlink_frame_parser_test() ? 0 : -1;
+	}
+
+	bool ftp_passed = mavlink_ftp_test();
+	bool parser_passed = mavlink_frame_parser_test();
+
+	return (ftp_passed && parser_passed) ? 0 : -1;
 }
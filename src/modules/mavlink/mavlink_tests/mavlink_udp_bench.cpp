@@ -0,0 +1,324 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file mavlink_udp_bench.cpp
+ * Loopback throughput of the MAVLink UDP transport.
+ */
+
+#include <px4_config.h>
+#include <px4_log.h>
+#include <drivers/drv_hrt.h>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../mavlink_bridge_header.h"
+#include "../mavlink_frame_parser.h"
+#include "mavlink_udp_bench.h"
+
+#ifdef __PX4_LINUX
+
+namespace
+{
+
+const unsigned frame_count = 200000;	///< frames sent by each method
+const unsigned batch = 32;		///< frames sent before receiving them
+
+struct bench_socket {
+	int fd;
+	struct sockaddr_in addr;
+};
+
+bool open_socket(bench_socket *s)
+{
+	socklen_t len = sizeof(s->addr);
+
+	memset(&s->addr, 0, sizeof(s->addr));
+	s->addr.sin_family = AF_INET;
+	s->addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	s->addr.sin_port = 0;
+
+	s->fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+	if (s->fd < 0) {
+		return false;
+	}
+
+	if (bind(s->fd, (struct sockaddr *)&s->addr, sizeof(s->addr)) < 0 ||
+	    getsockname(s->fd, (struct sockaddr *)&s->addr, &len) < 0) {
+		close(s->fd);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Fill buf with frame number index, alternating between a small and a big
+ * message and between MAVLink 1 and 2 (which truncates the payload).
+ *
+ * @return length of the frame
+ */
+unsigned build_frame(uint8_t *buf, mavlink_status_t *status, unsigned index)
+{
+	mavlink_message_t msg = {};
+
+	if (index & 2) {
+		status->flags |= MAVLINK_STATUS_FLAG_OUT_MAVLINK1;
+
+	} else {
+		status->flags &= ~MAVLINK_STATUS_FLAG_OUT_MAVLINK1;
+	}
+
+	if (index & 1) {
+		mavlink_highres_imu_t imu = {};
+		imu.time_usec = index;
+		imu.xacc = 9.81f;
+		memcpy(_MAV_PAYLOAD_NON_CONST(&msg), &imu, sizeof(imu));
+		msg.msgid = MAVLINK_MSG_ID_HIGHRES_IMU;
+		mavlink_finalize_message_buffer(&msg, 1, 1, status, MAVLINK_MSG_ID_HIGHRES_IMU_MIN_LEN,
+						MAVLINK_MSG_ID_HIGHRES_IMU_LEN, MAVLINK_MSG_ID_HIGHRES_IMU_CRC);
+
+	} else {
+		mavlink_attitude_t att = {};
+		att.time_boot_ms = index;
+		att.roll = 0.1f;
+		memcpy(_MAV_PAYLOAD_NON_CONST(&msg), &att, sizeof(att));
+		msg.msgid = MAVLINK_MSG_ID_ATTITUDE;
+		mavlink_finalize_message_buffer(&msg, 1, 1, status, MAVLINK_MSG_ID_ATTITUDE_MIN_LEN,
+						MAVLINK_MSG_ID_ATTITUDE_LEN, MAVLINK_MSG_ID_ATTITUDE_CRC);
+	}
+
+	return mavlink_msg_to_send_buffer(buf, &msg);
+}
+
+/**
+ * @return index of the frame the message was built from, -1 if it is not one of them
+ */
+int64_t frame_index(const mavlink_message_t *msg)
+{
+	if (msg->msgid == MAVLINK_MSG_ID_HIGHRES_IMU) {
+		mavlink_highres_imu_t imu;
+		mavlink_msg_highres_imu_decode(msg, &imu);
+		return (imu.xacc == 9.81f) ? (int64_t)imu.time_usec : -1;
+
+	} else if (msg->msgid == MAVLINK_MSG_ID_ATTITUDE) {
+		mavlink_attitude_t att;
+		mavlink_msg_attitude_decode(msg, &att);
+		return (att.roll == 0.1f) ? (int64_t)att.time_boot_ms : -1;
+	}
+
+	return -1;
+}
+
+struct bench_result {
+	unsigned received;	///< frames which arrived in order and intact
+	unsigned syscalls;
+	hrt_abstime elapsed;
+};
+
+/**
+ * Run one method.
+ *
+ * @param batched use sendmmsg()/recvmmsg() and MavlinkFrameParser, else
+ * sendto()/poll()/recvfrom() and the per byte state machine
+ */
+bool run(bool batched, bench_result *result)
+{
+	bench_socket tx;
+	bench_socket rx;
+
+	if (!open_socket(&tx)) {
+		return false;
+	}
+
+	if (!open_socket(&rx)) {
+		close(tx.fd);
+		return false;
+	}
+
+	static uint8_t tx_buf[batch][MAVLINK_MAX_PACKET_LEN];
+	static uint8_t rx_buf[batch][MAVLINK_MAX_PACKET_LEN];
+	unsigned tx_len[batch];
+	struct iovec tx_iov[batch];
+	struct iovec rx_iov[batch];
+	struct mmsghdr tx_msgs[batch];
+	struct mmsghdr rx_msgs[batch];
+
+	mavlink_status_t tx_status = {};
+	mavlink_message_t rxmsg = {};
+	mavlink_status_t rxstatus = {};
+	mavlink_status_t status;
+	mavlink_message_t msg;
+	MavlinkFrameParser *parser = new MavlinkFrameParser();
+
+	if (parser == nullptr) {
+		close(tx.fd);
+		close(rx.fd);
+		return false;
+	}
+
+	memset(result, 0, sizeof(*result));
+	memset(tx_msgs, 0, sizeof(tx_msgs));
+	memset(rx_msgs, 0, sizeof(rx_msgs));
+
+	for (unsigned i = 0; i < batch; i++) {
+		tx_iov[i].iov_base = tx_buf[i];
+		tx_msgs[i].msg_hdr.msg_name = &rx.addr;
+		tx_msgs[i].msg_hdr.msg_namelen = sizeof(rx.addr);
+		tx_msgs[i].msg_hdr.msg_iov = &tx_iov[i];
+		tx_msgs[i].msg_hdr.msg_iovlen = 1;
+
+		rx_iov[i].iov_base = rx_buf[i];
+		rx_iov[i].iov_len = sizeof(rx_buf[i]);
+		rx_msgs[i].msg_hdr.msg_iov = &rx_iov[i];
+		rx_msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	unsigned next = 0;
+	bool ok = true;
+	hrt_abstime start = hrt_absolute_time();
+
+	for (unsigned sent = 0; ok && sent < frame_count; sent += batch) {
+		for (unsigned i = 0; i < batch; i++) {
+			tx_len[i] = build_frame(tx_buf[i], &tx_status, sent + i);
+			tx_iov[i].iov_len = tx_len[i];
+		}
+
+		if (batched) {
+			if (sendmmsg(tx.fd, tx_msgs, batch, 0) != (int)batch) {
+				ok = false;
+			}
+
+			result->syscalls++;
+
+		} else {
+			for (unsigned i = 0; i < batch; i++) {
+				if (sendto(tx.fd, tx_buf[i], tx_len[i], 0, (struct sockaddr *)&rx.addr, sizeof(rx.addr)) != (ssize_t)tx_len[i]) {
+					ok = false;
+				}
+
+				result->syscalls++;
+			}
+		}
+
+		/* receive until the whole batch is there, it is only lost if the wait times out */
+		unsigned received = 0;
+
+		while (ok && received < batch) {
+			struct pollfd fds = { rx.fd, POLLIN, 0 };
+
+			result->syscalls++;
+
+			if (poll(&fds, 1, 100) <= 0) {
+				ok = false;
+				break;
+			}
+
+			if (batched) {
+				int ret = recvmmsg(rx.fd, rx_msgs, batch, MSG_DONTWAIT, nullptr);
+				result->syscalls++;
+
+				for (int d = 0; d < ret; d++) {
+					parser->set_buffer(rx_buf[d], rx_msgs[d].msg_len);
+
+					while (parser->next(&msg)) {
+						ok = ok && frame_index(&msg) == (int64_t)next++;
+						received++;
+					}
+				}
+
+			} else {
+				ssize_t ret = recvfrom(rx.fd, rx_buf[0], sizeof(rx_buf[0]), 0, nullptr, nullptr);
+				result->syscalls++;
+
+				for (ssize_t i = 0; i < ret; i++) {
+					if (mavlink_frame_char_buffer(&rxmsg, &rxstatus, rx_buf[0][i], &msg, &status) == MAVLINK_FRAMING_OK) {
+						ok = ok && frame_index(&msg) == (int64_t)next++;
+						received++;
+					}
+				}
+			}
+		}
+
+		if (ok) {
+			result->received += received;
+		}
+	}
+
+	result->elapsed = hrt_elapsed_time(&start);
+
+	delete parser;
+	close(tx.fd);
+	close(rx.fd);
+
+	return ok && result->received == frame_count;
+}
+
+} // anonymous namespace
+
+bool mavlink_udp_bench(void)
+{
+	static const char *const names[2] = { "per datagram", "batched" };
+	bool passed = true;
+
+	for (int batched = 0; batched < 2; batched++) {
+		bench_result result;
+		bool ok = run(batched, &result);
+
+		PX4_INFO("%-12s: %u/%u frames, %.0f frames/s, %.2f system calls/frame%s",
+			 names[batched], result.received, frame_count,
+			 result.received / (result.elapsed / 1e6), (double)result.syscalls / frame_count,
+			 ok ? "" : " FAILED");
+
+		passed = passed && ok;
+	}
+
+	return passed;
+}
+
+#else
+
+bool mavlink_udp_bench(void)
+{
+	PX4_WARN("sendmmsg() and recvmmsg() are Linux only");
+	return true;
+}
+
+#endif
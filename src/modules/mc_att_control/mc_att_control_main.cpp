@@ -328,8 +328,8 @@ MulticopterAttitudeControl::MulticopterAttitudeControl() :
 	_actuators_0_circuit_breaker_enabled(false),
 
 	/* performance counters */
-	_loop_perf(perf_alloc(PC_ELAPSED, "mc_att_control")),
-	_controller_latency_perf(perf_alloc_once(PC_ELAPSED, "ctrl_latency")),
+	_loop_perf(perf_alloc(PC_HISTOGRAM, "mc_att_control")),
+	_controller_latency_perf(perf_alloc_once(PC_HISTOGRAM, "ctrl_latency")),
 	_ts_opt_recovery(nullptr)
 
 {
@@ -908,6 +908,7 @@ MulticopterAttitudeControl::task_main()
 				_v_rates_sp.yaw = _rates_sp(2);
 				_v_rates_sp.thrust = _thrust_sp;
 				_v_rates_sp.timestamp = hrt_absolute_time();
+				_v_rates_sp.timestamp_sample = _ctrl_state.timestamp_sample;
 
 				if (_v_rates_sp_pub != nullptr) {
 					orb_publish(_rates_sp_id, _v_rates_sp_pub, &_v_rates_sp);
@@ -932,6 +933,7 @@ MulticopterAttitudeControl::task_main()
 					_v_rates_sp.yaw = _rates_sp(2);
 					_v_rates_sp.thrust = _thrust_sp;
 					_v_rates_sp.timestamp = hrt_absolute_time();
+					_v_rates_sp.timestamp_sample = _ctrl_state.timestamp_sample;
 
 					if (_v_rates_sp_pub != nullptr) {
 						orb_publish(_rates_sp_id, _v_rates_sp_pub, &_v_rates_sp);
@@ -959,7 +961,7 @@ MulticopterAttitudeControl::task_main()
 				_actuators.control[2] = (PX4_ISFINITE(_att_control(2))) ? _att_control(2) : 0.0f;
 				_actuators.control[3] = (PX4_ISFINITE(_thrust_sp)) ? _thrust_sp : 0.0f;
 				_actuators.timestamp = hrt_absolute_time();
-				_actuators.timestamp_sample = _ctrl_state.timestamp;
+				_actuators.timestamp_sample = _ctrl_state.timestamp_sample;
 
 				_controller_status.roll_rate_integ = _rates_int(0);
 				_controller_status.pitch_rate_integ = _rates_int(1);
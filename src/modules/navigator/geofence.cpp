@@ -62,6 +62,16 @@
 #endif
 static const int ERROR = -1;
 
+/**
+ * Layout of a stored fence vertex before polygon_vertex_count and polygon_type were added.
+ * Such fences are still read, as a single inclusion polygon.
+ */
+struct fence_vertex_legacy_s {
+	uint64_t timestamp;
+	float lat;
+	float lon;
+};
+
 
 Geofence::Geofence(Navigator *navigator) :
 	SuperBlock(NULL, "GF"),
@@ -74,6 +84,11 @@ Geofence::Geofence(Navigator *navigator) :
 	_altitude_min(0),
 	_altitude_max(0),
 	_vertices_count(0),
+	_polygons_count(0),
+	_polygons_valid(true),
+	_has_inclusion_polygon(false),
+	_polygons_stale(true),
+	_projection_reference{},
 	_param_action(this, "ACTION"),
 	_param_altitude_mode(this, "ALTMODE"),
 	_param_source(this, "SOURCE"),
@@ -91,6 +106,111 @@ Geofence::~Geofence()
 
 }
 
+constexpr unsigned Geofence::MAX_POLYGONS;
+
+void Geofence::updatePolygons()
+{
+	/* acquire pairs with the release of the writers, so the vertex count and the points are theirs */
+	if (!__atomic_exchange_n(&_polygons_stale, false, __ATOMIC_ACQUIRE)) {
+		return;
+	}
+
+	_polygons_count = 0;
+
+	for (unsigned i = 0; i < MAX_POLYGONS; i++) {
+		_polygons[i].release();
+	}
+	_has_inclusion_polygon = false;
+	_polygons_valid = false;
+
+	if (isEmpty()) {
+		_polygons_valid = true;
+		return;
+	}
+
+	if (_vertices_count > fence_s::GEOFENCE_MAX_VERTICES) {
+		return;
+	}
+
+	/* the navigator stack is small, keep only what is needed to build the polygons */
+	float lat[fence_s::GEOFENCE_MAX_VERTICES];
+	float lon[fence_s::GEOFENCE_MAX_VERTICES];
+	uint16_t polygon_vertex_count[fence_s::GEOFENCE_MAX_VERTICES];
+	uint8_t polygon_type[fence_s::GEOFENCE_MAX_VERTICES];
+	double lat_sum = 0.0;
+	double lon_sum = 0.0;
+
+	bool legacy = false;
+
+	for (unsigned i = 0; i < _vertices_count; i++) {
+		struct fence_vertex_s vertex;
+		ssize_t len = dm_read(DM_KEY_FENCE_POINTS, i, &vertex, sizeof(struct fence_vertex_s));
+
+		if (len == sizeof(struct fence_vertex_legacy_s)) {
+			/* stored by an older firmware, lat and lon are at the same place */
+			struct fence_vertex_legacy_s legacy_vertex;
+			memcpy(&legacy_vertex, &vertex, sizeof(legacy_vertex));
+			vertex.lat = legacy_vertex.lat;
+			vertex.lon = legacy_vertex.lon;
+			vertex.polygon_vertex_count = 0;
+			vertex.polygon_type = fence_vertex_s::FENCE_TYPE_INCLUSION;
+			legacy = true;
+
+		} else if (len != sizeof(struct fence_vertex_s)) {
+			mavlink_and_console_log_critical(_navigator->get_mavlink_log_pub(),
+							 "Geofence: vertex %u unreadable, fence ignored", i);
+			return;
+		}
+
+		lat[i] = vertex.lat;
+		lon[i] = vertex.lon;
+		polygon_vertex_count[i] = vertex.polygon_vertex_count;
+		polygon_type[i] = vertex.polygon_type;
+		lat_sum += vertex.lat;
+		lon_sum += vertex.lon;
+	}
+
+	if (legacy) {
+		/* mixing old and new vertices would misread polygon_vertex_count, use them as one polygon */
+		polygon_vertex_count[0] = 0;
+		mavlink_and_console_log_info(_navigator->get_mavlink_log_pub(),
+					     "Geofence: old format, using it as one inclusion polygon");
+	}
+
+	/* all polygons share one projection around the center of the fence */
+	map_projection_init(&_projection_reference, lat_sum / _vertices_count, lon_sum / _vertices_count);
+
+	/* A fence without polygon information (vertices added one by one) is a single inclusion polygon
+	 * which needs to be closed explicitly */
+	if (polygon_vertex_count[0] == 0) {
+		polygon_vertex_count[0] = _vertices_count;
+		polygon_type[0] = fence_vertex_s::FENCE_TYPE_INCLUSION;
+
+		if (_vertices_count < 4) {
+			return;
+		}
+	}
+
+	for (unsigned start = 0; start < _vertices_count;) {
+		unsigned count = polygon_vertex_count[start];
+
+		bool exclusion = polygon_type[start] == fence_vertex_s::FENCE_TYPE_EXCLUSION;
+
+		if (count == 0 || start + count > _vertices_count || _polygons_count >= MAX_POLYGONS ||
+		    !_polygons[_polygons_count].init(_projection_reference, &lat[start], &lon[start], count, exclusion)) {
+			mavlink_and_console_log_critical(_navigator->get_mavlink_log_pub(),
+							 "Geofence: invalid polygon at vertex %u, fence ignored", start);
+			return;
+		}
+
+		_has_inclusion_polygon = _has_inclusion_polygon || !exclusion;
+		_polygons_count++;
+		start += count;
+	}
+
+	_polygons_valid = true;
+}
+
 
 bool Geofence::inside(const struct vehicle_global_position_s &global_position)
 {
@@ -190,54 +310,36 @@ bool Geofence::inside(double lat, double lon, float altitude)
 
 bool Geofence::inside_polygon(double lat, double lon, float altitude)
 {
-	if (valid()) {
-
-		if (!isEmpty()) {
-			/* Vertical check */
-			if (altitude > _altitude_max || altitude < _altitude_min) {
-				return false;
-			}
-
-			/*Horizontal check */
-			/* Adaptation of algorithm originally presented as
-			 * PNPOLY - Point Inclusion in Polygon Test
-			 * W. Randolph Franklin (WRF) */
+	updatePolygons();
 
-			bool c = false;
-
-			struct fence_vertex_s temp_vertex_i;
-			struct fence_vertex_s temp_vertex_j;
+	if (!_polygons_valid || isEmpty()) {
+		/* Invalid or empty fence --> accept all points */
+		return true;
+	}
 
-			/* Red until fence is finished */
-			for (unsigned i = 0, j = _vertices_count - 1; i < _vertices_count; j = i++) {
-				if (dm_read(DM_KEY_FENCE_POINTS, i, &temp_vertex_i, sizeof(struct fence_vertex_s)) != sizeof(struct fence_vertex_s)) {
-					break;
-				}
+	/* Vertical check */
+	if (altitude > _altitude_max || altitude < _altitude_min) {
+		return false;
+	}
 
-				if (dm_read(DM_KEY_FENCE_POINTS, j, &temp_vertex_j, sizeof(struct fence_vertex_s)) != sizeof(struct fence_vertex_s)) {
-					break;
-				}
+	/* Horizontal check */
+	float x, y;
+	map_projection_project(&_projection_reference, lat, lon, &x, &y);
 
-				// skip vertex 0 (return point)
-				if (((double)temp_vertex_i.lon >= lon) != ((double)temp_vertex_j.lon >= lon) &&
-				    (lat <= (double)(temp_vertex_j.lat - temp_vertex_i.lat) * (lon - (double)temp_vertex_i.lon) /
-				     (double)(temp_vertex_j.lon - temp_vertex_i.lon) + (double)temp_vertex_i.lat)) {
-					c = !c;
-				}
+	bool inside_inclusion = !_has_inclusion_polygon;
 
+	for (unsigned i = 0; i < _polygons_count; i++) {
+		if (_polygons[i].isExclusion()) {
+			if (_polygons[i].inside(x, y)) {
+				return false;
 			}
 
-			return c;
-
-		} else {
-			/* Empty fence --> accept all points */
-			return true;
+		} else if (!inside_inclusion) {
+			inside_inclusion = _polygons[i].inside(x, y);
 		}
-
-	} else {
-		/* Invalid fence --> accept all points */
-		return true;
 	}
+
+	return inside_inclusion;
 }
 
 bool
@@ -249,12 +351,21 @@ Geofence::valid()
 	}
 
 	// Otherwise
-	if ((_vertices_count < 4) || (_vertices_count > fence_s::GEOFENCE_MAX_VERTICES)) {
-		warnx("Fence must have at least 3 sides and not more than %d", fence_s::GEOFENCE_MAX_VERTICES - 1);
+	if (_vertices_count > fence_s::GEOFENCE_MAX_VERTICES) {
+		warnx("Fence must not have more than %d vertices", fence_s::GEOFENCE_MAX_VERTICES);
 		return false;
 	}
 
-	return true;
+	// The polygons are only rebuilt in the navigator thread, until then check the vertex count
+	if (__atomic_load_n(&_polygons_stale, __ATOMIC_ACQUIRE)) {
+		return _vertices_count >= 3;
+	}
+
+	if (!_polygons_valid) {
+		warnx("Fence polygons must have at least 3 sides");
+	}
+
+	return _polygons_valid;
 }
 
 void
@@ -267,6 +378,8 @@ Geofence::addPoint(int argc, char *argv[])
 
 	if ((argc == 1) && (strcmp("-clear", argv[0]) == 0)) {
 		dm_clear(DM_KEY_FENCE_POINTS);
+		_vertices_count = 0;
+		__atomic_store_n(&_polygons_stale, true, __ATOMIC_RELEASE);
 		publishFence(0);
 		return;
 	}
@@ -292,9 +405,13 @@ Geofence::addPoint(int argc, char *argv[])
 
 	vertex.lat = (float)lat;
 	vertex.lon = (float)lon;
+	vertex.polygon_vertex_count = 0;
+	vertex.polygon_type = fence_vertex_s::FENCE_TYPE_INCLUSION;
 
 	if (dm_write(DM_KEY_FENCE_POINTS, ix, DM_PERSIST_POWER_ON_RESET, &vertex, sizeof(vertex)) == sizeof(vertex)) {
 		if (last) {
+			_vertices_count = ix + 1;
+			__atomic_store_n(&_polygons_stale, true, __ATOMIC_RELEASE);
 			publishFence((unsigned)ix + 1);
 		}
 
@@ -321,6 +438,8 @@ Geofence::loadFromFile(const char *filename)
 	FILE		*fp;
 	char		line[120];
 	int			pointCounter = 0;
+	int			polygonStart = 0;
+	uint8_t		polygonType = fence_vertex_s::FENCE_TYPE_INCLUSION;
 	bool		gotVertical = false;
 	const char commentChar = '#';
 	int rc = ERROR;
@@ -357,9 +476,24 @@ Geofence::loadFromFile(const char *filename)
 			continue;
 		}
 
+		/* INCLUSION or EXCLUSION starts a new polygon of that type, the first polygon is an inclusion polygon */
+		bool inclusion = strncmp(&line[textStart], "INCLUSION", 9) == 0;
+
+		if (gotVertical && (inclusion || strncmp(&line[textStart], "EXCLUSION", 9) == 0)) {
+			if (!closePolygon(polygonStart, pointCounter)) {
+				goto error;
+			}
+
+			polygonStart = pointCounter;
+			polygonType = inclusion ? fence_vertex_s::FENCE_TYPE_INCLUSION : fence_vertex_s::FENCE_TYPE_EXCLUSION;
+			continue;
+		}
+
 		if (gotVertical) {
 			/* Parse the line as a geofence point */
 			struct fence_vertex_s vertex;
+			vertex.polygon_vertex_count = 0;
+			vertex.polygon_type = polygonType;
 
 			/* if the line starts with DMS, this means that the coordinate is given as degree minute second instead of decimal degrees */
 			if (line[textStart] == 'D' && line[textStart + 1] == 'M' && line[textStart + 2] == 'S') {
@@ -404,8 +538,12 @@ Geofence::loadFromFile(const char *filename)
 	}
 
 	/* Check if import was successful */
-	if (gotVertical && pointCounter > 0) {
+	if (gotVertical && pointCounter > 0 && closePolygon(polygonStart, pointCounter)) {
+		/* all polygons are closed, have the whole fence on physical media before using it */
+		dm_flush();
+
 		_vertices_count = pointCounter;
+		__atomic_store_n(&_polygons_stale, true, __ATOMIC_RELEASE);
 		warnx("Geofence: imported successfully");
 		mavlink_log_info(_navigator->get_mavlink_log_pub(), "Geofence imported");
 		rc = OK;
@@ -420,8 +558,27 @@ error:
 	return rc;
 }
 
+bool Geofence::closePolygon(int start, int end)
+{
+	struct fence_vertex_s vertex;
+
+	if (end == start) {
+		return true;
+	}
+
+	if (dm_read(DM_KEY_FENCE_POINTS, start, &vertex, sizeof(vertex)) != sizeof(vertex)) {
+		return false;
+	}
+
+	vertex.polygon_vertex_count = end - start;
+
+	return dm_write(DM_KEY_FENCE_POINTS, start, DM_PERSIST_POWER_ON_RESET, &vertex, sizeof(vertex)) == sizeof(vertex);
+}
+
 int Geofence::clearDm()
 {
 	dm_clear(DM_KEY_FENCE_POINTS);
+	_vertices_count = 0;
+	__atomic_store_n(&_polygons_stale, true, __ATOMIC_RELEASE);
 	return OK;
 }
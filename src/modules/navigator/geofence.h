@@ -51,6 +51,8 @@
 #include <drivers/drv_hrt.h>
 #include <px4_defines.h>
 
+#include "geofence_polygon.h"
+
 #define GEOFENCE_FILENAME PX4_ROOTFSDIR"/fs/microsd/etc/geofence.txt"
 
 class Navigator;
@@ -88,6 +90,10 @@ public:
 		    const struct vehicle_gps_position_s &gps_position, float baro_altitude_amsl,
 		    const struct home_position_s home_pos, bool home_position_set);
 
+	/**
+	 * Return whether a position is inside the fence: inside one of the inclusion polygons (if there
+	 * are any) and outside of all exclusion polygons.
+	 */
 	bool inside_polygon(double lat, double lon, float altitude);
 
 	int clearDm();
@@ -127,6 +133,15 @@ private:
 
 	unsigned _vertices_count;
 
+	/* The fence polygons are built from the data manager in the navigator thread when it changes */
+	static constexpr unsigned MAX_POLYGONS = fence_s::GEOFENCE_MAX_VERTICES / 3;
+	GeofencePolygon _polygons[MAX_POLYGONS];
+	unsigned _polygons_count;
+	bool _polygons_valid;
+	bool _has_inclusion_polygon;
+	bool _polygons_stale;				/**< set when the fence changes, accessed with __atomic builtins */
+	struct map_projection_reference_s _projection_reference;
+
 	/* Params */
 	control::BlockParamInt _param_action;
 	control::BlockParamInt _param_altitude_mode;
@@ -140,6 +155,16 @@ private:
 	bool inside(double lat, double lon, float altitude);
 	bool inside(const struct vehicle_global_position_s &global_position);
 	bool inside(const struct vehicle_global_position_s &global_position, float baro_altitude_amsl);
+
+	/**
+	 * Rebuild the polygons from the data manager if the fence changed.
+	 */
+	void updatePolygons();
+
+	/**
+	 * Write the vertex count of the polygon started at index start to the data manager.
+	 */
+	bool closePolygon(int start, int end);
 };
 
 
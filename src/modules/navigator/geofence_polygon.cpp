@@ -0,0 +1,421 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+/**
+ * @file geofence_polygon.cpp
+ * Geofence polygon projected to a local plane.
+ */
+
+#include "geofence_polygon.h"
+
+#include <drivers/drv_hrt.h>
+#include <px4_log.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+constexpr unsigned GeofencePolygon::MAX_CELLS_PER_AXIS;
+constexpr unsigned GeofencePolygon::MAX_EDGE_REFS_PER_EDGE;
+
+void
+GeofencePolygon::release()
+{
+	delete[] _x;
+	delete[] _y;
+	delete[] _cell_start;
+	delete[] _cell_edges;
+	delete[] _center_inside;
+	_x = nullptr;
+	_y = nullptr;
+	_cell_start = nullptr;
+	_cell_edges = nullptr;
+	_center_inside = nullptr;
+	_count = 0;
+	_cells = 0;
+}
+
+bool
+GeofencePolygon::init(const struct map_projection_reference_s &ref, const float *lat, const float *lon,
+		      unsigned count, bool exclusion)
+{
+	release();
+
+	/* drop an explicit closing vertex */
+	if (count > 3 && lat[count - 1] == lat[0] && lon[count - 1] == lon[0]) {
+		count--;
+	}
+
+	if (count < 3 || count >= UINT16_MAX) {
+		return false;
+	}
+
+	_x = new float[count];
+	_y = new float[count];
+
+	if (_x == nullptr || _y == nullptr) {
+		release();
+		return false;
+	}
+
+	_count = count;
+	_exclusion = exclusion;
+	_min_x = _min_y = FLT_MAX;
+	_max_x = _max_y = -FLT_MAX;
+
+	for (unsigned i = 0; i < count; i++) {
+		map_projection_project(&ref, lat[i], lon[i], &_x[i], &_y[i]);
+
+		_min_x = (_x[i] < _min_x) ? _x[i] : _min_x;
+		_max_x = (_x[i] > _max_x) ? _x[i] : _max_x;
+		_min_y = (_y[i] < _min_y) ? _y[i] : _min_y;
+		_max_y = (_y[i] > _max_y) ? _y[i] : _max_y;
+	}
+
+	if (!buildIndex()) {
+		release();
+		return false;
+	}
+
+	return true;
+}
+
+unsigned
+GeofencePolygon::cell(float v, float min, float scale) const
+{
+	int c = (int)((v - min) * scale);
+
+	if (c < 0) {
+		return 0;
+	}
+
+	return ((unsigned)c < _cells) ? (unsigned)c : _cells - 1;
+}
+
+void
+GeofencePolygon::cellCenter(unsigned cx, unsigned cy, float &x, float &y) const
+{
+	x = (_scale_x > 0.f) ? _min_x + (cx + 0.5f) / _scale_x : _min_x;
+	y = (_scale_y > 0.f) ? _min_y + (cy + 0.5f) / _scale_y : _min_y;
+}
+
+bool
+GeofencePolygon::insideLinear(float x, float y) const
+{
+	/* Adaptation of algorithm originally presented as
+	 * PNPOLY - Point Inclusion in Polygon Test
+	 * W. Randolph Franklin (WRF) */
+	bool c = false;
+
+	for (unsigned i = 0, j = _count - 1; i < _count; j = i++) {
+		if ((_x[i] >= x) != (_x[j] >= x) &&
+		    (y <= (_y[j] - _y[i]) * (x - _x[i]) / (_x[j] - _x[i]) + _y[i])) {
+			c = !c;
+		}
+	}
+
+	return c;
+}
+
+unsigned
+GeofencePolygon::countCellRefs(bool fill)
+{
+	unsigned refs = 0;
+
+	/* an edge is listed in every cell its bounding box overlaps */
+	for (unsigned i = 0; i < _count; i++) {
+		unsigned j = (i + 1 < _count) ? i + 1 : 0;
+		unsigned x0 = cell(_x[i], _min_x, _scale_x);
+		unsigned x1 = cell(_x[j], _min_x, _scale_x);
+		unsigned y0 = cell(_y[i], _min_y, _scale_y);
+		unsigned y1 = cell(_y[j], _min_y, _scale_y);
+
+		for (unsigned cx = (x0 < x1 ? x0 : x1); cx <= (x0 < x1 ? x1 : x0); cx++) {
+			for (unsigned cy = (y0 < y1 ? y0 : y1); cy <= (y0 < y1 ? y1 : y0); cy++) {
+				if (fill) {
+					/* _cell_start is used as insertion cursor and restored afterwards */
+					_cell_edges[_cell_start[cx * _cells + cy]++] = i;
+				}
+
+				refs++;
+			}
+		}
+	}
+
+	return refs;
+}
+
+bool
+GeofencePolygon::buildIndex()
+{
+	/* about one edge per cell */
+	unsigned cells = 1;
+
+	while (cells * cells < _count && cells < MAX_CELLS_PER_AXIS) {
+		cells *= 2;
+	}
+
+	/* use a coarser grid if the polygon has many long edges */
+	unsigned refs;
+
+	for (;;) {
+		_cells = cells;
+		_scale_x = (_max_x > _min_x) ? cells / (_max_x - _min_x) : 0.f;
+		_scale_y = (_max_y > _min_y) ? cells / (_max_y - _min_y) : 0.f;
+		refs = countCellRefs(false);
+
+		if ((refs <= _count * MAX_EDGE_REFS_PER_EDGE && refs < UINT16_MAX) || cells == 1) {
+			break;
+		}
+
+		cells /= 2;
+	}
+
+	if (refs >= UINT16_MAX) {
+		return false;
+	}
+
+	unsigned num_cells = _cells * _cells;
+	_cell_start = new uint16_t[num_cells + 1];
+	_cell_edges = new uint16_t[refs];
+	_center_inside = new uint8_t[(num_cells + 7) / 8];
+
+	if (_cell_start == nullptr || _cell_edges == nullptr || _center_inside == nullptr) {
+		return false;
+	}
+
+	/* counting sort of the edge references by cell */
+	memset(_cell_start, 0, (num_cells + 1) * sizeof(uint16_t));
+
+	for (unsigned i = 0; i < _count; i++) {
+		unsigned j = (i + 1 < _count) ? i + 1 : 0;
+		unsigned x0 = cell(_x[i], _min_x, _scale_x);
+		unsigned x1 = cell(_x[j], _min_x, _scale_x);
+		unsigned y0 = cell(_y[i], _min_y, _scale_y);
+		unsigned y1 = cell(_y[j], _min_y, _scale_y);
+
+		for (unsigned cx = (x0 < x1 ? x0 : x1); cx <= (x0 < x1 ? x1 : x0); cx++) {
+			for (unsigned cy = (y0 < y1 ? y0 : y1); cy <= (y0 < y1 ? y1 : y0); cy++) {
+				_cell_start[cx * _cells + cy + 1]++;
+			}
+		}
+	}
+
+	for (unsigned c = 0; c < num_cells; c++) {
+		_cell_start[c + 1] += _cell_start[c];
+	}
+
+	countCellRefs(true);
+
+	for (unsigned c = num_cells; c > 0; c--) {
+		_cell_start[c] = _cell_start[c - 1];
+	}
+
+	_cell_start[0] = 0;
+
+	memset(_center_inside, 0, (num_cells + 7) / 8);
+
+	for (unsigned cx = 0; cx < _cells; cx++) {
+		for (unsigned cy = 0; cy < _cells; cy++) {
+			float x, y;
+			cellCenter(cx, cy, x, y);
+
+			if (insideLinear(x, y)) {
+				unsigned c = cx * _cells + cy;
+				_center_inside[c >> 3] |= (1 << (c & 7));
+			}
+		}
+	}
+
+	return true;
+}
+
+bool
+GeofencePolygon::inside(float x, float y) const
+{
+	if (_count == 0 || x < _min_x || x > _max_x || y < _min_y || y > _max_y) {
+		return false;
+	}
+
+	unsigned cx = cell(x, _min_x, _scale_x);
+	unsigned cy = cell(y, _min_y, _scale_y);
+	unsigned c = cx * _cells + cy;
+	bool inside = _center_inside[c >> 3] & (1 << (c & 7));
+
+	float center_x, center_y;
+	cellCenter(cx, cy, center_x, center_y);
+
+	/* every edge crossing the segment from the cell center to the point toggles the result */
+	for (unsigned k = _cell_start[c]; k < _cell_start[c + 1]; k++) {
+		unsigned i = _cell_edges[k];
+		unsigned j = (i + 1 < _count) ? i + 1 : 0;
+
+		float edge_x = _x[j] - _x[i];
+		float edge_y = _y[j] - _y[i];
+		bool center_side = edge_x * (center_y - _y[i]) - edge_y * (center_x - _x[i]) > 0.f;
+		bool point_side = edge_x * (y - _y[i]) - edge_y * (x - _x[i]) > 0.f;
+
+		if (center_side == point_side) {
+			continue;
+		}
+
+		float segment_x = x - center_x;
+		float segment_y = y - center_y;
+		bool start_side = segment_x * (_y[i] - center_y) - segment_y * (_x[i] - center_x) > 0.f;
+		bool end_side = segment_x * (_y[j] - center_y) - segment_y * (_x[j] - center_x) > 0.f;
+
+		if (start_side != end_side) {
+			inside = !inside;
+		}
+	}
+
+	return inside;
+}
+
+void
+geofence_polygon_bench()
+{
+	static const unsigned sizes[] = {4, 64, 1024};
+	static const unsigned points = 1000;
+	static const unsigned rounds = 10;
+	struct map_projection_reference_s ref;
+	map_projection_init(&ref, 47.397742, 8.545594);
+
+	/* the same pseudo random points inside the bounding circle for both variants, generated up front
+	 * so that neither timed loop includes the generation */
+	float *px = new float[points];
+	float *py = new float[points];
+	bool *expected = new bool[points];
+
+	if (px == nullptr || py == nullptr || expected == nullptr) {
+		PX4_ERR("alloc failed");
+		delete[] px;
+		delete[] py;
+		delete[] expected;
+		return;
+	}
+
+	uint32_t seed = 1;
+
+	for (unsigned k = 0; k < points; k++) {
+		seed = seed * 1664525u + 1013904223u;
+		px[k] = (float)(seed >> 16) / 65536.f * 2200.f - 1100.f;
+		py[k] = (float)(seed & 0xffff) / 65536.f * 2200.f - 1100.f;
+	}
+
+	for (unsigned size : sizes) {
+		float *lat = new float[size];
+		float *lon = new float[size];
+		float *x = new float[size];
+		float *y = new float[size];
+
+		if (lat == nullptr || lon == nullptr || x == nullptr || y == nullptr) {
+			PX4_ERR("alloc failed");
+			delete[] lat;
+			delete[] lon;
+			delete[] x;
+			delete[] y;
+			break;
+		}
+
+		/* star shaped polygon with a radius alternating between 1000 m and 600 m */
+		for (unsigned i = 0; i < size; i++) {
+			float angle = 2.f * M_PI_F * i / size;
+			float radius = (size > 4 && (i & 1)) ? 600.f : 1000.f;
+			double vertex_lat, vertex_lon;
+			map_projection_reproject(&ref, radius * cosf(angle), radius * sinf(angle), &vertex_lat, &vertex_lon);
+			lat[i] = vertex_lat;
+			lon[i] = vertex_lon;
+			map_projection_project(&ref, lat[i], lon[i], &x[i], &y[i]);
+		}
+
+		GeofencePolygon polygon;
+		hrt_abstime start = hrt_absolute_time();
+
+		if (!polygon.init(ref, lat, lon, size, false)) {
+			PX4_ERR("polygon init failed");
+		}
+
+		hrt_abstime init = hrt_elapsed_time(&start);
+
+		/* plain PNPOLY over all projected vertices as reference, timed as a whole like the indexed test */
+		unsigned inside = 0;
+		start = hrt_absolute_time();
+
+		for (unsigned r = 0; r < rounds; r++) {
+			for (unsigned k = 0; k < points; k++) {
+				bool c = false;
+
+				for (unsigned i = 0, j = size - 1; i < size; j = i++) {
+					if ((x[i] >= px[k]) != (x[j] >= px[k]) &&
+					    (py[k] <= (y[j] - y[i]) * (px[k] - x[i]) / (x[j] - x[i]) + y[i])) {
+						c = !c;
+					}
+				}
+
+				expected[k] = c;
+			}
+		}
+
+		hrt_abstime linear = hrt_elapsed_time(&start);
+
+		start = hrt_absolute_time();
+
+		for (unsigned r = 0; r < rounds; r++) {
+			inside = 0;
+
+			for (unsigned k = 0; k < points; k++) {
+				inside += polygon.inside(px[k], py[k]);
+			}
+		}
+
+		hrt_abstime indexed = hrt_elapsed_time(&start);
+
+		unsigned mismatches = 0;
+
+		for (unsigned k = 0; k < points; k++) {
+			mismatches += (expected[k] != polygon.inside(px[k], py[k]));
+		}
+
+		PX4_INFO("%4u vertices: init %llu us, %.3f us/check (%.3f us/check linear), %u/%u inside, %u mismatches",
+			 size, (unsigned long long)init, (double)indexed / (points * rounds), (double)linear / (points * rounds),
+			 inside, points, mismatches);
+
+		delete[] lat;
+		delete[] lon;
+		delete[] x;
+		delete[] y;
+	}
+
+	delete[] px;
+	delete[] py;
+	delete[] expected;
+}
@@ -0,0 +1,111 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+/**
+ * @file geofence_polygon.h
+ * Geofence polygon projected to a local plane, with a grid index over its edges
+ * for containment tests that do not depend on the number of vertices.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <geo/geo.h>
+
+class GeofencePolygon
+{
+public:
+	GeofencePolygon() = default;
+	~GeofencePolygon() { release(); }
+
+	GeofencePolygon(const GeofencePolygon &) = delete;
+	GeofencePolygon &operator=(const GeofencePolygon &) = delete;
+
+	/**
+	 * Project the polygon into the plane of ref and build the edge index.
+	 * The polygon is implicitly closed, a last vertex equal to the first one is allowed.
+	 * @param lat latitude of the vertices in degrees
+	 * @param lon longitude of the vertices in degrees
+	 * @param count number of vertices, at least 3
+	 * @return true on success, false if the polygon is invalid or memory ran out
+	 */
+	bool init(const struct map_projection_reference_s &ref, const float *lat, const float *lon, unsigned count,
+		  bool exclusion);
+
+	/**
+	 * Return whether a point given in the projection plane is inside the polygon.
+	 * @param x north in meters
+	 * @param y east in meters
+	 */
+	bool inside(float x, float y) const;
+
+	bool isExclusion() const { return _exclusion; }
+
+	unsigned vertexCount() const { return _count; }
+
+	void release();
+
+private:
+	static constexpr unsigned MAX_CELLS_PER_AXIS = 64;
+	static constexpr unsigned MAX_EDGE_REFS_PER_EDGE = 8; /**< limits the index size of polygons with long edges */
+
+	float *_x{nullptr};		/**< projected vertices, north */
+	float *_y{nullptr};		/**< projected vertices, east */
+	unsigned _count{0};
+	bool _exclusion{false};
+
+	float _min_x{0.f};
+	float _max_x{0.f};
+	float _min_y{0.f};
+	float _max_y{0.f};
+
+	/* The bounding box is cut into a grid of cells. Each cell knows whether its center is inside and
+	 * lists the edges that can pass through it, so a test only counts the crossings of these edges
+	 * with the segment from the cell center to the point. */
+	unsigned _cells{0};		/**< cells per axis */
+	float _scale_x{0.f};		/**< cells per meter */
+	float _scale_y{0.f};
+	uint16_t *_cell_start{nullptr};	/**< first entry of each cell in _cell_edges, _cells * _cells + 1 entries */
+	uint16_t *_cell_edges{nullptr};	/**< edge i connects vertex i and i + 1 */
+	uint8_t *_center_inside{nullptr};	/**< one bit per cell */
+
+	unsigned cell(float v, float min, float scale) const;
+	void cellCenter(unsigned cx, unsigned cy, float &x, float &y) const;
+	bool insideLinear(float x, float y) const;
+	bool buildIndex();
+	unsigned countCellRefs(bool fill);
+};
+
+/**
+ * Time containment tests of 4, 64 and 1024 vertex polygons, with and without the edge index.
+ */
+void geofence_polygon_bench();
@@ -793,7 +793,7 @@ void Navigator::load_fence_from_file(const char *filename)
 
 static void usage()
 {
-	warnx("usage: navigator {start|stop|status|fence|fencefile}");
+	warnx("usage: navigator {start|stop|status|fence|fencefile|fencebench}");
 }
 
 int navigator_main(int argc, char *argv[])
@@ -827,6 +827,11 @@ int navigator_main(int argc, char *argv[])
 		return 0;
 	}
 
+	if (!strcmp(argv[1], "fencebench")) {
+		geofence_polygon_bench();
+		return 0;
+	}
+
 	if (navigator::g_navigator == nullptr) {
 		warnx("not running");
 		return 1;
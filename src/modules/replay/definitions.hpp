@@ -39,6 +39,7 @@ namespace replay
 {
 
 static const char *ENV_FILENAME = "replay"; ///< name for getenv()
+static const char *ENV_MODE = "replay_mode"; ///< name for getenv(), "lockstep" to replay as fast as possible
 
 
 } //namespace replay
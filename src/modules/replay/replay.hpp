@@ -41,6 +41,7 @@
 
 #include "definitions.hpp"
 
+#include <logger/messages.h>
 #include <uORB/uORBTopics.h>
 
 namespace px4
@@ -49,9 +50,15 @@ namespace px4
 /**
  * @class Replay
  * Parses an ULog file and replays it in 'real-time'. The timestamp of each replayed message is offset
- * to match the starting time of replay. It keeps a stream for each subscription to find the next message
- * to replay. This is necessary because data messages from different subscriptions don't need to be in
- * monotonic increasing order.
+ * to match the starting time of replay.
+ * The file is memory-mapped and indexed in a single pass: for each subscription, the file offsets and
+ * timestamps of its data messages, and the offsets of parameter changes and dropouts. Data messages
+ * from different subscriptions don't need to be in monotonic increasing order, so they are merged
+ * through a heap ordered by timestamp.
+ *
+ * In lockstep mode (@see replay::ENV_MODE), the HRT follows the log time and the next message is
+ * published as soon as all subscribers processed the previous one, so that replay runs as fast
+ * as possible and deterministically.
  */
 class Replay
 {
@@ -82,14 +89,25 @@ public:
 	static bool isSetup() { return _replay_file; }
 private:
 	bool _task_should_exit = false;
+	bool _lockstep = false;
 	std::set<std::string> _overridden_params;
 	std::map<std::string, std::string> _file_formats; ///< all formats we read from the file
 
 	uint64_t _file_start_time;
 	uint64_t _replay_start_time;
-	std::streampos _data_section_start; ///< first ADD_LOGGED_MSG message
+	size_t _data_section_start; ///< first ADD_LOGGED_MSG message
 	std::vector<uint8_t> _read_buffer;
 
+	int _fd = -1;
+	const uint8_t *_file_data = nullptr; ///< memory-mapped replay file
+	size_t _file_size = 0;
+
+	/** data message in the file */
+	struct IndexEntry {
+		uint64_t timestamp; ///< timestamp of the file
+		size_t offset; ///< start of the message header
+	};
+
 	struct Subscription {
 
 		const orb_metadata *orb_meta = nullptr; ///< if nullptr, this subscription is invalid
@@ -97,53 +115,83 @@ private:
 		uint8_t multi_id;
 		int timestamp_offset; ///< marks the field of the timestamp
 
-		std::streampos next_read_pos;
-		uint64_t next_timestamp; ///< timestamp of the file
+		std::vector<IndexEntry> messages; ///< all data messages, in file order
+		size_t next_message = 0; ///< index into messages of the next one to publish
 	};
 	std::vector<Subscription> _subscriptions;
+	std::vector<int> _msg_id_to_subscription; ///< index into _subscriptions, -1 for ignored topics
+
+	std::vector<size_t> _additional_messages; ///< offsets of parameter changes and dropouts
+	size_t _next_additional_message = 0; ///< index into _additional_messages of the next one to handle
+
+	/**
+	 * Open and map the replay file. A compressed log is decoded into a plain ULog file
+	 * first, which then replaces the replay file.
+	 * @return true on success
+	 */
+	bool openReplayFile();
 
-	/** keep track of file position to avoid adding a subscription multiple times. */
-	std::streampos _subscription_file_pos = 0;
+	void closeReplayFile();
 
-	bool readFileHeader(std::ifstream &file);
+	/**
+	 * Decode a compressed log (@see logger/ulog_compression.h) frame by frame, starting after
+	 * the compressed file header.
+	 * @return true on success
+	 */
+	static bool decompressFile(std::ifstream &file, const char *out_file_name);
+
+	/**
+	 * Get the header of the message at offset and check that the whole message is within the file
+	 * @return false at the end of the file
+	 */
+	bool readMessageHeader(size_t offset, ulog_message_header_s &header) const;
+
+	bool readFileHeader();
 
 	/**
 	 * Read definitions section: check formats, apply parameters and store
 	 * the start of the data section.
 	 * @return true on success
 	 */
-	bool readFileDefinitions(std::ifstream &file);
+	bool readFileDefinitions();
 
-	///file parsing methods. They return false, when further parsing should be aborted.
-	bool readFormat(std::ifstream &file, uint16_t msg_size);
-	bool readAndAddSubscription(std::ifstream &file, uint16_t msg_size);
+	///message parsing methods. They return false, when further parsing should be aborted.
+	bool readFormat(const uint8_t *message, uint16_t msg_size);
+	bool readAndAddSubscription(const uint8_t *message, uint16_t msg_size);
 
 	/**
 	 * Read the file header and definitions sections. Apply the parameters from this section
 	 * and apply user-defined overridden parameters.
 	 * @return true on success
 	 */
-	bool readDefinitionsAndApplyParams(std::ifstream &file);
+	bool readDefinitionsAndApplyParams();
 
 	/**
-	 * Read and handle additional messages starting at current file position, while position < end_position.
-	 * This handles dropout and parameter update messages.
-	 * We need to handle these separately, because they have no timestamp. We look at the file position instead.
+	 * Single pass over the data section to add all subscriptions and index their data messages,
+	 * parameter changes and dropouts.
 	 * @return false on file error
 	 */
-	bool readAndHandleAdditionalMessages(std::ifstream &file, std::streampos end_position);
-	bool readDropout(std::ifstream &file, uint16_t msg_size);
-	bool readAndApplyParameter(std::ifstream &file, uint16_t msg_size);
+	bool buildIndex();
 
 	/**
-	 * Find next data message for this subscription, starting with the stored file offset.
-	 * Skip the first message, and if found, read the timestamp and store the new file offset.
-	 * This also takes care of new subscriptions and parameter updates. When reaching EOF,
-	 * the subscription is set to invalid.
-	 * File seek position is arbitrary after this call.
-	 * @return false on file error
+	 * Handle the additional messages (parameter changes and dropouts) in the file before end_offset,
+	 * that were not handled yet.
+	 */
+	void handleAdditionalMessages(size_t end_offset);
+	void readDropout(const uint8_t *message, uint16_t msg_size);
+	bool readAndApplyParameter(const uint8_t *message, uint16_t msg_size);
+
+	/**
+	 * Publish a data message, advertising the topic if necessary
+	 * @return true if published
+	 */
+	bool publishMessage(Subscription &sub, size_t offset, uint64_t timestamp);
+
+	/**
+	 * Lockstep: wait until all subscribers processed the published messages
+	 * @return false on timeout
 	 */
-	bool nextDataMessage(std::ifstream &file, Subscription &subscription, int msg_id);
+	bool waitForSubscribers();
 
 	static const orb_metadata *findTopic(const std::string &name);
 	/** get the array size from a type. eg. float[3] -> return float */
@@ -46,22 +46,29 @@
 #include <px4_time.h>
 
 #include <cstring>
+#include <errno.h>
+#include <fcntl.h>
 #include <float.h>
 #include <fstream>
 #include <iostream>
 #include <math.h>
+#include <queue>
 #include <time.h>
 #include <sstream>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <logger/logger.h>
 #include <logger/messages.h>
+#include <logger/ulog_compression.h>
 
 #include "replay.hpp"
 
 #define PARAMS_OVERRIDE_FILE PX4_ROOTFSDIR "/replay_params.txt"
+#define DECOMPRESSED_REPLAY_FILE PX4_ROOTFSDIR "/replay_decompressed.ulg"
 
 
 extern "C" __EXPORT int replay_main(int argc, char *argv[]);
@@ -105,6 +112,7 @@ Replay::~Replay()
 			}
 		} while (replay::control_task != -1);
 	}
+	closeReplayFile();
 }
 
 void Replay::setupReplayFile(const char *file_name)
@@ -116,6 +124,107 @@ void Replay::setupReplayFile(const char *file_name)
 	_replay_file = strdup(file_name);
 }
 
+bool Replay::openReplayFile()
+{
+	ifstream file(_replay_file, ios::in | ios::binary);
+	ulog_compressed_file_header_s header;
+	file.read((char *)&header, sizeof(header));
+
+	if (file && memcmp(header.magic, ulog_compressed_magic, sizeof(header.magic)) == 0) {
+		PX4_INFO("decompressing %s to %s", _replay_file, DECOMPRESSED_REPLAY_FILE);
+
+		if (!decompressFile(file, DECOMPRESSED_REPLAY_FILE)) {
+			PX4_ERR("Failed to decompress replay file");
+			return false;
+		}
+
+		setupReplayFile(DECOMPRESSED_REPLAY_FILE);
+	}
+
+	file.close();
+
+	_fd = ::open(_replay_file, O_RDONLY);
+
+	if (_fd < 0) {
+		PX4_ERR("Failed to open replay file");
+		return false;
+	}
+
+	struct stat st;
+
+	if (fstat(_fd, &st) != 0 || st.st_size == 0) {
+		PX4_ERR("Failed to get replay file size");
+		closeReplayFile();
+		return false;
+	}
+
+	void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, _fd, 0);
+
+	if (data == MAP_FAILED) {
+		PX4_ERR("Failed to map replay file (%i)", errno);
+		closeReplayFile();
+		return false;
+	}
+
+	_file_data = (const uint8_t *)data;
+	_file_size = st.st_size;
+	return true;
+}
+
+void Replay::closeReplayFile()
+{
+	if (_file_data) {
+		munmap((void *)_file_data, _file_size);
+		_file_data = nullptr;
+		_file_size = 0;
+	}
+
+	if (_fd >= 0) {
+		::close(_fd);
+		_fd = -1;
+	}
+}
+
+bool Replay::decompressFile(std::ifstream &file, const char *out_file_name)
+{
+	ofstream out_file(out_file_name, ios::out | ios::binary | ios::trunc);
+	std::vector<uint8_t> frame(ULOG_COMPRESSED_FRAME_MAX);
+	std::vector<uint8_t> raw(ULOG_COMPRESSED_FRAME_MAX);
+	ulog_compressed_frame_header_s header;
+
+	while (file.read((char *)&header, sizeof(header))) {
+		const bool stored = header.data_size & ULOG_COMPRESSED_FRAME_STORED;
+		const int data_size = header.data_size & ~ULOG_COMPRESSED_FRAME_STORED;
+
+		if (data_size > ULOG_COMPRESSED_FRAME_MAX || (stored && data_size != header.raw_size)) {
+			PX4_ERR("invalid frame header");
+			return false;
+		}
+
+		file.read((char *)frame.data(), data_size);
+
+		if (!file) {
+			// the log was not closed properly, keep everything up to here
+			PX4_WARN("truncated frame");
+			break;
+		}
+
+		if (stored) {
+			out_file.write((const char *)frame.data(), data_size);
+
+		} else {
+			if (ulog_decompress_block(frame.data(), data_size, raw.data(), raw.size()) != header.raw_size) {
+				PX4_ERR("corrupt frame");
+				return false;
+			}
+
+			out_file.write((const char *)raw.data(), header.raw_size);
+		}
+	}
+
+	return out_file.good();
+}
+
 
 
 void Replay::setUserParams(const char *filename)
@@ -159,16 +268,26 @@ void Replay::setUserParams(const char *filename)
 	}
 }
 
-bool Replay::readFileHeader(std::ifstream &file)
+bool Replay::readMessageHeader(size_t offset, ulog_message_header_s &header) const
+{
+	if (offset + ULOG_MSG_HEADER_LEN > _file_size) {
+		return false;
+	}
+
+	memcpy(&header, &_file_data[offset], ULOG_MSG_HEADER_LEN);
+	return offset + ULOG_MSG_HEADER_LEN + header.msg_size <= _file_size;
+}
+
+bool Replay::readFileHeader()
 {
-	file.seekg(0);
 	ulog_file_header_s msg_header;
-	file.read((char *)&msg_header, sizeof(msg_header));
 
-	if (!file) {
+	if (_file_size < sizeof(msg_header)) {
 		return false;
 	}
 
+	memcpy(&msg_header, _file_data, sizeof(msg_header));
+
 	_file_start_time = msg_header.timestamp;
 	//verify it's an ULog file
 	char magic[8];
@@ -182,66 +301,53 @@ bool Replay::readFileHeader(std::ifstream &file)
 	return memcmp(magic, msg_header.magic, 7) == 0;
 }
 
-bool Replay::readFileDefinitions(std::ifstream &file)
+bool Replay::readFileDefinitions()
 {
 	PX4_INFO("Applying params from ULog file...");
 
 	ulog_message_header_s message_header;
-	file.seekg(sizeof(ulog_file_header_s));
+	size_t offset = sizeof(ulog_file_header_s);
 
-	while (true) {
-		file.read((char *)&message_header, ULOG_MSG_HEADER_LEN);
-
-		if (!file) {
-			return false;
-		}
+	while (readMessageHeader(offset, message_header)) {
+		const uint8_t *message = &_file_data[offset + ULOG_MSG_HEADER_LEN];
 
 		switch (message_header.msg_type) {
 		case (int)ULogMessageType::FORMAT:
-			if (!readFormat(file, message_header.msg_size)) {
+			if (!readFormat(message, message_header.msg_size)) {
 				return false;
 			}
 
 			break;
 
 		case (int)ULogMessageType::PARAMETER:
-			if (!readAndApplyParameter(file, message_header.msg_size)) {
+			if (!readAndApplyParameter(message, message_header.msg_size)) {
 				return false;
 			}
 
 			break;
 
 		case (int)ULogMessageType::ADD_LOGGED_MSG:
-			_data_section_start = file.tellg() - (streamoff)ULOG_MSG_HEADER_LEN;
+			_data_section_start = offset;
 			return true;
 
 		case (int)ULogMessageType::INFO: //skip
-			file.seekg(message_header.msg_size, ios::cur);
 			break;
 
 		default:
-			PX4_ERR("unknown log definition type %i, size %i (offset %i)",
-				(int)message_header.msg_type, (int)message_header.msg_size, (int)file.tellg());
-			file.seekg(message_header.msg_size, ios::cur);
+			PX4_ERR("unknown log definition type %i, size %i (offset %zu)",
+				(int)message_header.msg_type, (int)message_header.msg_size, offset);
 			break;
 		}
+
+		offset += ULOG_MSG_HEADER_LEN + message_header.msg_size;
 	}
 
-	return true;
+	return false;
 }
 
-bool Replay::readFormat(std::ifstream &file, uint16_t msg_size)
+bool Replay::readFormat(const uint8_t *message, uint16_t msg_size)
 {
-	_read_buffer.reserve(msg_size + 1);
-	char *format = (char *)_read_buffer.data();
-	file.read(format, msg_size);
-	format[msg_size] = 0;
-
-	if (!file) {
-		return false;
-	}
-
-	string str_format(format);
+	string str_format((const char *)message, strnlen((const char *)message, msg_size));
 	size_t pos = str_format.find(':');
 
 	if (pos == string::npos) {
@@ -255,27 +361,23 @@ bool Replay::readFormat(std::ifstream &file, uint16_t msg_size)
 	return true;
 }
 
-bool Replay::readAndAddSubscription(std::ifstream &file, uint16_t msg_size)
+bool Replay::readAndAddSubscription(const uint8_t *message, uint16_t msg_size)
 {
-	_read_buffer.reserve(msg_size + 1);
-	char *message = (char *)_read_buffer.data();
-	streampos this_message_pos = file.tellg() - (streamoff)ULOG_MSG_HEADER_LEN;
-	file.read(message, msg_size);
-	message[msg_size] = 0;
-
-	if (!file) {
+	if (msg_size < 3) {
 		return false;
 	}
 
-	if (file.tellg() <= _subscription_file_pos) { //already read this subscription
-		return true;
+	uint8_t multi_id = message[0];
+	uint16_t msg_id = ((uint16_t) message[1]) | (((uint16_t) message[2]) << 8);
+	string topic_name((const char *)message + 3, strnlen((const char *)message + 3, msg_size - 3));
+
+	if (_msg_id_to_subscription.size() <= msg_id) {
+		_msg_id_to_subscription.resize(msg_id + 1, -1);
 	}
 
-	_subscription_file_pos = file.tellg();
+	//ignore the data messages, unless the topic can be replayed
+	_msg_id_to_subscription[msg_id] = -1;
 
-	uint8_t multi_id = *(uint8_t *)message;
-	uint16_t msg_id = ((uint16_t) message[1]) | (((uint16_t) message[2]) << 8);
-	string topic_name(message + 3);
 	const orb_metadata *orb_meta = findTopic(topic_name);
 
 	if (!orb_meta) {
@@ -334,77 +436,123 @@ bool Replay::readAndAddSubscription(std::ifstream &file, uint16_t msg_size)
 		return true;
 	}
 
-
-	//find first data message (and the timestamp)
-	streampos cur_pos = file.tellg();
-	subscription.next_read_pos = this_message_pos; //this will be skipped
-
-	if (!nextDataMessage(file, subscription, msg_id)) {
-		return false;
-	}
-
-	file.seekg(cur_pos);
-
-	if (!subscription.orb_meta) {
-		//no message found. This is not a fatal error
-		return true;
-	}
-
 	PX4_DEBUG("adding subscription for %s (msg_id %i)", subscription.orb_meta->o_name, msg_id);
 
 	//add subscription
-	if (_subscriptions.size() <= msg_id) {
-		_subscriptions.resize(msg_id + 1);
-	}
-
-	_subscriptions[msg_id] = subscription;
+	_msg_id_to_subscription[msg_id] = _subscriptions.size();
+	_subscriptions.push_back(subscription);
 
 	return true;
 }
 
-bool Replay::readAndHandleAdditionalMessages(std::ifstream &file, std::streampos end_position)
+bool Replay::buildIndex()
 {
 	ulog_message_header_s message_header;
+	size_t offset = _data_section_start;
 
-	while (file.tellg() < end_position) {
-		file.read((char *)&message_header, ULOG_MSG_HEADER_LEN);
-
-		if (!file) {
-			return false;
-		}
+	//stops at the end of the file, or at a truncated message if the log was not closed properly
+	while (readMessageHeader(offset, message_header)) {
+		const uint8_t *message = &_file_data[offset + ULOG_MSG_HEADER_LEN];
 
 		switch (message_header.msg_type) {
-		case (int)ULogMessageType::PARAMETER:
-			if (!readAndApplyParameter(file, message_header.msg_size)) {
+		case (int)ULogMessageType::ADD_LOGGED_MSG:
+			if (!readAndAddSubscription(message, message_header.msg_size)) {
 				return false;
 			}
 
 			break;
 
+		case (int)ULogMessageType::DATA: {
+				if (message_header.msg_size < sizeof(uint16_t)) {
+					return false;
+				}
+
+				uint16_t msg_id = ((uint16_t) message[0]) | (((uint16_t) message[1]) << 8);
+
+				if (msg_id >= _msg_id_to_subscription.size() || _msg_id_to_subscription[msg_id] < 0) {
+					break;
+				}
+
+				Subscription &subscription = _subscriptions[_msg_id_to_subscription[msg_id]];
+
+				if (message_header.msg_size != subscription.orb_meta->o_size_no_padding + 2) { //sanity check failed!
+					PX4_ERR("data message %s has wrong size %i (expected %i). Skipping",
+						subscription.orb_meta->o_name, message_header.msg_size,
+						subscription.orb_meta->o_size_no_padding + 2);
+					break;
+				}
+
+				IndexEntry entry;
+				memcpy(&entry.timestamp, message + sizeof(msg_id) + subscription.timestamp_offset, sizeof(entry.timestamp));
+				entry.offset = offset;
+
+				//someone didn't set the timestamp properly. Consider the message invalid
+				if (entry.timestamp != 0) {
+					subscription.messages.push_back(entry);
+				}
+			}
+			break;
+
+		case (int)ULogMessageType::PARAMETER:
 		case (int)ULogMessageType::DROPOUT:
-			readDropout(file, message_header.msg_size);
+			_additional_messages.push_back(offset);
+			break;
+
+		case (int)ULogMessageType::REMOVE_LOGGED_MSG: //skip these
+		case (int)ULogMessageType::SYNC:
+		case (int)ULogMessageType::LOGGING:
 			break;
 
-		default: //skip all others
-			file.seekg(message_header.msg_size, ios::cur);
+		default:
+			//this really should not happen
+			PX4_ERR("unknown log message type %i, size %i (offset %zu)",
+				(int)message_header.msg_type, (int)message_header.msg_size, offset);
 			break;
 		}
+
+		offset += ULOG_MSG_HEADER_LEN + message_header.msg_size;
 	}
 
 	return true;
 }
 
-bool Replay::readAndApplyParameter(std::ifstream &file, uint16_t msg_size)
+void Replay::handleAdditionalMessages(size_t end_offset)
 {
-	_read_buffer.reserve(msg_size);
-	uint8_t *message = (uint8_t *)_read_buffer.data();
-	file.read((char *)message, msg_size);
+	ulog_message_header_s message_header;
 
-	if (!file) {
+	while (_next_additional_message < _additional_messages.size()) {
+		const size_t offset = _additional_messages[_next_additional_message];
+
+		if (offset >= end_offset) {
+			break;
+		}
+
+		memcpy(&message_header, &_file_data[offset], ULOG_MSG_HEADER_LEN);
+		const uint8_t *message = &_file_data[offset + ULOG_MSG_HEADER_LEN];
+
+		if (message_header.msg_type == (int)ULogMessageType::PARAMETER) {
+			readAndApplyParameter(message, message_header.msg_size);
+
+		} else {
+			readDropout(message, message_header.msg_size);
+		}
+
+		++_next_additional_message;
+	}
+}
+
+bool Replay::readAndApplyParameter(const uint8_t *message, uint16_t msg_size)
+{
+	if (msg_size < 1) {
 		return false;
 	}
 
 	uint8_t key_len = message[0];
+
+	if (1 + key_len > msg_size) {
+		return false;
+	}
+
 	string key((char *)message + 1, key_len);
 
 	size_t pos = key.find(' ');
@@ -426,6 +574,10 @@ bool Replay::readAndApplyParameter(std::ifstream &file, uint16_t msg_size)
 		return true;
 	}
 
+	if (1 + key_len + 4 > msg_size) {
+		return false;
+	}
+
 	param_t handle = param_find(param_name.c_str());
 
 	if (handle != PARAM_INVALID) {
@@ -435,90 +587,15 @@ bool Replay::readAndApplyParameter(std::ifstream &file, uint16_t msg_size)
 	return true;
 }
 
-bool Replay::readDropout(std::ifstream &file, uint16_t msg_size)
-{
-	uint16_t duration;
-	file.read((char *)&duration, sizeof(duration));
-
-	PX4_INFO("Dropout in replayed log, %i ms", (int)duration);
-	return file.good();
-}
-
-bool Replay::nextDataMessage(std::ifstream &file, Subscription &subscription, int msg_id)
+void Replay::readDropout(const uint8_t *message, uint16_t msg_size)
 {
-	ulog_message_header_s message_header;
-	file.seekg(subscription.next_read_pos);
-	//ignore the first message (it's data we already read)
-	file.read((char *)&message_header, ULOG_MSG_HEADER_LEN);
-
-	if (file) {
-		file.seekg(message_header.msg_size, ios::cur);
-	}
-
-	uint16_t file_msg_id;
-	bool done = false;
-
-	while (file && !done) {
-		streampos cur_pos = file.tellg();
-		file.read((char *)&message_header, ULOG_MSG_HEADER_LEN);
-
-		if (!file) {
-			break;
-		}
-
-		switch (message_header.msg_type) {
-		case (int)ULogMessageType::ADD_LOGGED_MSG:
-			readAndAddSubscription(file, message_header.msg_size);
-			break;
-
-		case (int)ULogMessageType::DATA:
-			file.read((char *)&file_msg_id, sizeof(file_msg_id));
-
-			if (file) {
-				if (msg_id == file_msg_id) {
-					if (message_header.msg_size == subscription.orb_meta->o_size_no_padding + 2) {
-						subscription.next_read_pos = cur_pos;
-						file.seekg(subscription.timestamp_offset, ios::cur);
-						file.read((char *)&subscription.next_timestamp, sizeof(subscription.next_timestamp));
-						done = true;
-
-					} else { //sanity check failed!
-						PX4_ERR("data message %s has wrong size %i (expected %i). Skipping",
-							subscription.orb_meta->o_name, message_header.msg_size,
-							subscription.orb_meta->o_size_no_padding + 2);
-						file.seekg(message_header.msg_size - sizeof(file_msg_id), ios::cur);
-					}
-
-				} else { //not the one we are looking for
-					file.seekg(message_header.msg_size - sizeof(file_msg_id), ios::cur);
-				}
-			}
-
-			break;
-
-		case (int)ULogMessageType::REMOVE_LOGGED_MSG: //skip these
-		case (int)ULogMessageType::PARAMETER:
-		case (int)ULogMessageType::DROPOUT:
-		case (int)ULogMessageType::SYNC:
-		case (int)ULogMessageType::LOGGING:
-			file.seekg(message_header.msg_size, ios::cur);
-			break;
-
-		default:
-			//this really should not happen
-			PX4_ERR("unknown log message type %i, size %i (offset %i)",
-				(int)message_header.msg_type, (int)message_header.msg_size, (int)file.tellg());
-			file.seekg(message_header.msg_size, ios::cur);
-			break;
-		}
-	}
+	uint16_t duration = 0;
 
-	if (file.eof()) { //no more data messages for this subscription
-		subscription.orb_meta = nullptr;
-		file.clear();
+	if (msg_size >= sizeof(duration)) {
+		memcpy(&duration, message, sizeof(duration));
 	}
 
-	return file.good();
+	PX4_INFO("Dropout in replayed log, %i ms", (int)duration);
 }
 
 const orb_metadata *Replay::findTopic(const std::string &name)
@@ -588,7 +665,7 @@ size_t Replay::sizeOfFullType(const std::string &type_name_full)
 	return sizeOfType(type_name) * array_size;
 }
 
-bool Replay::readDefinitionsAndApplyParams(std::ifstream &file)
+bool Replay::readDefinitionsAndApplyParams()
 {
 	// log reader currently assumes little endian
 	int num = 1;
@@ -598,18 +675,18 @@ bool Replay::readDefinitionsAndApplyParams(std::ifstream &file)
 		return false;
 	}
 
-	if (!file.is_open()) {
+	if (!_file_data) {
 		PX4_ERR("Failed to open replay file");
 		return false;
 	}
 
-	if (!readFileHeader(file)) {
+	if (!readFileHeader()) {
 		PX4_ERR("Failed to read file header. Not a valid ULog file");
 		return false;
 	}
 
 	//initialize the formats and apply the parameters from the log file
-	if (!readFileDefinitions(file)) {
+	if (!readFileDefinitions()) {
 		PX4_ERR("Failed to read ULog definitions section. Broken file?");
 		return false;
 	}
@@ -618,123 +695,162 @@ bool Replay::readDefinitionsAndApplyParams(std::ifstream &file)
 	return true;
 }
 
-void Replay::task_main()
+bool Replay::publishMessage(Subscription &sub, size_t offset, uint64_t timestamp)
 {
-	ifstream replay_file(_replay_file, ios::in | ios::binary);
+	const size_t msg_read_size = sub.orb_meta->o_size_no_padding;
+	const size_t msg_write_size = sub.orb_meta->o_size;
+	_read_buffer.resize(msg_write_size);
+	memcpy(_read_buffer.data(), &_file_data[offset + ULOG_MSG_HEADER_LEN + 2], msg_read_size); //skip header & msg id
+	memcpy(_read_buffer.data() + sub.timestamp_offset, &timestamp, sizeof(timestamp));
+
+	if (sub.orb_advert) {
+		orb_publish(sub.orb_meta, sub.orb_advert, _read_buffer.data());
+		return true;
+	}
 
-	if (!readDefinitionsAndApplyParams(replay_file)) {
-		return;
+	if (sub.multi_id == 0) {
+		sub.orb_advert = orb_advertise(sub.orb_meta, _read_buffer.data());
+		return true;
 	}
 
-	_replay_start_time = hrt_absolute_time();
+	// make sure the other instances are advertised already so that we get the correct instance
+	bool advertised = false;
 
-	PX4_INFO("Replay in progress...");
+	for (const auto &subscription : _subscriptions) {
+		if (strcmp(sub.orb_meta->o_name, subscription.orb_meta->o_name) == 0 &&
+		    subscription.orb_advert && subscription.multi_id == sub.multi_id - 1) {
+			advertised = true;
+		}
+	}
 
-	ulog_message_header_s message_header;
-	replay_file.seekg(_data_section_start);
+	if (advertised) {
+		int instance;
+		sub.orb_advert = orb_advertise_multi(sub.orb_meta, _read_buffer.data(),
+						     &instance, ORB_PRIO_DEFAULT);
+		return true;
+	}
+
+	return false;
+}
+
+bool Replay::waitForSubscribers()
+{
+	const hrt_abstime timeout = 1000000; // [us]
+	// the HRT follows the log time, so measure the timeout with the system clock
+	const uint64_t start = hrt_system_time();
+
+	for (int i = 0; !orb_subscribers_idle(); ++i) {
+		if (_task_should_exit) {
+			return true;
+		}
+
+		// most subscribers are done within a few scheduler rounds, so only sleep after that
+		if (i < 100) {
+			sched_yield();
+			continue;
+		}
+
+		usleep(100);
+
+		if (hrt_system_time() - start > timeout) {
+			return false;
+		}
+	}
 
-	//we know the next message must be an ADD_LOGGED_MSG
-	replay_file.read((char *)&message_header, ULOG_MSG_HEADER_LEN);
+	return true;
+}
 
-	if (!readAndAddSubscription(replay_file, message_header.msg_size)) {
-		PX4_ERR("Failed to read subscription");
+void Replay::task_main()
+{
+	if (!openReplayFile() || !readDefinitionsAndApplyParams()) {
+		closeReplayFile();
 		return;
 	}
 
+	const hrt_abstime index_start_time = hrt_absolute_time();
 
-	//we update the timestamps from the file by a constant offset to match
-	//the current replay time
-	const uint64_t timestamp_offset = _replay_start_time - _file_start_time;
-	uint32_t nr_published_messages = 0;
-	streampos last_additional_message_pos = _data_section_start;
+	if (!buildIndex()) {
+		PX4_ERR("Failed to index replay file");
+		closeReplayFile();
+		return;
+	}
 
-	while (!_task_should_exit && replay_file) {
+	size_t nr_indexed_messages = 0;
 
-		//Find the next message to publish. Messages from different subscriptions don't need
-		//to be in chronological order, so we need to check all subscriptions
-		uint64_t next_file_time = 0;
-		int next_msg_id = -1;
+	for (const auto &subscription : _subscriptions) {
+		nr_indexed_messages += subscription.messages.size();
+	}
 
-		for (size_t i = 0; i < _subscriptions.size(); ++i) {
-			const Subscription &subscription = _subscriptions[i];
+	PX4_INFO("Indexed %zu msgs of %zu topics in %.3lf s", nr_indexed_messages, _subscriptions.size(),
+		 (double)hrt_elapsed_time(&index_start_time) / 1.e6);
 
-			if (subscription.orb_meta) {
-				if (next_file_time == 0 || subscription.next_timestamp < next_file_time) {
-					next_msg_id = (int)i;
-					next_file_time = subscription.next_timestamp;
-				}
-			}
-		}
+	_replay_start_time = hrt_absolute_time();
 
-		if (next_msg_id == -1) {
-			break; //no active subscription anymore. We're done.
-		}
+	PX4_INFO("Replay in progress...");
+
+	//we update the timestamps from the file by a constant offset to match
+	//the current replay time. In lockstep mode the HRT follows the log time instead.
+	const char *mode = getenv(replay::ENV_MODE);
+	_lockstep = mode && !strcmp(mode, "lockstep");
+	const uint64_t timestamp_offset = _lockstep ? 0 : _replay_start_time - _file_start_time;
+	const uint64_t replay_start_system_time = hrt_system_time(); // the HRT can follow the log time
+	uint32_t nr_published_messages = 0;
+	uint32_t nr_lockstep_timeouts = 0;
+
+	if (_lockstep) {
+		PX4_INFO("Lockstep mode: the HRT follows the log time");
+	}
 
-		Subscription &sub = _subscriptions[next_msg_id];
+	//next message of each subscription, earliest timestamp first (lower subscription index on equal timestamps)
+	typedef std::pair<uint64_t, size_t> NextMessage;
+	std::priority_queue<NextMessage, std::vector<NextMessage>, std::greater<NextMessage>> next_messages;
 
-		if (next_file_time == 0) {
-			//someone didn't set the timestamp properly. Consider the message invalid
-			nextDataMessage(replay_file, sub, next_msg_id);
-			continue;
+	for (size_t i = 0; i < _subscriptions.size(); ++i) {
+		if (!_subscriptions[i].messages.empty()) {
+			next_messages.push(NextMessage(_subscriptions[i].messages[0].timestamp, i));
 		}
+	}
 
+	while (!_task_should_exit && !next_messages.empty()) {
 
-		//handle additional messages between last and next published data
-		replay_file.seekg(last_additional_message_pos);
-		streampos next_additional_message_pos = sub.next_read_pos;
-		readAndHandleAdditionalMessages(replay_file, next_additional_message_pos);
-		last_additional_message_pos = next_additional_message_pos;
+		const uint64_t next_file_time = next_messages.top().first;
+		const size_t next_subscription = next_messages.top().second;
+		next_messages.pop();
 
+		Subscription &sub = _subscriptions[next_subscription];
+		const size_t offset = sub.messages[sub.next_message].offset;
+
+		//handle additional messages between last and next published data
+		handleAdditionalMessages(offset);
 
 		//wait if necessary
 		const uint64_t publish_timestamp = next_file_time + timestamp_offset;
-		uint64_t cur_time = hrt_absolute_time();
 
-		if (cur_time < publish_timestamp) {
-			usleep(publish_timestamp - cur_time);
+		if (_lockstep) {
+			hrt_set_external_time(publish_timestamp);
+
+		} else {
+			uint64_t cur_time = hrt_absolute_time();
+
+			if (cur_time < publish_timestamp) {
+				usleep(publish_timestamp - cur_time);
+			}
 		}
 
 		//It's time to publish
-		const size_t msg_read_size = sub.orb_meta->o_size_no_padding;
-		const size_t msg_write_size = sub.orb_meta->o_size;
-		_read_buffer.reserve(msg_write_size);
-		replay_file.seekg(sub.next_read_pos + (streamoff)(ULOG_MSG_HEADER_LEN + 2)); //skip header & msg id
-		replay_file.read((char *)_read_buffer.data(), msg_read_size);
-		*(uint64_t *)(_read_buffer.data() + sub.timestamp_offset) = publish_timestamp;
-
-		if (sub.orb_advert) {
-			orb_publish(sub.orb_meta, sub.orb_advert, _read_buffer.data());
+		if (publishMessage(sub, offset, publish_timestamp)) {
 			++nr_published_messages;
+		}
 
-		} else {
-			if (sub.multi_id == 0) {
-				sub.orb_advert = orb_advertise(sub.orb_meta, _read_buffer.data());
-				++nr_published_messages;
-
-			} else {
-				// make sure the other instances are advertised already so that we get the correct instance
-				bool advertised = false;
-
-				for (const auto &subscription : _subscriptions) {
-					if (subscription.orb_meta) {
-						if (strcmp(sub.orb_meta->o_name, subscription.orb_meta->o_name) == 0 &&
-						    subscription.orb_advert && subscription.multi_id == sub.multi_id - 1) {
-							advertised = true;
-						}
-					}
-				}
-
-				if (advertised) {
-					int instance;
-					sub.orb_advert = orb_advertise_multi(sub.orb_meta, _read_buffer.data(),
-									     &instance, ORB_PRIO_DEFAULT);
-					++nr_published_messages;
-				}
+		if (_lockstep && !waitForSubscribers()) {
+			if (nr_lockstep_timeouts++ == 0) {
+				PX4_WARN("timeout waiting for subscribers, replay may not be deterministic");
 			}
 		}
 
-
-		nextDataMessage(replay_file, _subscriptions[next_msg_id], next_msg_id);
+		if (++sub.next_message < sub.messages.size()) {
+			next_messages.push(NextMessage(sub.messages[sub.next_message].timestamp, next_subscription));
+		}
 
 		//TODO: output status (eg. every sec), including total duration...
 	}
@@ -747,11 +863,20 @@ void Replay::task_main()
 	}
 
 	if (!_task_should_exit) {
-		PX4_INFO("Replay done (published %u msgs, %.3lf s)", nr_published_messages,
-			 (double)hrt_elapsed_time(&_replay_start_time) / 1.e6);
+		const double replay_duration = (double)(hrt_system_time() - replay_start_system_time) / 1.e6;
+
+		if (_lockstep) {
+			PX4_INFO("Lockstep replay of %.3lf s of log data, %u timeouts",
+				 (double)(hrt_absolute_time() - _file_start_time) / 1.e6, nr_lockstep_timeouts);
+		}
+
+		PX4_INFO("Replay done (published %u msgs, %.3lf s, %.0lf msgs/s)", nr_published_messages,
+			 replay_duration, nr_published_messages / replay_duration);
 
 		//TODO: should we close the log file & exit (optionally, by adding a parameter -q) ?
 	}
+
+	closeReplayFile();
 }
 
 void Replay::task_main_trampoline(int argc, char *argv[])
@@ -799,9 +924,7 @@ int Replay::start(bool quiet, bool apply_params_only)
 			return -ENOMEM;
 		}
 
-		ifstream replay_file(_replay_file, ios::in | ios::binary);
-
-		if (!r->readDefinitionsAndApplyParams(replay_file)) {
+		if (!r->openReplayFile() || !r->readDefinitionsAndApplyParams()) {
 			ret = -1;
 		}
 
@@ -131,8 +131,13 @@ int Simulator::start(int argc, char *argv[])
 	if (_instance) {
 		drv_led_start();
 
-		if (argc == 5 && strcmp(argv[3], "-u") == 0) {
-			udp_port = atoi(argv[4]);
+		for (int i = 3; i < argc; i++) {
+			if (strcmp(argv[i], "-u") == 0 && i + 1 < argc) {
+				udp_port = atoi(argv[++i]);
+
+			} else if (strcmp(argv[i], "-l") == 0) {
+				_instance->_lockstep = true;
+			}
 		}
 
 		if (argv[2][1] == 's') {
@@ -161,10 +166,11 @@ int Simulator::start(int argc, char *argv[])
 
 static void usage()
 {
-	PX4_WARN("Usage: simulator {start -[spt] [-u udp_port] |stop}");
+	PX4_WARN("Usage: simulator {start -[spt] [-u udp_port] [-l] |stop}");
 	PX4_WARN("Simulate raw sensors:     simulator start -s");
 	PX4_WARN("Publish sensors combined: simulator start -p");
 	PX4_WARN("Dummy unit test data:     simulator start -t");
+	PX4_WARN("Run on the simulator time (lockstep): -l");
 }
 
 __BEGIN_DECLS
@@ -58,6 +58,7 @@
 #include <uORB/topics/distance_sensor.h>
 #include <v1.0/mavlink_types.h>
 #include <v1.0/common/mavlink.h>
+#include "simulator_report.h"
 namespace simulator
 {
 
@@ -124,61 +125,6 @@ struct RawGPSData {
 };
 #pragma pack(pop)
 
-template <typename RType> class Report
-{
-public:
-	Report(int readers) :
-		_readidx(0),
-		_max_readers(readers),
-		_report_len(sizeof(RType))
-	{
-		px4_sem_init(&_lock, 0, _max_readers);
-	}
-
-	~Report() {};
-
-	bool copyData(void *outbuf, int len)
-	{
-		if (len != _report_len) {
-			return false;
-		}
-
-		read_lock();
-		memcpy(outbuf, &_buf[_readidx], _report_len);
-		read_unlock();
-		return true;
-	}
-	void writeData(void *inbuf)
-	{
-		write_lock();
-		memcpy(&_buf[!_readidx], inbuf, _report_len);
-		_readidx = !_readidx;
-		write_unlock();
-	}
-
-protected:
-	void read_lock() { px4_sem_wait(&_lock); }
-	void read_unlock() { px4_sem_post(&_lock); }
-	void write_lock()
-	{
-		for (int i = 0; i < _max_readers; i++) {
-			px4_sem_wait(&_lock);
-		}
-	}
-	void write_unlock()
-	{
-		for (int i = 0; i < _max_readers; i++) {
-			px4_sem_post(&_lock);
-		}
-	}
-
-	int _readidx;
-	px4_sem_t _lock;
-	const int _max_readers;
-	const int _report_len;
-	RType _buf[2];
-};
-
 };
 
 class Simulator
@@ -220,12 +166,12 @@ public:
 
 private:
 	Simulator() :
-		_accel(1),
-		_mpu(1),
-		_baro(1),
-		_mag(1),
-		_gps(1),
-		_airspeed(1),
+		_accel(),
+		_mpu(),
+		_baro(),
+		_mag(),
+		_gps(),
+		_airspeed(),
 		_perf_accel(perf_alloc_once(PC_ELAPSED, "sim_accel_delay")),
 		_perf_mpu(perf_alloc_once(PC_ELAPSED, "sim_mpu_delay")),
 		_perf_baro(perf_alloc_once(PC_ELAPSED, "sim_baro_delay")),
@@ -241,7 +187,10 @@ private:
 		_flow_pub(nullptr),
 		_dist_pub(nullptr),
 		_battery_pub(nullptr),
-		_initialized(false)
+		_initialized(false),
+		_lockstep(false),
+		_sim_time_valid(false),
+		_sim_time_offset(0)
 #ifndef __PX4_QURT
 		,
 		_rc_channels_pub(nullptr),
@@ -295,6 +244,11 @@ private:
 
 	bool _initialized;
 
+	// drive the HRT from the simulator time, so PX4 runs in lockstep with it
+	bool _lockstep;
+	bool _sim_time_valid;
+	hrt_abstime _sim_time_offset;
+
 	// Lib used to do the battery calculations.
 	Battery _battery;
 
@@ -324,6 +278,7 @@ private:
 	void handle_message(mavlink_message_t *msg, bool publish);
 	void send_controls();
 	void pollForMAVLinkMessages(bool publish, int udp_port);
+	void set_sim_time(uint64_t sim_time);
 
 	void pack_actuator_message(mavlink_hil_controls_t &actuator_msg, unsigned index);
 	void send_mavlink_message(const uint8_t msgid, const void *msg, uint8_t component_ID);
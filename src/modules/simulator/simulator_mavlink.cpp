@@ -215,6 +215,25 @@ void Simulator::update_gps(mavlink_hil_gps_t *gps_sim)
 	write_gps_data((void *)&gps);
 }
 
+void Simulator::set_sim_time(uint64_t sim_time)
+{
+	hrt_abstime now = hrt_absolute_time();
+
+	// The simulator clock starts anywhere and starts over when the simulation
+	// is reset. Continue the HRT from where it is in both cases.
+	if (!_sim_time_valid || sim_time + _sim_time_offset < now) {
+		if (_sim_time_valid) {
+			PX4_WARN("simulator time went back, continuing from %" PRIu64 " us", now);
+		}
+
+		_sim_time_offset = now - sim_time;
+		_sim_time_valid = true;
+	}
+
+	// blocking calls of all PX4 tasks wait on this clock from now on
+	hrt_set_external_time(sim_time + _sim_time_offset);
+}
+
 void Simulator::handle_message(mavlink_message_t *msg, bool publish)
 {
 	switch (msg->msgid) {
@@ -225,6 +244,10 @@ void Simulator::handle_message(mavlink_message_t *msg, bool publish)
 			// set temperature to a decent value
 			imu.temperature = 32.0f;
 
+			if (_lockstep) {
+				set_sim_time(imu.time_usec);
+			}
+
 			uint64_t sim_timestamp = imu.time_usec;
 			struct timespec ts;
 			px4_clock_gettime(CLOCK_REALTIME, &ts);
@@ -596,7 +619,8 @@ void Simulator::pollForMAVLinkMessages(bool publish, int udp_port)
 
 		//timed out
 		if (pret == 0) {
-			if (!sim_delay) {
+			// in lockstep the time stands still anyway until the simulator continues
+			if (!sim_delay && !_lockstep) {
 				// we do not want to spam the console by default
 				// PX4_WARN("mavlink sim timeout for %d ms", max_wait_ms);
 				sim_delay = true;
@@ -0,0 +1,116 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file simulator_report.h
+ * Hand-over of the latest simulated sensor sample from the simulator thread
+ * to the driver reading it.
+ */
+
+#pragma once
+
+#include <px4_sem.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace simulator
+{
+
+/**
+ * Latest sample of one simulated sensor.
+ *
+ * A triple buffer: the writer fills its own back buffer and swaps it with
+ * the middle one, the reader swaps the middle one with its front buffer if
+ * a new sample arrived since its last copy. Each buffer is owned by exactly
+ * one side at a time, so neither side ever waits for the other and the
+ * reader always gets a whole sample.
+ *
+ * There must be only one writer. Readers are serialised among themselves,
+ * which the writer never has to care about.
+ */
+template <typename RType> class Report
+{
+public:
+	Report() :
+		_front(0),
+		_middle(1),
+		_back(2),
+		_report_len(sizeof(RType)),
+		_buf{}
+	{
+		px4_sem_init(&_read_lock, 0, 1);
+	}
+
+	~Report()
+	{
+		px4_sem_destroy(&_read_lock);
+	}
+
+	bool copyData(void *outbuf, int len)
+	{
+		if (len != _report_len) {
+			return false;
+		}
+
+		px4_sem_wait(&_read_lock);
+
+		if (__atomic_load_n(&_middle, __ATOMIC_RELAXED) & FRESH) {
+			_front = __atomic_exchange_n(&_middle, _front, __ATOMIC_ACQ_REL) & INDEX;
+		}
+
+		memcpy(outbuf, &_buf[_front], _report_len);
+		px4_sem_post(&_read_lock);
+		return true;
+	}
+
+	void writeData(void *inbuf)
+	{
+		memcpy(&_buf[_back], inbuf, _report_len);
+		_back = __atomic_exchange_n(&_middle, _back | FRESH, __ATOMIC_ACQ_REL) & INDEX;
+	}
+
+protected:
+	/** _middle holds the index of the middle buffer, FRESH if it has not been read yet */
+	static const unsigned INDEX = 0x3;
+	static const unsigned FRESH = 0x4;
+
+	unsigned _front;	/**< reader's buffer */
+	unsigned _middle;	/**< last complete sample, swapped atomically */
+	unsigned _back;		/**< writer's buffer */
+	px4_sem_t _read_lock;
+	const int _report_len;
+	RType _buf[3];
+};
+
+};
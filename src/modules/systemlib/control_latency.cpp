@@ -0,0 +1,105 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file control_latency.cpp
+ *
+ * Sensor to actuator latency statistics for output drivers.
+ */
+
+#include "control_latency.h"
+
+#include <string.h>
+
+#define CONTROL_LATENCY_PUBLISH_INTERVAL	100000	/**< us */
+
+ControlLatency::ControlLatency(const char *perf_name) :
+	_latency_sum(0),
+	_perf(perf_alloc(PC_HISTOGRAM, perf_name)),
+	_pub(nullptr),
+	_last_publish(0)
+{
+	memset(&_latency, 0, sizeof(_latency));
+}
+
+ControlLatency::~ControlLatency()
+{
+	if (_pub != nullptr) {
+		orb_unadvertise(_pub);
+	}
+
+	perf_free(_perf);
+}
+
+void
+ControlLatency::update(hrt_abstime timestamp_sample, hrt_abstime now)
+{
+	/* no sample timestamp, or one from the future (e.g. after a simulator clock jump) */
+	if (timestamp_sample == 0 || timestamp_sample > now) {
+		return;
+	}
+
+	uint32_t latency = (now - timestamp_sample > UINT32_MAX) ? UINT32_MAX : (uint32_t)(now - timestamp_sample);
+
+	perf_set_elapsed(_perf, latency);
+
+	_latency.count++;
+	_latency.latency_last = latency;
+	_latency.timestamp_sample = timestamp_sample;
+	_latency_sum += latency;
+
+	if (now - _last_publish < CONTROL_LATENCY_PUBLISH_INTERVAL) {
+		return;
+	}
+
+	/* min, max and the percentiles come from the histogram of the perf counter */
+	struct perf_counter_snapshot_s snapshot;
+	perf_snapshot_counter(_perf, &snapshot);
+
+	_last_publish = now;
+	_latency.timestamp = now;
+	_latency.latency_min = snapshot.min;
+	_latency.latency_max = snapshot.max;
+	_latency.latency_mean = (float)_latency_sum / _latency.count;
+	_latency.latency_p50 = snapshot.p50;
+	_latency.latency_p90 = snapshot.p90;
+	_latency.latency_p99 = snapshot.p99;
+
+	if (_pub != nullptr) {
+		orb_publish(ORB_ID(control_latency), _pub, &_latency);
+
+	} else {
+		int instance;
+		_pub = orb_advertise_multi(ORB_ID(control_latency), &_latency, &instance, ORB_PRIO_DEFAULT);
+	}
+}
@@ -0,0 +1,82 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file control_latency.h
+ *
+ * Sensor to actuator latency statistics for output drivers.
+ */
+
+#pragma once
+
+#include <drivers/drv_hrt.h>
+#include <systemlib/perf_counter.h>
+#include <uORB/uORB.h>
+#include <uORB/topics/control_latency.h>
+
+
+class ControlLatency
+{
+public:
+	/**
+	 * Constructor
+	 *
+	 * @param perf_name: name of the PC_HISTOGRAM perf counter the latencies are accounted in
+	 */
+	ControlLatency(const char *perf_name);
+
+	/**
+	 * Destructor
+	 */
+	~ControlLatency();
+
+	/**
+	 * Account one actuator output and publish the statistics, at most at 10 Hz.
+	 *
+	 * @param timestamp_sample: gyro sample timestamp of the mixed controls, 0 if unknown
+	 * @param now: time the output was written
+	 */
+	void update(hrt_abstime timestamp_sample, hrt_abstime now);
+
+	/**
+	 * Get the statistics, mean and percentiles as of the last publication
+	 */
+	const control_latency_s &get() const { return _latency; }
+
+private:
+	control_latency_s _latency;
+	uint64_t _latency_sum;
+	perf_counter_t _perf;
+	orb_advert_t _pub;
+	hrt_abstime _last_publish;
+};
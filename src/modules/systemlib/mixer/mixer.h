@@ -184,6 +184,29 @@ public:
 	 */
 	virtual void			groups_required(uint32_t &groups) = 0;
 
+	/**
+	 * Perform simpler linear scaling.
+	 *
+	 * @param scaler		The scaler configuration.
+	 * @param input			The value to be scaled.
+	 * @return			The scaled value.
+	 */
+	static float			scale(const mixer_scaler_s &scaler, float input);
+
+	/**
+	 * Convert a scale, offset or limit from a mixer definition to float.
+	 *
+	 * Definitions give these values in units of 1/10000. Multiplying by the
+	 * reciprocal, rather than dividing, gives the same result whether the
+	 * compiler evaluates it or the parser does at runtime with
+	 * -funsafe-math-optimizations, so mixers compiled in at build time match
+	 * the parsed ones bit for bit.
+	 *
+	 * @param value			The value as written in the definition.
+	 * @return			The value as float.
+	 */
+	static constexpr float		scaler_value(int value) { return value * 0.0001f; }
+
 protected:
 	/** client-supplied callback used when fetching control values */
 	ControlCallback			_control_cb;
@@ -198,15 +221,6 @@ protected:
 	 */
 	float				get_control(uint8_t group, uint8_t index);
 
-	/**
-	 * Perform simpler linear scaling.
-	 *
-	 * @param scaler		The scaler configuration.
-	 * @param input			The value to be scaled.
-	 * @return			The scaled value.
-	 */
-	static float			scale(const mixer_scaler_s &scaler, float input);
-
 	/**
 	 * Validate a scaler
 	 *
@@ -303,7 +317,7 @@ public:
 	 *
 	 * The multirotor mixer definition is a single line of the form:
 	 *
-	 * R: <geometry> <roll scale> <pitch scale> <yaw scale> <deadband>
+	 * R: <geometry> <roll scale> <pitch scale> <yaw scale> <deadband> [<allocation>]
 	 *
 	 * @param buf			The mixer configuration buffer.
 	 * @param buflen		The length of the buffer, updated to reflect
@@ -459,14 +473,25 @@ enum class MultirotorGeometry : MultirotorGeometryUnderlyingType;
 {
 public:
 	/**
+	 * Precalculated rotor mix of a geometry.
+	 *
+	 * The scales are stored as one array per input, so the mix is a small
+	 * matrix-vector product over contiguous rows that the compiler can vectorise.
+	 */
+	struct RotorMatrix {
+		unsigned	rotor_count;
+		const float	*roll_scale;	/**< scales roll for each rotor */
+		const float	*pitch_scale;	/**< scales pitch for each rotor */
+		const float	*yaw_scale;	/**< scales yaw for each rotor */
+		const float	*out_scale;	/**< scales total out for each rotor */
+	};
 
-	 * Precalculated rotor mix.
+	/**
+	 * How yaw is traded against thrust when the outputs saturate.
 	 */
-	struct Rotor {
-		float	roll_scale;	/**< scales roll for this rotor */
-		float	pitch_scale;	/**< scales pitch for this rotor */
-		float	yaw_scale;	/**< scales yaw for this rotor */
-		float	out_scale;	/**< scales total out for this rotor */
+	enum class Allocation {
+		CLIP = 0,	/**< limit yaw rotor by rotor, reducing thrust by at most 0.15 */
+		SEARCH = 1	/**< search the largest feasible yaw, then the closest thrust */
 	};
 
 	/**
@@ -518,7 +543,51 @@ public:
 	virtual unsigned		mix(float *outputs, unsigned space, uint16_t *status_reg);
 	virtual void			groups_required(uint32_t &groups);
 
+	/**
+	 * Mix a batch of control inputs without going through the control callback.
+	 *
+	 * @param controls		count * 4 control inputs, each roll, pitch, yaw and thrust.
+	 * @param count			Number of control inputs.
+	 * @param outputs		count * rotor_count() outputs.
+	 * @param status_reg		count saturation flags, or nullptr.
+	 * @return			The number of outputs per control input.
+	 */
+	unsigned			mix_batch(const float *controls, unsigned count, float *outputs, uint16_t *status_reg);
+
+	/**
+	 * Select how yaw is traded against thrust under saturation.
+	 */
+	void				set_allocation(Allocation allocation) { _allocation = allocation; }
+
+	/**
+	 * Get the number of rotors of the geometry.
+	 */
+	unsigned			rotor_count() const { return _rotors.rotor_count; }
+
 private:
+	/**
+	 * Mix one set of control inputs, already scaled and constrained.
+	 */
+	unsigned			mix_rotors(float roll, float pitch, float yaw, float thrust,
+					   float *outputs, uint16_t *status_reg) const;
+
+	/**
+	 * Find the largest yaw and the thrust closest to the demand that keep all
+	 * outputs in range, in a bounded number of bisection steps.
+	 *
+	 * @param rp			Mixed roll and pitch per rotor, already scaled.
+	 * @param yaw			Yaw demand, reduced on return.
+	 * @param thrust		Thrust demand, adjusted on return.
+	 */
+	void				search_allocation(const float *rp, float &yaw, float &thrust) const;
+
+	/**
+	 * Get the range of thrust that keeps rp + yaw * yaw_scale + thrust of all rotors
+	 * in [0, 1] and within margin of the thrust demand. Empty if thrust_min > thrust_max.
+	 */
+	void				thrust_range(const float *rp, float yaw, float thrust, float margin,
+					     float &thrust_min, float &thrust_max) const;
+
 	float				_roll_scale;
 	float				_pitch_scale;
 	float				_yaw_scale;
@@ -527,8 +596,8 @@ private:
 	orb_advert_t			_limits_pub;
 	multirotor_motor_limits_s 	_limits;
 
-	unsigned			_rotor_count;
-	const Rotor			*_rotors;
+	const RotorMatrix		&_rotors;
+	Allocation			_allocation;
 
 	/* do not allow to copy due to ptr data members */
 	MultirotorMixer(const MultirotorMixer &);
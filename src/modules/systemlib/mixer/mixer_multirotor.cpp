@@ -90,8 +90,8 @@ MultirotorMixer::MultirotorMixer(ControlCallback control_cb,
 	_yaw_scale(yaw_scale),
 	_idle_speed(-1.0f + idle_speed * 2.0f),	/* shift to output range here to avoid runtime calculation */
 	_limits_pub(),
-	_rotor_count(_config_rotor_count[(MultirotorGeometryUnderlyingType)geometry]),
-	_rotors(_config_index[(MultirotorGeometryUnderlyingType)geometry])
+	_rotors(_config_index[(MultirotorGeometryUnderlyingType)geometry]),
+	_allocation(Allocation::CLIP)
 {
 }
 
@@ -135,6 +135,22 @@ MultirotorMixer::from_text(Mixer::ControlCallback control_cb, uintptr_t cb_handl
 		return nullptr;
 	}
 
+	/* optional allocation mode, only on the same line */
+	int allocation = (int)Allocation::CLIP;
+
+	while (used < (int)buflen && (buf[used] == ' ' || buf[used] == '\t')) {
+		used++;
+	}
+
+	if (used < (int)buflen && buf[used] >= '0' && buf[used] <= '9') {
+		allocation = buf[used] - '0';
+
+		if (allocation > (int)Allocation::SEARCH) {
+			debug("unknown allocation %d", allocation);
+			return nullptr;
+		}
+	}
+
 	buf = skipline(buf, buflen);
 
 	if (buf == nullptr) {
@@ -199,18 +215,53 @@ MultirotorMixer::from_text(Mixer::ControlCallback control_cb, uintptr_t cb_handl
 
 	debug("adding multirotor mixer '%s'", geomname);
 
-	return new MultirotorMixer(
-		       control_cb,
-		       cb_handle,
-		       geometry,
-		       s[0] / 10000.0f,
-		       s[1] / 10000.0f,
-		       s[2] / 10000.0f,
-		       s[3] / 10000.0f);
+	MultirotorMixer *mixer = new MultirotorMixer(
+		control_cb,
+		cb_handle,
+		geometry,
+		scaler_value(s[0]),
+		scaler_value(s[1]),
+		scaler_value(s[2]),
+		scaler_value(s[3]));
+
+	if (mixer != nullptr) {
+		mixer->set_allocation((Allocation)allocation);
+	}
+
+	return mixer;
 }
 
 unsigned
 MultirotorMixer::mix(float *outputs, unsigned space, uint16_t *status_reg)
+{
+	float		roll    = constrain(get_control(0, 0) * _roll_scale, -1.0f, 1.0f);
+	float		pitch   = constrain(get_control(0, 1) * _pitch_scale, -1.0f, 1.0f);
+	float		yaw     = constrain(get_control(0, 2) * _yaw_scale, -1.0f, 1.0f);
+	float		thrust  = constrain(get_control(0, 3), 0.0f, 1.0f);
+
+	return mix_rotors(roll, pitch, yaw, thrust, outputs, status_reg);
+}
+
+unsigned
+MultirotorMixer::mix_batch(const float *controls, unsigned count, float *outputs, uint16_t *status_reg)
+{
+	for (unsigned i = 0; i < count; i++) {
+		const float *control = &controls[i * 4];
+
+		mix_rotors(constrain(control[0] * _roll_scale, -1.0f, 1.0f),
+			   constrain(control[1] * _pitch_scale, -1.0f, 1.0f),
+			   constrain(control[2] * _yaw_scale, -1.0f, 1.0f),
+			   constrain(control[3], 0.0f, 1.0f),
+			   &outputs[i * _rotors.rotor_count],
+			   (status_reg != nullptr) ? &status_reg[i] : nullptr);
+	}
+
+	return _rotors.rotor_count;
+}
+
+unsigned
+MultirotorMixer::mix_rotors(float roll, float pitch, float yaw, float thrust, float *outputs,
+			    uint16_t *status_reg) const
 {
 	/* Summary of mixing strategy:
 	1) mix roll, pitch and thrust without yaw.
@@ -221,12 +272,20 @@ MultirotorMixer::mix(float *outputs, unsigned space, uint16_t *status_reg)
 		on both sides.
 	3) mix in yaw and scale if it leads to limit violation.
 	4) scale all outputs to range [idle_speed,1]
+
+	The scales are walked as rows, and the passes without data dependencies between
+	rotors use selects instead of branches, so they vectorise. The roll and pitch mix
+	of pass 1 is kept and reused by the later passes, and the yaw limiting only runs
+	if yaw saturates a rotor.
 	*/
 
-	float		roll    = constrain(get_control(0, 0) * _roll_scale, -1.0f, 1.0f);
-	float		pitch   = constrain(get_control(0, 1) * _pitch_scale, -1.0f, 1.0f);
-	float		yaw     = constrain(get_control(0, 2) * _yaw_scale, -1.0f, 1.0f);
-	float		thrust  = constrain(get_control(0, 3), 0.0f, 1.0f);
+	const unsigned	rotor_count = _rotors.rotor_count;
+	const float	*roll_scale = _rotors.roll_scale;
+	const float	*pitch_scale = _rotors.pitch_scale;
+	const float	*yaw_scale = _rotors.yaw_scale;
+	const float	*out_scale = _rotors.out_scale;
+	const float	idle_speed = _idle_speed;
+	float		rp[MULTIROTOR_MIXER_MAX_ROTORS];
 	float		min_out = 1.0f;
 	float		max_out = 0.0f;
 
@@ -240,23 +299,15 @@ MultirotorMixer::mix(float *outputs, unsigned space, uint16_t *status_reg)
 	float thrust_decrease_factor = 0.6f;
 
 	/* perform initial mix pass yielding unbounded outputs, ignore yaw */
-	for (unsigned i = 0; i < _rotor_count; i++) {
-		float out = roll * _rotors[i].roll_scale +
-			    pitch * _rotors[i].pitch_scale +
-			    thrust;
-
-		out *= _rotors[i].out_scale;
+	for (unsigned i = 0; i < rotor_count; i++) {
+		float mix = roll * roll_scale[i] + pitch * pitch_scale[i];
+		float out = (mix + thrust) * out_scale[i];
 
 		/* calculate min and max output values */
-		if (out < min_out) {
-			min_out = out;
-		}
-
-		if (out > max_out) {
-			max_out = out;
-		}
+		min_out = (out < min_out) ? out : min_out;
+		max_out = (out > max_out) ? out : max_out;
 
-		outputs[i] = out;
+		rp[i] = mix;
 	}
 
 	float boost = 0.0f;				// value added to demanded thrust (can also be negative)
@@ -313,59 +364,139 @@ MultirotorMixer::mix(float *outputs, unsigned space, uint16_t *status_reg)
 		}
 	}
 
-	// mix again but now with thrust boost, scale roll/pitch and also add yaw
-	for (unsigned i = 0; i < _rotor_count; i++) {
-		float out = (roll * _rotors[i].roll_scale +
-			     pitch * _rotors[i].pitch_scale) * roll_pitch_scale +
-			    yaw * _rotors[i].yaw_scale +
-			    thrust + boost;
+	/* scale roll/pitch, add thrust boost and yaw, and check whether yaw saturates any rotor */
+	bool yaw_saturated = false;
 
-		out *= _rotors[i].out_scale;
+	for (unsigned i = 0; i < rotor_count; i++) {
+		rp[i] *= roll_pitch_scale;
 
-		// scale yaw if it violates limits. inform about yaw limit reached
-		if (out < 0.0f) {
-			if (fabsf(_rotors[i].yaw_scale) <= FLT_EPSILON) {
-				yaw = 0.0f;
+		float out = (rp[i] + yaw * yaw_scale[i] + thrust + boost) * out_scale[i];
 
-			} else {
-				yaw = -((roll * _rotors[i].roll_scale + pitch * _rotors[i].pitch_scale) *
-					roll_pitch_scale + thrust + boost) / _rotors[i].yaw_scale;
-			}
+		yaw_saturated |= (out < 0.0f) | (out > 1.0f);
+	}
+
+	if (yaw_saturated) {
+		if (status_reg != NULL) {
+			(*status_reg) |= PX4IO_P_STATUS_MIXER_YAW_LIMIT;
+		}
 
-			if (status_reg != NULL) {
-				(*status_reg) |= PX4IO_P_STATUS_MIXER_YAW_LIMIT;
+		if (_allocation == Allocation::SEARCH) {
+			thrust += boost;
+			boost = 0.0f;
+			search_allocation(rp, yaw, thrust);
+
+		} else {
+			/* scale yaw rotor by rotor, each limit depends on the previous ones */
+			for (unsigned i = 0; i < rotor_count; i++) {
+				float out = (rp[i] + yaw * yaw_scale[i] + thrust + boost) * out_scale[i];
+
+				if (out < 0.0f) {
+					if (fabsf(yaw_scale[i]) <= FLT_EPSILON) {
+						yaw = 0.0f;
+
+					} else {
+						yaw = -(rp[i] + thrust + boost) / yaw_scale[i];
+					}
+
+				} else if (out > 1.0f) {
+					// allow to reduce thrust to get some yaw response
+					float thrust_reduction = fminf(0.15f, out - 1.0f);
+					thrust -= thrust_reduction;
+
+					if (fabsf(yaw_scale[i]) <= FLT_EPSILON) {
+						yaw = 0.0f;
+
+					} else {
+						yaw = (1.0f - (rp[i] + thrust + boost)) / yaw_scale[i];
+					}
+				}
 			}
+		}
+	}
 
-		} else if (out > 1.0f) {
-			// allow to reduce thrust to get some yaw response
-			float thrust_reduction = fminf(0.15f, out - 1.0f);
-			thrust -= thrust_reduction;
+	/* add yaw and scale outputs to range idle_speed...1 */
+	for (unsigned i = 0; i < rotor_count; i++) {
+		float out = idle_speed + ((rp[i] + yaw * yaw_scale[i] + thrust + boost) * (1.0f - idle_speed));
 
-			if (fabsf(_rotors[i].yaw_scale) <= FLT_EPSILON) {
-				yaw = 0.0f;
+		out = (out < idle_speed) ? idle_speed : out;
+		outputs[i] = (out > 1.0f) ? 1.0f : out;
+	}
 
-			} else {
-				yaw = (1.0f - ((roll * _rotors[i].roll_scale + pitch * _rotors[i].pitch_scale) *
-					       roll_pitch_scale + thrust + boost)) / _rotors[i].yaw_scale;
-			}
+	return rotor_count;
+}
 
-			if (status_reg != NULL) {
-				(*status_reg) |= PX4IO_P_STATUS_MIXER_YAW_LIMIT;
-			}
+void
+MultirotorMixer::search_allocation(const float *rp, float &yaw, float &thrust) const
+{
+	/* thrust may move this much from the demand to make room for yaw */
+	const float thrust_margin = 0.15f;
+	const unsigned iterations = 12;
+
+	float thrust_min;
+	float thrust_max;
+
+	/* full yaw, moving thrust within the margin */
+	thrust_range(rp, yaw, thrust, thrust_margin, thrust_min, thrust_max);
+
+	if (thrust_min <= thrust_max) {
+		thrust = constrain(thrust, thrust_min, thrust_max);
+		return;
+	}
+
+	thrust_range(rp, 0.0f, thrust, thrust_margin, thrust_min, thrust_max);
+
+	if (thrust_min > thrust_max) {
+		/* roll and pitch alone do not fit, center them and drop yaw */
+		thrust_range(rp, 0.0f, 0.0f, FLT_MAX, thrust_min, thrust_max);
+		thrust = 0.5f * (thrust_min + thrust_max);
+		yaw = 0.0f;
+		return;
+	}
+
+	/*
+	 * The thrust range shrinks as the yaw fraction grows, so the feasible fractions
+	 * are an interval [0, k_max] that can be bisected.
+	 */
+	float lo = 0.0f;
+	float hi = 1.0f;
+	float lo_thrust_min = thrust_min;
+	float lo_thrust_max = thrust_max;
+
+	for (unsigned i = 0; i < iterations; i++) {
+		float k = 0.5f * (lo + hi);
+
+		thrust_range(rp, k * yaw, thrust, thrust_margin, thrust_min, thrust_max);
+
+		if (thrust_min <= thrust_max) {
+			lo = k;
+			lo_thrust_min = thrust_min;
+			lo_thrust_max = thrust_max;
+
+		} else {
+			hi = k;
 		}
 	}
 
-	/* add yaw and scale outputs to range idle_speed...1 */
-	for (unsigned i = 0; i < _rotor_count; i++) {
-		outputs[i] = (roll * _rotors[i].roll_scale +
-			      pitch * _rotors[i].pitch_scale) * roll_pitch_scale +
-			     yaw * _rotors[i].yaw_scale +
-			     thrust + boost;
+	yaw *= lo;
+	thrust = constrain(thrust, lo_thrust_min, lo_thrust_max);
+}
 
-		outputs[i] = constrain(_idle_speed + (outputs[i] * (1.0f - _idle_speed)), _idle_speed, 1.0f);
+void
+MultirotorMixer::thrust_range(const float *rp, float yaw, float thrust, float margin,
+			      float &thrust_min, float &thrust_max) const
+{
+	const float *yaw_scale = _rotors.yaw_scale;
+	float min_out = rp[0] + yaw * yaw_scale[0];
+	float max_out = min_out;
+
+	for (unsigned i = 1; i < _rotors.rotor_count; i++) {
+		float out = rp[i] + yaw * yaw_scale[i];
+		min_out = (out < min_out) ? out : min_out;
+		max_out = (out > max_out) ? out : max_out;
 	}
 
-	return _rotor_count;
+	thrust_min = fmaxf(-min_out, thrust - margin);
+	thrust_max = fminf(1.0f - max_out, thrust + margin);
 }
 
 void
@@ -99,11 +99,11 @@ SimpleMixer::parse_output_scaler(const char *buf, unsigned &buflen, mixer_scaler
 		return -1;
 	}
 
-	scaler.negative_scale	= s[0] / 10000.0f;
-	scaler.positive_scale	= s[1] / 10000.0f;
-	scaler.offset		= s[2] / 10000.0f;
-	scaler.min_output	= s[3] / 10000.0f;
-	scaler.max_output	= s[4] / 10000.0f;
+	scaler.negative_scale	= scaler_value(s[0]);
+	scaler.positive_scale	= scaler_value(s[1]);
+	scaler.offset		= scaler_value(s[2]);
+	scaler.min_output	= scaler_value(s[3]);
+	scaler.max_output	= scaler_value(s[4]);
 
 	return 0;
 }
@@ -137,11 +137,11 @@ SimpleMixer::parse_control_scaler(const char *buf, unsigned &buflen, mixer_scale
 
 	control_group		= u[0];
 	control_index		= u[1];
-	scaler.negative_scale	= s[0] / 10000.0f;
-	scaler.positive_scale	= s[1] / 10000.0f;
-	scaler.offset		= s[2] / 10000.0f;
-	scaler.min_output	= s[3] / 10000.0f;
-	scaler.max_output	= s[4] / 10000.0f;
+	scaler.negative_scale	= scaler_value(s[0]);
+	scaler.positive_scale	= scaler_value(s[1]);
+	scaler.offset		= scaler_value(s[2]);
+	scaler.min_output	= scaler_value(s[3]);
+	scaler.max_output	= scaler_value(s[4]);
 
 	return 0;
 }
@@ -0,0 +1,95 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mixer_static.h
+ *
+ * Building blocks for mixers compiled in from a mixer definition at build
+ * time, see mixer_static.py.
+ *
+ * A compiled mixer needs no heap, no parsing and no virtual calls, and gives
+ * the same outputs as a MixerGroup loaded from the same definition, bit for
+ * bit: the scalers go through Mixer::scaler_value() and Mixer::scale() like the
+ * parsed ones, and multirotor mixing is done by MultirotorMixer itself.
+ */
+
+#pragma once
+
+#include "mixer.h"
+
+namespace mixer_static
+{
+
+/**
+ * Simple mixer with N control inputs, see SimpleMixer.
+ */
+template<unsigned N>
+struct Simple {
+	mixer_scaler_s		output_scaler;
+	mixer_control_s		controls[N];
+
+	unsigned mix(Mixer::ControlCallback control_cb, uintptr_t cb_handle, float *outputs, unsigned space) const
+	{
+		float sum = 0.0f;
+
+		if (space < 1) {
+			return 0;
+		}
+
+		for (unsigned i = 0; i < N; i++) {
+			float input;
+
+			control_cb(cb_handle, controls[i].control_group, controls[i].control_index, input);
+
+			sum += Mixer::scale(controls[i].scaler, input);
+		}
+
+		*outputs = Mixer::scale(output_scaler, sum);
+		return 1;
+	}
+};
+
+/**
+ * Null mixer, see NullMixer.
+ */
+inline unsigned mix_null(float *outputs, unsigned space)
+{
+	if (space > 0) {
+		*outputs = 0.0f;
+		return 1;
+	}
+
+	return 0;
+}
+
+} // namespace mixer_static
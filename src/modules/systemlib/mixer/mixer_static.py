@@ -0,0 +1,288 @@
+#!/usr/bin/env python
+############################################################################
+#
+#   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in
+#    the documentation and/or other materials provided with the
+#    distribution.
+# 3. Neither the name PX4 nor the names of its contributors may be
+#    used to endorse or promote products derived from this software
+#    without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+# OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+# AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+# ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+############################################################################
+
+#
+# Compile a mixer definition file into a C++ class, see mixer_static.h.
+#
+# The file is read the way the mixer command and MixerGroup::load_from_buf()
+# read it: only lines starting with a capital letter and a colon count, and
+# the mixers are mixed in the order they are defined.
+#
+
+# for python2.7 compatibility
+from __future__ import print_function
+
+import argparse
+import os
+import re
+import sys
+
+# geometry names as accepted by MultirotorMixer::from_text()
+geometries = {
+    "4+": "QUAD_PLUS",
+    "4x": "QUAD_X",
+    "4h": "QUAD_H",
+    "4v": "QUAD_V",
+    "4w": "QUAD_WIDE",
+    "4dc": "QUAD_DEADCAT",
+    "6+": "HEX_PLUS",
+    "6x": "HEX_X",
+    "6c": "HEX_COX",
+    "8+": "OCTA_PLUS",
+    "8x": "OCTA_X",
+    "8c": "OCTA_COX",
+    "2-": "TWIN_ENGINE",
+    "3y": "TRI_Y",
+}
+
+allocations = ["CLIP", "SEARCH"]
+
+
+class MixerError(Exception):
+    pass
+
+
+def read_lines(path):
+    lines = []
+    with open(path) as f:
+        for number, line in enumerate(f, 1):
+            if len(line) >= 2 and line[0].isupper() and line[1] == ':':
+                lines.append((number, line[0], line[2:].split()))
+    return lines
+
+
+def parse_ints(number, fields, count):
+    try:
+        values = [int(field) for field in fields[:count]]
+    except ValueError:
+        raise MixerError("line {}: expected integers".format(number))
+
+    if len(values) != count:
+        raise MixerError("line {}: expected {} values".format(number, count))
+
+    return values
+
+
+def parse(lines):
+    mixers = []
+    pos = 0
+
+    def expect(tag):
+        if pos >= len(lines) or lines[pos][1] != tag:
+            where = lines[pos][0] if pos < len(lines) else "end of file"
+            raise MixerError("line {}: expected {}:".format(where, tag))
+        return lines[pos]
+
+    while pos < len(lines):
+        number, tag, fields = lines[pos]
+        pos += 1
+
+        if tag == 'Z':
+            mixers.append(("null",))
+
+        elif tag == 'M':
+            inputs = parse_ints(number, fields, 1)[0]
+            number, _, fields = expect('O')
+            output = parse_ints(number, fields, 5)
+            pos += 1
+            controls = []
+
+            for i in range(inputs):
+                number, _, fields = expect('S')
+                controls.append(parse_ints(number, fields, 7))
+                pos += 1
+
+            mixers.append(("simple", output, controls))
+
+        elif tag == 'R':
+            if len(fields) < 5 or fields[0] not in geometries:
+                raise MixerError("line {}: unknown multirotor geometry".format(number))
+
+            scales = parse_ints(number, fields[1:], 4)
+            allocation = 0
+
+            if len(fields) > 5 and fields[5][0].isdigit():
+                allocation = int(fields[5][0])
+
+                if allocation >= len(allocations):
+                    raise MixerError("line {}: unknown allocation {}".format(number, allocation))
+
+            mixers.append(("multirotor", geometries[fields[0]], scales, allocation))
+
+        else:
+            raise MixerError("line {}: unexpected {}:".format(number, tag))
+
+    if not mixers:
+        raise MixerError("no mixers defined")
+
+    return mixers
+
+
+def scaler(values):
+    return "{{ {} }}".format(", ".join("Mixer::scaler_value({})".format(v) for v in values))
+
+
+def print_header(name, source, mixers):
+    prefix = "_" + re.sub(r'([a-z0-9])([A-Z])', r'\1_\2', name).lower()
+    has_simple = any(m[0] == "simple" for m in mixers)
+    has_multirotor = any(m[0] == "multirotor" for m in mixers)
+    groups = 0
+
+    print("/*")
+    print("* This file is automatically generated by mixer_static from {} - do not edit.".format(source))
+    print("*/")
+    print("")
+    print("#pragma once")
+    print("")
+    print("#include <systemlib/mixer/mixer_static.h>")
+
+    if has_multirotor:
+        print("#include \"mixer_multirotor.generated.h\"")
+
+    print("")
+
+    if has_simple:
+        print("namespace {")
+
+        for i, mixer in enumerate(mixers):
+            if mixer[0] != "simple":
+                continue
+
+            _, output, controls = mixer
+            print("")
+            print("constexpr mixer_static::Simple<{}> {}_{} = {{".format(len(controls), prefix, i))
+            print("\t{},".format(scaler(output)))
+            print("\t{")
+
+            for control in controls:
+                print("\t\t{{ {}, {}, {} }},".format(control[0], control[1], scaler(control[2:])))
+                groups |= 1 << control[0]
+
+            print("\t}")
+            print("};")
+
+        print("")
+        print("} // anonymous namespace")
+        print("")
+
+    print("class {}".format(name))
+    print("{")
+    print("public:")
+    print("\t/** control groups read by the mixers, see Mixer::groups_required() */")
+
+    for mixer in mixers:
+        if mixer[0] == "multirotor":
+            groups |= 1 << 0
+
+    print("\tstatic constexpr uint32_t groups_required = 0x{:x};".format(groups))
+    print("")
+    print("\t/** mixer definition the class was generated from */")
+    print("\tstatic const char *source() {{ return \"{}\"; }}".format(source))
+    print("")
+    print("\t{}(Mixer::ControlCallback control_cb, uintptr_t cb_handle){}".format(name, " :" if has_simple or has_multirotor else ""))
+
+    inits = []
+
+    if has_simple:
+        inits += ["_control_cb(control_cb)", "_cb_handle(cb_handle)"]
+
+    for i, mixer in enumerate(mixers):
+        if mixer[0] == "multirotor":
+            _, geometry, scales, _ = mixer
+            inits.append("_multirotor_{}(control_cb, cb_handle, MultirotorGeometry::{},\n\t\t\t      {})".format(
+                i, geometry, ", ".join("Mixer::scaler_value({})".format(s) for s in scales)))
+
+    if inits:
+        print("\t\t" + ",\n\t\t".join(inits))
+
+    print("\t{")
+
+    for i, mixer in enumerate(mixers):
+        if mixer[0] == "multirotor" and mixer[3] != 0:
+            print("\t\t_multirotor_{}.set_allocation(MultirotorMixer::Allocation::{});".format(i, allocations[mixer[3]]))
+
+    print("\t}")
+    print("")
+    print("\t/** see MixerGroup::mix() */")
+    print("\tunsigned mix(float *outputs, unsigned space, uint16_t *status_reg)")
+    print("\t{")
+    print("\t\tunsigned index = 0;")
+
+    for i, mixer in enumerate(mixers):
+        print("")
+        print("\t\tif (index < space) {")
+
+        if mixer[0] == "null":
+            print("\t\t\tindex += mixer_static::mix_null(outputs + index, space - index);")
+
+        elif mixer[0] == "simple":
+            print("\t\t\tindex += {}_{}.mix(_control_cb, _cb_handle, outputs + index, space - index);".format(prefix, i))
+
+        else:
+            print("\t\t\tindex += _multirotor_{}.MultirotorMixer::mix(outputs + index, space - index, status_reg);".format(i))
+
+        print("\t\t}")
+
+    print("")
+    print("\t\treturn index;")
+    print("\t}")
+
+    if has_simple or has_multirotor:
+        print("")
+        print("private:")
+
+    if has_simple:
+        print("\tMixer::ControlCallback\t_control_cb;")
+        print("\tuintptr_t\t\t_cb_handle;")
+
+    for i, mixer in enumerate(mixers):
+        if mixer[0] == "multirotor":
+            print("\tMultirotorMixer\t\t_multirotor_{};".format(i))
+
+    print("};")
+    print("")
+
+
+parser = argparse.ArgumentParser(description="Compile a mixer definition file into a C++ class")
+parser.add_argument("--name", default="MixerStatic", help="name of the generated class")
+parser.add_argument("file", help="mixer definition file")
+args = parser.parse_args()
+
+try:
+    mixers = parse(read_lines(args.file))
+except (IOError, MixerError) as e:
+    print("{}: {}".format(args.file, e), file=sys.stderr)
+    sys.exit(1)
+
+print_header(args.name, os.path.basename(args.file), mixers)
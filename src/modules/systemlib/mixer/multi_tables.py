@@ -202,35 +202,32 @@ def printEnum():
 
 def printScaleTables():
     for table in tables:
-        print("const MultirotorMixer::Rotor _config_{}[] = {{".format(variableName(table)))
-        for row in table:
-            angle, yawScale, thrustScale = unpackScales(row)
-            rollScale = rcos(angle + 90)
-            pitchScale = rcos(angle)
-            print("\t{{ {:9f}, {:9f}, {:9f}, {:9f} }},".format(rollScale, pitchScale, yawScale, thrustScale))
+        rows = [unpackScales(list(row)) for row in table]
+        print("const float _config_{}[4][{}] = {{".format(variableName(table), len(rows)))
+        print("\t{{ {} }}, /* roll */".format(", ".join("{:9f}".format(rcos(angle + 90)) for angle, yawScale, thrustScale in rows)))
+        print("\t{{ {} }}, /* pitch */".format(", ".join("{:9f}".format(rcos(angle)) for angle, yawScale, thrustScale in rows)))
+        print("\t{{ {} }}, /* yaw */".format(", ".join("{:9f}".format(yawScale) for angle, yawScale, thrustScale in rows)))
+        print("\t{{ {} }}, /* out */".format(", ".join("{:9f}".format(thrustScale) for angle, yawScale, thrustScale in rows)))
         print("};\n")
 
 def printScaleTablesIndex():
-    print("const MultirotorMixer::Rotor *_config_index[] = {")
+    print("const MultirotorMixer::RotorMatrix _config_index[] = {")
     for table in tables:
-        print("\t&_config_{}[0],".format(variableName(table)))
+        name = variableName(table)
+        print("\t{{ {}, _config_{}[0], _config_{}[1], _config_{}[2], _config_{}[3] }},".format(len(table), name, name, name, name))
     print("};\n")
 
-
-def printScaleTablesCounts():
-    print("const unsigned _config_rotor_count[] = {")
-    for table in tables:
-        print("\t{}, /* {} */".format(len(table), variableName(table)))
-    print("};\n")
+def printMaxRotorCount():
+    print("#define MULTIROTOR_MIXER_MAX_ROTORS {}\n".format(max(len(table) for table in tables)))
 
 
 
 printEnum()
+printMaxRotorCount()
 
 print("namespace {")
 printScaleTables()
 printScaleTablesIndex()
-printScaleTablesCounts()
 
 print("} // anonymous namespace\n")
 print("#endif /* _MIXER_MULTI_TABLES */")
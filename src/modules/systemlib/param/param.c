@@ -53,7 +53,9 @@
 #include <unistd.h>
 #include <systemlib/err.h>
 #include <errno.h>
+#include <limits.h>
 #include <semaphore.h>
+#include <pthread.h>
 
 #include <sys/stat.h>
 
@@ -155,18 +157,59 @@ static void param_set_used_internal(param_t param);
 
 static param_t param_find_internal(const char *name, bool notification);
 
+/**
+ * Readers of modified values do not lock. Writers hold param_mutex and make the
+ * sequence odd while they modify param_values, readers retry if the sequence
+ * was odd or changed during their read. Every completed write bumps the
+ * sequence by two, so half of it is the parameter generation.
+ */
+static pthread_mutex_t param_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t param_values_seq = 0;
+
+/** number of lock-free read attempts before a reader falls back to the lock */
+static const int param_max_read_retries = 3;
+
 /** lock the parameter store */
 static void
 param_lock(void)
 {
-	//do {} while (px4_sem_wait(&param_sem) != 0);
+	pthread_mutex_lock(&param_mutex);
 }
 
 /** unlock the parameter store */
 static void
 param_unlock(void)
 {
-	//px4_sem_post(&param_sem);
+	pthread_mutex_unlock(&param_mutex);
+}
+
+/** start modifying param_values, the store has to be locked */
+static void
+param_write_begin(void)
+{
+	__atomic_store_n(&param_values_seq, param_values_seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/** publish the modified param_values as a new generation */
+static void
+param_write_end(void)
+{
+	__atomic_store_n(&param_values_seq, param_values_seq + 1, __ATOMIC_RELEASE);
+}
+
+static uint32_t
+param_read_begin(void)
+{
+	return __atomic_load_n(&param_values_seq, __ATOMIC_ACQUIRE);
+}
+
+/** @return true if the values read since param_read_begin() might be torn */
+static bool
+param_read_retry(uint32_t seq)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return (seq & 1) || __atomic_load_n(&param_values_seq, __ATOMIC_RELAXED) != seq;
 }
 
 /** assert that the parameter store is locked */
@@ -190,25 +233,46 @@ handle_in_range(param_t param)
 }
 
 /**
- * Compare two modifid parameter structures to determine ordering.
+ * Locate the position of a parameter in the modified values array, which is sorted by parameter.
  *
- * This function is suitable for passing to qsort or bsearch.
+ * @param param			The parameter being searched.
+ * @param index			Set to the position of the parameter, or to the position
+ *				where it has to be inserted if it has not been modified.
+ * @return			The structure holding the modified value, or
+ *				NULL if the parameter has not been modified.
  */
-static int
-param_compare_values(const void *a, const void *b)
+static struct param_wbuf_s *
+param_find_changed_index(param_t param, unsigned *index)
 {
-	struct param_wbuf_s *pa = (struct param_wbuf_s *)a;
-	struct param_wbuf_s *pb = (struct param_wbuf_s *)b;
-
-	if (pa->param < pb->param) {
-		return -1;
+	UT_array *values = __atomic_load_n(&param_values, __ATOMIC_ACQUIRE);
+	unsigned low = 0;
+	unsigned high = 0;
+	struct param_wbuf_s *data = NULL;
+
+	if (values != NULL) {
+		/* the writer publishes a grown array before the length that needs it */
+		high = __atomic_load_n(&values->i, __ATOMIC_ACQUIRE);
+		data = (struct param_wbuf_s *)__atomic_load_n(&values->d, __ATOMIC_ACQUIRE);
 	}
 
-	if (pa->param > pb->param) {
-		return 1;
+	while (low < high) {
+		unsigned mid = (low + high) / 2;
+		struct param_wbuf_s *s = &data[mid];
+
+		if (s->param < param) {
+			low = mid + 1;
+
+		} else if (s->param > param) {
+			high = mid;
+
+		} else {
+			*index = mid;
+			return s;
+		}
 	}
 
-	return 0;
+	*index = low;
+	return NULL;
 }
 
 /**
@@ -221,27 +285,52 @@ param_compare_values(const void *a, const void *b)
 static struct param_wbuf_s *
 param_find_changed(param_t param)
 {
-	struct param_wbuf_s	*s = NULL;
-
 	param_assert_locked();
 
-	if (param_values != NULL) {
-#if 0	/* utarray_find requires bsearch, not available */
-		struct param_wbuf_s key;
-		key.param = param;
-		s = utarray_find(param_values, &key, param_compare_values);
-#else
+	unsigned index;
+	return param_find_changed_index(param, &index);
+}
 
-		while ((s = (struct param_wbuf_s *)utarray_next(param_values, s)) != NULL) {
-			if (s->param == param) {
-				break;
-			}
+/**
+ * Insert a modified value into param_values, which must exist. Readers may
+ * still be using the old array when it has to grow, so it is never freed.
+ * As the array doubles, the arrays left behind are smaller than the current one.
+ *
+ * @return			The inserted structure, or NULL if out of memory.
+ */
+static struct param_wbuf_s *
+param_values_insert(unsigned index, const struct param_wbuf_s *buf)
+{
+	unsigned len = param_values->i;
+
+	if (len + 1 > param_values->n) {
+		unsigned n = param_values->n ? 2 * param_values->n : 32;
+		char *d = malloc(n * sizeof(struct param_wbuf_s));
+
+		if (d == NULL) {
+			return NULL;
 		}
 
-#endif
+		if (len > 0) {
+			memcpy(d, param_values->d, len * sizeof(struct param_wbuf_s));
+		}
+
+		param_values->n = n;
+		__atomic_store_n(&param_values->d, d, __ATOMIC_RELEASE);
 	}
 
-	return s;
+	struct param_wbuf_s *data = (struct param_wbuf_s *)param_values->d;
+	memmove(&data[index + 1], &data[index], (len - index) * sizeof(struct param_wbuf_s));
+	data[index] = *buf;
+	__atomic_store_n(&param_values->i, len + 1, __ATOMIC_RELEASE);
+
+	return &data[index];
+}
+
+uint32_t
+param_generation(void)
+{
+	return __atomic_load_n(&param_values_seq, __ATOMIC_ACQUIRE) / 2;
 }
 
 static void
@@ -267,11 +356,68 @@ param_notify_changes(bool is_saved)
 #endif
 }
 
+/**
+ * Test whether the parameter info table is sorted by name, which the generated
+ * table is. The result is determined once.
+ */
+static bool
+param_info_sorted(void)
+{
+#ifdef _UNIT_TEST
+	/* the unit tests switch between sorted and unsorted tables */
+	int sorted = -1;
+#else
+	static int sorted = -1;
+#endif
+
+	if (sorted < 0) {
+		unsigned count = get_param_info_count();
+
+		sorted = 1;
+
+		for (unsigned i = 1; i < count; i++) {
+			if (strcmp(param_info_base[i - 1].name, param_info_base[i].name) >= 0) {
+				sorted = 0;
+				break;
+			}
+		}
+	}
+
+	return sorted;
+}
+
 param_t
 param_find_internal(const char *name, bool notification)
 {
 	param_t param;
 
+	if (param_info_sorted()) {
+		/* binary search of the known parameters */
+		unsigned low = 0;
+		unsigned high = get_param_info_count();
+
+		while (low < high) {
+			unsigned mid = (low + high) / 2;
+			int cmp = strcmp(name, param_info_base[mid].name);
+
+			if (cmp > 0) {
+				low = mid + 1;
+
+			} else if (cmp < 0) {
+				high = mid;
+
+			} else {
+				if (notification) {
+					param_set_used_internal((param_t)mid);
+				}
+
+				return (param_t)mid;
+			}
+		}
+
+		return PARAM_INVALID;
+	}
+
 	/* perform a linear search of the known parameters */
 
 	for (param = 0; handle_in_range(param); param++) {
@@ -497,20 +643,39 @@ param_get_value_ptr(param_t param)
 int
 param_get(param_t param, void *val)
 {
-	int result = -1;
+	if (val == NULL) {
+		return -1;
+	}
+
+	size_t size = param_size(param);
+
+	for (int retries = 0; retries < param_max_read_retries; retries++) {
+		uint32_t seq = param_read_begin();
+
+		/* a torn read may point to a value that is not allocated yet */
+		const void *v = param_get_value_ptr(param);
+
+		if (v != NULL) {
+			memcpy(val, v, size);
+		}
+
+		if (!param_read_retry(seq)) {
+			return 0;
+		}
+	}
 
+	/* keep writers out instead of retrying forever */
 	param_lock();
 
 	const void *v = param_get_value_ptr(param);
 
-	if (val != NULL) {
-		memcpy(val, v, param_size(param));
-		result = 0;
+	if (v != NULL) {
+		memcpy(val, v, size);
 	}
 
 	param_unlock();
 
-	return result;
+	return 0;
 }
 
 static int
@@ -520,9 +685,12 @@ param_set_internal(param_t param, const void *val, bool mark_saved, bool notify_
 	bool params_changed = false;
 
 	param_lock();
+	param_write_begin();
 
 	if (param_values == NULL) {
-		utarray_new(param_values, &param_icd);
+		UT_array *values;
+		utarray_new(values, &param_icd);
+		__atomic_store_n(&param_values, values, __ATOMIC_RELEASE);
 	}
 
 	if (param_values == NULL) {
@@ -532,7 +700,8 @@ param_set_internal(param_t param, const void *val, bool mark_saved, bool notify_
 
 	if (handle_in_range(param)) {
 
-		struct param_wbuf_s *s = param_find_changed(param);
+		unsigned index;
+		struct param_wbuf_s *s = param_find_changed_index(param, &index);
 
 		if (s == NULL) {
 
@@ -543,12 +712,13 @@ param_set_internal(param_t param, const void *val, bool mark_saved, bool notify_
 				.unsaved = false
 			};
 
-			/* add it to the array and sort */
-			utarray_push_back(param_values, &buf);
-			utarray_sort(param_values, param_compare_values);
+			/* insert it at its sorted position */
+			s = param_values_insert(index, &buf);
 
-			/* find it after sorting */
-			s = param_find_changed(param);
+			if (s == NULL) {
+				debug("failed to allocate modified values array");
+				goto out;
+			}
 		}
 
 		/* update the changed value */
@@ -587,6 +757,7 @@ param_set_internal(param_t param, const void *val, bool mark_saved, bool notify_
 	}
 
 out:
+	param_write_end();
 	param_unlock();
 
 	/*
@@ -656,13 +827,13 @@ void param_set_used_internal(param_t param)
 		(1 << param_index % bits_per_allocation_unit);
 }
 
-int
-param_reset(param_t param)
+/** reset a parameter to its default, the store has to be locked */
+static bool
+param_reset_locked(param_t param, bool *param_found)
 {
 	struct param_wbuf_s *s = NULL;
-	bool param_found = false;
 
-	param_lock();
+	*param_found = false;
 
 	if (handle_in_range(param)) {
 
@@ -672,15 +843,29 @@ param_reset(param_t param)
 		/* if we found one, erase it */
 		if (s != NULL) {
 			int pos = utarray_eltidx(param_values, s);
+			param_write_begin();
 			utarray_erase(param_values, pos, 1);
+			param_write_end();
 		}
 
-		param_found = true;
+		*param_found = true;
 	}
 
+	return s != NULL;
+}
+
+int
+param_reset(param_t param)
+{
+	bool param_found;
+
+	param_lock();
+
+	bool changed = param_reset_locked(param, &param_found);
+
 	param_unlock();
 
-	if (s != NULL) {
+	if (changed) {
 		param_notify_changes(false);
 	}
 
@@ -692,13 +877,13 @@ param_reset_all(void)
 {
 	param_lock();
 
+	/* readers may still access the array, keep it and only drop its contents */
 	if (param_values != NULL) {
-		utarray_free(param_values);
+		param_write_begin();
+		__atomic_store_n(&param_values->i, 0, __ATOMIC_RELEASE);
+		param_write_end();
 	}
 
-	/* mark as reset / deleted */
-	param_values = NULL;
-
 	param_unlock();
 
 	param_notify_changes(false);
@@ -727,7 +912,8 @@ param_reset_excludes(const char *excludes[], int num_excludes)
 		}
 
 		if (!exclude) {
-			param_reset(param);
+			bool param_found;
+			param_reset_locked(param, &param_found);
 		}
 	}
 
@@ -760,24 +946,17 @@ param_get_default_file(void)
 	return (param_user_file != NULL) ? param_user_file : param_default_file;
 }
 
-int
-param_save_default(void)
+static int
+param_save_bson(const char *filename)
 {
-	int res;
-#if !defined(FLASH_BASED_PARAMS)
-	int fd;
-
-	const char *filename = param_get_default_file();
-
-	/* write parameters to temp file */
-	fd = PARAM_OPEN(filename, O_WRONLY | O_CREAT, PX4_O_MODE_666);
+	int fd = PARAM_OPEN(filename, O_WRONLY | O_CREAT, PX4_O_MODE_666);
 
 	if (fd < 0) {
 		warn("failed to open param file: %s", filename);
 		return ERROR;
 	}
 
-	res = 1;
+	int res = 1;
 	int attempts = 5;
 
 	while (res != OK && attempts > 0) {
@@ -790,6 +969,93 @@ param_save_default(void)
 	}
 
 	PARAM_CLOSE(fd);
+
+	return res;
+}
+
+/**
+ * Write the binary parameter image. Regular files are replaced atomically by
+ * renaming a temporary file, devices like the FRAM are written in place.
+ *
+ * @return 0 on success, 1 if the image can not hold all parameters, -1 on error
+ */
+static int
+param_save_image(const char *filename)
+{
+	const char *path = filename;
+#ifndef __PX4_QURT
+	char tmp_path[PATH_MAX];
+	struct stat st;
+
+	if (stat(filename, &st) != 0 || S_ISREG(st.st_mode)) {
+		if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", filename) >= (int)sizeof(tmp_path)) {
+			return -1;
+		}
+
+		path = tmp_path;
+	}
+
+#endif
+
+	int fd = PARAM_OPEN(path, (path == filename) ? O_WRONLY | O_CREAT : O_WRONLY | O_CREAT | O_TRUNC, PX4_O_MODE_666);
+
+	if (fd < 0) {
+		warn("failed to open param file: %s", path);
+		return -1;
+	}
+
+	int res = param_export_image(fd);
+
+	if (res == 0 && path != filename) {
+		res = px4_fsync(fd);
+	}
+
+	PARAM_CLOSE(fd);
+
+#ifndef __PX4_QURT
+
+	if (path != filename) {
+#ifdef __PX4_NUTTX
+
+		/* the NuttX file systems do not replace an existing file, param_load_default() picks up the temporary one */
+		if (res == 0) {
+			(void)unlink(filename);
+		}
+
+#endif
+
+		if (res == 0 && rename(path, filename) != 0) {
+			warn("failed to replace param file: %s", filename);
+			res = -1;
+		}
+
+		if (res != 0) {
+			(void)unlink(path);
+		}
+	}
+
+#endif
+
+	return res;
+}
+
+int
+param_save_default(void)
+{
+	int res;
+#if !defined(FLASH_BASED_PARAMS)
+	const char *filename = param_get_default_file();
+
+	res = param_save_image(filename);
+
+	if (res == 1) {
+		/* structure parameters are only supported by BSON */
+		res = param_save_bson(filename);
+
+	} else if (res != 0) {
+		warnx("failed to write parameters to file: %s", filename);
+	}
+
 #else
 	res = flash_param_save();
 #endif
@@ -806,6 +1072,21 @@ param_load_default(void)
 	warnx("param_load_default\n");
 	int fd_load = PARAM_OPEN(param_get_default_file(), O_RDONLY);
 
+#if defined(__PX4_NUTTX)
+
+	if (fd_load < 0 && errno == ENOENT) {
+		/* a save was interrupted between removing the old file and renaming the new one */
+		char tmp_path[PATH_MAX];
+		snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", param_get_default_file());
+		fd_load = PARAM_OPEN(tmp_path, O_RDONLY);
+
+		if (fd_load < 0) {
+			errno = ENOENT;
+		}
+	}
+
+#endif
+
 	if (fd_load < 0) {
 		/* no parameter file is OK, otherwise this is an error */
 		if (errno != ENOENT) {
@@ -973,6 +1254,252 @@ out:
 	return result;
 }
 
+/*
+ * Binary parameter image, an alternative to BSON that can be written and read
+ * in one go. It holds the modified int32 and float parameters as fixed size
+ * records, sorted by parameter index. The indices are only meaningful for the
+ * parameter table the image was written with, after a firmware update the
+ * records are looked up by name instead.
+ */
+#define PARAM_IMAGE_MAGIC	0x42505850	/* "PXPB", can not be the length of a BSON document */
+#define PARAM_IMAGE_VERSION	2
+#define PARAM_IMAGE_NAME_LEN	16		/* like the MAVLink param_id, not null terminated at full length */
+
+struct param_image_header_s {
+	uint32_t	magic;
+	uint16_t	version;
+	uint16_t	record_size;
+	uint32_t	table_hash;	/**< CRC32 of the names and types of all parameters */
+	uint32_t	count;		/**< number of records following the header */
+	uint32_t	crc;		/**< CRC32 of the records */
+};
+
+struct param_image_record_s {
+	uint16_t	index;
+	uint8_t		type;
+	uint8_t		reserved;
+	union {
+		int32_t	i;
+		float	f;
+	} value;
+	char		name[PARAM_IMAGE_NAME_LEN];
+};
+
+#if defined (CONFIG_ARCH_BOARD_PX4FMU_V4)
+/* the bus lock disables interrupts, so only write a little at a time */
+#define PARAM_IMAGE_WRITE_CHUNK	256
+#else
+#define PARAM_IMAGE_WRITE_CHUNK	0
+#endif
+
+/** @return a hash of the parameter table, which changes whenever a parameter index would */
+static uint32_t
+param_table_hash(void)
+{
+	static uint32_t table_hash = 0;
+	static bool table_hash_valid = false;
+
+	if (!table_hash_valid) {
+		uint32_t hash = 0;
+
+		for (param_t param = 0; handle_in_range(param); param++) {
+			const char *name = param_name(param);
+			uint8_t type = param_type(param);
+			hash = crc32part((const uint8_t *)name, strlen(name) + 1, hash);
+			hash = crc32part(&type, sizeof(type), hash);
+		}
+
+		table_hash = hash;
+		table_hash_valid = true;
+	}
+
+	return table_hash;
+}
+
+static int
+param_image_write(int fd, const uint8_t *buf, size_t size)
+{
+	size_t chunk = (PARAM_IMAGE_WRITE_CHUNK > 0) ? PARAM_IMAGE_WRITE_CHUNK : size;
+
+	for (size_t offset = 0; offset < size; offset += chunk) {
+		size_t len = (size - offset < chunk) ? size - offset : chunk;
+
+		param_bus_lock(true);
+		ssize_t written = write(fd, buf + offset, len);
+		param_bus_lock(false);
+
+		if (written != (ssize_t)len) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int
+param_export_image(int fd)
+{
+	int result = -1;
+
+	param_lock();
+
+	unsigned count = (param_values != NULL) ? utarray_len(param_values) : 0;
+	size_t size = sizeof(struct param_image_header_s) + count * sizeof(struct param_image_record_s);
+	uint8_t *buf = malloc(size);
+
+	if (buf == NULL) {
+		param_unlock();
+		debug("failed to allocate parameter image");
+		return -1;
+	}
+
+	struct param_image_header_s *header = (struct param_image_header_s *)buf;
+	struct param_image_record_s *records = (struct param_image_record_s *)(header + 1);
+
+	/* param_values is sorted by index, so are the records */
+	for (unsigned i = 0; i < count; i++) {
+		struct param_wbuf_s *s = (struct param_wbuf_s *)utarray_eltptr(param_values, i);
+		struct param_image_record_s *record = &records[i];
+
+		switch (param_type(s->param)) {
+		case PARAM_TYPE_INT32:
+			record->value.i = s->val.i;
+			break;
+
+		case PARAM_TYPE_FLOAT:
+			record->value.f = s->val.f;
+			break;
+
+		default:
+			/* structures do not fit, keep unsaved and let the caller use BSON */
+			result = 1;
+			goto out;
+		}
+
+		record->index = s->param;
+		record->type = param_type(s->param);
+		record->reserved = 0;
+		strncpy(record->name, param_name(s->param), sizeof(record->name));
+	}
+
+	header->magic = PARAM_IMAGE_MAGIC;
+	header->version = PARAM_IMAGE_VERSION;
+	header->record_size = sizeof(struct param_image_record_s);
+	header->table_hash = param_table_hash();
+	header->count = count;
+	header->crc = crc32part((const uint8_t *)records, count * sizeof(struct param_image_record_s), 0);
+
+	for (unsigned i = 0; i < count; i++) {
+		((struct param_wbuf_s *)utarray_eltptr(param_values, i))->unsaved = false;
+	}
+
+	result = 0;
+
+out:
+	param_unlock();
+
+	if (result == 0) {
+		result = param_image_write(fd, buf, size);
+	}
+
+	free(buf);
+
+	return result;
+}
+
+/**
+ * Find the parameter a record from an image of another parameter table refers to.
+ */
+static param_t
+param_image_find(const struct param_image_record_s *record)
+{
+	char name[PARAM_IMAGE_NAME_LEN + 1];
+
+	memcpy(name, record->name, PARAM_IMAGE_NAME_LEN);
+	name[PARAM_IMAGE_NAME_LEN] = '\0';
+
+	return param_find_no_notification(name);
+}
+
+static int
+param_import_image(int fd, const struct param_image_header_s *header, bool mark_saved)
+{
+	if (header->version != PARAM_IMAGE_VERSION || header->record_size != sizeof(struct param_image_record_s)
+	    || header->count > UINT16_MAX) {
+		debug("unsupported parameter image");
+		return -1;
+	}
+
+	size_t size = header->count * sizeof(struct param_image_record_s);
+	struct param_image_record_s *records = malloc(size > 0 ? size : 1);
+
+	if (records == NULL) {
+		debug("failed to allocate parameter image");
+		return -1;
+	}
+
+	int result = -1;
+
+	param_bus_lock(true);
+	ssize_t nread = read(fd, records, size);
+	param_bus_lock(false);
+
+	if (nread != (ssize_t)size
+	    || crc32part((const uint8_t *)records, size, 0) != header->crc) {
+		debug("corrupt parameter image");
+		goto out;
+	}
+
+	bool same_table = (header->table_hash == param_table_hash());
+
+	/* validate everything before changing any parameter */
+	for (unsigned i = 0; i < header->count; i++) {
+		struct param_image_record_s *record = &records[i];
+		param_t param = same_table ? record->index : param_image_find(record);
+
+		if (param == PARAM_INVALID || !handle_in_range(param) || param_type(param) != record->type) {
+			if (same_table) {
+				debug("invalid record for index %u", record->index);
+				goto out;
+			}
+
+			/* like BSON, ignore parameters this firmware does not know */
+			record->index = UINT16_MAX;
+			continue;
+		}
+
+		record->index = param;
+	}
+
+	bool changed = false;
+
+	for (unsigned i = 0; i < header->count; i++) {
+		const struct param_image_record_s *record = &records[i];
+
+		if (record->index == UINT16_MAX) {
+			continue;
+		}
+
+		if (param_set_internal(record->index, &record->value, mark_saved, false, false)) {
+			debug("error setting value for index %u", record->index);
+			goto out;
+		}
+
+		changed = true;
+	}
+
+	result = 0;
+
+	if (changed) {
+		param_notify_changes(false);
+	}
+
+out:
+	free(records);
+
+	return result;
+}
+
 struct param_import_state {
 	bool mark_saved;
 };
@@ -1091,6 +1618,21 @@ param_import_internal(int fd, bool mark_saved)
 	struct bson_decoder_s decoder;
 	int result = -1;
 	struct param_import_state state;
+	struct param_image_header_s header;
+
+	/* binary images are read in one go, anything else should be BSON */
+	param_bus_lock(true);
+	ssize_t nread = read(fd, &header, sizeof(header));
+	param_bus_lock(false);
+
+	if (nread == sizeof(header) && header.magic == PARAM_IMAGE_MAGIC) {
+		return param_import_image(fd, &header, mark_saved);
+	}
+
+	if (lseek(fd, 0, SEEK_SET) != 0) {
+		debug("failed to rewind parameter file");
+		return -1;
+	}
 
 	param_bus_lock(true);
 
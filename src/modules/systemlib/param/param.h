@@ -199,6 +199,8 @@ __EXPORT size_t		param_size(param_t param);
 /**
  * Copy the value of a parameter.
  *
+ * Only waits for the parameter lock if writers keep modifying values during the read.
+ *
  * @param param		A handle returned by param_find or passed by param_foreach.
  * @param val		Where to return the value, assumed to point to suitable storage for the parameter type.
  *			For structures, a bitwise copy of the structure is performed to this address.
@@ -206,6 +208,17 @@ __EXPORT size_t		param_size(param_t param);
  */
 __EXPORT int		param_get(param_t param, void *val);
 
+/**
+ * Get the generation of the parameter values.
+ *
+ * The generation changes whenever a parameter is set or reset. Callers caching
+ * parameter values only need to param_get() them again if it differs from the
+ * generation they last read.
+ *
+ * @return		The current generation.
+ */
+__EXPORT uint32_t	param_generation(void);
+
 /**
  * Set the value of a parameter.
  *
@@ -275,10 +288,25 @@ __EXPORT void		param_reset_excludes(const char *excludes[], int num_excludes);
  */
 __EXPORT int		param_export(int fd, bool only_unsaved);
 
+/**
+ * Export changed parameters to a file as a binary image.
+ *
+ * The image is a header and one fixed size record per changed parameter,
+ * written with a single write. It is what param_save_default() uses, and
+ * param_import() and param_load() read it as well as BSON.
+ *
+ * @param fd		File descriptor to export to.
+ * @return		Zero on success, 1 if the image is not supported, because a changed
+ *			structure parameter does not fit into it or the parameter storage has
+ *			no image support (nothing is written then, use BSON), -1 on failure.
+ */
+__EXPORT int		param_export_image(int fd);
+
 /**
  * Import parameters from a file, discarding any unrecognized parameters.
  *
  * This function merges the imported parameters with the current parameter set.
+ * The file can be BSON or a binary image written by param_export_image().
  *
  * @param fd		File descriptor to import from.  (Currently expected to be a file.)
  * @return		Zero on success, nonzero if an error occurred during import.
@@ -290,7 +318,7 @@ __EXPORT int		param_import(int fd);
  * Load parameters from a file.
  *
  * This function resets all parameters to their default values, then loads new
- * values from a file.
+ * values from a BSON file or binary image.
  *
  * @param fd		File descriptor to import from.  (Currently expected to be a file.)
  * @return		Zero on success, nonzero if an error occurred during import.
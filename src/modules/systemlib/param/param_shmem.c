@@ -161,6 +161,9 @@ const UT_icd	param_icd = {sizeof(struct param_wbuf_s), NULL, NULL, NULL};
 /** parameter update topic handle */
 static orb_advert_t param_topic = NULL;
 
+/** incremented whenever param_values is modified */
+static uint32_t param_values_generation = 0;
+
 static void param_set_used_internal(param_t param);
 
 static param_t param_find_internal(const char *name, bool notification);
@@ -200,25 +203,38 @@ handle_in_range(param_t param)
 }
 
 /**
- * Compare two modifid parameter structures to determine ordering.
+ * Locate the position of a parameter in the modified values array, which is sorted by parameter.
  *
- * This function is suitable for passing to qsort or bsearch.
+ * @param param			The parameter being searched.
+ * @param index			Set to the position of the parameter, or to the position
+ *				where it has to be inserted if it has not been modified.
+ * @return			The structure holding the modified value, or
+ *				NULL if the parameter has not been modified.
  */
-static int
-param_compare_values(const void *a, const void *b)
+static struct param_wbuf_s *
+param_find_changed_index(param_t param, unsigned *index)
 {
-	struct param_wbuf_s *pa = (struct param_wbuf_s *)a;
-	struct param_wbuf_s *pb = (struct param_wbuf_s *)b;
+	unsigned low = 0;
+	unsigned high = (param_values != NULL) ? utarray_len(param_values) : 0;
 
-	if (pa->param < pb->param) {
-		return -1;
-	}
+	while (low < high) {
+		unsigned mid = (low + high) / 2;
+		struct param_wbuf_s *s = (struct param_wbuf_s *)_utarray_eltptr(param_values, mid);
 
-	if (pa->param > pb->param) {
-		return 1;
+		if (s->param < param) {
+			low = mid + 1;
+
+		} else if (s->param > param) {
+			high = mid;
+
+		} else {
+			*index = mid;
+			return s;
+		}
 	}
 
-	return 0;
+	*index = low;
+	return NULL;
 }
 
 /**
@@ -231,19 +247,16 @@ param_compare_values(const void *a, const void *b)
 struct param_wbuf_s *
 param_find_changed(param_t param)
 {
-	struct param_wbuf_s	*s = NULL;
-
 	param_assert_locked();
 
-	if (param_values != NULL) {
-		while ((s = (struct param_wbuf_s *)utarray_next(param_values, s)) != NULL) {
-			if (s->param == param) {
-				break;
-			}
-		}
-	}
+	unsigned index;
+	return param_find_changed_index(param, &index);
+}
 
-	return s;
+uint32_t
+param_generation(void)
+{
+	return __atomic_load_n(&param_values_generation, __ATOMIC_ACQUIRE);
 }
 
 static void
@@ -263,11 +276,63 @@ param_notify_changes(bool is_saved)
 	}
 }
 
+/**
+ * Test whether the parameter info table is sorted by name, which the generated
+ * table is. The result is determined once.
+ */
+static bool
+param_info_sorted(void)
+{
+	static int sorted = -1;
+
+	if (sorted < 0) {
+		unsigned count = get_param_info_count();
+
+		sorted = 1;
+
+		for (unsigned i = 1; i < count; i++) {
+			if (strcmp(param_info_base[i - 1].name, param_info_base[i].name) >= 0) {
+				sorted = 0;
+				break;
+			}
+		}
+	}
+
+	return sorted;
+}
+
 param_t
 param_find_internal(const char *name, bool notification)
 {
 	param_t param;
 
+	if (param_info_sorted()) {
+		/* binary search of the known parameters */
+		unsigned low = 0;
+		unsigned high = get_param_info_count();
+
+		while (low < high) {
+			unsigned mid = (low + high) / 2;
+			int cmp = strcmp(name, param_info_base[mid].name);
+
+			if (cmp > 0) {
+				low = mid + 1;
+
+			} else if (cmp < 0) {
+				high = mid;
+
+			} else {
+				if (notification) {
+					param_set_used_internal((param_t)mid);
+				}
+
+				return (param_t)mid;
+			}
+		}
+
+		return PARAM_INVALID;
+	}
+
 	/* perform a linear search of the known parameters */
 	for (param = 0; handle_in_range(param); param++) {
 		if (!strcmp(param_info_base[param].name, name)) {
@@ -580,7 +645,8 @@ param_set_internal(param_t param, const void *val, bool mark_saved, bool notify_
 
 	if (handle_in_range(param)) {
 
-		struct param_wbuf_s *s = param_find_changed(param);
+		unsigned index;
+		struct param_wbuf_s *s = param_find_changed_index(param, &index);
 
 		if (s == NULL) {
 
@@ -591,12 +657,9 @@ param_set_internal(param_t param, const void *val, bool mark_saved, bool notify_
 				.unsaved = false
 			};
 
-			/* add it to the array and sort */
-			utarray_push_back(param_values, &buf);
-			utarray_sort(param_values, param_compare_values);
-
-			/* find it after sorting */
-			s = param_find_changed(param);
+			/* insert it at its sorted position */
+			utarray_insert(param_values, &buf, index);
+			s = (struct param_wbuf_s *)utarray_eltptr(param_values, index);
 		}
 
 		/* update the changed value */
@@ -633,6 +696,7 @@ param_set_internal(param_t param, const void *val, bool mark_saved, bool notify_
 	}
 
 out:
+	__atomic_add_fetch(&param_values_generation, 1, __ATOMIC_RELEASE);
 	param_unlock();
 
 	/*
@@ -737,6 +801,7 @@ param_reset(param_t param)
 		param_found = true;
 	}
 
+	__atomic_add_fetch(&param_values_generation, 1, __ATOMIC_RELEASE);
 	param_unlock();
 
 	if (s != NULL) {
@@ -758,6 +823,7 @@ param_reset_all(void)
 	/* mark as reset / deleted */
 	param_values = NULL;
 
+	__atomic_add_fetch(&param_values_generation, 1, __ATOMIC_RELEASE);
 	param_unlock();
 
 	param_notify_changes(false);
@@ -1030,6 +1096,13 @@ out:
 	return result;
 }
 
+int
+param_export_image(int fd)
+{
+	/* the binary image is not supported with shared memory parameters, use BSON */
+	return 1;
+}
+
 struct param_import_state {
 	bool mark_saved;
 };
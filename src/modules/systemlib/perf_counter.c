@@ -43,8 +43,15 @@
 #include <sys/queue.h>
 #include <drivers/drv_hrt.h>
 #include <math.h>
+#include <px4_trace.h>
 #include "perf_counter.h"
 
+#if defined(__PX4_POSIX) && !defined(__PX4_QURT)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
 #ifdef __PX4_QURT
 // There is presumably no dprintf on QURT. Therefore use the usual output to mini-dm.
 #define dprintf(_fd, _text, ...) ((_fd) == 1 ? PX4_INFO((_text), ##__VA_ARGS__) : (void)(_fd))
@@ -97,6 +104,30 @@ struct perf_ctr_interval {
 	float			M2;
 };
 
+/*
+ * PC_HISTOGRAM buckets are log-linear: values below HIST_SUB_BUCKETS us get one
+ * bucket each, every power of two above is split into HIST_SUB_BUCKETS buckets.
+ * This bounds the error of a percentile to 1/HIST_SUB_BUCKETS of its value.
+ */
+#define HIST_SUB_BITS		3
+#define HIST_SUB_BUCKETS	(1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS		24	/**< everything from 2^24 us (16.7 s) on ends up in the last bucket */
+#define HIST_BUCKETS		((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+/**
+ * PC_HISTOGRAM counter.
+ *
+ * perf_end() only does atomic 32 bit updates, the event count is the sum of the buckets.
+ */
+struct perf_ctr_histogram {
+	struct perf_ctr_header	hdr;
+	uint64_t		time_start;
+	uint32_t		event_overruns;
+	uint32_t		time_least;
+	uint32_t		time_most;
+	uint32_t		buckets[HIST_BUCKETS];
+};
+
 /**
  * List of all known counters.
  */
@@ -122,6 +153,15 @@ perf_alloc(enum perf_counter_type type, const char *name)
 
 		break;
 
+	case PC_HISTOGRAM:
+		ctr = (perf_counter_t)calloc(sizeof(struct perf_ctr_histogram), 1);
+
+		if (ctr != NULL) {
+			((struct perf_ctr_histogram *)ctr)->time_least = UINT32_MAX;
+		}
+
+		break;
+
 	default:
 		break;
 	}
@@ -170,6 +210,143 @@ perf_free(perf_counter_t handle)
 	free(handle);
 }
 
+static unsigned
+hist_bucket(uint32_t value)
+{
+	if (value < HIST_SUB_BUCKETS) {
+		return value;
+	}
+
+	if (value >= (1u << HIST_MAX_BITS)) {
+		return HIST_BUCKETS - 1;
+	}
+
+	unsigned msb = 31 - __builtin_clz(value);
+	unsigned shift = msb - HIST_SUB_BITS;
+
+	return (shift + 1) * HIST_SUB_BUCKETS + (value >> shift) - HIST_SUB_BUCKETS;
+}
+
+/** @return the smallest value falling into a bucket */
+static uint32_t
+hist_bucket_low(unsigned bucket)
+{
+	if (bucket < HIST_SUB_BUCKETS) {
+		return bucket;
+	}
+
+	unsigned shift = bucket / HIST_SUB_BUCKETS - 1;
+
+	return (uint32_t)(HIST_SUB_BUCKETS + bucket % HIST_SUB_BUCKETS) << shift;
+}
+
+static uint32_t
+hist_bucket_high(unsigned bucket)
+{
+	if (bucket == HIST_BUCKETS - 1) {
+		return UINT32_MAX;
+	}
+
+	return hist_bucket_low(bucket + 1) - 1;
+}
+
+static void
+hist_add(struct perf_ctr_histogram *pch, int64_t elapsed)
+{
+	if (elapsed < 0) {
+		__atomic_fetch_add(&pch->event_overruns, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	uint32_t value = (elapsed > UINT32_MAX) ? UINT32_MAX : (uint32_t)elapsed;
+
+	__atomic_fetch_add(&pch->buckets[hist_bucket(value)], 1, __ATOMIC_RELAXED);
+
+	uint32_t least = __atomic_load_n(&pch->time_least, __ATOMIC_RELAXED);
+
+	while (value < least
+	       && !__atomic_compare_exchange_n(&pch->time_least, &least, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	}
+
+	uint32_t most = __atomic_load_n(&pch->time_most, __ATOMIC_RELAXED);
+
+	while (value > most
+	       && !__atomic_compare_exchange_n(&pch->time_most, &most, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	}
+}
+
+/** @return the upper bound of the bucket containing the percentile, at most max */
+static uint32_t
+hist_percentile(struct perf_ctr_histogram *pch, uint64_t count, unsigned per_mille, uint32_t max)
+{
+	/* the rank of the percentile, rounded up */
+	uint64_t rank = (count * per_mille + 999) / 1000;
+	uint64_t cumulative = 0;
+	unsigned bucket = 0;
+
+	while (bucket < HIST_BUCKETS - 1) {
+		cumulative += __atomic_load_n(&pch->buckets[bucket], __ATOMIC_RELAXED);
+
+		if (cumulative >= rank) {
+			break;
+		}
+
+		bucket++;
+	}
+
+	uint32_t value = hist_bucket_high(bucket);
+
+	return (value < max) ? value : max;
+}
+
+/**
+ * Summarize the buckets. The mean and standard deviation are estimated from
+ * the bucket centers. perf_end() may run concurrently, so the percentiles can
+ * be off by the events added meanwhile.
+ */
+static uint64_t
+hist_summary(struct perf_ctr_histogram *pch, struct perf_counter_snapshot_s *snapshot)
+{
+	uint64_t count = 0;
+	double sum = 0.0;
+	double sum_sq = 0.0;
+
+	for (unsigned i = 0; i < HIST_BUCKETS; i++) {
+		uint32_t events = __atomic_load_n(&pch->buckets[i], __ATOMIC_RELAXED);
+
+		if (events > 0) {
+			/* the last bucket is open ended */
+			double center = (i == HIST_BUCKETS - 1) ? hist_bucket_low(i)
+					: (hist_bucket_low(i) + (double)hist_bucket_high(i)) / 2.0;
+
+			count += events;
+			sum += center * events;
+			sum_sq += center * center * events;
+		}
+	}
+
+	snapshot->event_count = count;
+	snapshot->overruns = __atomic_load_n(&pch->event_overruns, __ATOMIC_RELAXED);
+	snapshot->max = __atomic_load_n(&pch->time_most, __ATOMIC_RELAXED);
+	snapshot->min = (count > 0) ? __atomic_load_n(&pch->time_least, __ATOMIC_RELAXED) : 0;
+
+	if (count == 0) {
+		return 0;
+	}
+
+	double mean = sum / count;
+	double variance = sum_sq / count - mean * mean;
+	snapshot->mean = (uint32_t)mean;
+	snapshot->rms = (variance > 0.0) ? (uint32_t)sqrt(variance) : 0;
+
+	snapshot->p50 = hist_percentile(pch, count, 500, snapshot->max);
+	snapshot->p90 = hist_percentile(pch, count, 900, snapshot->max);
+	snapshot->p99 = hist_percentile(pch, count, 990, snapshot->max);
+	snapshot->p999 = hist_percentile(pch, count, 999, snapshot->max);
+
+	return count;
+}
+
 void
 perf_count(perf_counter_t handle)
 {
@@ -238,9 +415,15 @@ perf_begin(perf_counter_t handle)
 
 	switch (handle->type) {
 	case PC_ELAPSED:
+		PX4_TRACE(PX4_TRACE_SPAN_BEGIN, handle->name, handle);
 		((struct perf_ctr_elapsed *)handle)->time_start = hrt_absolute_time();
 		break;
 
+	case PC_HISTOGRAM:
+		PX4_TRACE(PX4_TRACE_SPAN_BEGIN, handle->name, handle);
+		((struct perf_ctr_histogram *)handle)->time_start = hrt_absolute_time();
+		break;
+
 	default:
 		break;
 	}
@@ -258,6 +441,7 @@ perf_end(perf_counter_t handle)
 			struct perf_ctr_elapsed *pce = (struct perf_ctr_elapsed *)handle;
 
 			if (pce->time_start != 0) {
+				PX4_TRACE(PX4_TRACE_SPAN_END, handle->name, handle);
 				int64_t elapsed = hrt_absolute_time() - pce->time_start;
 
 				if (elapsed < 0) {
@@ -289,6 +473,18 @@ perf_end(perf_counter_t handle)
 		}
 		break;
 
+	case PC_HISTOGRAM: {
+			struct perf_ctr_histogram *pch = (struct perf_ctr_histogram *)handle;
+			uint64_t time_start = pch->time_start;
+
+			if (time_start != 0) {
+				PX4_TRACE(PX4_TRACE_SPAN_END, handle->name, handle);
+				hist_add(pch, hrt_absolute_time() - time_start);
+				pch->time_start = 0;
+			}
+		}
+		break;
+
 	default:
 		break;
 	}
@@ -335,6 +531,10 @@ perf_set_elapsed(perf_counter_t handle, int64_t elapsed)
 		}
 		break;
 
+	case PC_HISTOGRAM:
+		hist_add((struct perf_ctr_histogram *)handle, elapsed);
+		break;
+
 	default:
 		break;
 	}
@@ -374,6 +574,10 @@ perf_cancel(perf_counter_t handle)
 		}
 		break;
 
+	case PC_HISTOGRAM:
+		((struct perf_ctr_histogram *)handle)->time_start = 0;
+		break;
+
 	default:
 		break;
 	}
@@ -413,6 +617,16 @@ perf_reset(perf_counter_t handle)
 			pci->time_most = 0;
 			break;
 		}
+
+	case PC_HISTOGRAM: {
+			struct perf_ctr_histogram *pch = (struct perf_ctr_histogram *)handle;
+			pch->time_start = 0;
+			pch->event_overruns = 0;
+			pch->time_least = UINT32_MAX;
+			pch->time_most = 0;
+			memset(pch->buckets, 0, sizeof(pch->buckets));
+			break;
+		}
 	}
 }
 
@@ -469,6 +683,25 @@ perf_print_counter_fd(int fd, perf_counter_t handle)
 			break;
 		}
 
+	case PC_HISTOGRAM: {
+			struct perf_counter_snapshot_s snapshot = {};
+			hist_summary((struct perf_ctr_histogram *)handle, &snapshot);
+
+			dprintf(fd, "%s: %llu events, %lu overruns, %luus avg, min %luus max %luus %luus rms, "
+				"p50 %luus p99 %luus p99.9 %luus\n",
+				handle->name,
+				(unsigned long long)snapshot.event_count,
+				(unsigned long)snapshot.overruns,
+				(unsigned long)snapshot.mean,
+				(unsigned long)snapshot.min,
+				(unsigned long)snapshot.max,
+				(unsigned long)snapshot.rms,
+				(unsigned long)snapshot.p50,
+				(unsigned long)snapshot.p99,
+				(unsigned long)snapshot.p999);
+			break;
+		}
+
 	default:
 		break;
 	}
@@ -495,6 +728,11 @@ perf_event_count(perf_counter_t handle)
 			return pci->event_count;
 		}
 
+	case PC_HISTOGRAM: {
+			struct perf_counter_snapshot_s snapshot;
+			return hist_summary((struct perf_ctr_histogram *)handle, &snapshot);
+		}
+
 	default:
 		break;
 	}
@@ -513,6 +751,171 @@ perf_print_all(int fd)
 	}
 }
 
+void
+perf_print_percentiles(int fd)
+{
+	perf_counter_t handle = (perf_counter_t)sq_peek(&perf_counters);
+
+	dprintf(fd, "%-24s %10s %8s %8s %8s %8s %8s %8s\n", "counter", "events", "min", "p50", "p90", "p99", "p99.9", "max");
+
+	while (handle != NULL) {
+		if (handle->type == PC_HISTOGRAM) {
+			struct perf_counter_snapshot_s snapshot = {};
+			hist_summary((struct perf_ctr_histogram *)handle, &snapshot);
+
+			dprintf(fd, "%-24s %10llu %8lu %8lu %8lu %8lu %8lu %8lu\n",
+				handle->name,
+				(unsigned long long)snapshot.event_count,
+				(unsigned long)snapshot.min,
+				(unsigned long)snapshot.p50,
+				(unsigned long)snapshot.p90,
+				(unsigned long)snapshot.p99,
+				(unsigned long)snapshot.p999,
+				(unsigned long)snapshot.max);
+		}
+
+		handle = (perf_counter_t)sq_next(&handle->link);
+	}
+}
+
+void
+perf_snapshot_counter(perf_counter_t handle, struct perf_counter_snapshot_s *snapshot)
+{
+	memset(snapshot, 0, sizeof(*snapshot));
+
+	if (handle == NULL) {
+		return;
+	}
+
+	strncpy(snapshot->name, handle->name, sizeof(snapshot->name) - 1);
+	snapshot->type = handle->type;
+
+	switch (handle->type) {
+	case PC_COUNT:
+		snapshot->event_count = ((struct perf_ctr_count *)handle)->event_count;
+		break;
+
+	case PC_ELAPSED: {
+			struct perf_ctr_elapsed *pce = (struct perf_ctr_elapsed *)handle;
+			snapshot->event_count = pce->event_count;
+			snapshot->overruns = pce->event_overruns;
+			snapshot->min = pce->time_least;
+			snapshot->max = pce->time_most;
+
+			if (pce->event_count > 0) {
+				snapshot->mean = pce->time_total / pce->event_count;
+			}
+
+			if (pce->event_count > 1) {
+				snapshot->rms = 1e6f * sqrtf(pce->M2 / (pce->event_count - 1));
+			}
+
+			break;
+		}
+
+	case PC_INTERVAL: {
+			struct perf_ctr_interval *pci = (struct perf_ctr_interval *)handle;
+			snapshot->event_count = pci->event_count;
+			snapshot->min = pci->time_least;
+			snapshot->max = pci->time_most;
+
+			if (pci->event_count > 0) {
+				snapshot->mean = (pci->time_last - pci->time_first) / pci->event_count;
+			}
+
+			if (pci->event_count > 1) {
+				snapshot->rms = 1e6f * sqrtf(pci->M2 / (pci->event_count - 1));
+			}
+
+			break;
+		}
+
+	case PC_HISTOGRAM:
+		hist_summary((struct perf_ctr_histogram *)handle, snapshot);
+		break;
+
+	default:
+		break;
+	}
+}
+
+unsigned
+perf_snapshot(struct perf_counter_snapshot_s *snapshots, unsigned max)
+{
+	perf_counter_t handle = (perf_counter_t)sq_peek(&perf_counters);
+	unsigned count = 0;
+
+	while (handle != NULL) {
+		if (count < max) {
+			perf_snapshot_counter(handle, &snapshots[count]);
+		}
+
+		count++;
+		handle = (perf_counter_t)sq_next(&handle->link);
+	}
+
+	return count;
+}
+
+#if defined(__PX4_POSIX) && !defined(__PX4_QURT)
+
+static struct perf_export_header_s *perf_export_header = NULL;
+
+int
+perf_export_shm(void)
+{
+	if (perf_export_header == NULL) {
+		size_t size = sizeof(struct perf_export_header_s)
+			      + PERF_EXPORT_MAX_COUNTERS * sizeof(struct perf_counter_snapshot_s);
+		int fd = shm_open(PERF_EXPORT_SHM_NAME, O_CREAT | O_RDWR, 0644);
+
+		if (fd < 0) {
+			return PX4_ERROR;
+		}
+
+		void *mem = MAP_FAILED;
+
+		if (ftruncate(fd, size) == 0) {
+			mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		}
+
+		close(fd);
+
+		if (mem == MAP_FAILED) {
+			return PX4_ERROR;
+		}
+
+		perf_export_header = (struct perf_export_header_s *)mem;
+		perf_export_header->magic = PERF_EXPORT_MAGIC;
+		perf_export_header->version = PERF_EXPORT_VERSION;
+		perf_export_header->record_size = sizeof(struct perf_counter_snapshot_s);
+		perf_export_header->seq = 0;
+	}
+
+	struct perf_export_header_s *header = perf_export_header;
+
+	__atomic_store_n(&header->seq, header->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	unsigned count = perf_snapshot((struct perf_counter_snapshot_s *)(header + 1), PERF_EXPORT_MAX_COUNTERS);
+	header->count = (count < PERF_EXPORT_MAX_COUNTERS) ? count : PERF_EXPORT_MAX_COUNTERS;
+	header->timestamp = hrt_absolute_time();
+
+	__atomic_store_n(&header->seq, header->seq + 1, __ATOMIC_RELEASE);
+
+	return PX4_OK;
+}
+
+#else
+
+int
+perf_export_shm(void)
+{
+	return PX4_ERROR;
+}
+
+#endif
+
 extern const uint16_t latency_bucket_count;
 extern uint32_t latency_counters[];
 extern const uint16_t latency_buckets[];
@@ -48,7 +48,46 @@
 enum perf_counter_type {
 	PC_COUNT,		/**< count the number of times an event occurs */
 	PC_ELAPSED,		/**< measure the time elapsed performing an event */
-	PC_INTERVAL		/**< measure the interval between instances of an event */
+	PC_INTERVAL,		/**< measure the interval between instances of an event */
+	PC_HISTOGRAM		/**< measure the distribution of the time elapsed performing an event */
+};
+
+/**
+ * Summary of a counter, as filled in by perf_snapshot().
+ *
+ * Times are in microseconds. The percentiles are only set for PC_HISTOGRAM
+ * counters, they are the upper bound of the bucket the percentile falls into.
+ */
+struct perf_counter_snapshot_s {
+	char			name[32];	/**< counter name, truncated and null terminated */
+	uint32_t		type;		/**< enum perf_counter_type */
+	uint32_t		overruns;
+	uint64_t		event_count;
+	uint32_t		min;
+	uint32_t		max;
+	uint32_t		mean;
+	uint32_t		rms;		/**< standard deviation, or jitter for PC_INTERVAL */
+	uint32_t		p50;
+	uint32_t		p90;
+	uint32_t		p99;
+	uint32_t		p999;
+};
+
+#define PERF_EXPORT_SHM_NAME		"/px4_perf"
+#define PERF_EXPORT_MAGIC		0x46524550	/* "PERF" */
+#define PERF_EXPORT_VERSION		1
+#define PERF_EXPORT_MAX_COUNTERS	256
+
+/**
+ * Header of the shared memory export, see perf_export_shm().
+ */
+struct perf_export_header_s {
+	uint32_t		magic;
+	uint16_t		version;
+	uint16_t		record_size;	/**< size of struct perf_counter_snapshot_s */
+	uint32_t		seq;		/**< odd while the writer updates the records */
+	uint32_t		count;		/**< number of valid records */
+	uint64_t		timestamp;	/**< hrt time of the snapshot */
 };
 
 struct perf_ctr_header;
@@ -108,6 +147,9 @@ __EXPORT extern void		perf_begin(perf_counter_t handle);
  * If a call is made without a corresponding perf_begin call, or if perf_cancel
  * has been called subsequently, no change is made to the counter.
  *
+ * For PC_HISTOGRAM counters it does not lock and can be called while the
+ * counter is being printed or exported.
+ *
  * @param handle		The handle returned from perf_alloc.
  */
 __EXPORT extern void		perf_end(perf_counter_t handle);
@@ -182,6 +224,42 @@ __EXPORT extern void		perf_print_all(int fd);
  */
 __EXPORT extern void		perf_print_latency(int fd);
 
+/**
+ * Print the percentiles of all PC_HISTOGRAM counters.
+ *
+ * @param fd			File descriptor to print to - e.g. 0 for stdout
+ */
+__EXPORT extern void		perf_print_percentiles(int fd);
+
+/**
+ * Summarize all counters into a contiguous array.
+ *
+ * @param snapshots		Array to fill, may be NULL if max is 0.
+ * @param max			Number of elements in the array.
+ * @return			The number of counters, which can be more than max.
+ */
+__EXPORT extern unsigned	perf_snapshot(struct perf_counter_snapshot_s *snapshots, unsigned max);
+
+/**
+ * Summarize one counter.
+ *
+ * @param handle		The counter to summarize, a NULL handle gives an empty summary.
+ * @param snapshot		The summary to fill.
+ */
+__EXPORT extern void		perf_snapshot_counter(perf_counter_t handle, struct perf_counter_snapshot_s *snapshot);
+
+/**
+ * Export a snapshot of all counters to the shared memory object PERF_EXPORT_SHM_NAME.
+ *
+ * The object starts with a struct perf_export_header_s, followed by the
+ * struct perf_counter_snapshot_s records. The writer makes the sequence odd
+ * while it updates the records, readers have to retry if it was odd or changed.
+ * Only supported on POSIX.
+ *
+ * @return			OK on success, PX4_ERROR otherwise.
+ */
+__EXPORT extern int		perf_export_shm(void);
+
 /**
  * Reset all of the performance counters.
  */
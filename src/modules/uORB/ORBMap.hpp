@@ -33,6 +33,7 @@
 
 #pragma once
 
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -43,104 +44,99 @@ class DeviceNode;
 class ORBMap;
 }
 
+/**
+ * Map from node path to DeviceNode.
+ *
+ * The nodes are kept in hash buckets, and each entry stores the hash of its
+ * name so that a lookup only compares strings for a matching hash.
+ */
 class uORB::ORBMap
 {
 public:
 	struct Node {
 		struct Node *next;
+		uint32_t hash;
 		const char *node_name;
 		uORB::DeviceNode *node;
 	};
 
-	ORBMap() :
-		_top(nullptr),
-		_end(nullptr)
-	{ }
+	ORBMap()
+	{
+		for (unsigned i = 0; i < num_buckets; ++i) {
+			_buckets[i] = nullptr;
+		}
+	}
 	~ORBMap()
 	{
-		while (_top != nullptr) {
-			unlinkNext(_top);
-
-			if (_top->next == nullptr) {
-				free((void *)_top->node_name);
-				free(_top);
-				_top = nullptr;
-				_end = nullptr;
+		for (unsigned i = 0; i < num_buckets; ++i) {
+			while (_buckets[i] != nullptr) {
+				Node *p = _buckets[i];
+				_buckets[i] = p->next;
+				free((void *)p->node_name);
+				free(p);
 			}
 		}
 	}
 	void insert(const char *node_name, uORB::DeviceNode *node)
 	{
-		Node **p;
+		Node *p = (Node *)malloc(sizeof(Node));
 
-		if (_top == nullptr) {
-			p = &_top;
-
-		} else {
-			p = &_end->next;
+		if (p == nullptr) {
+			return;
 		}
 
-		*p = (Node *)malloc(sizeof(Node));
-
-		if (_end) {
-			_end = _end->next;
-
-		} else {
-			_end = _top;
-		}
+		p->hash = hash(node_name);
+		p->node_name = strdup(node_name);
+		p->node = node;
 
-		_end->next = nullptr;
-		_end->node_name = strdup(node_name);
-		_end->node = node;
+		Node **bucket = &_buckets[p->hash % num_buckets];
+		p->next = *bucket;
+		*bucket = p;
 	}
 
 	bool find(const char *node_name)
 	{
-		Node *p = _top;
-
-		while (p) {
-			if (strcmp(p->node_name, node_name) == 0) {
-				return true;
-			}
-
-			p = p->next;
-		}
-
-		return false;
+		return lookup(node_name) != nullptr;
 	}
 
 	uORB::DeviceNode *get(const char *node_name)
 	{
-		Node *p = _top;
+		Node *p = lookup(node_name);
+		return p ? p->node : nullptr;
+	}
 
-		while (p) {
-			if (strcmp(p->node_name, node_name) == 0) {
-				return p->node;
-			}
+private:
+	static const unsigned num_buckets = 64;
 
-			p = p->next;
+	/**
+	 * FNV-1a hash of a node path
+	 */
+	static uint32_t hash(const char *str)
+	{
+		uint32_t h = 2166136261u;
+
+		while (*str) {
+			h = (h ^ (uint8_t) * str++) * 16777619u;
 		}
 
-		return nullptr;
+		return h;
 	}
 
-	void unlinkNext(Node *a)
+	Node *lookup(const char *node_name)
 	{
-		Node *b = a->next;
+		const uint32_t h = hash(node_name);
+		Node *p = _buckets[h % num_buckets];
 
-		if (b != nullptr) {
-			if (_end == b) {
-				_end = a;
+		while (p) {
+			if (p->hash == h && strcmp(p->node_name, node_name) == 0) {
+				return p;
 			}
 
-			a->next = b->next;
-			free((void *)b->node_name);
-			free(b);
+			p = p->next;
 		}
+
+		return nullptr;
 	}
 
-private:
-	Node *_top;
-	Node *_end;
+	Node *_buckets[num_buckets];
 };
-
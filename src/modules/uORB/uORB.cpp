@@ -114,6 +114,41 @@ int  orb_check(int handle, bool *updated)
 	return uORB::Manager::get_instance()->orb_check(handle, updated);
 }
 
+int  orb_subscribe_direct(const struct orb_metadata *meta, unsigned instance, orb_sub_direct_t *sub)
+{
+	return uORB::Manager::get_instance()->orb_subscribe_direct(meta, instance, sub);
+}
+
+int  orb_unsubscribe_direct(orb_sub_direct_t *sub)
+{
+	return uORB::Manager::get_instance()->orb_unsubscribe_direct(sub);
+}
+
+int  orb_copy_direct(const struct orb_metadata *meta, orb_sub_direct_t *sub, void *buffer)
+{
+	return uORB::Manager::get_instance()->orb_copy_direct(meta, sub, buffer);
+}
+
+int  orb_check_direct(orb_sub_direct_t *sub, bool *updated)
+{
+	return uORB::Manager::get_instance()->orb_check_direct(sub, updated);
+}
+
+const void *orb_borrow_direct(const struct orb_metadata *meta, orb_sub_direct_t *sub, unsigned *token)
+{
+	return uORB::Manager::get_instance()->orb_borrow_direct(meta, sub, token);
+}
+
+bool orb_borrow_valid(orb_sub_direct_t *sub, unsigned token)
+{
+	return uORB::Manager::get_instance()->orb_borrow_valid(sub, token);
+}
+
+bool orb_subscribers_idle(void)
+{
+	return uORB::Manager::get_instance()->orb_subscribers_idle();
+}
+
 int  orb_stat(int handle, uint64_t *time)
 {
 	return uORB::Manager::get_instance()->orb_stat(handle, time);
@@ -135,6 +135,23 @@ __BEGIN_DECLS
  */
 typedef void 	*orb_advert_t;
 
+/**
+ * Direct ORB topic subscription.
+ *
+ * A direct subscription references the topic node itself instead of going
+ * through a file descriptor, so checking for and copying updates does not
+ * involve the file table. It is filled in by orb_subscribe_direct() and
+ * owned by the caller; there is one per subscriber.
+ *
+ * Direct subscriptions cannot be polled and do not support
+ * orb_set_interval(). Use a regular subscription for those.
+ */
+typedef struct {
+	void *node;			/**< topic node the subscription is bound to */
+	unsigned generation;		/**< last generation this subscriber has seen */
+	unsigned borrow_generation;	/**< generation before the last orb_borrow_direct() */
+} orb_sub_direct_t;
+
 /**
  * @see uORB::Manager::orb_advertise()
  */
@@ -204,6 +221,43 @@ extern int	orb_copy(const struct orb_metadata *meta, int handle, void *buffer) _
  */
 extern int	orb_check(int handle, bool *updated) __EXPORT;
 
+/**
+ * @see uORB::Manager::orb_subscribe_direct()
+ */
+extern int	orb_subscribe_direct(const struct orb_metadata *meta, unsigned instance,
+				     orb_sub_direct_t *sub) __EXPORT;
+
+/**
+ * @see uORB::Manager::orb_unsubscribe_direct()
+ */
+extern int	orb_unsubscribe_direct(orb_sub_direct_t *sub) __EXPORT;
+
+/**
+ * @see uORB::Manager::orb_copy_direct()
+ */
+extern int	orb_copy_direct(const struct orb_metadata *meta, orb_sub_direct_t *sub, void *buffer) __EXPORT;
+
+/**
+ * @see uORB::Manager::orb_check_direct()
+ */
+extern int	orb_check_direct(orb_sub_direct_t *sub, bool *updated) __EXPORT;
+
+/**
+ * @see uORB::Manager::orb_borrow_direct()
+ */
+extern const void *orb_borrow_direct(const struct orb_metadata *meta, orb_sub_direct_t *sub,
+				     unsigned *token) __EXPORT;
+
+/**
+ * @see uORB::Manager::orb_borrow_valid()
+ */
+extern bool	orb_borrow_valid(orb_sub_direct_t *sub, unsigned token) __EXPORT;
+
+/**
+ * @see uORB::Manager::orb_subscribers_idle()
+ */
+extern bool	orb_subscribers_idle(void) __EXPORT;
+
 /**
  * @see uORB::Manager::orb_stat()
  */
@@ -62,6 +62,7 @@ uORB::DeviceNode::DeviceNode
 	_priority(priority),
 	_published(false),
 	_queue_size(queue_size),
+	_seq(0),
 	_IsRemoteSubscriberPresent(false),
 	_subscriber_count(0)
 {
@@ -190,26 +191,7 @@ uORB::DeviceNode::read(struct file *filp, char *buffer, size_t buflen)
 	 */
 	irqstate_t flags = px4_enter_critical_section();
 
-	if (_generation > sd->generation + _queue_size) {
-		/* Reader is too far behind: some messages are lost */
-		sd->generation = _generation - _queue_size;
-	}
-
-	if (_generation == sd->generation && sd->generation > 0) {
-		/* The subscriber already read the latest message, but nothing new was published yet.
-		 * Return the previous message
-		 */
-		--sd->generation;
-	}
-
-	/* if the caller doesn't want the data, don't give it to them */
-	if (nullptr != buffer) {
-		memcpy(buffer, _data + (_meta->o_size * (sd->generation % _queue_size)), _meta->o_size);
-	}
-
-	if (sd->generation < _generation) {
-		++sd->generation;
-	}
+	copy_locked(buffer, sd->generation);
 
 	/* set priority */
 	sd->set_priority(_priority);
@@ -269,6 +251,7 @@ uORB::DeviceNode::write(struct file *filp, const char *buffer, size_t buflen)
 	_last_update = hrt_absolute_time();
 	/* wrap-around happens after ~49 days, assuming a publisher rate of 1 kHz */
 	_generation++;
+	_seq++;
 
 	_published = true;
 
@@ -533,6 +516,78 @@ out:
 	return ret;
 }
 
+bool
+uORB::DeviceNode::copy(void *dst, unsigned &generation)
+{
+	/* if the object has not been written yet, there is nothing to copy */
+	if (_data == nullptr) {
+		return false;
+	}
+
+	irqstate_t flags = px4_enter_critical_section();
+	copy_locked(dst, generation);
+	px4_leave_critical_section(flags);
+
+	return true;
+}
+
+const void *
+uORB::DeviceNode::borrow(unsigned &generation, unsigned &seq)
+{
+	/* if the object has not been written yet, there is nothing to borrow */
+	if (_data == nullptr) {
+		return nullptr;
+	}
+
+	irqstate_t flags = px4_enter_critical_section();
+
+	seq = _seq;
+
+	/* same generation handling as copy_locked() */
+	if (_generation > generation + _queue_size) {
+		generation = _generation - _queue_size;
+	}
+
+	if (_generation == generation && generation > 0) {
+		--generation;
+	}
+
+	const void *element = _data + (_meta->o_size * (generation % _queue_size));
+
+	if (generation < _generation) {
+		++generation;
+	}
+
+	px4_leave_critical_section(flags);
+
+	return element;
+}
+
+void
+uORB::DeviceNode::copy_locked(void *dst, unsigned &generation)
+{
+	if (_generation > generation + _queue_size) {
+		/* Reader is too far behind: some messages are lost */
+		generation = _generation - _queue_size;
+	}
+
+	if (_generation == generation && generation > 0) {
+		/* The subscriber already read the latest message, but nothing new was published yet.
+		 * Return the previous message
+		 */
+		--generation;
+	}
+
+	/* if the caller doesn't want the data, don't give it to them */
+	if (nullptr != dst) {
+		memcpy(dst, _data + (_meta->o_size * (generation % _queue_size)), _meta->o_size);
+	}
+
+	if (generation < _generation) {
+		++generation;
+	}
+}
+
 void
 uORB::DeviceNode::update_deferred()
 {
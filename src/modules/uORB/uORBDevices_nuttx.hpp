@@ -178,6 +178,48 @@ public:
 	 */
 	int update_queue_size(unsigned int queue_size);
 
+	/**
+	 * Copy the next element for a subscriber and advance its generation.
+	 *
+	 * This is the read path shared by file descriptor based subscribers and
+	 * direct subscriptions (@see orb_copy_direct()). Queueing semantics are
+	 * the same as for read().
+	 *
+	 * @param dst		Buffer of o_size bytes, or nullptr to only advance the generation
+	 * @param generation	Last generation seen by the subscriber, updated on return
+	 * @return		false if nothing has been published yet
+	 */
+	bool copy(void *dst, unsigned &generation);
+
+	/**
+	 * Get the current generation of the topic, without locking.
+	 */
+	unsigned published_generation() const { return _generation; }
+
+	/**
+	 * Check if something was published after @p generation, without locking.
+	 */
+	bool updated_since(unsigned generation) const { return published_generation() != generation; }
+
+	/**
+	 * Get a pointer to the next element for a subscriber without copying it,
+	 * and advance the generation like copy() does.
+	 *
+	 * The element stays owned by the node and the next publication may
+	 * overwrite it. After using the data, check borrow_valid() with the
+	 * returned sequence; if that fails, the caller has to fall back to copy().
+	 *
+	 * @param generation	Last generation seen by the subscriber, updated on return
+	 * @param seq		Write sequence at the time of the borrow
+	 * @return		nullptr if nothing has been published yet
+	 */
+	const void *borrow(unsigned &generation, unsigned &seq);
+
+	/**
+	 * Check that no publication happened since borrow() returned @p seq.
+	 */
+	bool borrow_valid(unsigned seq) const { return _seq == seq; }
+
 protected:
 	virtual pollevent_t poll_state(struct file *filp);
 	virtual void poll_notify_one(struct pollfd *fds, pollevent_t events);
@@ -210,6 +252,7 @@ private:
 	const int   _priority;  /**< priority of topic */
 	bool _published;  /**< has ever data been published */
 	unsigned int _queue_size; /**< maximum number of elements in the queue */
+	volatile unsigned _seq; /**< write sequence, incremented by each publication */
 
 private: // private class methods.
 
@@ -242,6 +285,11 @@ private: // private class methods.
 	 */
 	bool      appears_updated(SubscriberData *sd);
 
+	/**
+	 * Implementation of copy(). Must be called inside a critical section.
+	 */
+	void      copy_locked(void *dst, unsigned &generation);
+
 	// disable copy and assignment operators
 	DeviceNode(const DeviceNode &);
 	DeviceNode &operator=(const DeviceNode &);
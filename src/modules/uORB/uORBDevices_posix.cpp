@@ -42,9 +42,12 @@
 #include "uORBManager.hpp"
 #include "uORBCommunicator.hpp"
 #include <px4_sem.hpp>
+#include <px4_trace.h>
 #include <stdlib.h>
+#include <algorithm>
 
-std::map<std::string, uORB::DeviceNode *> uORB::DeviceMaster::_node_map;
+std::unordered_map<std::string, uORB::DeviceNode *> uORB::DeviceMaster::_node_map;
+pthread_mutex_t uORB::DeviceMaster::_node_map_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 
 uORB::DeviceNode::SubscriberData  *uORB::DeviceNode::filp_to_sd(device::file_t *filp)
@@ -72,10 +75,13 @@ uORB::DeviceNode::DeviceNode(const struct orb_metadata *meta, const char *name,
 	_priority(priority),
 	_published(false),
 	_queue_size(queue_size),
+	_seq(0),
 	_subscriber_count(0)
 {
 	// enable debug() calls
 	//_debug_enabled = true;
+
+	px4_sem_init(&_publish_lock, 0, 1);
 }
 
 uORB::DeviceNode::~DeviceNode()
@@ -84,6 +90,7 @@ uORB::DeviceNode::~DeviceNode()
 		delete[] _data;
 	}
 
+	px4_sem_destroy(&_publish_lock);
 }
 
 int
@@ -173,6 +180,11 @@ uORB::DeviceNode::close(device::file_t *filp)
 				hrt_cancel(&sd->update_interval->update_call);
 			}
 
+			lock();
+			_poll_subscribers.erase(std::remove(_poll_subscribers.begin(), _poll_subscribers.end(), filp),
+						_poll_subscribers.end());
+			unlock();
+
 			remove_internal_subscriber();
 			delete sd;
 			sd = nullptr;
@@ -199,33 +211,12 @@ uORB::DeviceNode::read(device::file_t *filp, char *buffer, size_t buflen)
 	}
 
 	/*
-	 * Perform an atomic copy & state update
+	 * Perform an atomic copy & state update. This does not take the node lock,
+	 * the data is protected by the write sequence.
 	 */
-	lock();
+	copy(buffer, sd->generation);
 
-	if (_generation > sd->generation + _queue_size) {
-		/* Reader is too far behind: some messages are lost */
-		sd->generation = _generation - _queue_size;
-	}
-
-	if (_generation == sd->generation && sd->generation > 0) {
-		/* The subscriber already read the latest message, but nothing new was published yet.
-		 * Return the previous message
-		 */
-		--sd->generation;
-	}
-
-	/* if the caller doesn't want the data, don't give it to them */
-	if (nullptr != buffer) {
-		memcpy(buffer, _data + (_meta->o_size * (sd->generation % _queue_size)), _meta->o_size);
-	}
-
-	if (sd->generation < _generation) {
-		++sd->generation;
-	}
-
-	/* set priority */
-	sd->set_priority(_priority);
+	PX4_TRACE(PX4_TRACE_COPY, _meta->o_name, sd->generation - 1);
 
 	/*
 	 * Clear the flag that indicates that an update has been reported, as
@@ -233,8 +224,6 @@ uORB::DeviceNode::read(device::file_t *filp, char *buffer, size_t buflen)
 	 */
 	sd->set_update_reported(false);
 
-	unlock();
-
 	return _meta->o_size;
 }
 
@@ -272,17 +261,31 @@ uORB::DeviceNode::write(device::file_t *filp, const char *buffer, size_t buflen)
 		return -EIO;
 	}
 
-	lock();
-	memcpy(_data + (_meta->o_size * (_generation % _queue_size)), buffer, _meta->o_size);
+	/*
+	 * Readers do not take any lock, so this never waits for them. The publish
+	 * lock only serializes multiple publishers of the same node.
+	 */
+	publish_lock();
+
+	/* an odd sequence tells readers that a write is in progress */
+	__atomic_store_n(&_seq, _seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	unsigned generation = _generation;
+	memcpy(_data + (_meta->o_size * (generation % _queue_size)), buffer, _meta->o_size);
 
 	/* update the timestamp and generation count */
 	_last_update = hrt_absolute_time();
 	/* wrap-around happens after ~49 days, assuming a publisher rate of 1 kHz */
-	_generation++;
+	__atomic_store_n(&_generation, _generation + 1, __ATOMIC_RELEASE);
 
 	_published = true;
 
-	unlock();
+	__atomic_store_n(&_seq, _seq + 1, __ATOMIC_RELEASE);
+
+	publish_unlock();
+
+	PX4_TRACE(PX4_TRACE_PUBLISH, _meta->o_name, generation);
 
 	/* notify any poll waiters */
 	poll_notify(POLLIN);
@@ -297,15 +300,35 @@ uORB::DeviceNode::ioctl(device::file_t *filp, int cmd, unsigned long arg)
 	SubscriberData *sd = filp_to_sd(filp);
 
 	switch (cmd) {
-	case ORBIOCLASTUPDATE:
-		lock();
-		*(hrt_abstime *)arg = _last_update;
-		unlock();
-		return PX4_OK;
+	case ORBIOCLASTUPDATE: {
+			unsigned seq;
+			int retries = 0;
+
+			do {
+				if (++retries > max_read_retries) {
+					publish_lock();
+					*(hrt_abstime *)arg = _last_update;
+					publish_unlock();
+					break;
+				}
+
+				seq = read_begin();
+				*(hrt_abstime *)arg = _last_update;
+			} while (read_retry(seq));
+
+			return PX4_OK;
+		}
 
 	case ORBIOCUPDATED:
 		lock();
 		*(bool *)arg = appears_updated(sd);
+
+		/* a poller that took to orb_check() is not waited for in subscribers_idle() anymore */
+		if (!poll_registered(filp) && ++sd->checks_without_poll == max_checks_without_poll) {
+			_poll_subscribers.erase(std::remove(_poll_subscribers.begin(), _poll_subscribers.end(), filp),
+						_poll_subscribers.end());
+		}
+
 		unlock();
 		return PX4_OK;
 
@@ -449,6 +472,13 @@ uORB::DeviceNode::poll_state(device::file_t *filp)
 	//warnx("uORB::DeviceNode::poll_state fd = %d", filp->fd);
 	SubscriberData *sd = filp_to_sd(filp);
 
+	/* remember the subscribers that wait for updates, for subscribers_idle() */
+	if (std::find(_poll_subscribers.begin(), _poll_subscribers.end(), filp) == _poll_subscribers.end()) {
+		_poll_subscribers.push_back(filp);
+	}
+
+	sd->checks_without_poll = 0;
+
 	/*
 	 * If the topic appears updated to the subscriber, say so.
 	 */
@@ -459,6 +489,25 @@ uORB::DeviceNode::poll_state(device::file_t *filp)
 	return 0;
 }
 
+bool
+uORB::DeviceNode::subscribers_idle()
+{
+	bool idle = true;
+
+	lock();
+
+	for (device::file_t *filp : _poll_subscribers) {
+		if (update_pending(filp_to_sd(filp)) || !poll_sleeping(filp)) {
+			idle = false;
+			break;
+		}
+	}
+
+	unlock();
+
+	return idle;
+}
+
 void
 uORB::DeviceNode::poll_notify_one(px4_pollfd_struct_t *fds, pollevent_t events)
 {
@@ -478,9 +527,7 @@ uORB::DeviceNode::appears_updated(SubscriberData *sd)
 {
 
 	/* block if in simulation mode */
-	while (px4_sim_delay_enabled()) {
-		usleep(100);
-	}
+	px4_sim_delay_wait();
 
 	//warnx("uORB::DeviceNode::appears_updated sd = %p", sd);
 	/* assume it doesn't look updated */
@@ -537,6 +584,95 @@ uORB::DeviceNode::appears_updated(SubscriberData *sd)
 	return ret;
 }
 
+bool
+uORB::DeviceNode::copy(void *dst, unsigned &generation)
+{
+	/* if the object has not been written yet, there is nothing to copy */
+	if (_data == nullptr) {
+		return false;
+	}
+
+	unsigned seq;
+	unsigned next_generation;
+	int retries = 0;
+
+	do {
+		if (++retries > max_read_retries) {
+			/* We keep racing with a publisher, which might have been preempted by
+			 * us in the middle of a write. Block until it is done. */
+			publish_lock();
+			next_generation = generation;
+			copy_element(dst, next_generation);
+			publish_unlock();
+			break;
+		}
+
+		seq = read_begin();
+		next_generation = generation;
+		copy_element(dst, next_generation);
+	} while (read_retry(seq));
+
+	generation = next_generation;
+	return true;
+}
+
+const void *
+uORB::DeviceNode::borrow(unsigned &generation, unsigned &seq)
+{
+	/* if the object has not been written yet, there is nothing to borrow */
+	if (_data == nullptr) {
+		return nullptr;
+	}
+
+	seq = read_begin();
+
+	if (seq & 1) {
+		/* wait for the write in progress to finish */
+		publish_lock();
+		seq = read_begin();
+		publish_unlock();
+	}
+
+	return next_element(generation);
+}
+
+const uint8_t *
+uORB::DeviceNode::next_element(unsigned &generation) const
+{
+	const unsigned current = _generation;
+
+	if (current > generation + _queue_size) {
+		/* Reader is too far behind: some messages are lost */
+		generation = current - _queue_size;
+	}
+
+	if (current == generation && generation > 0) {
+		/* The subscriber already read the latest message, but nothing new was published yet.
+		 * Return the previous message
+		 */
+		--generation;
+	}
+
+	const uint8_t *element = _data + (_meta->o_size * (generation % _queue_size));
+
+	if (generation < current) {
+		++generation;
+	}
+
+	return element;
+}
+
+void
+uORB::DeviceNode::copy_element(void *dst, unsigned &generation) const
+{
+	const uint8_t *element = next_element(generation);
+
+	/* if the caller doesn't want the data, don't give it to them */
+	if (nullptr != dst) {
+		memcpy(dst, element, _meta->o_size);
+	}
+}
+
 void
 uORB::DeviceNode::update_deferred()
 {
@@ -758,7 +894,9 @@ uORB::DeviceMaster::ioctl(device::file_t *filp, int cmd, unsigned long arg)
 
 				} else {
 					// add to the node map;.
+					pthread_mutex_lock(&_node_map_mutex);
 					_node_map[std::string(nodepath)] = node;
+					pthread_mutex_unlock(&_node_map_mutex);
 				}
 
 
@@ -779,16 +917,39 @@ uORB::DeviceMaster::ioctl(device::file_t *filp, int cmd, unsigned long arg)
 	}
 }
 
+bool uORB::DeviceMaster::subscribers_idle()
+{
+	bool idle = true;
+
+	pthread_mutex_lock(&_node_map_mutex);
+
+	for (const auto &entry : _node_map) {
+		if (!entry.second->subscribers_idle()) {
+			idle = false;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&_node_map_mutex);
+
+	return idle;
+}
+
 uORB::DeviceNode *uORB::DeviceMaster::GetDeviceNode(const char *nodepath)
 {
 	uORB::DeviceNode *rc = nullptr;
 	std::string np(nodepath);
 
+	/* an advertise() in another thread may rehash the map meanwhile */
+	pthread_mutex_lock(&_node_map_mutex);
+
 	auto iter = _node_map.find(np);
 
 	if (iter != _node_map.end()) {
 		rc = iter->second;
 	}
 
+	pthread_mutex_unlock(&_node_map_mutex);
+
 	return rc;
 }
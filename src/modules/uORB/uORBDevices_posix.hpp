@@ -36,7 +36,9 @@
 
 #include <stdint.h>
 #include <string>
-#include <map>
+#include <unordered_map>
+#include <vector>
+#include <pthread.h>
 #include "uORBCommon.hpp"
 
 namespace uORB
@@ -115,6 +117,61 @@ public:
 	 */
 	int update_queue_size(unsigned int queue_size);
 
+	/**
+	 * Copy the next element for a subscriber and advance its generation.
+	 *
+	 * This is the read path shared by file descriptor based subscribers and
+	 * direct subscriptions (@see orb_copy_direct()). It does not go through the
+	 * file layer and does not take any lock: the copy is retried if a
+	 * publication raced it. Queueing semantics are the same as for read(): a
+	 * subscriber that fell behind by more than the queue size skips the lost
+	 * elements, and a subscriber that is up to date gets the latest element again.
+	 *
+	 * @param dst		Buffer of o_size bytes, or nullptr to only advance the generation
+	 * @param generation	Last generation seen by the subscriber, updated on return
+	 * @return		false if nothing has been published yet
+	 */
+	bool copy(void *dst, unsigned &generation);
+
+	/**
+	 * Get the current generation of the topic. This is a single atomic load
+	 * and does not take any lock.
+	 */
+	unsigned published_generation() const { return __atomic_load_n(&_generation, __ATOMIC_ACQUIRE); }
+
+	/**
+	 * Check if something was published after @p generation, without locking.
+	 */
+	bool updated_since(unsigned generation) const { return published_generation() != generation; }
+
+	/**
+	 * Get a pointer to the next element for a subscriber without copying it,
+	 * and advance the generation like copy() does.
+	 *
+	 * The element stays owned by the node and the next publication may
+	 * overwrite it. After using the data, check borrow_valid() with the
+	 * returned sequence; if that fails, the data may be torn and the caller
+	 * has to fall back to copy().
+	 *
+	 * @param generation	Last generation seen by the subscriber, updated on return
+	 * @param seq		Write sequence at the time of the borrow
+	 * @return		nullptr if nothing has been published yet
+	 */
+	const void *borrow(unsigned &generation, unsigned &seq);
+
+	/**
+	 * Check that no publication happened since borrow() returned @p seq.
+	 */
+	bool borrow_valid(unsigned seq) const { return !read_retry(seq); }
+
+	/**
+	 * Check whether every subscriber that polls this topic has read all updates
+	 * it is interested in, and is blocked waiting for the next one.
+	 * Subscribers that never polled the topic are not considered, nor are those
+	 * that went on to check it with orb_check() instead of polling.
+	 */
+	bool subscribers_idle();
+
 protected:
 	virtual pollevent_t poll_state(device::file_t *filp);
 	virtual void    poll_notify_one(px4_pollfd_struct_t *fds, pollevent_t events);
@@ -131,12 +188,23 @@ private:
 		unsigned  generation; /**< last generation the subscriber has seen */
 		int   flags; /**< lowest 8 bits: priority of publisher, 9. bit: update_reported bit */
 		UpdateIntervalData *update_interval; /**< if null, no update interval */
+		unsigned  checks_without_poll; /**< orb_check() calls outside of a poll since the last poll, protected by lock() */
 
 		int priority() const { return flags & 0xff; }
 		void set_priority(uint8_t prio) { flags = (flags & ~0xff) | prio; }
 
-		bool update_reported() const { return flags & (1 << 8); }
-		void set_update_reported(bool update_reported_flag) { flags = (flags & ~(1 << 8)) | (((int)update_reported_flag) << 8); }
+		bool update_reported() const { return __atomic_load_n(&flags, __ATOMIC_RELAXED) & (1 << 8); }
+
+		/* atomic: the flag is set from the publisher's poll_notify() and cleared by the lock-free read() */
+		void set_update_reported(bool update_reported_flag)
+		{
+			if (update_reported_flag) {
+				__atomic_fetch_or(&flags, 1 << 8, __ATOMIC_RELAXED);
+
+			} else {
+				__atomic_fetch_and(&flags, ~(1 << 8), __ATOMIC_RELAXED);
+			}
+		}
 	};
 
 	const struct orb_metadata *_meta; /**< object metadata information */
@@ -148,11 +216,35 @@ private:
 	const int   _priority;  /**< priority of topic */
 	bool _published;  /**< has ever data been published */
 	unsigned int _queue_size; /**< maximum number of elements in the queue */
+	volatile unsigned _seq; /**< write sequence, odd while a publication is in progress */
+	px4_sem_t _publish_lock; /**< serializes publishers, never taken by readers */
+
+	/** lock-free reads that raced a publication this often fall back to the publish lock */
+	static const int max_read_retries = 3;
 
 	static SubscriberData    *filp_to_sd(device::file_t *filp);
 
 	int32_t _subscriber_count;
 
+	std::vector<device::file_t *> _poll_subscribers; /**< subscribers that poll the topic, protected by lock() */
+
+	/**
+	 * A subscriber may poll only once, e.g. to wait for the first update, and
+	 * then check the topic from a usleep() loop. It is no longer waited for once
+	 * it checked this often without polling in between; a poller checks at most
+	 * once after its poll returned.
+	 */
+	static const unsigned max_checks_without_poll = 2;
+
+	/**
+	 * Whether the subscriber has an update to collect, without any side effects
+	 * (unlike appears_updated()).
+	 */
+	bool      update_pending(SubscriberData *sd) const
+	{
+		return sd->generation != published_generation() && (sd->update_interval == nullptr || sd->update_reported());
+	}
+
 	/**
 	 * Perform a deferred update for a rate-limited subscriber.
 	 */
@@ -175,6 +267,38 @@ private:
 	 */
 	bool      appears_updated(SubscriberData *sd);
 
+	/**
+	 * Find the next element for a subscriber and advance its generation.
+	 *
+	 * Must be called inside a read section (@see read_begin()) or with the
+	 * publish lock held.
+	 */
+	const uint8_t *next_element(unsigned &generation) const;
+
+	/**
+	 * Copy the next element for a subscriber, @see next_element().
+	 */
+	void      copy_element(void *dst, unsigned &generation) const;
+
+	/**
+	 * Start a lock-free read section.
+	 * @return the write sequence to pass to read_retry()
+	 */
+	unsigned  read_begin() const { return __atomic_load_n(&_seq, __ATOMIC_ACQUIRE); }
+
+	/**
+	 * End a lock-free read section.
+	 * @return true if a publication raced the read and it must be repeated
+	 */
+	bool      read_retry(unsigned seq) const
+	{
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		return (seq & 1) || __atomic_load_n(&_seq, __ATOMIC_RELAXED) != seq;
+	}
+
+	void      publish_lock() { do {} while (px4_sem_wait(&_publish_lock) != 0); }
+	void      publish_unlock() { px4_sem_post(&_publish_lock); }
+
 
 	// disable copy and assignment operators
 	DeviceNode(const DeviceNode &);
@@ -195,10 +319,17 @@ public:
 
 	static uORB::DeviceNode *GetDeviceNode(const char *node_name);
 
+	/**
+	 * Check whether the subscribers of all topics are idle.
+	 * @see DeviceNode::subscribers_idle()
+	 */
+	static bool subscribers_idle();
+
 	virtual int   ioctl(device::file_t *filp, int cmd, unsigned long arg);
 private:
 	const Flavor      _flavor;
-	static std::map<std::string, uORB::DeviceNode *> _node_map;
+	static std::unordered_map<std::string, uORB::DeviceNode *> _node_map;
+	static pthread_mutex_t _node_map_mutex; /**< protects insertions against lookups and iterating the map */
 };
 
 #endif /* _uORBDeviceNode_posix.hpp */
@@ -245,6 +245,126 @@ int uORB::Manager::orb_check(int handle, bool *updated)
 	return px4_ioctl(handle, ORBIOCUPDATED, (unsigned long)(uintptr_t)updated);
 }
 
+int uORB::Manager::orb_subscribe_direct(const struct orb_metadata *meta, unsigned instance, orb_sub_direct_t *sub)
+{
+	uORB::DeviceNode *node = nullptr;
+
+	/* open the node the regular way, this also creates it if it is not advertised yet */
+	int fd = orb_subscribe_multi(meta, instance);
+
+	if (fd < 0) {
+		return ERROR;
+	}
+
+	int ret = px4_ioctl(fd, ORBIOCGADVERTISER, (unsigned long)(uintptr_t)&node);
+
+	if (ret == PX4_OK && node != nullptr) {
+		/* register before closing the fd so a remote subscription is not dropped in between */
+		node->add_internal_subscriber();
+	}
+
+	px4_close(fd);
+
+	if (ret != PX4_OK || node == nullptr) {
+		errno = EIO;
+		return ERROR;
+	}
+
+	sub->node = node;
+	/* default to no pending update */
+	sub->generation = node->published_generation();
+	sub->borrow_generation = sub->generation;
+
+	return PX4_OK;
+}
+
+int uORB::Manager::orb_unsubscribe_direct(orb_sub_direct_t *sub)
+{
+	uORB::DeviceNode *node = (uORB::DeviceNode *)sub->node;
+
+	if (node == nullptr) {
+		errno = EINVAL;
+		return ERROR;
+	}
+
+	node->remove_internal_subscriber();
+	sub->node = nullptr;
+
+	return PX4_OK;
+}
+
+int uORB::Manager::orb_copy_direct(const struct orb_metadata *meta, orb_sub_direct_t *sub, void *buffer)
+{
+	uORB::DeviceNode *node = (uORB::DeviceNode *)sub->node;
+
+	if (node == nullptr) {
+		errno = EINVAL;
+		return ERROR;
+	}
+
+	/* nothing published yet: same as orb_copy on an unpublished topic */
+	if (!node->copy(buffer, sub->generation)) {
+		errno = EIO;
+		return ERROR;
+	}
+
+	return PX4_OK;
+}
+
+int uORB::Manager::orb_check_direct(orb_sub_direct_t *sub, bool *updated)
+{
+	uORB::DeviceNode *node = (uORB::DeviceNode *)sub->node;
+
+	if (node == nullptr) {
+		*updated = false;
+		errno = EINVAL;
+		return ERROR;
+	}
+
+	*updated = node->updated_since(sub->generation);
+	return PX4_OK;
+}
+
+const void *uORB::Manager::orb_borrow_direct(const struct orb_metadata *meta, orb_sub_direct_t *sub,
+		unsigned *token)
+{
+	uORB::DeviceNode *node = (uORB::DeviceNode *)sub->node;
+
+	if (node == nullptr) {
+		errno = EINVAL;
+		return nullptr;
+	}
+
+	sub->borrow_generation = sub->generation;
+	return node->borrow(sub->generation, *token);
+}
+
+bool uORB::Manager::orb_borrow_valid(orb_sub_direct_t *sub, unsigned token)
+{
+	uORB::DeviceNode *node = (uORB::DeviceNode *)sub->node;
+
+	if (node == nullptr) {
+		return false;
+	}
+
+	if (!node->borrow_valid(token)) {
+		/* the element was overwritten: read it again on the next call */
+		sub->generation = sub->borrow_generation;
+		return false;
+	}
+
+	return true;
+}
+
+bool uORB::Manager::orb_subscribers_idle()
+{
+#ifdef __PX4_NUTTX
+	return true;
+#else
+	return uORB::DeviceMaster::subscribers_idle();
+#endif
+}
+
 int uORB::Manager::orb_stat(int handle, uint64_t *time)
 {
 	return px4_ioctl(handle, ORBIOCLASTUPDATE, (unsigned long)(uintptr_t)time);
@@ -275,6 +275,108 @@ public:
 	 */
 	int  orb_check(int handle, bool *updated) ;
 
+	/**
+	 * Subscribe to a topic instance without a file descriptor.
+	 *
+	 * The subscription is bound directly to the topic node: orb_check_direct()
+	 * is a single atomic load, and orb_copy_direct() only takes the node lock,
+	 * bypassing the file table and its global lock. This is meant for high
+	 * rate consumers that check many topics per cycle.
+	 *
+	 * As with orb_subscribe_multi(), the topic does not have to be advertised
+	 * yet. A new subscription does not report an update for data that was
+	 * published before it was created, but orb_copy_direct() will return it.
+	 *
+	 * Direct subscriptions cannot be polled and do not support intervals.
+	 *
+	 * @param meta    The uORB metadata (usually from the ORB_ID() macro)
+	 *      for the topic.
+	 * @param instance  The instance of the topic.
+	 * @param sub     Subscription to initialize.
+	 * @return    OK on success, ERROR otherwise with errno set accordingly.
+	 */
+	int  orb_subscribe_direct(const struct orb_metadata *meta, unsigned instance, orb_sub_direct_t *sub);
+
+	/**
+	 * Release a subscription created with orb_subscribe_direct().
+	 *
+	 * @param sub     The subscription.
+	 * @return    OK on success, ERROR otherwise with errno set accordingly.
+	 */
+	int  orb_unsubscribe_direct(orb_sub_direct_t *sub);
+
+	/**
+	 * Fetch data from a topic through a direct subscription.
+	 *
+	 * @see orb_copy()
+	 *
+	 * @param meta    The uORB metadata (usually from the ORB_ID() macro)
+	 *      for the topic.
+	 * @param sub     A subscription created with orb_subscribe_direct().
+	 * @param buffer  Pointer to the buffer receiving the data, or NULL
+	 *      if the caller wants to clear the updated flag without
+	 *      using the data.
+	 * @return    OK on success, ERROR otherwise with errno set accordingly.
+	 */
+	int  orb_copy_direct(const struct orb_metadata *meta, orb_sub_direct_t *sub, void *buffer);
+
+	/**
+	 * Check whether a topic has been published to since the last orb_copy_direct().
+	 *
+	 * @see orb_check()
+	 *
+	 * @param sub     A subscription created with orb_subscribe_direct().
+	 * @param updated Set to true if the topic has been updated.
+	 * @return    OK if the check was successful, ERROR otherwise with
+	 *      errno set accordingly.
+	 */
+	int  orb_check_direct(orb_sub_direct_t *sub, bool *updated);
+
+	/**
+	 * Access the data of a topic through a direct subscription without copying it.
+	 *
+	 * This marks the data as read, like orb_copy_direct(). The returned buffer
+	 * belongs to the topic and a publication may overwrite it at any time, so
+	 * once done with it the caller must confirm with orb_borrow_valid() that
+	 * the data was not modified meanwhile. If it was, orb_borrow_valid() puts
+	 * the subscription back to where it was before the borrow, so that the
+	 * next orb_borrow_direct() or orb_copy_direct() returns the same element
+	 * again (or the oldest one still queued).
+	 *
+	 * @param meta    The uORB metadata (usually from the ORB_ID() macro)
+	 *      for the topic.
+	 * @param sub     A subscription created with orb_subscribe_direct().
+	 * @param token   Returns the token to pass to orb_borrow_valid().
+	 * @return    Pointer to the topic data, nullptr if nothing was published
+	 *      yet or on error.
+	 */
+	const void *orb_borrow_direct(const struct orb_metadata *meta, orb_sub_direct_t *sub, unsigned *token);
+
+	/**
+	 * Check that data returned by orb_borrow_direct() was not modified meanwhile.
+	 *
+	 * On failure the borrow is undone and the element is not marked as read.
+	 *
+	 * @param sub     A subscription created with orb_subscribe_direct().
+	 * @param token   The token returned by orb_borrow_direct().
+	 * @return    true if the borrowed data is consistent.
+	 */
+	bool orb_borrow_valid(orb_sub_direct_t *sub, unsigned token);
+
+	/**
+	 * Check whether the system has processed all publications, for lockstep
+	 * execution (e.g. replay as fast as possible).
+	 *
+	 * This is the case when every subscriber that polls a topic has read all
+	 * updates it is interested in and is blocked waiting for the next one.
+	 * Subscribers that only check topics without polling are not considered,
+	 * including those that polled a topic before and now keep checking it.
+	 * Only supported on POSIX, always true otherwise.
+	 *
+	 * @return    true if all polling subscribers are idle.
+	 */
+	bool orb_subscribers_idle();
+
 	/**
 	 * Return the last time that the topic was updated. If a queue is used, it returns
 	 * the timestamp of the latest element in the queue.
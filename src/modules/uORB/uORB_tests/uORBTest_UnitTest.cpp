@@ -33,11 +33,17 @@
 
 #include "uORBTest_UnitTest.hpp"
 #include "../uORBCommon.hpp"
+#include "../uORBTopics.h"
+#ifdef __PX4_POSIX
+#include "../uORBDevices.hpp"
+#include "../uORBUtils.hpp"
+#endif
 #include <px4_config.h>
 #include <px4_time.h>
 #include <stdio.h>
 #include <errno.h>
 #include <poll.h>
+#include <string.h>
 
 uORBTest::UnitTest &uORBTest::UnitTest::instance()
 {
@@ -178,7 +184,34 @@ int uORBTest::UnitTest::test()
 		return ret;
 	}
 
-	return test_queue_poll_notify();
+	ret = test_queue_poll_notify();
+
+	if (ret != OK) {
+		return ret;
+	}
+
+	ret = test_direct();
+
+	if (ret != OK) {
+		return ret;
+	}
+
+#ifdef __PX4_POSIX
+	ret = test_waitset();
+
+	if (ret != OK) {
+		return ret;
+	}
+
+	ret = test_subscribers_idle();
+
+	if (ret != OK) {
+		return ret;
+	}
+
+#endif
+
+	return contention_test(4, 2000, false);
 }
 
 int uORBTest::UnitTest::test_unadvertise()
@@ -792,6 +825,875 @@ int uORBTest::UnitTest::test_queue_poll_notify()
 }
 
 
+int uORBTest::UnitTest::test_direct()
+{
+	test_note("Testing direct subscriptions");
+
+	struct orb_test_medium t, u;
+	orb_sub_direct_t sub;
+	orb_advert_t ptopic;
+	bool updated;
+
+	/* subscribe before advertising */
+	if (PX4_OK != orb_subscribe_direct(ORB_ID(orb_test_medium_direct), 0, &sub)) {
+		return test_fail("direct subscribe failed: %d", errno);
+	}
+
+	orb_check_direct(&sub, &updated);
+
+	if (updated) {
+		return test_fail("spurious updated flag before advertise");
+	}
+
+	if (PX4_OK == orb_copy_direct(ORB_ID(orb_test_medium_direct), &sub, &u)) {
+		return test_fail("copy succeeded before advertise");
+	}
+
+	const unsigned int queue_size = 5;
+	t.val = 1;
+	ptopic = orb_advertise_queue(ORB_ID(orb_test_medium_direct), &t, queue_size);
+
+	if (ptopic == nullptr) {
+		return test_fail("advertise failed: %d", errno);
+	}
+
+	orb_check_direct(&sub, &updated);
+
+	if (!updated) {
+		return test_fail("update flag not set after advertise");
+	}
+
+	if (PX4_OK != orb_copy_direct(ORB_ID(orb_test_medium_direct), &sub, &u) || u.val != t.val) {
+		return test_fail("copy(1) mismatch: %d expected %d", u.val, t.val);
+	}
+
+	orb_check_direct(&sub, &updated);
+
+	if (updated) {
+		return test_fail("spurious updated flag");
+	}
+
+	/* a direct and a file descriptor subscriber must see the same data */
+	int sfd = orb_subscribe(ORB_ID(orb_test_medium_direct));
+
+	if (sfd < 0) {
+		return test_fail("subscribe failed: %d", errno);
+	}
+
+	for (unsigned int i = 0; i < queue_size + 2; ++i) {
+		t.val = 10 + i;
+		orb_publish(ORB_ID(orb_test_medium_direct), ptopic, &t);
+	}
+
+	/* the first two elements were overwritten */
+	for (unsigned int i = 0; i < queue_size; ++i) {
+		struct orb_test_medium v;
+		orb_check_direct(&sub, &updated);
+
+		if (!updated) {
+			return test_fail("update flag not set, element %i", i);
+		}
+
+		orb_copy_direct(ORB_ID(orb_test_medium_direct), &sub, &u);
+		orb_copy(ORB_ID(orb_test_medium_direct), sfd, &v);
+
+		if (u.val != (int)(12 + i) || v.val != u.val) {
+			return test_fail("got wrong element (direct %i, fd %i, should be %i)", u.val, v.val, 12 + i);
+		}
+	}
+
+	orb_check_direct(&sub, &updated);
+
+	if (updated) {
+		return test_fail("spurious updated flag after draining the queue");
+	}
+
+	/* an up to date subscriber gets the latest element again */
+	orb_copy_direct(ORB_ID(orb_test_medium_direct), &sub, &u);
+
+	if (u.val != t.val) {
+		return test_fail("copy of latest mismatch: %d expected %d", u.val, t.val);
+	}
+
+	orb_unsubscribe(sfd);
+	orb_unsubscribe_direct(&sub);
+	orb_unadvertise(ptopic);
+
+	return test_note("PASS direct subscriptions");
+}
+
+#ifdef __PX4_POSIX
+int uORBTest::UnitTest::waitset_publisher_entry(char *const argv[])
+{
+	uORBTest::UnitTest &t = uORBTest::UnitTest::instance();
+	return t.waitset_publisher_main();
+}
+
+int uORBTest::UnitTest::waitset_publisher_main()
+{
+	struct orb_test_medium t;
+	memset(&t, 0, sizeof(t));
+
+	/* give the waiter time to block */
+	usleep(20 * 1000);
+
+	t.val = 2;
+	t.time = hrt_absolute_time();
+	orb_publish(ORB_ID(orb_test_medium_waitset), _waitset_pub_medium, &t);
+
+	return OK;
+}
+
+int uORBTest::UnitTest::test_waitset_checks(px4_waitset_t *ws, int sfd, int sfd_medium, orb_advert_t pub)
+{
+	struct orb_test t;
+	struct orb_test_medium tm;
+	memset(&t, 0, sizeof(t));
+
+	if (px4_waitset_add(ws, sfd, POLLIN) != 0 || px4_waitset_add(ws, sfd_medium, POLLIN) != 1) {
+		return test_fail("waitset add failed: %d", errno);
+	}
+
+	if (px4_waitset_add(ws, sfd, POLLIN) >= 0) {
+		return test_fail("waitset add beyond the capacity succeeded");
+	}
+
+	/* nothing published: the wait times out, and not early */
+	hrt_abstime start = hrt_absolute_time();
+	int ret = px4_waitset_wait(ws, 50);
+	hrt_abstime elapsed = hrt_elapsed_time(&start);
+
+	if (ret != 0) {
+		return test_fail("spurious wakeup: %d", ret);
+	}
+
+	if (elapsed < 50 * 1000) {
+		return test_fail("timeout expired early: %u us", (unsigned)elapsed);
+	}
+
+	/* only the published fd is reported */
+	t.val = 1;
+	orb_publish(ORB_ID(orb_test_waitset), pub, &t);
+	ret = px4_waitset_wait(ws, 0);
+
+	if (ret != 1 || !(px4_waitset_revents(ws, 0) & POLLIN) || px4_waitset_revents(ws, 1) != 0) {
+		return test_fail("wrong events after publish: %d (%x, %x)", ret, px4_waitset_revents(ws, 0),
+				 px4_waitset_revents(ws, 1));
+	}
+
+	/* level triggered like px4_poll(): reported again until it is copied */
+	if (px4_waitset_wait(ws, 0) != 1) {
+		return test_fail("unconsumed update not reported again");
+	}
+
+	orb_copy(ORB_ID(orb_test_waitset), sfd, &t);
+
+	if (px4_waitset_wait(ws, 0) != 0) {
+		return test_fail("update reported again after copy");
+	}
+
+	/* a publication from another thread wakes up a blocked wait on the second fd */
+	char *const args[1] = { NULL };
+	int task = px4_task_spawn_cmd("uorb_waitset",
+				      SCHED_DEFAULT,
+				      SCHED_PRIORITY_MAX - 5,
+				      2000,
+				      (px4_main_t)&uORBTest::UnitTest::waitset_publisher_entry,
+				      args);
+
+	if (task < 0) {
+		return test_fail("failed launching task");
+	}
+
+	start = hrt_absolute_time();
+	ret = px4_waitset_wait(ws, 1000);
+	elapsed = hrt_elapsed_time(&start);
+
+	if (ret != 1 || px4_waitset_revents(ws, 0) != 0 || !(px4_waitset_revents(ws, 1) & POLLIN)) {
+		return test_fail("wrong events after wakeup: %d (%x, %x)", ret, px4_waitset_revents(ws, 0),
+				 px4_waitset_revents(ws, 1));
+	}
+
+	if (elapsed >= 1000 * 1000) {
+		return test_fail("woken up by the timeout");
+	}
+
+	orb_copy(ORB_ID(orb_test_medium_waitset), sfd_medium, &tm);
+
+	if (tm.val != 2) {
+		return test_fail("copy mismatch: %d expected 2", tm.val);
+	}
+
+	/* a removed fd is no longer reported */
+	if (px4_waitset_remove(ws, sfd) != PX4_OK) {
+		return test_fail("waitset remove failed");
+	}
+
+	if (px4_waitset_remove(ws, sfd) == PX4_OK) {
+		return test_fail("removed an fd twice");
+	}
+
+	t.val = 3;
+	orb_publish(ORB_ID(orb_test_waitset), pub, &t);
+
+	if (px4_waitset_wait(ws, 10) != 0) {
+		return test_fail("removed fd reported");
+	}
+
+	/* added again it reuses the free slot and reports the pending update */
+	if (px4_waitset_add(ws, sfd, POLLIN) != 0) {
+		return test_fail("waitset add into the free slot failed");
+	}
+
+	if (px4_waitset_wait(ws, 0) != 1 || !(px4_waitset_revents(ws, 0) & POLLIN)) {
+		return test_fail("pending update not reported after add");
+	}
+
+	orb_copy(ORB_ID(orb_test_waitset), sfd, &t);
+
+	if (t.val != 3) {
+		return test_fail("copy mismatch: %d expected 3", t.val);
+	}
+
+	return OK;
+}
+
+int uORBTest::UnitTest::test_waitset()
+{
+	test_note("Testing wait sets");
+
+	struct orb_test t;
+	struct orb_test_medium tm;
+	memset(&t, 0, sizeof(t));
+	memset(&tm, 0, sizeof(tm));
+
+	orb_advert_t pub = orb_advertise(ORB_ID(orb_test_waitset), &t);
+	_waitset_pub_medium = orb_advertise(ORB_ID(orb_test_medium_waitset), &tm);
+
+	if (pub == nullptr || _waitset_pub_medium == nullptr) {
+		return test_fail("advertise failed: %d", errno);
+	}
+
+	int sfd = orb_subscribe(ORB_ID(orb_test_waitset));
+	int sfd_medium = orb_subscribe(ORB_ID(orb_test_medium_waitset));
+
+	if (sfd < 0 || sfd_medium < 0) {
+		return test_fail("subscribe failed: %d", errno);
+	}
+
+	/* consume the advertisements */
+	orb_copy(ORB_ID(orb_test_waitset), sfd, &t);
+	orb_copy(ORB_ID(orb_test_medium_waitset), sfd_medium, &tm);
+
+	px4_waitset_t ws;
+
+	if (px4_waitset_init(&ws, 2) != PX4_OK) {
+		return test_fail("waitset init failed");
+	}
+
+	/* the drivers reference the wait set, so always tear it down */
+	int ret = test_waitset_checks(&ws, sfd, sfd_medium, pub);
+
+	px4_waitset_deinit(&ws);
+	orb_unsubscribe(sfd);
+	orb_unsubscribe(sfd_medium);
+	orb_unadvertise(pub);
+	orb_unadvertise(_waitset_pub_medium);
+
+	if (ret != OK) {
+		return ret;
+	}
+
+	return test_note("PASS wait sets");
+}
+
+int uORBTest::UnitTest::test_subscribers_idle()
+{
+	test_note("Testing idle subscribers");
+
+	struct orb_test t;
+	memset(&t, 0, sizeof(t));
+
+	orb_advert_t pub = orb_advertise(ORB_ID(orb_test_idle), &t);
+	int sfd = orb_subscribe(ORB_ID(orb_test_idle));
+
+	if (pub == nullptr || sfd < 0) {
+		return test_fail("advertise or subscribe failed: %d", errno);
+	}
+
+	char nodepath[uORB::orb_maxpath] = {};
+	uORB::DeviceNode *node = nullptr;
+
+	if (uORB::Utils::node_mkpath(nodepath, uORB::PUBSUB, ORB_ID(orb_test_idle)) == OK) {
+		node = uORB::DeviceMaster::GetDeviceNode(nodepath);
+	}
+
+	int ret = OK;
+	bool updated;
+	px4_pollfd_struct_t fds;
+	fds.fd = sfd;
+	fds.events = POLLIN;
+
+	if (node == nullptr) {
+		ret = test_fail("no device node for %s", nodepath);
+
+	} else if (!node->subscribers_idle()) {
+		ret = test_fail("subscriber that never polled is waited for");
+
+	} else if (orb_publish(ORB_ID(orb_test_idle), pub, &t) != OK || px4_poll(&fds, 1, 0) != 1
+		   || node->subscribers_idle()) {
+		/* returned from poll with an update: busy until it polls again */
+		ret = test_fail("poller not waited for after its poll returned");
+
+	} else if (orb_copy(ORB_ID(orb_test_idle), sfd, &t) != OK || orb_check(sfd, &updated) != OK
+		   || node->subscribers_idle()) {
+		ret = test_fail("poller not waited for after one orb_check()");
+
+	} else if (orb_check(sfd, &updated) != OK || !node->subscribers_idle()) {
+		/* checks twice without polling, like from a usleep() loop */
+		ret = test_fail("subscriber that switched to orb_check() is waited for");
+
+	} else if (orb_publish(ORB_ID(orb_test_idle), pub, &t) != OK || !node->subscribers_idle()) {
+		ret = test_fail("update for an orb_check() subscriber is waited for");
+
+	} else if (px4_poll(&fds, 1, 0) != 1 || node->subscribers_idle()) {
+		ret = test_fail("subscriber not waited for after polling again");
+	}
+
+	orb_unsubscribe(sfd);
+	orb_unadvertise(pub);
+
+	if (ret != OK) {
+		return ret;
+	}
+
+	return test_note("PASS idle subscribers");
+}
+#endif
+
+int uORBTest::UnitTest::bench_subscriber_entry(char *const argv[])
+{
+	uORBTest::UnitTest &t = uORBTest::UnitTest::instance();
+	return t.bench_subscriber_main();
+}
+
+int uORBTest::UnitTest::bench_subscriber_main()
+{
+	const unsigned iterations = bench_iterations;
+	struct orb_test_medium t;
+	bool updated;
+	hrt_abstime start;
+
+	if (_bench_direct) {
+		orb_sub_direct_t sub;
+		orb_subscribe_direct(ORB_ID(orb_test_medium_bench), 0, &sub);
+
+		start = hrt_absolute_time();
+
+		for (unsigned i = 0; i < iterations; ++i) {
+			orb_check_direct(&sub, &updated);
+			orb_copy_direct(ORB_ID(orb_test_medium_bench), &sub, &t);
+		}
+
+		__sync_fetch_and_add(&_bench_elapsed, hrt_elapsed_time(&start));
+		orb_unsubscribe_direct(&sub);
+
+	} else {
+		int sfd = orb_subscribe(ORB_ID(orb_test_medium_bench));
+
+		start = hrt_absolute_time();
+
+		for (unsigned i = 0; i < iterations; ++i) {
+			orb_check(sfd, &updated);
+			orb_copy(ORB_ID(orb_test_medium_bench), sfd, &t);
+		}
+
+		__sync_fetch_and_add(&_bench_elapsed, hrt_elapsed_time(&start));
+		orb_unsubscribe(sfd);
+	}
+
+	__sync_fetch_and_sub(&_bench_running, 1);
+
+	return iterations;
+}
+
+int uORBTest::UnitTest::direct_benchmark()
+{
+	test_note("---------------- DIRECT SUBSCRIPTION BENCHMARK ------------------");
+
+	const unsigned iterations = bench_iterations;
+	const int subscriber_counts[] = { 1, 4, 16 };
+	struct orb_test_medium t;
+	memset(&t, 0, sizeof(t));
+
+	orb_advert_t ptopic = orb_advertise(ORB_ID(orb_test_medium_bench), &t);
+
+	if (ptopic == nullptr) {
+		return test_fail("advertise failed: %d", errno);
+	}
+
+	double single_ns_per_op[2] = {};
+
+	for (int num_subscribers : subscriber_counts) {
+		for (int direct = 0; direct < 2; ++direct) {
+			_bench_direct = direct;
+			_bench_elapsed = 0;
+			_bench_running = num_subscribers;
+
+			for (int i = 0; i < num_subscribers; ++i) {
+				char *const args[1] = { NULL };
+				int task = px4_task_spawn_cmd("uorb_bench",
+							      SCHED_DEFAULT,
+							      SCHED_PRIORITY_MAX - 5,
+							      2000,
+							      (px4_main_t)&uORBTest::UnitTest::bench_subscriber_entry,
+							      args);
+
+				if (task < 0) {
+					return test_fail("failed launching task");
+				}
+			}
+
+			/* keep publishing at ~1 kHz while the subscribers are running */
+			while (_bench_running > 0) {
+				++t.val;
+				t.time = hrt_absolute_time();
+				orb_publish(ORB_ID(orb_test_medium_bench), ptopic, &t);
+				usleep(1000);
+			}
+
+			/* one op is an orb_check() followed by an orb_copy() */
+			double ns_per_op = (double)_bench_elapsed * 1000.0 / ((double)iterations * num_subscribers);
+
+			if (num_subscribers == 1) {
+				single_ns_per_op[direct] = ns_per_op;
+			}
+
+			PX4_INFO("%-6s %2i subscribers: %8.1f ns/op, contention factor %.2f",
+				 direct ? "direct" : "fd", num_subscribers, ns_per_op,
+				 single_ns_per_op[direct] > 0.0 ? ns_per_op / single_ns_per_op[direct] : 1.0);
+		}
+	}
+
+	orb_unadvertise(ptopic);
+
+	return OK;
+}
+
+int uORBTest::UnitTest::contention_reader_entry(char *const argv[])
+{
+	uORBTest::UnitTest &t = uORBTest::UnitTest::instance();
+	return t.contention_reader_main();
+}
+
+int uORBTest::UnitTest::contention_reader_main()
+{
+	/* readers cycle through the three read paths */
+	const int mode = __sync_fetch_and_add(&_contention_reader_index, 1) % 3;
+	struct orb_test_large t;
+	orb_sub_direct_t sub;
+	int reads = 0;
+
+	/* every reader blocks on the fd, so that it can not starve the publisher on a single core */
+	int sfd = orb_subscribe(ORB_ID(orb_test_large_contention));
+
+	if (mode != 0) {
+		orb_subscribe_direct(ORB_ID(orb_test_large_contention), 0, &sub);
+	}
+
+	px4_pollfd_struct_t fds[1];
+	fds[0].fd = sfd;
+	fds[0].events = POLLIN;
+
+	while (_contention_running) {
+		const struct orb_test_large *data = &t;
+
+		if (px4_poll(fds, 1, 100) <= 0) {
+			continue;
+		}
+
+		/* clears the update flag of the fd, the direct modes read again below */
+		orb_copy(ORB_ID(orb_test_large_contention), sfd, &t);
+
+		if (mode == 1) {
+			orb_copy_direct(ORB_ID(orb_test_large_contention), &sub, &t);
+
+		} else if (mode == 2) {
+			unsigned token;
+			data = (const struct orb_test_large *)orb_borrow_direct(ORB_ID(orb_test_large_contention), &sub, &token);
+
+			if (data == nullptr) {
+				continue;
+			}
+
+			memcpy(&t, data, sizeof(t));
+
+			if (!orb_borrow_valid(&sub, token)) {
+				/* raced with a publication: the borrow was undone, the next pass reads it again */
+				continue;
+			}
+
+			data = &t;
+		}
+
+		/* the publisher fills the whole message with the same value */
+		for (unsigned i = 0; i < sizeof(data->junk); ++i) {
+			if (data->junk[i] != (char)data->val) {
+				__sync_fetch_and_add(&_contention_errors, 1);
+				break;
+			}
+		}
+
+		++reads;
+	}
+
+	if (mode != 0) {
+		orb_unsubscribe_direct(&sub);
+	}
+
+	orb_unsubscribe(sfd);
+
+	__sync_fetch_and_sub(&_contention_readers, 1);
+
+	return reads;
+}
+
+static int compare_latency(const void *a, const void *b)
+{
+	const unsigned la = *(const unsigned *)a;
+	const unsigned lb = *(const unsigned *)b;
+	return (la > lb) - (la < lb);
+}
+
+int uORBTest::UnitTest::contention_test(int num_readers, unsigned num_publications, bool print)
+{
+	test_note("Testing publication under read contention (%i readers)", num_readers);
+
+	struct orb_test_large t;
+	memset(&t, 0, sizeof(t));
+
+	orb_advert_t ptopic = orb_advertise_queue(ORB_ID(orb_test_large_contention), &t, 4);
+
+	if (ptopic == nullptr) {
+		return test_fail("advertise failed: %d", errno);
+	}
+
+	unsigned *latencies = new unsigned[num_publications];
+
+	if (latencies == nullptr) {
+		return test_fail("alloc failed");
+	}
+
+	_contention_errors = 0;
+	_contention_reader_index = 0;
+	_contention_readers = num_readers;
+	_contention_running = true;
+
+	for (int i = 0; i < num_readers; ++i) {
+		char *const args[1] = { NULL };
+		/* below the publisher, which runs at the priority of the calling shell */
+		int task = px4_task_spawn_cmd("uorb_contention",
+					      SCHED_DEFAULT,
+					      SCHED_PRIORITY_DEFAULT - 10,
+					      2000,
+					      (px4_main_t)&uORBTest::UnitTest::contention_reader_entry,
+					      args);
+
+		if (task < 0) {
+			_contention_running = false;
+			delete[] latencies;
+			return test_fail("failed launching task");
+		}
+	}
+
+	/* let the readers start up */
+	usleep(10 * 1000);
+
+	for (unsigned i = 0; i < num_publications; ++i) {
+		t.val = i;
+		memset(t.junk, (char)t.val, sizeof(t.junk));
+
+		hrt_abstime start = hrt_absolute_time();
+		t.time = start;
+		orb_publish(ORB_ID(orb_test_large_contention), ptopic, &t);
+		latencies[i] = hrt_elapsed_time(&start);
+
+		usleep(100);
+	}
+
+	_contention_running = false;
+
+	while (_contention_readers > 0) {
+		usleep(1000);
+	}
+
+	orb_unadvertise(ptopic);
+
+	qsort(latencies, num_publications, sizeof(latencies[0]), compare_latency);
+
+	const unsigned p50 = latencies[num_publications / 2];
+	const unsigned p99 = latencies[num_publications * 99 / 100];
+	const unsigned p999 = latencies[num_publications * 999 / 1000];
+	const unsigned max = latencies[num_publications - 1];
+
+	delete[] latencies;
+
+	if (print) {
+		PX4_INFO("publish latency: p50 %u us, p99 %u us, p99.9 %u us, max %u us", p50, p99, p999, max);
+	}
+
+	if (_contention_errors > 0) {
+		return test_fail("%i inconsistent reads", _contention_errors);
+	}
+
+	return test_note("PASS publication under read contention (p50 %u us, p99 %u us)", p50, p99);
+}
+
+int uORBTest::UnitTest::wakeup_waiter_entry(char *const argv[])
+{
+	uORBTest::UnitTest &t = uORBTest::UnitTest::instance();
+	return t.wakeup_waiter_main();
+}
+
+int uORBTest::UnitTest::wakeup_waiter_main()
+{
+	struct orb_test_medium t;
+	int sfd = orb_subscribe(ORB_ID(orb_test_medium_wakeup));
+
+#ifdef __PX4_POSIX
+	px4_waitset_t ws;
+
+	if (_wakeup_waitset) {
+		px4_waitset_init(&ws, 1);
+		px4_waitset_add(&ws, sfd, POLLIN);
+	}
+
+#endif
+
+	_wakeup_waiting = true;
+
+	while (_wakeup_running) {
+		int ret;
+
+#ifdef __PX4_POSIX
+
+		if (_wakeup_waitset) {
+			ret = px4_waitset_wait(&ws, 100);
+
+		} else
+#endif
+		{
+			px4_pollfd_struct_t fds[1];
+			fds[0].fd = sfd;
+			fds[0].events = POLLIN;
+			ret = px4_poll(fds, 1, 100);
+		}
+
+		const hrt_abstime now = hrt_absolute_time();
+
+		if (ret > 0) {
+			orb_copy(ORB_ID(orb_test_medium_wakeup), sfd, &t);
+
+			if (_wakeup_count < wakeup_samples) {
+				_wakeup_latencies[_wakeup_count++] = now - t.time;
+			}
+		}
+	}
+
+#ifdef __PX4_POSIX
+
+	if (_wakeup_waitset) {
+		px4_waitset_deinit(&ws);
+	}
+
+#endif
+
+	orb_unsubscribe(sfd);
+	_wakeup_waiting = false;
+
+	return OK;
+}
+
+int uORBTest::UnitTest::wakeup_run(bool waitset, const char *name)
+{
+	struct orb_test_medium t;
+	memset(&t, 0, sizeof(t));
+
+	orb_advert_t ptopic = orb_advertise(ORB_ID(orb_test_medium_wakeup), &t);
+
+	if (ptopic == nullptr) {
+		return test_fail("advertise failed: %d", errno);
+	}
+
+	_wakeup_waitset = waitset;
+	_wakeup_count = 0;
+	_wakeup_waiting = false;
+	_wakeup_running = true;
+
+	char *const args[1] = { NULL };
+	int task = px4_task_spawn_cmd("uorb_wakeup",
+				      SCHED_DEFAULT,
+				      SCHED_PRIORITY_MAX - 5,
+				      2000,
+				      (px4_main_t)&uORBTest::UnitTest::wakeup_waiter_entry,
+				      args);
+
+	if (task < 0) {
+		_wakeup_running = false;
+		orb_unadvertise(ptopic);
+		return test_fail("failed launching task");
+	}
+
+	while (!_wakeup_waiting) {
+		usleep(1000);
+	}
+
+	/* let the waiter consume the initial advertisement */
+	usleep(10 * 1000);
+
+	for (unsigned i = 0; i < wakeup_samples; ++i) {
+		++t.val;
+		t.time = hrt_absolute_time();
+		orb_publish(ORB_ID(orb_test_medium_wakeup), ptopic, &t);
+		usleep(1000);
+	}
+
+	_wakeup_running = false;
+
+	while (_wakeup_waiting) {
+		usleep(1000);
+	}
+
+	orb_unadvertise(ptopic);
+
+	const unsigned count = _wakeup_count;
+
+	if (count == 0) {
+		return test_fail("no wakeups");
+	}
+
+	qsort(_wakeup_latencies, count, sizeof(_wakeup_latencies[0]), compare_latency);
+
+	PX4_INFO("%-20s wakeup latency: p50 %u us, p99 %u us, max %u us (%u samples)",
+		 name, _wakeup_latencies[count / 2], _wakeup_latencies[count * 99 / 100],
+		 _wakeup_latencies[count - 1], count);
+
+	return OK;
+}
+
+int uORBTest::UnitTest::wakeup_benchmark()
+{
+	test_note("---------------- WAKEUP LATENCY BENCHMARK ------------------");
+
+	_wakeup_latencies = new unsigned[wakeup_samples];
+
+	if (_wakeup_latencies == nullptr) {
+		return test_fail("alloc failed");
+	}
+
+#ifdef __PX4_POSIX
+	/* the px4_poll() implementation from before wait sets, for comparison */
+	px4_poll_use_semaphore(true);
+	int ret = wakeup_run(false, "px4_poll (semaphore)");
+	px4_poll_use_semaphore(false);
+
+	if (ret == OK) {
+		ret = wakeup_run(false, "px4_poll");
+	}
+
+	if (ret == OK) {
+		ret = wakeup_run(true, "waitset");
+	}
+
+#else
+	int ret = wakeup_run(false, "px4_poll");
+#endif
+
+	delete[] _wakeup_latencies;
+	_wakeup_latencies = nullptr;
+
+	return ret;
+}
+
+int uORBTest::UnitTest::startup_benchmark()
+{
+	test_note("---------------- STARTUP BENCHMARK ------------------");
+
+	/*
+	 * This mimics the advertise/subscribe burst of a system startup, so it is
+	 * meant to be run before the flight stack is started: topics that do not
+	 * exist yet are advertised with zeroed data.
+	 */
+	const size_t num_topics = orb_topics_count();
+	const struct orb_metadata **topics = orb_get_topics();
+
+	orb_advert_t *adverts = new orb_advert_t[num_topics];
+	int *subs = new int[num_topics];
+
+	if (adverts == nullptr || subs == nullptr) {
+		delete[] adverts;
+		delete[] subs;
+		return test_fail("alloc failed");
+	}
+
+	unsigned num_advertised = 0;
+	hrt_abstime advertise_time = 0;
+	hrt_abstime subscribe_time = 0;
+
+	for (size_t i = 0; i < num_topics; ++i) {
+		adverts[i] = nullptr;
+
+		if (orb_exists(topics[i], 0) == PX4_OK) {
+			continue;
+		}
+
+		void *data = calloc(1, topics[i]->o_size);
+
+		if (data == nullptr) {
+			continue;
+		}
+
+		hrt_abstime start = hrt_absolute_time();
+		adverts[i] = orb_advertise(topics[i], data);
+		advertise_time += hrt_elapsed_time(&start);
+
+		if (adverts[i] != nullptr) {
+			++num_advertised;
+		}
+
+		free(data);
+	}
+
+	hrt_abstime start = hrt_absolute_time();
+
+	for (size_t i = 0; i < num_topics; ++i) {
+		subs[i] = orb_subscribe(topics[i]);
+	}
+
+	subscribe_time = hrt_elapsed_time(&start);
+
+	for (size_t i = 0; i < num_topics; ++i) {
+		if (subs[i] >= 0) {
+			orb_unsubscribe(subs[i]);
+		}
+
+		if (adverts[i] != nullptr) {
+			orb_unadvertise(adverts[i]);
+		}
+	}
+
+	delete[] adverts;
+	delete[] subs;
+
+	PX4_INFO("advertised %u of %u topics in %.3f ms (%.1f us/topic)", num_advertised, (unsigned)num_topics,
+		 advertise_time / 1e3, num_advertised > 0 ? (double)advertise_time / num_advertised : 0.0);
+	PX4_INFO("subscribed %u topics in %.3f ms (%.1f us/topic)", (unsigned)num_topics,
+		 subscribe_time / 1e3, num_topics > 0 ? (double)subscribe_time / num_topics : 0.0);
+	PX4_INFO("total: %.3f ms", (advertise_time + subscribe_time) / 1e3);
+
+	return OK;
+}
+
 int uORBTest::UnitTest::test_fail(const char *fmt, ...)
 {
 	va_list ap;
@@ -43,6 +43,8 @@ struct orb_test {
 };
 ORB_DEFINE(orb_test, struct orb_test, sizeof(orb_test), "ORB_TEST:int val;hrt_abstime time;");
 ORB_DEFINE(orb_multitest, struct orb_test, sizeof(orb_test), "ORB_MULTITEST:int val;hrt_abstime time;");
+ORB_DEFINE(orb_test_waitset, struct orb_test, sizeof(orb_test), "ORB_TEST:int val;hrt_abstime time;");
+ORB_DEFINE(orb_test_idle, struct orb_test, sizeof(orb_test), "ORB_TEST:int val;hrt_abstime time;");
 
 
 struct orb_test_medium {
@@ -58,6 +60,14 @@ ORB_DEFINE(orb_test_medium_queue, struct orb_test_medium, sizeof(orb_test_medium
 	   "ORB_TEST_MEDIUM_MULTI:int val;hrt_abstime time;char[64] junk;");
 ORB_DEFINE(orb_test_medium_queue_poll, struct orb_test_medium, sizeof(orb_test_medium),
 	   "ORB_TEST_MEDIUM_MULTI:int val;hrt_abstime time;char[64] junk;");
+ORB_DEFINE(orb_test_medium_direct, struct orb_test_medium, sizeof(orb_test_medium),
+	   "ORB_TEST_MEDIUM_MULTI:int val;hrt_abstime time;char[64] junk;");
+ORB_DEFINE(orb_test_medium_bench, struct orb_test_medium, sizeof(orb_test_medium),
+	   "ORB_TEST_MEDIUM_MULTI:int val;hrt_abstime time;char[64] junk;");
+ORB_DEFINE(orb_test_medium_wakeup, struct orb_test_medium, sizeof(orb_test_medium),
+	   "ORB_TEST_MEDIUM_MULTI:int val;hrt_abstime time;char[64] junk;");
+ORB_DEFINE(orb_test_medium_waitset, struct orb_test_medium, sizeof(orb_test_medium),
+	   "ORB_TEST_MEDIUM_MULTI:int val;hrt_abstime time;char[64] junk;");
 
 struct orb_test_large {
 	int val;
@@ -66,6 +76,8 @@ struct orb_test_large {
 };
 ORB_DEFINE(orb_test_large, struct orb_test_large, sizeof(orb_test_large),
 	   "ORB_TEST_LARGE:int val;hrt_abstime time;char[512] junk;");
+ORB_DEFINE(orb_test_large_contention, struct orb_test_large, sizeof(orb_test_large),
+	   "ORB_TEST_LARGE:int val;hrt_abstime time;char[512] junk;");
 
 
 namespace uORBTest
@@ -83,6 +95,10 @@ public:
 	int test();
 	template<typename S> int latency_test(orb_id_t T, bool print);
 	int info();
+	int direct_benchmark();
+	int startup_benchmark();
+	int contention_test(int num_readers, unsigned num_publications, bool print);
+	int wakeup_benchmark();
 
 private:
 	UnitTest() : pubsubtest_passed(false), pubsubtest_print(false) {}
@@ -119,6 +135,46 @@ private:
 	int test_queue_poll_notify();
 	volatile int _num_messages_sent = 0;
 
+	/* direct subscription tests */
+	int test_direct();
+	static int bench_subscriber_entry(char *const argv[]);
+	int bench_subscriber_main();
+	static const unsigned bench_iterations = 20000; ///< check & copy calls per subscriber
+	volatile bool _bench_direct = false;
+	volatile int _bench_running = 0;
+	volatile uint64_t _bench_elapsed = 0; ///< sum of the per-subscriber run times [us]
+
+#ifdef __PX4_POSIX
+	/* wait set tests */
+	int test_waitset();
+	int test_waitset_checks(px4_waitset_t *ws, int sfd, int sfd_medium, orb_advert_t pub);
+	static int waitset_publisher_entry(char *const argv[]);
+	int waitset_publisher_main();
+	orb_advert_t _waitset_pub_medium = nullptr;
+
+	/* lockstep replay: which subscribers are waited for */
+	int test_subscribers_idle();
+#endif
+
+	/* publish/read contention test */
+	static int contention_reader_entry(char *const argv[]);
+	int contention_reader_main();
+	volatile bool _contention_running = false;
+	volatile int _contention_reader_index = 0;
+	volatile int _contention_readers = 0;
+	volatile int _contention_errors = 0; ///< number of inconsistent reads
+
+	/* publish to subscriber wakeup latency */
+	static int wakeup_waiter_entry(char *const argv[]);
+	int wakeup_waiter_main();
+	int wakeup_run(bool waitset, const char *name);
+	static const unsigned wakeup_samples = 2000;
+	bool _wakeup_waitset = false; ///< wait with a persistent wait set instead of px4_poll()
+	unsigned *_wakeup_latencies = nullptr;
+	volatile unsigned _wakeup_count = 0;
+	volatile bool _wakeup_running = false;
+	volatile bool _wakeup_waiting = false;
+
 	int test_fail(const char *fmt, ...);
 	int test_note(const char *fmt, ...);
 };
@@ -32,6 +32,7 @@
  ****************************************************************************/
 
 #include <string.h>
+#include <stdlib.h>
 #include "../uORBDevices.hpp"
 #include "../uORB.h"
 #include "../uORBCommon.hpp"
@@ -44,7 +45,7 @@ extern "C" { __EXPORT int uorb_tests_main(int argc, char *argv[]); }
 
 static void usage()
 {
-	PX4_INFO("Usage: uorb_test 'latency_test'");
+	PX4_INFO("Usage: uorb_test 'latency_test' | 'direct_bench' | 'contention [num_readers]' | 'startup_bench' | 'wakeup_bench'");
 }
 
 int
@@ -90,6 +91,39 @@ uorb_tests_main(int argc, char *argv[])
 		}
 	}
 
+	/*
+	 * Compare the file descriptor and direct subscription paths.
+	 */
+	if (argc > 1 && !strcmp(argv[1], "direct_bench")) {
+		uORBTest::UnitTest &t = uORBTest::UnitTest::instance();
+		return t.direct_benchmark();
+	}
+
+	/*
+	 * Advertise and subscribe all topics, like during startup.
+	 */
+	if (argc > 1 && !strcmp(argv[1], "startup_bench")) {
+		uORBTest::UnitTest &t = uORBTest::UnitTest::instance();
+		return t.startup_benchmark();
+	}
+
+	/*
+	 * Publish latency while many readers access the same topic.
+	 */
+	if (argc > 1 && !strcmp(argv[1], "contention")) {
+		uORBTest::UnitTest &t = uORBTest::UnitTest::instance();
+		int num_readers = (argc > 2) ? atoi(argv[2]) : 16;
+		return t.contention_test(num_readers, 20000, true);
+	}
+
+	/*
+	 * Time from a publication until the subscriber wakes up.
+	 */
+	if (argc > 1 && !strcmp(argv[1], "wakeup_bench")) {
+		uORBTest::UnitTest &t = uORBTest::UnitTest::instance();
+		return t.wakeup_benchmark();
+	}
+
 #endif
 
 	usage();
@@ -410,6 +410,7 @@ void Standard::fill_actuator_outputs()
 {
 	/* multirotor controls */
 	_actuators_out_0->timestamp = _actuators_mc_in->timestamp;
+	_actuators_out_0->timestamp_sample = _actuators_mc_in->timestamp_sample;
 	_actuators_out_0->control[actuator_controls_s::INDEX_ROLL] = _actuators_mc_in->control[actuator_controls_s::INDEX_ROLL]
 			* _mc_roll_weight;	// roll
 
@@ -424,6 +425,7 @@ void Standard::fill_actuator_outputs()
 
 	/* fixed wing controls */
 	_actuators_out_1->timestamp = _actuators_fw_in->timestamp;
+	_actuators_out_1->timestamp_sample = _actuators_fw_in->timestamp_sample;
 	_actuators_out_1->control[actuator_controls_s::INDEX_ROLL] = -_actuators_fw_in->control[actuator_controls_s::INDEX_ROLL]
 			* (1 - _mc_roll_weight);	//roll
 	_actuators_out_1->control[actuator_controls_s::INDEX_PITCH] =
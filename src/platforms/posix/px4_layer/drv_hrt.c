@@ -47,6 +47,7 @@
 #include <string.h>
 #include <inttypes.h>
 #include <errno.h>
+#include <unistd.h>
 #include "hrt_work.h"
 
 static struct sq_queue_s	callout_queue;
@@ -70,11 +71,37 @@ static hrt_abstime px4_timestart = 0;
 #else
 static int32_t dsp_offset = 0;
 #endif
+
+/*
+ * The clock state below is changed rarely (by the simulator and replay) but
+ * read by every hrt_absolute_time() call. Writers serialise on _hrt_mutex and
+ * publish through the _hrt_seq sequence lock, so readers usually do not block.
+ * A reader that keeps seeing a write in progress has probably preempted the
+ * writer on the same core, after HRT_STATE_READ_RETRIES it waits for the
+ * writer on _hrt_mutex instead of spinning.
+ */
 static hrt_abstime _start_delay_time = 0;
 static hrt_abstime _delay_interval = 0;
-static hrt_abstime max_time = 0;
+static bool _external_time_enabled = false;
+static hrt_abstime _external_time = 0;
+static uint32_t _hrt_seq = 0;		/**< odd while a writer changes the clock state */
+#define HRT_STATE_READ_RETRIES 16
 pthread_mutex_t _hrt_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+#ifndef __PX4_QURT
+/*
+ * Timeouts waiting for the external clock, sorted by deadline. The thread
+ * setting the external time must not wait for it, it keeps the system clock.
+ */
+static struct hrt_external_wait *_external_waits = NULL;
+static pthread_mutex_t _external_wait_mutex = PTHREAD_MUTEX_INITIALIZER;
+static __thread bool _external_time_owner = false;
+#endif
+
+#if (defined(__APPLE__) && defined(__MACH__))
+static hrt_abstime max_time = 0;	/**< latest time returned, gettimeofday() can step back */
+#endif
+
 static void
 hrt_call_invoke(void);
 
@@ -93,6 +120,33 @@ static void hrt_unlock(void)
 	px4_sem_post(&_hrt_lock);
 }
 
+static void hrt_state_write_begin(void)
+{
+	pthread_mutex_lock(&_hrt_mutex);
+	__atomic_store_n(&_hrt_seq, _hrt_seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void hrt_state_write_end(void)
+{
+	__atomic_store_n(&_hrt_seq, _hrt_seq + 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&_hrt_mutex);
+}
+
+static inline bool hrt_state_read_begin(uint32_t *seq)
+{
+	*seq = __atomic_load_n(&_hrt_seq, __ATOMIC_ACQUIRE);
+
+	/* odd while a write is in progress */
+	return !(*seq & 1);
+}
+
+static inline bool hrt_state_read_retry(uint32_t seq)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&_hrt_seq, __ATOMIC_RELAXED) != seq;
+}
+
 #if (defined(__APPLE__) && defined(__MACH__))
 #include <time.h>
 #include <sys/time.h>
@@ -171,14 +225,20 @@ hrt_abstime _hrt_absolute_time_internal(void)
 	return ts_to_abstime(&ts);
 
 #else
+	hrt_abstime timestart = __atomic_load_n(&px4_timestart, __ATOMIC_RELAXED);
 
-	if (!px4_timestart) {
+	if (!timestart) {
 		px4_clock_gettime(CLOCK_MONOTONIC, &ts);
-		px4_timestart = ts_to_abstime(&ts);
+		hrt_abstime now = ts_to_abstime(&ts);
+
+		/* the first caller sets the start, everybody else uses that one */
+		if (__atomic_compare_exchange_n(&px4_timestart, &timestart, now, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+			timestart = now;
+		}
 	}
 
 	px4_clock_gettime(CLOCK_MONOTONIC, &ts);
-	return ts_to_abstime(&ts) - px4_timestart;
+	return ts_to_abstime(&ts) - timestart;
 #endif
 }
 
@@ -193,38 +253,94 @@ int hrt_set_absolute_time_offset(int32_t time_diff_us)
 /*
  * Get absolute time.
  */
-hrt_abstime hrt_absolute_time(void)
+static inline hrt_abstime hrt_state_read_time(bool *external)
 {
-	pthread_mutex_lock(&_hrt_mutex);
-
 	hrt_abstime ret;
 
-	if (_start_delay_time > 0) {
-		ret = _start_delay_time;
+	*external = __atomic_load_n(&_external_time_enabled, __ATOMIC_RELAXED);
+
+	if (*external) {
+		ret = __atomic_load_n(&_external_time, __ATOMIC_RELAXED);
 
 	} else {
-		ret = _hrt_absolute_time_internal();
+		hrt_abstime start_delay_time = __atomic_load_n(&_start_delay_time, __ATOMIC_RELAXED);
+
+		if (start_delay_time > 0) {
+			ret = start_delay_time;
+
+		} else {
+			ret = _hrt_absolute_time_internal();
+		}
+
+		ret -= __atomic_load_n(&_delay_interval, __ATOMIC_RELAXED);
+	}
+
+	return ret;
+}
+
+hrt_abstime hrt_absolute_time(void)
+{
+	hrt_abstime ret;
+	bool external;
+	uint32_t seq;
+	unsigned retries = 0;
+
+	for (;;) {
+		if (++retries > HRT_STATE_READ_RETRIES) {
+			/* the writer may be preempted by this thread, let it finish */
+			pthread_mutex_lock(&_hrt_mutex);
+			ret = hrt_state_read_time(&external);
+			pthread_mutex_unlock(&_hrt_mutex);
+			break;
+		}
+
+		if (!hrt_state_read_begin(&seq)) {
+			continue;
+		}
+
+		ret = hrt_state_read_time(&external);
+
+		if (!hrt_state_read_retry(seq)) {
+			break;
+		}
 	}
 
-	ret -= _delay_interval;
+	/*
+	 * CLOCK_MONOTONIC does not go back, and the delay and external time are
+	 * kept monotonic when they are set. Only the gettimeofday() fallback
+	 * needs clamping.
+	 */
+#if (defined(__APPLE__) && defined(__MACH__))
+	hrt_abstime last = __atomic_load_n(&max_time, __ATOMIC_RELAXED);
 
-	if (ret < max_time) {
-		PX4_ERR("WARNING! TIME IS NEGATIVE! %d vs %d", (int)ret, (int)max_time);
-		ret = max_time;
+	while (!external) {
+		if (ret < last) {
+			return last;
+		}
+
+		if (__atomic_compare_exchange_n(&max_time, &last, ret, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+			break;
+		}
 	}
 
-	max_time = ret;
-	pthread_mutex_unlock(&_hrt_mutex);
+#else
+	(void)external;
+#endif
 
 	return ret;
 }
 
 __EXPORT hrt_abstime hrt_reset(void)
 {
+	hrt_state_write_begin();
 #ifndef __PX4_QURT
-	px4_timestart = 0;
+	__atomic_store_n(&px4_timestart, 0, __ATOMIC_RELAXED);
+#endif
+#if (defined(__APPLE__) && defined(__MACH__))
+	__atomic_store_n(&max_time, 0, __ATOMIC_RELAXED);
 #endif
-	max_time = 0;
+	hrt_state_write_end();
+
 	return _hrt_absolute_time_internal();
 }
 
@@ -332,26 +448,231 @@ void	hrt_init(void)
 
 void	hrt_start_delay()
 {
-	pthread_mutex_lock(&_hrt_mutex);
-	_start_delay_time = _hrt_absolute_time_internal();
-	pthread_mutex_unlock(&_hrt_mutex);
+	/* keep the write section short, readers wait for it */
+	hrt_abstime now = _hrt_absolute_time_internal();
+
+	hrt_state_write_begin();
+	__atomic_store_n(&_start_delay_time, now, __ATOMIC_RELAXED);
+	hrt_state_write_end();
 }
 
 void	hrt_stop_delay()
 {
-	pthread_mutex_lock(&_hrt_mutex);
-	uint64_t delta = _hrt_absolute_time_internal() - _start_delay_time;
-	_delay_interval += delta;
-	_start_delay_time = 0;
+	hrt_abstime now = _hrt_absolute_time_internal();
+
+	hrt_state_write_begin();
+
+	if (_start_delay_time == 0) {
+		/* not delayed, the time would jump back */
+		hrt_state_write_end();
+		return;
+	}
+
+	/* a concurrent hrt_start_delay() may have read the clock after us */
+	uint64_t delta = now > _start_delay_time ? now - _start_delay_time : 0;
+	__atomic_store_n(&_delay_interval, _delay_interval + delta, __ATOMIC_RELAXED);
+	__atomic_store_n(&_start_delay_time, 0, __ATOMIC_RELAXED);
+	hrt_state_write_end();
 
 	if (delta > 10000) {
 		PX4_INFO("simulator is slow. Delay added: %" PRIu64 " us", delta);
 	}
+}
 
-	pthread_mutex_unlock(&_hrt_mutex);
+void	hrt_set_external_time(hrt_abstime time)
+{
+	hrt_state_write_begin();
+
+	if (!_external_time_enabled) {
+		/* the time may jump back when switching the clock source */
+		__atomic_store_n(&_external_time_enabled, true, __ATOMIC_RELAXED);
+		__atomic_store_n(&_external_time, time, __ATOMIC_RELAXED);
+
+	} else if (time >= _external_time) {
+		__atomic_store_n(&_external_time, time, __ATOMIC_RELAXED);
+	}
+
+	hrt_abstime external_time = _external_time;
+	hrt_state_write_end();
+
+	if (time < external_time) {
+		PX4_ERR("WARNING! TIME IS NEGATIVE! %" PRIu64 " vs %" PRIu64, time, external_time);
+	}
+
+#ifndef __PX4_QURT
+	_external_time_owner = true;
 
+	/* end the timeouts that expired by now */
+	pthread_mutex_lock(&_external_wait_mutex);
+
+	while (_external_waits != NULL && _external_waits->deadline <= external_time) {
+		struct hrt_external_wait *wait = _external_waits;
+		_external_waits = wait->next;
+		__atomic_store_n(&wait->expired, true, __ATOMIC_RELEASE);
+		wait->wakeup(wait->arg);
+	}
+
+	pthread_mutex_unlock(&_external_wait_mutex);
+#endif
+
+	/* run the callouts that are due by now */
+	hrt_lock();
+	hrt_call_reschedule();
+	hrt_unlock();
+}
+
+void	hrt_clear_external_time(void)
+{
+	hrt_abstime now = _hrt_absolute_time_internal();
+
+	hrt_state_write_begin();
+
+	if (_external_time_enabled) {
+		if (_start_delay_time > 0) {
+			now = _start_delay_time;
+		}
+
+		/* continue from the external time by delaying the system clock, it cannot be advanced */
+		if (now - _delay_interval > _external_time) {
+			__atomic_store_n(&_delay_interval, now - _external_time, __ATOMIC_RELAXED);
+		}
+
+		__atomic_store_n(&_external_time_enabled, false, __ATOMIC_RELAXED);
+	}
+
+	hrt_state_write_end();
+
+#ifndef __PX4_QURT
+	_external_time_owner = false;
+
+	/* nothing advances the external time anymore, end all timeouts */
+	pthread_mutex_lock(&_external_wait_mutex);
+
+	while (_external_waits != NULL) {
+		struct hrt_external_wait *wait = _external_waits;
+		_external_waits = wait->next;
+		__atomic_store_n(&wait->expired, true, __ATOMIC_RELEASE);
+		wait->wakeup(wait->arg);
+	}
+
+	pthread_mutex_unlock(&_external_wait_mutex);
+#endif
+
+	/* the callouts are due on the system clock again */
+	hrt_lock();
+	hrt_call_reschedule();
+	hrt_unlock();
 }
 
+bool	hrt_external_wait_start(struct hrt_external_wait *wait, hrt_abstime timeout,
+				void (*wakeup)(void *arg), void *arg)
+{
+#ifdef __PX4_QURT
+	return false;
+#else
+
+	if (!__atomic_load_n(&_external_time_enabled, __ATOMIC_RELAXED) || _external_time_owner) {
+		return false;
+	}
+
+	wait->wakeup = wakeup;
+	wait->arg = arg;
+	wait->next = NULL;
+	wait->expired = false;
+
+	/* read the time under the lock, so the deadline is either seen by the
+	 * next hrt_set_external_time() or already passed here */
+	pthread_mutex_lock(&_external_wait_mutex);
+
+	/* hrt_clear_external_time() may have ended all timeouts in the meantime */
+	if (!__atomic_load_n(&_external_time_enabled, __ATOMIC_RELAXED)) {
+		pthread_mutex_unlock(&_external_wait_mutex);
+		return false;
+	}
+
+	wait->deadline = __atomic_load_n(&_external_time, __ATOMIC_RELAXED) + timeout;
+
+	if (timeout == 0) {
+		wait->expired = true;
+		wakeup(arg);
+
+	} else {
+		struct hrt_external_wait **link = &_external_waits;
+
+		while (*link != NULL && (*link)->deadline <= wait->deadline) {
+			link = &(*link)->next;
+		}
+
+		wait->next = *link;
+		*link = wait;
+	}
+
+	pthread_mutex_unlock(&_external_wait_mutex);
+	return true;
+#endif
+}
+
+bool	hrt_external_wait_stop(struct hrt_external_wait *wait)
+{
+#ifdef __PX4_QURT
+	return false;
+#else
+	pthread_mutex_lock(&_external_wait_mutex);
+
+	if (!wait->expired) {
+		struct hrt_external_wait **link = &_external_waits;
+
+		while (*link != NULL && *link != wait) {
+			link = &(*link)->next;
+		}
+
+		if (*link != NULL) {
+			*link = wait->next;
+		}
+	}
+
+	bool expired = wait->expired;
+	pthread_mutex_unlock(&_external_wait_mutex);
+	return expired;
+#endif
+}
+
+#ifndef __PX4_QURT
+static void usleep_timeout(void *arg)
+{
+	px4_sem_post((px4_sem_t *)arg);
+}
+
+/*
+ * Replaces usleep() from the C library, so PX4 tasks sleep on the external
+ * clock while the HRT follows it.
+ */
+int usleep(useconds_t usec)
+{
+	struct hrt_external_wait wait;
+	px4_sem_t sem;
+
+	px4_sem_init(&sem, 0, 0);
+
+	if (usec > 0 && hrt_external_wait_start(&wait, usec, usleep_timeout, &sem)) {
+		while (px4_sem_wait(&sem) != 0) {
+			/* interrupted, the timeout still posts the semaphore */
+		}
+
+		(void)hrt_external_wait_stop(&wait);
+		px4_sem_destroy(&sem);
+		return 0;
+	}
+
+	px4_sem_destroy(&sem);
+
+	struct timespec ts;
+	ts.tv_sec = usec / 1000000;
+	ts.tv_nsec = (usec % 1000000) * 1000;
+	return nanosleep(&ts, NULL);
+}
+#endif
+
 static void
 hrt_call_enter(struct hrt_call *entry)
 {
@@ -431,7 +752,12 @@ hrt_call_reschedule()
 	 */
 	if (next != NULL) {
 		//lldbg("entry in queue\n");
-		if (next->deadline <= (now + HRT_INTERVAL_MIN)) {
+		if (next->deadline <= now && __atomic_load_n(&_external_time_enabled, __ATOMIC_RELAXED)) {
+			/* the external time only moves in steps, the minimal deadline
+			 * would be pushed back to the next step every time */
+			delay = 0;
+
+		} else if (next->deadline <= (now + HRT_INTERVAL_MIN)) {
 			//lldbg("pre-expired\n");
 			/* set a minimal deadline so that we call ASAP */
 			delay = HRT_INTERVAL_MIN;
@@ -56,7 +56,8 @@ extern pthread_t _shell_task_id;
 
 __BEGIN_DECLS
 
-long PX4_TICKS_PER_SEC = sysconf(_SC_CLK_TCK);
+/* the work queues run on hrt_absolute_time(), so a tick is one microsecond */
+long PX4_TICKS_PER_SEC = 1000000L;
 
 #ifdef CONFIG_SHMEM
 extern void init_params(void);
@@ -44,6 +44,8 @@
 #include <stdio.h>
 #include <pthread.h>
 #include <errno.h>
+#include <px4_time.h>
+#include <drivers/drv_hrt.h>
 
 #ifdef __PX4_DARWIN
 
@@ -86,7 +88,7 @@ int px4_sem_wait(px4_sem_t *s)
 	return (ret) ? ret : mret;
 }
 
-int px4_sem_timedwait(px4_sem_t *s, const struct timespec *abstime)
+static int px4_sem_timedwait_system(px4_sem_t *s, const struct timespec *abstime)
 {
 	int ret = pthread_mutex_lock(&(s->lock));
 
@@ -106,6 +108,12 @@ int px4_sem_timedwait(px4_sem_t *s, const struct timespec *abstime)
 
 	int err = ret;
 
+	if (err != 0) {
+		/* we did not take the semaphore, give back the count or the
+		 * next post would only cancel out this wait */
+		s->value++;
+	}
+
 	if (err != 0 && err != ETIMEDOUT) {
 		setbuf(stdout, NULL);
 		setbuf(stderr, NULL);
@@ -177,3 +185,49 @@ int px4_sem_destroy(px4_sem_t *s)
 }
 
 #endif
+
+#ifndef __PX4_QURT
+
+static void px4_sem_timeout(void *arg)
+{
+	px4_sem_post((px4_sem_t *)arg);
+}
+
+int px4_sem_timedwait(px4_sem_t *s, const struct timespec *abstime)
+{
+	struct timespec now;
+	px4_clock_gettime(CLOCK_REALTIME, &now);
+
+	int64_t timeout = ((int64_t)abstime->tv_sec - now.tv_sec) * 1000000 + (abstime->tv_nsec - now.tv_nsec) / 1000;
+	struct hrt_external_wait wait;
+
+	/* while the HRT follows the simulator or a replay, so does the timeout:
+	 * it posts the semaphore once the external time has advanced by as much */
+	if (!hrt_external_wait_start(&wait, timeout > 0 ? timeout : 0, px4_sem_timeout, s)) {
+#ifdef __PX4_DARWIN
+		return px4_sem_timedwait_system(s, abstime);
+#else
+		return sem_timedwait(s, abstime);
+#endif
+	}
+
+	int ret;
+
+	while ((ret = px4_sem_wait(s)) != 0 && errno == EINTR) {
+	}
+
+	/* the timeout took the count it posted, a post that raced with it is
+	 * still there for the next wait */
+	if (hrt_external_wait_stop(&wait)) {
+#ifdef __PX4_DARWIN
+		return ETIMEDOUT;
+#else
+		errno = ETIMEDOUT;
+		return -1;
+#endif
+	}
+
+	return ret;
+}
+
+#endif
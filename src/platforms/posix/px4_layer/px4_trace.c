@@ -0,0 +1,343 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file px4_trace.c
+ *
+ * Per-thread ring buffers of trace events and the Chrome trace JSON writer.
+ *
+ * A ring is only written by its thread. The writer stores the event and then
+ * publishes the new head, the dump copies a ring and drops the events the
+ * writer may have overwritten meanwhile. Rings are never freed, so a dump can
+ * include threads that already exited.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE	/* pthread_getname_np */
+#endif
+
+#include <px4_trace.h>
+#include <px4_log.h>
+
+#include <drivers/drv_hrt.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TRACE_RING_SIZE_DEFAULT	8192
+#define TRACE_RING_SIZE_MAX	(1 << 20)
+
+struct trace_event_s {
+	uint64_t	timestamp;
+	const char	*name;
+	uintptr_t	arg;
+	uint8_t		type;
+};
+
+struct trace_ring_s {
+	struct trace_ring_s	*next;
+	unsigned		session;	/**< trace the events belong to */
+	uint32_t		head;		/**< number of events recorded in this session */
+	uint32_t		mask;
+	int			tid;
+	char			thread_name[16];
+	struct trace_event_s	*events;
+};
+
+bool px4_trace_enabled = false;
+
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct trace_ring_s *trace_rings = NULL;
+static int trace_ring_count = 0;
+static unsigned trace_ring_size = TRACE_RING_SIZE_DEFAULT;
+static unsigned trace_session = 0;
+
+static __thread struct trace_ring_s *trace_ring = NULL;
+
+static struct trace_ring_s *
+trace_ring_create(void)
+{
+	pthread_mutex_lock(&trace_mutex);
+
+	struct trace_ring_s *ring = calloc(1, sizeof(struct trace_ring_s));
+
+	if (ring != NULL) {
+		ring->events = malloc(trace_ring_size * sizeof(struct trace_event_s));
+
+		if (ring->events == NULL) {
+			free(ring);
+			ring = NULL;
+		}
+	}
+
+	if (ring != NULL) {
+		ring->mask = trace_ring_size - 1;
+		ring->session = trace_session;
+		ring->tid = ++trace_ring_count;
+
+		if (pthread_getname_np(pthread_self(), ring->thread_name, sizeof(ring->thread_name)) != 0) {
+			ring->thread_name[0] = '\0';
+		}
+
+		ring->next = trace_rings;
+		__atomic_store_n(&trace_rings, ring, __ATOMIC_RELEASE);
+	}
+
+	pthread_mutex_unlock(&trace_mutex);
+
+	return ring;
+}
+
+void
+px4_trace_record(uint8_t type, const char *name, uintptr_t arg)
+{
+	struct trace_ring_s *ring = trace_ring;
+
+	if (ring == NULL) {
+		ring = trace_ring_create();
+
+		if (ring == NULL) {
+			return;
+		}
+
+		trace_ring = ring;
+	}
+
+	unsigned session = __atomic_load_n(&trace_session, __ATOMIC_ACQUIRE);
+
+	if (ring->session != session) {
+		/* a new trace was started, drop the events of the old one */
+		__atomic_store_n(&ring->head, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&ring->session, session, __ATOMIC_RELEASE);
+	}
+
+	uint32_t head = ring->head;
+	struct trace_event_s *event = &ring->events[head & ring->mask];
+	event->timestamp = hrt_absolute_time();
+	event->name = name;
+	event->arg = arg;
+	event->type = type;
+
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void
+px4_trace_start(unsigned ring_size)
+{
+	pthread_mutex_lock(&trace_mutex);
+
+	if (ring_size > 0) {
+		unsigned size = 64;
+
+		while (size < ring_size && size < TRACE_RING_SIZE_MAX) {
+			size <<= 1;
+		}
+
+		trace_ring_size = size;
+	}
+
+	__atomic_store_n(&trace_session, trace_session + 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&px4_trace_enabled, true, __ATOMIC_RELEASE);
+
+	pthread_mutex_unlock(&trace_mutex);
+}
+
+void
+px4_trace_stop(void)
+{
+	__atomic_store_n(&px4_trace_enabled, false, __ATOMIC_RELEASE);
+}
+
+/**
+ * Copy the valid events of a ring.
+ *
+ * @return the number of events copied to events, which has room for the whole ring
+ */
+static uint32_t
+trace_ring_copy(struct trace_ring_s *ring, unsigned session, struct trace_event_s *events)
+{
+	uint32_t size = ring->mask + 1;
+
+	if (__atomic_load_n(&ring->session, __ATOMIC_ACQUIRE) != session) {
+		return 0;
+	}
+
+	uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	uint32_t first = (head > size) ? head - size : 0;
+
+	for (uint32_t i = first; i < head; i++) {
+		events[i - first] = ring->events[i & ring->mask];
+	}
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	if (__atomic_load_n(&ring->session, __ATOMIC_RELAXED) != session) {
+		return 0;
+	}
+
+	/* the writer may be overwriting the event after its current head */
+	uint32_t head_now = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	uint32_t valid = (head_now >= size) ? head_now - size + 1 : 0;
+
+	if (valid <= first) {
+		return head - first;
+	}
+
+	if (valid >= head) {
+		return 0;
+	}
+
+	memmove(events, &events[valid - first], (head - valid) * sizeof(struct trace_event_s));
+	return head - valid;
+}
+
+static int
+trace_write_event(int fd, int pid, int tid, const struct trace_event_s *event)
+{
+	unsigned long long ts = event->timestamp;
+
+	switch (event->type) {
+	case PX4_TRACE_PUBLISH:
+		if (dprintf(fd, ",\n{\"name\":\"%s\",\"cat\":\"publish\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu,\"pid\":%d,\"tid\":%d,"
+			    "\"args\":{\"generation\":%lu}}", event->name, ts, pid, tid, (unsigned long)event->arg) < 0) {
+			return -1;
+		}
+
+		/* start a flow from the publication to every copy of it */
+		return dprintf(fd, ",\n{\"name\":\"%s\",\"cat\":\"topic\",\"ph\":\"s\",\"id\":\"%p:%lu\",\"ts\":%llu,\"pid\":%d,\"tid\":%d}",
+			       event->name, event->name, (unsigned long)event->arg, ts, pid, tid);
+
+	case PX4_TRACE_COPY:
+		if (dprintf(fd, ",\n{\"name\":\"%s\",\"cat\":\"copy\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu,\"pid\":%d,\"tid\":%d,"
+			    "\"args\":{\"generation\":%lu}}", event->name, ts, pid, tid, (unsigned long)event->arg) < 0) {
+			return -1;
+		}
+
+		return dprintf(fd, ",\n{\"name\":\"%s\",\"cat\":\"topic\",\"ph\":\"f\",\"bp\":\"e\",\"id\":\"%p:%lu\",\"ts\":%llu,\"pid\":%d,"
+			       "\"tid\":%d}", event->name, event->name, (unsigned long)event->arg, ts, pid, tid);
+
+	case PX4_TRACE_POLL_WAKEUP:
+		return dprintf(fd, ",\n{\"name\":\"%s\",\"cat\":\"poll\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu,\"pid\":%d,\"tid\":%d}",
+			       event->name ? event->name : "timeout", ts, pid, tid);
+
+	case PX4_TRACE_WORK_BEGIN:
+		return dprintf(fd, ",\n{\"name\":\"work\",\"cat\":\"work\",\"ph\":\"B\",\"ts\":%llu,\"pid\":%d,\"tid\":%d,"
+			       "\"args\":{\"worker\":\"%p\"}}", ts, pid, tid, (void *)event->arg);
+
+	case PX4_TRACE_WORK_END:
+		return dprintf(fd, ",\n{\"name\":\"work\",\"cat\":\"work\",\"ph\":\"E\",\"ts\":%llu,\"pid\":%d,\"tid\":%d}",
+			       ts, pid, tid);
+
+	case PX4_TRACE_SPAN_BEGIN:
+	case PX4_TRACE_SPAN_END:
+		/* async events, perf_begin and perf_end can be on different threads */
+		return dprintf(fd, ",\n{\"name\":\"%s\",\"cat\":\"perf\",\"ph\":\"%c\",\"id\":\"%p\",\"ts\":%llu,\"pid\":%d,\"tid\":%d}",
+			       event->name, event->type == PX4_TRACE_SPAN_BEGIN ? 'b' : 'e', (void *)event->arg, ts, pid, tid);
+
+	default:
+		return 0;
+	}
+}
+
+int
+px4_trace_dump(int fd)
+{
+	pthread_mutex_lock(&trace_mutex);
+
+	unsigned session = trace_session;
+	struct trace_ring_s *rings = trace_rings;
+	int pid = getpid();
+	int count = 0;
+
+	if (dprintf(fd, "{\"traceEvents\":[\n"
+		    "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"px4\"}}", pid) < 0) {
+		count = -1;
+	}
+
+	for (struct trace_ring_s *ring = rings; ring != NULL && count >= 0; ring = ring->next) {
+		struct trace_event_s *events = malloc((ring->mask + 1) * sizeof(struct trace_event_s));
+
+		if (events == NULL) {
+			PX4_ERR("out of memory, skipping thread %d", ring->tid);
+			continue;
+		}
+
+		uint32_t n = trace_ring_copy(ring, session, events);
+
+		if (n > 0 && dprintf(fd, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+				     pid, ring->tid, ring->thread_name[0] ? ring->thread_name : "unnamed") < 0) {
+			count = -1;
+		}
+
+		for (uint32_t i = 0; i < n && count >= 0; i++) {
+			if (trace_write_event(fd, pid, ring->tid, &events[i]) < 0) {
+				count = -1;
+
+			} else {
+				count++;
+			}
+		}
+
+		free(events);
+	}
+
+	if (count >= 0 && dprintf(fd, "\n]}\n") < 0) {
+		count = -1;
+	}
+
+	pthread_mutex_unlock(&trace_mutex);
+
+	return count;
+}
+
+void
+px4_trace_status(void)
+{
+	pthread_mutex_lock(&trace_mutex);
+
+	PX4_INFO("tracing %s, %u events per thread", px4_trace_enabled ? "enabled" : "disabled", trace_ring_size);
+
+	for (struct trace_ring_s *ring = trace_rings; ring != NULL; ring = ring->next) {
+		if (__atomic_load_n(&ring->session, __ATOMIC_ACQUIRE) != trace_session) {
+			continue;
+		}
+
+		uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		PX4_INFO("%3d %-16s %10u events%s", ring->tid, ring->thread_name, head, (head > ring->mask + 1) ? ", wrapped" : "");
+	}
+
+	pthread_mutex_unlock(&trace_mutex);
+}
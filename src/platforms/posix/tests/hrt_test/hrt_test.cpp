@@ -40,10 +40,14 @@
  */
 
 #include <px4_time.h>
+#include <px4_log.h>
 #include <drivers/drv_hrt.h>
 #include "hrt_test.h"
 #include <unistd.h>
 #include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
 
 px4::AppState HRTTest::appState;
 
@@ -89,3 +93,100 @@ int HRTTest::main()
 
 	return 0;
 }
+
+struct bench_thread {
+	pthread_t thread;
+	unsigned long calls;
+	unsigned backwards;
+	uint64_t cpu_ns;
+};
+
+static volatile bool bench_running;
+
+static uint64_t thread_cpu_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *bench_worker(void *arg)
+{
+	bench_thread *t = (bench_thread *)arg;
+	hrt_abstime last = 0;
+	uint64_t start = thread_cpu_ns();
+
+	while (bench_running) {
+		for (int i = 0; i < 1000; i++) {
+			hrt_abstime now = hrt_absolute_time();
+
+			if (now < last) {
+				t->backwards++;
+			}
+
+			last = now;
+		}
+
+		t->calls += 1000;
+	}
+
+	t->cpu_ns = thread_cpu_ns() - start;
+	return nullptr;
+}
+
+int HRTTest::bench()
+{
+	static const unsigned max_threads = 16;
+	static const unsigned run_time_us = 500000;
+	bench_thread threads[max_threads];
+
+	for (unsigned count = 1; count <= max_threads; count *= 2) {
+		unsigned started = 0;
+
+		memset(threads, 0, sizeof(threads));
+		bench_running = true;
+
+		while (started < count && pthread_create(&threads[started].thread, nullptr, bench_worker, &threads[started]) == 0) {
+			started++;
+		}
+
+		if (started == count) {
+			usleep(run_time_us);
+		}
+
+		bench_running = false;
+
+		if (started < count) {
+			for (unsigned i = 0; i < started; i++) {
+				pthread_join(threads[i].thread, nullptr);
+			}
+
+			PX4_ERR("failed to create thread");
+			return 1;
+		}
+
+		double ns_per_call = 0.0;
+		unsigned long calls = 0;
+		unsigned backwards = 0;
+
+		for (unsigned i = 0; i < count; i++) {
+			pthread_join(threads[i].thread, nullptr);
+
+			if (threads[i].calls > 0) {
+				ns_per_call += (double)threads[i].cpu_ns / threads[i].calls;
+			}
+
+			calls += threads[i].calls;
+			backwards += threads[i].backwards;
+		}
+
+		PX4_INFO("%2u threads: %6.1f ns/call (thread CPU time), %lu calls/s, %u times back",
+			 count, ns_per_call / count, calls * (1000000 / run_time_us), backwards);
+
+		if (backwards > 0) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -50,5 +50,11 @@ public:
 
 	int main();
 
+	/**
+	 * Measure the cost of hrt_absolute_time() with 1 to 16 threads calling it
+	 * concurrently, and check that it never goes back within a thread.
+	 */
+	static int bench();
+
 	static px4::AppState appState; /* track requests to terminate app */
 };
@@ -50,7 +50,7 @@ extern "C" __EXPORT int hrttest_main(int argc, char *argv[]);
 int hrttest_main(int argc, char *argv[])
 {
 	if (argc < 2) {
-		PX4_WARN("usage: hrttest_main {start|stop|status}\n");
+		PX4_WARN("usage: hrttest_main {start|stop|status|bench}\n");
 		return 1;
 	}
 
@@ -77,6 +77,10 @@ int hrttest_main(int argc, char *argv[])
 		return 0;
 	}
 
+	if (!strcmp(argv[1], "bench")) {
+		return HRTTest::bench();
+	}
+
 	if (!strcmp(argv[1], "status")) {
 		if (HRTTest::appState.isRunning()) {
 			PX4_INFO("is running\n");
@@ -88,6 +92,6 @@ int hrttest_main(int argc, char *argv[])
 		return 0;
 	}
 
-	PX4_WARN("usage: hrttest_main {start|stop|status}\n");
+	PX4_WARN("usage: hrttest_main {start|stop|status|bench}\n");
 	return 1;
 }
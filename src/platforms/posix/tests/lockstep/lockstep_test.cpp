@@ -0,0 +1,426 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+
+/**
+ * @file lockstep_test.cpp
+ * Test of the blocking calls on an external clock: a clock thread drives the
+ * HRT with hrt_set_external_time() in fixed steps, like the simulator does,
+ * while waiter threads block in usleep(), px4_sem_timedwait() and px4_poll().
+ * Every timeout has to end at the first step that reaches it, never before,
+ * and a post racing with a semaphore timeout must not get lost.
+ *
+ * The HRT returns to the system clock when the test is done. It refuses to
+ * run while a simulator or a replay drives the clock.
+ */
+
+#include <px4_log.h>
+#include <px4_posix.h>
+#include <px4_sem.h>
+#include <px4_time.h>
+#include <drivers/drv_hrt.h>
+#include <drivers/device/device.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+extern "C" __EXPORT int lockstep_test_main(int argc, char *argv[]);
+
+namespace
+{
+
+#define LOCKSTEP_TEST_DEV "/dev/lockstep_test"
+
+/** the clock advances in steps of this many us */
+const hrt_abstime step = 1000;
+
+/** how long to wait for a waiter in system time, in us */
+const unsigned wall_timeout = 1000000;
+
+/** a device that never has data, to poll on */
+class Silent : public device::VDev
+{
+public:
+	Silent() : VDev("lockstep_test", LOCKSTEP_TEST_DEV) {}
+};
+
+enum class Call {
+	Usleep,
+	SemTimedwait,
+	Poll
+};
+
+const char *call_name[] = {"usleep", "px4_sem_timedwait", "px4_poll"};
+
+struct Waiter {
+	pthread_t thread;
+	Call call;
+	unsigned timeout;
+	px4_sem_t *sem;
+	int fd;
+
+	hrt_abstime start;
+	hrt_abstime end;
+	int ret;
+	int err;
+	bool ready;
+	bool done;
+};
+
+/** external time set by the clock thread */
+hrt_abstime sim_time;
+
+void no_wakeup(void *arg)
+{
+}
+
+void advance(hrt_abstime dt)
+{
+	sim_time += dt;
+	hrt_set_external_time(sim_time);
+}
+
+/* the clock thread is the one setting the time, so its own usleep() calls
+ * take system time */
+bool wait_flag(bool *flag, unsigned timeout_us)
+{
+	for (unsigned waited = 0; !__atomic_load_n(flag, __ATOMIC_ACQUIRE); waited += 100) {
+		if (waited >= timeout_us) {
+			return false;
+		}
+
+		usleep(100);
+	}
+
+	return true;
+}
+
+void *wait_thread(void *arg)
+{
+	Waiter *w = (Waiter *)arg;
+
+	w->start = hrt_absolute_time();
+	__atomic_store_n(&w->ready, true, __ATOMIC_RELEASE);
+
+	switch (w->call) {
+	case Call::Usleep:
+		w->ret = usleep(w->timeout);
+		break;
+
+	case Call::SemTimedwait: {
+			struct timespec ts;
+			px4_clock_gettime(CLOCK_REALTIME, &ts);
+
+			uint64_t nsecs = ts.tv_nsec + (uint64_t)w->timeout * 1000;
+			ts.tv_sec += nsecs / 1000000000;
+			ts.tv_nsec = nsecs % 1000000000;
+
+			w->ret = px4_sem_timedwait(w->sem, &ts);
+			break;
+		}
+
+	case Call::Poll: {
+			px4_pollfd_struct_t fds = {};
+			fds.fd = w->fd;
+			fds.events = POLLIN;
+
+			w->ret = px4_poll(&fds, 1, w->timeout / 1000);
+			break;
+		}
+	}
+
+	w->err = errno;
+	w->end = hrt_absolute_time();
+	__atomic_store_n(&w->done, true, __ATOMIC_RELEASE);
+
+	return nullptr;
+}
+
+/** start a waiter and give it some system time to block */
+bool start_waiter(Waiter *w)
+{
+	if (pthread_create(&w->thread, nullptr, wait_thread, w) != 0) {
+		PX4_ERR("failed to create thread");
+		return false;
+	}
+
+	while (!__atomic_load_n(&w->ready, __ATOMIC_ACQUIRE)) {
+		usleep(100);
+	}
+
+	usleep(10000);
+	return true;
+}
+
+/** step the clock until a waiter returns, so it can be joined */
+void finish_waiter(Waiter *w)
+{
+	for (unsigned i = 0; i < 1000 && !wait_flag(&w->done, 1000); i++) {
+		advance(step);
+	}
+
+	pthread_join(w->thread, nullptr);
+}
+
+/**
+ * One timeout: step the clock up to the deadline, the waiter must not return
+ * before, then expect it to return without the clock moving on.
+ */
+int check_timeout(Call call, unsigned timeout, px4_sem_t *sem, int fd)
+{
+	Waiter w;
+	memset(&w, 0, sizeof(w));
+	w.call = call;
+	w.timeout = timeout;
+	w.sem = sem;
+	w.fd = fd;
+
+	if (!start_waiter(&w)) {
+		return 1;
+	}
+
+	const hrt_abstime deadline = w.start + timeout;
+
+	while (sim_time < deadline && !__atomic_load_n(&w.done, __ATOMIC_ACQUIRE)) {
+		advance(step);
+		usleep(100);
+	}
+
+	bool on_time = wait_flag(&w.done, wall_timeout);
+	finish_waiter(&w);
+
+	const hrt_abstime elapsed = w.end - w.start;
+	int ret = 0;
+
+	if (!on_time) {
+		PX4_ERR("%s %u us: still blocked at the deadline", call_name[(int)call], timeout);
+		ret = 1;
+
+	} else if (elapsed < timeout) {
+		PX4_ERR("%s %u us: returned early after %" PRIu64 " us", call_name[(int)call], timeout, elapsed);
+		ret = 1;
+
+	} else if (elapsed > timeout + step) {
+		PX4_ERR("%s %u us: returned late after %" PRIu64 " us", call_name[(int)call], timeout, elapsed);
+		ret = 1;
+	}
+
+	bool timed_out;
+
+	switch (call) {
+	case Call::Usleep:
+		timed_out = w.ret == 0;
+		break;
+
+	case Call::SemTimedwait:
+		timed_out = w.ret == -1 && w.err == ETIMEDOUT;
+		break;
+
+	case Call::Poll:
+	default:
+		timed_out = w.ret == 0;
+		break;
+	}
+
+	if (!timed_out) {
+		PX4_ERR("%s %u us: returned %d, errno %d", call_name[(int)call], timeout, w.ret, w.err);
+		ret = 1;
+	}
+
+	return ret;
+}
+
+/**
+ * Post the semaphore of a px4_sem_timedwait() at its deadline, right before
+ * and right after the clock reaches it. Whichever wakes the waiter, the post
+ * has to be consumed by the wait or still be counted afterwards.
+ */
+int check_race(unsigned rounds)
+{
+	px4_sem_t sem;
+	px4_sem_init(&sem, 0, 0);
+
+	const unsigned timeout = 5 * step;
+	unsigned posted = 0;
+	unsigned timed_out = 0;
+	unsigned miscounted = 0;
+	int ret = 0;
+
+	for (unsigned i = 0; i < rounds && ret == 0; i++) {
+		Waiter w;
+		memset(&w, 0, sizeof(w));
+		w.call = Call::SemTimedwait;
+		w.timeout = timeout;
+		w.sem = &sem;
+
+		if (!start_waiter(&w)) {
+			ret = 1;
+			break;
+		}
+
+		while (sim_time + step < w.start + timeout) {
+			advance(step);
+		}
+
+		if (i % 2 == 0) {
+			px4_sem_post(&sem);
+			advance(step);
+
+		} else {
+			advance(step);
+			px4_sem_post(&sem);
+		}
+
+		if (!wait_flag(&w.done, wall_timeout)) {
+			PX4_ERR("px4_sem_timedwait: still blocked after a post");
+			ret = 1;
+		}
+
+		finish_waiter(&w);
+
+		int value = 0;
+		px4_sem_getvalue(&sem, &value);
+
+		if (w.ret == 0) {
+			posted++;
+
+		} else if (w.err == ETIMEDOUT) {
+			timed_out++;
+
+		} else {
+			PX4_ERR("px4_sem_timedwait: returned %d, errno %d", w.ret, w.err);
+			ret = 1;
+		}
+
+		/* the wait took our post, or the timeout's and ours is left */
+		if (value + (w.ret == 0 ? 1 : 0) != 1) {
+			miscounted++;
+			ret = 1;
+		}
+
+		while (value-- > 0) {
+			px4_sem_wait(&sem);
+		}
+	}
+
+	px4_sem_destroy(&sem);
+
+	PX4_INFO("post at the deadline: %u posted, %u timed out, %u miscounted", posted, timed_out, miscounted);
+
+	return ret;
+}
+
+void *clock_thread(void *arg)
+{
+	int *result = (int *)arg;
+	int ret = 0;
+
+	/* take over from the system clock */
+	sim_time = hrt_absolute_time();
+	advance(step);
+
+	Silent *dev = new Silent();
+	int fd = -1;
+
+	if (dev == nullptr || dev->init() != PX4_OK || (fd = px4_open(LOCKSTEP_TEST_DEV, 0)) < 0) {
+		PX4_ERR("failed to set up " LOCKSTEP_TEST_DEV);
+		ret = 1;
+	}
+
+	px4_sem_t sem;
+	px4_sem_init(&sem, 0, 0);
+
+	const unsigned timeouts[] = {1000, 2500, 10000, 100000};
+
+	for (unsigned c = 0; c < sizeof(call_name) / sizeof(call_name[0]) && ret == 0; c++) {
+		for (unsigned i = 0; i < sizeof(timeouts) / sizeof(timeouts[0]); i++) {
+			/* px4_poll() takes ms */
+			if ((Call)c == Call::Poll && timeouts[i] % 1000 != 0) {
+				continue;
+			}
+
+			ret |= check_timeout((Call)c, timeouts[i], &sem, fd);
+		}
+	}
+
+	px4_sem_destroy(&sem);
+
+	if (ret == 0) {
+		ret = check_race(100);
+	}
+
+	if (fd >= 0) {
+		px4_close(fd);
+	}
+
+	delete dev;
+
+	*result = ret;
+	return nullptr;
+}
+
+} // anonymous namespace
+
+int lockstep_test_main(int argc, char *argv[])
+{
+	/* an external wait only starts while some thread sets the time */
+	struct hrt_external_wait wait;
+
+	if (hrt_external_wait_start(&wait, 1000000, no_wakeup, nullptr)) {
+		hrt_external_wait_stop(&wait);
+		PX4_ERR("the HRT follows a simulator or replay, run this without");
+		return 1;
+	}
+
+	/* the HRT runs on the test clock until the clock thread is done */
+	pthread_t clock;
+	int ret = 1;
+
+	if (pthread_create(&clock, nullptr, clock_thread, &ret) != 0) {
+		PX4_ERR("failed to create thread");
+		return 1;
+	}
+
+	pthread_join(clock, nullptr);
+	hrt_clear_external_time();
+
+	if (ret == 0) {
+		PX4_INFO("PASSED");
+	}
+
+	return ret;
+}
@@ -0,0 +1,213 @@
+/****************************************************************************
+ *
+ * Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file sim_report_test.cpp
+ * Stress test of the simulator sensor report hand-over: one writer thread
+ * publishes as fast as it can while reader threads check that every copy
+ * they get is a whole sample and that samples never go back in time.
+ */
+
+#include <px4_log.h>
+#include <simulator/simulator_report.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+extern "C" __EXPORT int sim_report_test_main(int argc, char *argv[]);
+
+namespace
+{
+
+/** sample whose words are all derived from its sequence number */
+struct Sample {
+	uint32_t seq;
+	uint32_t data[15];
+};
+
+struct writer_thread {
+	pthread_t thread;
+	unsigned long writes;
+};
+
+struct reader_thread {
+	pthread_t thread;
+	unsigned long reads;
+	unsigned long torn;
+	unsigned long backwards;
+};
+
+simulator::Report<Sample> *report;
+volatile bool running;
+
+uint32_t pattern(uint32_t seq, unsigned i)
+{
+	return seq * 2654435761u + i;
+}
+
+void *writer(void *arg)
+{
+	writer_thread *t = (writer_thread *)arg;
+	Sample s;
+
+	while (running) {
+		s.seq = t->writes + 1;
+
+		for (unsigned i = 0; i < sizeof(s.data) / sizeof(s.data[0]); i++) {
+			s.data[i] = pattern(s.seq, i);
+		}
+
+		report->writeData(&s);
+		t->writes++;
+	}
+
+	return nullptr;
+}
+
+void *reader(void *arg)
+{
+	reader_thread *t = (reader_thread *)arg;
+	uint32_t last = 0;
+	Sample s;
+
+	while (running) {
+		report->copyData(&s, sizeof(s));
+		t->reads++;
+
+		/* nothing written yet */
+		if (s.seq == 0) {
+			continue;
+		}
+
+		for (unsigned i = 0; i < sizeof(s.data) / sizeof(s.data[0]); i++) {
+			if (s.data[i] != pattern(s.seq, i)) {
+				t->torn++;
+				break;
+			}
+		}
+
+		if (s.seq < last) {
+			t->backwards++;
+		}
+
+		last = s.seq;
+	}
+
+	return nullptr;
+}
+
+int run(unsigned readers, unsigned run_time_us)
+{
+	writer_thread w;
+	reader_thread *r = new reader_thread[readers];
+	unsigned started = 0;
+
+	memset(&w, 0, sizeof(w));
+	memset(r, 0, sizeof(reader_thread) * readers);
+
+	report = new simulator::Report<Sample>();
+	running = true;
+
+	bool ok = pthread_create(&w.thread, nullptr, writer, &w) == 0;
+
+	while (ok && started < readers && pthread_create(&r[started].thread, nullptr, reader, &r[started]) == 0) {
+		started++;
+	}
+
+	if (ok && started == readers) {
+		usleep(run_time_us);
+	}
+
+	running = false;
+
+	if (ok) {
+		pthread_join(w.thread, nullptr);
+	}
+
+	unsigned long reads = 0;
+	unsigned long torn = 0;
+	unsigned long backwards = 0;
+
+	for (unsigned i = 0; i < started; i++) {
+		pthread_join(r[i].thread, nullptr);
+		reads += r[i].reads;
+		torn += r[i].torn;
+		backwards += r[i].backwards;
+	}
+
+	delete report;
+	delete[] r;
+
+	if (!ok || started < readers) {
+		PX4_ERR("failed to create thread");
+		return 1;
+	}
+
+	double run_time_s = run_time_us / 1e6;
+
+	PX4_INFO("%u reader(s): %.0f writes/s, %.0f reads/s, %lu torn, %lu back in time",
+		 readers, w.writes / run_time_s, reads / run_time_s, torn, backwards);
+
+	return (torn > 0 || backwards > 0) ? 1 : 0;
+}
+
+} // anonymous namespace
+
+int sim_report_test_main(int argc, char *argv[])
+{
+	unsigned seconds = 2;
+
+	if (argc > 1) {
+		seconds = strtoul(argv[1], nullptr, 10);
+
+		if (seconds == 0) {
+			PX4_WARN("usage: sim_report_test [seconds]");
+			return 1;
+		}
+	}
+
+	int ret = 0;
+
+	for (unsigned readers = 1; readers <= 4; readers *= 2) {
+		ret |= run(readers, seconds * 1000000);
+	}
+
+	if (ret == 0) {
+		PX4_INFO("PASSED");
+	}
+
+	return ret;
+}
@@ -54,7 +54,7 @@ int wqueue_test_main(int argc, char *argv[])
 {
 
 	if (argc < 2) {
-		PX4_INFO("usage: wqueue_test {start|stop|status}\n");
+		PX4_INFO("usage: wqueue_test {start|stop|status|jitter}\n");
 		return 1;
 	}
 
@@ -81,6 +81,10 @@ int wqueue_test_main(int argc, char *argv[])
 		return 0;
 	}
 
+	if (!strcmp(argv[1], "jitter")) {
+		return WQueueTest::jitter();
+	}
+
 	if (!strcmp(argv[1], "status")) {
 		if (WQueueTest::appState.isRunning()) {
 			PX4_INFO("is running\n");
@@ -92,6 +96,6 @@ int wqueue_test_main(int argc, char *argv[])
 		return 0;
 	}
 
-	PX4_INFO("usage: wqueue_test {start|stop|status}\n");
+	PX4_INFO("usage: wqueue_test {start|stop|status|jitter}\n");
 	return 1;
 }
@@ -39,9 +39,12 @@
  * @author Mark Charlebois <charlebm@gmail.com>
  */
 
+#include <px4_log.h>
 #include <px4_time.h>
 #include <px4_workqueue.h>
+#include <drivers/drv_hrt.h>
 #include "wqueue_test.h"
+#include <algorithm>
 #include <unistd.h>
 #include <stdio.h>
 
@@ -110,3 +113,85 @@ int WQueueTest::main()
 
 	return 0;
 }
+
+struct jitter_item {
+	work_s work;
+	hrt_abstime period;
+	hrt_abstime due;
+	unsigned count;
+	unsigned samples;
+	int32_t *latency;
+	volatile bool stop;
+};
+
+static void jitter_cycle(void *arg)
+{
+	jitter_item *item = (jitter_item *)arg;
+	hrt_abstime now = hrt_absolute_time();
+
+	item->latency[item->count++] = (int32_t)(now - item->due);
+
+	if (item->count == item->samples || item->stop) {
+		return;
+	}
+
+	/* keep to a fixed schedule, so one late run does not delay the rest */
+	item->due += item->period;
+
+	hrt_abstime delay = item->due > now ? item->due - now : 0;
+
+	work_queue(HPWORK, &item->work, jitter_cycle, item, USEC2TICK(delay));
+}
+
+int WQueueTest::jitter()
+{
+	static const unsigned rates[] = { 250, 1000, 4000 };
+	static const unsigned run_time_s = 2;
+
+	for (unsigned rate : rates) {
+		jitter_item item;
+		memset(&item, 0, sizeof(item));
+		item.period = 1000000 / rate;
+		item.samples = rate * run_time_s;
+		item.latency = new int32_t[item.samples];
+
+		if (item.latency == nullptr) {
+			PX4_ERR("alloc failed");
+			return 1;
+		}
+
+		hrt_abstime start = hrt_absolute_time();
+		item.due = start + item.period;
+		work_queue(HPWORK, &item.work, jitter_cycle, &item, USEC2TICK(item.period));
+
+		/* give up if the queue falls far behind */
+		while (item.count < item.samples && hrt_elapsed_time(&start) < 2 * run_time_s * 1000000) {
+			usleep(10000);
+		}
+
+		unsigned count = item.count;
+		hrt_abstime elapsed = hrt_elapsed_time(&start);
+
+		/* a run that is in progress requeues at most once more */
+		item.stop = true;
+		usleep(100000);
+		work_cancel(HPWORK, &item.work);
+
+		if (count == 0) {
+			PX4_ERR("%4u Hz: no runs", rate);
+			delete[] item.latency;
+			return 1;
+		}
+
+		std::sort(item.latency, item.latency + count);
+
+		PX4_INFO("%4u Hz: ran at %6.1f Hz, late by p50 %d us, p99 %d us, max %d us, %d us early at most",
+			 rate, (double)count * 1e6 / elapsed, item.latency[count / 2],
+			 item.latency[count * 99 / 100], item.latency[count - 1],
+			 item.latency[0] < 0 ? -item.latency[0] : 0);
+
+		delete[] item.latency;
+	}
+
+	return 0;
+}
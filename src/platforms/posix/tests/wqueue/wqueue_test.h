@@ -58,6 +58,12 @@ public:
 
 	int main();
 
+	/**
+	 * Run a periodic item on the high priority queue at 250 Hz, 1 kHz and
+	 * 4 kHz and print how late it runs compared to its schedule.
+	 */
+	static int jitter();
+
 	static px4::AppState appState; /* track requests to terminate app */
 private:
 	static void hp_worker_cb(void *p);
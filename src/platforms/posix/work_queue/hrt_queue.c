@@ -40,14 +40,12 @@
 #include <px4_config.h>
 #include <px4_defines.h>
 
-#include <signal.h>
 #include <stdint.h>
-#include <queue.h>
 #include <stdio.h>
-#include <semaphore.h>
 #include <drivers/drv_hrt.h>
 #include <px4_workqueue.h>
 #include "hrt_work.h"
+#include "work_heap.h"
 
 /****************************************************************************
  * Pre-processor Definitions
@@ -118,16 +116,24 @@ int hrt_work_queue(struct work_s *work, worker_t worker, void *arg, uint32_t del
 
 	hrt_work_lock();
 	work->qtime  = hrt_absolute_time(); /* Time work queued */
+	work->due    = work->qtime + delay;
 	//PX4_INFO("hrt work_queue adding work delay=%u time=%lu", delay, work->qtime);
 
-	dq_addlast((dq_entry_t *)work, &wqueue->q);
-#ifdef __PX4_QURT
-	px4_task_kill(wqueue->pid, SIGALRM);      /* Wake up the worker thread */
-#else
-	px4_task_kill(wqueue->pid, SIGCONT);      /* Wake up the worker thread */
-#endif
+	/* Requeueing work that is still pending moves it to the new time */
+
+	work_heap_remove(wqueue, work);
+
+	int ret = work_heap_push(wqueue, work);
+
+	if (ret != PX4_OK) {
+		work->worker = NULL;
+
+	} else if (work->index == 0) {
+		/* Due before anything else, the worker may be sleeping past it */
+		work_heap_wake(wqueue);
+	}
 
 	hrt_work_unlock();
-	return PX4_OK;
+	return ret;
 }
 
@@ -45,10 +45,10 @@
 #include <signal.h>
 #include <stdio.h>
 #include <unistd.h>
-#include <queue.h>
 #include <px4_workqueue.h>
 #include <drivers/drv_hrt.h>
 #include "hrt_work.h"
+#include "work_heap.h"
 
 /****************************************************************************
  * Pre-processor Definitions
@@ -75,6 +75,7 @@ px4_sem_t _hrt_work_lock;
  ****************************************************************************/
 static void hrt_work_process(void);
 
+#ifdef __PX4_QURT
 static void _sighandler(int sig_num);
 
 /****************************************************************************
@@ -94,6 +95,7 @@ static void _sighandler(int sig_num)
 {
 	PX4_DEBUG("RECEIVED SIGNAL %d", sig_num);
 }
+#endif
 
 /****************************************************************************
  * Name: work_process
@@ -112,12 +114,11 @@ static void _sighandler(int sig_num)
 static void hrt_work_process()
 {
 	struct wqueue_s *wqueue = &g_hrt_work;
-	volatile struct work_s *work;
+	struct work_s *work;
 	worker_t  worker;
 	void *arg;
-	uint64_t elapsed;
-	uint32_t remaining;
-	uint32_t next;
+	uint64_t now;
+	uint64_t next;
 
 	// set the threads name
 #ifdef __PX4_DARWIN
@@ -136,87 +137,63 @@ static void hrt_work_process()
 
 	hrt_work_lock();
 
-	work  = (struct work_s *)wqueue->q.head;
-
-	while (work) {
-		/* Is this work ready?  It is ready if there is no delay or if
-		 * the delay has elapsed. qtime is the time that the work was added
-		 * to the work queue.  It will always be greater than or equal to
-		 * zero.  Therefore a delay of zero will always execute immediately.
-		 */
-
-		elapsed = hrt_absolute_time() - work->qtime;
-
-		//PX4_INFO("hrt work_process: in usec elapsed=%lu delay=%u work=%p", elapsed, work->delay, work);
-		if (elapsed >= work->delay) {
-			/* Remove the ready-to-execute work from the list */
+	/* The work due first is on top of the heap, run it until the top is
+	 * not due yet.
+	 */
 
-			(void)dq_rem((struct dq_entry_s *) & (work->dq), &(wqueue->q));
-			//PX4_INFO("Dequeued work=%p", work);
+	while ((work = work_heap_top(wqueue)) != NULL) {
+		now = hrt_absolute_time();
 
-			/* Extract the work description from the entry (in case the work
-			 * instance by the re-used after it has been de-queued).
+		if (work->due > now) {
+			/* Not ready.. wake up when it is, unless that is after the
+			 * next scheduled wakeup interval.
 			 */
 
-			worker = work->worker;
-			arg    = work->arg;
-
-			/* Mark the work as no longer being queued */
-
-			work->worker = NULL;
-
-			/* Do the work.  Re-enable interrupts while the work is being
-			 * performed... we don't have any idea how long that will take!
-			 */
+			if (work->due - now < next) {
+				next = work->due - now;
+			}
 
-			hrt_work_unlock();
+			break;
+		}
 
-			if (!worker) {
-				PX4_ERR("MESSED UP: worker = 0");
-				PX4_BACKTRACE();
+		/* Remove the ready-to-execute work from the heap */
 
-			} else {
-				worker(arg);
-			}
+		work_heap_remove(wqueue, work);
 
-			/* Now, unfortunately, since we re-enabled interrupts we don't
-			 * know the state of the work list and we will have to start
-			 * back at the head of the list.
-			 */
+		/* Extract the work description from the entry (in case the work
+		 * instance by the re-used after it has been de-queued).
+		 */
 
-			hrt_work_lock();
-			work  = (struct work_s *)wqueue->q.head;
+		worker = work->worker;
+		arg    = work->arg;
 
-		} else {
-			/* This one is not ready.. will it be ready before the next
-			 * scheduled wakeup interval?
-			 */
+		/* Mark the work as no longer being queued */
 
-			/* Here: elapsed < work->delay */
-			remaining = work->delay - elapsed;
+		work->worker = NULL;
 
-			//PX4_INFO("remaining=%u delay=%u elapsed=%lu", remaining, work->delay, elapsed);
-			if (remaining < next) {
-				/* Yes.. Then schedule to wake up when the work is ready */
+		/* Do the work.  Re-enable interrupts while the work is being
+		 * performed... we don't have any idea how long that will take!
+		 */
 
-				next = remaining;
-			}
+		hrt_work_unlock();
 
-			/* Then try the next in the list. */
+		if (!worker) {
+			PX4_ERR("MESSED UP: worker = 0");
+			PX4_BACKTRACE();
 
-			work = (struct work_s *)work->dq.flink;
-			//PX4_INFO("next %u work %p", next, work);
+		} else {
+			worker(arg);
 		}
+
+		hrt_work_lock();
 	}
 
-	/* Wait awhile to check the work list.  We will wait here until either
-	 * the time elapses or until we are awakened by a signal.
+	/* Wait until the next work is due.  hrt_work_queue() wakes us up early
+	 * if it queues work that is due before that.
 	 */
 	hrt_work_unlock();
 
-	/* might sleep less if a signal received and new item was queued */
-	//PX4_INFO("Sleeping for %u usec", next);
-	usleep(next);
+	work_heap_wait(wqueue, next);
 }
 
 /****************************************************************************
@@ -274,6 +251,7 @@ void hrt_work_queue_init(void)
 {
 	px4_sem_init(&_hrt_work_lock, 0, 1);
 	memset(&g_hrt_work, 0, sizeof(g_hrt_work));
+	px4_sem_init(&g_hrt_work.wake, 0, 0);
 
 	// Create high priority worker thread
 	g_hrt_work.pid = px4_task_spawn_cmd("wkr_hrt",
@@ -283,11 +261,9 @@ void hrt_work_queue_init(void)
 					    work_hrtthread,
 					    (char *const *)NULL);
 
-
 #ifdef __PX4_QURT
+	/* work_heap_wake() interrupts the sleep of the worker with SIGALRM */
 	signal(SIGALRM, _sighandler);
-#else
-	signal(SIGCONT, _sighandler);
 #endif
 }
 
@@ -39,9 +39,9 @@
 
 #include <px4_config.h>
 #include <px4_defines.h>
-#include <queue.h>
 #include <px4_workqueue.h>
 #include "hrt_work.h"
+#include "work_heap.h"
 
 /****************************************************************************
  * Pre-processor Definitions
@@ -93,17 +93,12 @@ void hrt_work_cancel(struct work_s *work)
 
 	hrt_work_lock();
 
-	if (work->worker != NULL) {
-		/* A little test of the integrity of the work queue */
-
-		//DEBUGASSERT(work->dq.flink ||(dq_entry_t *)work == wqueue->q.tail);
-		//DEBUGASSERT(work->dq.blink ||(dq_entry_t *)work == wqueue->q.head);
-
+	if (work_heap_contains(wqueue, work)) {
 		/* Remove the entry from the work queue and make sure that it is
 		 * mark as availalbe (i.e., the worker field is nullified).
 		 */
 
-		dq_rem((dq_entry_t *)work, &wqueue->q);
+		work_heap_remove(wqueue, work);
 		work->worker = NULL;
 	}
 
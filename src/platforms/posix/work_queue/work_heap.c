@@ -0,0 +1,169 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2017 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file work_heap.c
+ *
+ * Min-heap of pending work shared by the POSIX work queues and the HRT queue.
+ */
+
+#include <px4_config.h>
+#include <px4_defines.h>
+#include <px4_posix.h>
+#include <px4_time.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "work_heap.h"
+
+#define WORK_HEAP_INITIAL_CAPACITY 16
+
+static void work_heap_set(struct wqueue_s *wqueue, unsigned index, struct work_s *work)
+{
+	wqueue->heap[index] = work;
+	work->index = index;
+}
+
+static void work_heap_sift_up(struct wqueue_s *wqueue, unsigned index)
+{
+	struct work_s *work = wqueue->heap[index];
+
+	while (index > 0) {
+		unsigned parent = (index - 1) / 2;
+
+		if (wqueue->heap[parent]->due <= work->due) {
+			break;
+		}
+
+		work_heap_set(wqueue, index, wqueue->heap[parent]);
+		index = parent;
+	}
+
+	work_heap_set(wqueue, index, work);
+}
+
+static void work_heap_sift_down(struct wqueue_s *wqueue, unsigned index)
+{
+	struct work_s *work = wqueue->heap[index];
+
+	for (;;) {
+		unsigned child = 2 * index + 1;
+
+		if (child >= wqueue->count) {
+			break;
+		}
+
+		if (child + 1 < wqueue->count && wqueue->heap[child + 1]->due < wqueue->heap[child]->due) {
+			child++;
+		}
+
+		if (work->due <= wqueue->heap[child]->due) {
+			break;
+		}
+
+		work_heap_set(wqueue, index, wqueue->heap[child]);
+		index = child;
+	}
+
+	work_heap_set(wqueue, index, work);
+}
+
+int work_heap_push(struct wqueue_s *wqueue, struct work_s *work)
+{
+	if (wqueue->count == wqueue->capacity) {
+		unsigned capacity = wqueue->capacity > 0 ? 2 * wqueue->capacity : WORK_HEAP_INITIAL_CAPACITY;
+		struct work_s **heap = (struct work_s **)realloc(wqueue->heap, capacity * sizeof(struct work_s *));
+
+		if (heap == NULL) {
+			return -ENOMEM;
+		}
+
+		wqueue->heap = heap;
+		wqueue->capacity = capacity;
+	}
+
+	wqueue->heap[wqueue->count] = work;
+	work_heap_sift_up(wqueue, wqueue->count++);
+	return PX4_OK;
+}
+
+void work_heap_remove(struct wqueue_s *wqueue, struct work_s *work)
+{
+	if (!work_heap_contains(wqueue, work)) {
+		return;
+	}
+
+	unsigned index = work->index;
+	struct work_s *last = wqueue->heap[--wqueue->count];
+
+	/* fill the hole with the last element and restore the order in
+	 * whichever direction it is violated */
+	if (last != work) {
+		work_heap_set(wqueue, index, last);
+		work_heap_sift_down(wqueue, index);
+		work_heap_sift_up(wqueue, last->index);
+	}
+}
+
+void work_heap_wait(struct wqueue_s *wqueue, uint64_t usec)
+{
+#ifdef __PX4_QURT
+	/* px4_sem_timedwait() is built on the HRT queue there, so the HRT
+	 * worker cannot use it. Sleep and get interrupted by a signal instead.
+	 */
+	usleep(usec);
+#else
+	struct timespec ts;
+
+	/* sem_timedwait() takes an absolute CLOCK_REALTIME time */
+	px4_clock_gettime(CLOCK_REALTIME, &ts);
+
+	uint64_t nsec = (uint64_t)ts.tv_nsec + usec * 1000;
+	ts.tv_sec += nsec / 1000000000;
+	ts.tv_nsec = nsec % 1000000000;
+
+	/* a timeout, a post or an interruption all mean: look at the heap again */
+	(void)px4_sem_timedwait(&wqueue->wake, &ts);
+#endif
+}
+
+void work_heap_wake(struct wqueue_s *wqueue)
+{
+#ifdef __PX4_QURT
+	px4_task_kill(wqueue->pid, SIGALRM);
+#else
+	px4_sem_post(&wqueue->wake);
+#endif
+}
@@ -0,0 +1,89 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2017 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file work_heap.h
+ *
+ * Pending work of a POSIX work queue, kept as a binary min-heap ordered by
+ * the absolute due time so the worker finds the next work in O(1) and
+ * queueing or cancelling is O(log n). The heap is guarded by the lock of
+ * the queue it belongs to.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <px4_workqueue.h>
+
+__BEGIN_DECLS
+
+/**
+ * Insert work into the heap.
+ * @return 0, or -ENOMEM if the heap could not grow
+ */
+int work_heap_push(struct wqueue_s *wqueue, struct work_s *work);
+
+/**
+ * Remove work from the heap, does nothing if it is not in the heap.
+ */
+void work_heap_remove(struct wqueue_s *wqueue, struct work_s *work);
+
+/**
+ * Check whether work is in the heap. Unlike checking the worker this also
+ * works for a work structure that was never zeroed.
+ */
+static inline bool work_heap_contains(struct wqueue_s *wqueue, struct work_s *work)
+{
+	return work->index < wqueue->count && wqueue->heap[work->index] == work;
+}
+
+/**
+ * @return the work due first, or NULL if the heap is empty
+ */
+static inline struct work_s *work_heap_top(struct wqueue_s *wqueue)
+{
+	return wqueue->count > 0 ? wqueue->heap[0] : NULL;
+}
+
+/**
+ * Wait for up to usec microseconds or until work_heap_wake() is called.
+ */
+void work_heap_wait(struct wqueue_s *wqueue, uint64_t usec);
+
+/**
+ * Wake up the worker of the queue waiting in work_heap_wait().
+ */
+void work_heap_wake(struct wqueue_s *wqueue);
+
+__END_DECLS
@@ -40,12 +40,11 @@
 #include <px4_config.h>
 #include <px4_defines.h>
 
-#include <signal.h>
 #include <stdint.h>
-#include <queue.h>
 #include <stdio.h>
-#include <semaphore.h>
 #include <px4_workqueue.h>
+#include <drivers/drv_hrt.h>
+#include "work_heap.h"
 #include "work_lock.h"
 
 #ifdef CONFIG_SCHED_WORKQUEUE
@@ -121,17 +120,25 @@ int work_queue(int qid, struct work_s *work, worker_t worker, void *arg, uint32_
 	 */
 
 	work_lock(qid);
-	work->qtime  = clock_systimer(); /* Time work queued */
+	work->qtime  = hrt_absolute_time(); /* Time work queued */
+	work->due    = work->qtime + (uint64_t)delay * USEC_PER_TICK;
 
-	dq_addlast((dq_entry_t *)work, &wqueue->q);
-#ifdef __PX4_QURT
-	px4_task_kill(wqueue->pid, SIGALRM);      /* Wake up the worker thread */
-#else
-	px4_task_kill(wqueue->pid, SIGCONT);      /* Wake up the worker thread */
-#endif
+	/* Requeueing work that is still pending moves it to the new time */
+
+	work_heap_remove(wqueue, work);
+
+	int ret = work_heap_push(wqueue, work);
+
+	if (ret != PX4_OK) {
+		work->worker = NULL;
+
+	} else if (work->index == 0) {
+		/* Due before anything else, the worker may be sleeping past it */
+		work_heap_wake(wqueue);
+	}
 
 	work_unlock(qid);
-	return PX4_OK;
+	return ret;
 }
 
 #endif /* CONFIG_SCHED_WORKQUEUE */
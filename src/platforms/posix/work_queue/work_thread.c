@@ -41,13 +41,14 @@
 #include <px4_defines.h>
 #include <px4_posix.h>
 #include <px4_time.h>
+#include <px4_trace.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <unistd.h>
-#include <queue.h>
 #include <pthread.h>
 #include <px4_workqueue.h>
 #include <drivers/drv_hrt.h>
+#include "work_heap.h"
 #include "work_lock.h"
 
 #ifdef CONFIG_SCHED_WORKQUEUE
@@ -92,12 +93,11 @@ px4_sem_t _work_lock[NWORKERS];
 
 static void work_process(struct wqueue_s *wqueue, int lock_id)
 {
-	volatile struct work_s *work;
+	struct work_s *work;
 	worker_t  worker;
 	void *arg;
-	uint64_t elapsed;
-	uint32_t remaining;
-	uint32_t next;
+	uint64_t now;
+	uint64_t next;
 
 	/* Then process queued work.  We need to keep interrupts disabled while
 	 * we process items in the work list.
@@ -107,81 +107,64 @@ static void work_process(struct wqueue_s *wqueue, int lock_id)
 
 	work_lock(lock_id);
 
-	work  = (struct work_s *)wqueue->q.head;
-
-	while (work) {
-		/* Is this work ready?  It is ready if there is no delay or if
-		 * the delay has elapsed. qtime is the time that the work was added
-		 * to the work queue.  It will always be greater than or equal to
-		 * zero.  Therefore a delay of zero will always execute immediately.
-		 */
-
-		elapsed = USEC2TICK(clock_systimer() - work->qtime);
-
-		//printf("work_process: in ticks elapsed=%lu delay=%u\n", elapsed, work->delay);
-		if (elapsed >= work->delay) {
-			/* Remove the ready-to-execute work from the list */
+	/* The work due first is on top of the heap, run it until the top is
+	 * not due yet.
+	 */
 
-			(void)dq_rem((struct dq_entry_s *)work, &wqueue->q);
+	while ((work = work_heap_top(wqueue)) != NULL) {
+		now = hrt_absolute_time();
 
-			/* Extract the work description from the entry (in case the work
-			 * instance by the re-used after it has been de-queued).
+		if (work->due > now) {
+			/* Not ready.. wake up when it is, unless that is after the
+			 * next scheduled wakeup interval.
 			 */
 
-			worker = work->worker;
-			arg    = work->arg;
-
-			/* Mark the work as no longer being queued */
-
-			work->worker = NULL;
-
-			/* Do the work.  Re-enable interrupts while the work is being
-			 * performed... we don't have any idea how long that will take!
-			 */
+			if (work->due - now < next) {
+				next = work->due - now;
+			}
 
-			work_unlock(lock_id);
+			break;
+		}
 
-			if (!worker) {
-				PX4_WARN("MESSED UP: worker = 0\n");
+		/* Remove the ready-to-execute work from the heap */
 
-			} else {
-				worker(arg);
-			}
+		work_heap_remove(wqueue, work);
 
-			/* Now, unfortunately, since we re-enabled interrupts we don't
-			 * know the state of the work list and we will have to start
-			 * back at the head of the list.
-			 */
+		/* Extract the work description from the entry (in case the work
+		 * instance by the re-used after it has been de-queued).
+		 */
 
-			work_lock(lock_id);
-			work  = (struct work_s *)wqueue->q.head;
+		worker = work->worker;
+		arg    = work->arg;
 
-		} else {
-			/* This one is not ready.. will it be ready before the next
-			 * scheduled wakeup interval?
-			 */
+		/* Mark the work as no longer being queued */
 
-			/* Here: elapsed < work->delay */
-			remaining = USEC_PER_TICK * (work->delay - elapsed);
+		work->worker = NULL;
 
-			if (remaining < next) {
-				/* Yes.. Then schedule to wake up when the work is ready */
+		/* Do the work.  Re-enable interrupts while the work is being
+		 * performed... we don't have any idea how long that will take!
+		 */
 
-				next = remaining;
-			}
+		work_unlock(lock_id);
 
-			/* Then try the next in the list. */
+		if (!worker) {
+			PX4_WARN("MESSED UP: worker = 0\n");
 
-			work = (struct work_s *)work->dq.flink;
+		} else {
+			PX4_TRACE(PX4_TRACE_WORK_BEGIN, NULL, worker);
+			worker(arg);
+			PX4_TRACE(PX4_TRACE_WORK_END, NULL, worker);
 		}
+
+		work_lock(lock_id);
 	}
 
-	/* Wait awhile to check the work list.  We will wait here until either
-	 * the time elapses or until we are awakened by a signal.
+	/* Wait until the next work is due.  work_queue() wakes us up early if
+	 * it queues work that is due before that.
 	 */
 	work_unlock(lock_id);
 
-	usleep(next);
+	work_heap_wait(wqueue, next);
 }
 
 /****************************************************************************
@@ -191,8 +174,11 @@ void work_queues_init(void)
 {
 	px4_sem_init(&_work_lock[HPWORK], 0, 1);
 	px4_sem_init(&_work_lock[LPWORK], 0, 1);
+	px4_sem_init(&g_work[HPWORK].wake, 0, 0);
+	px4_sem_init(&g_work[LPWORK].wake, 0, 0);
 #ifdef CONFIG_SCHED_USRWORK
 	px4_sem_init(&_work_lock[USRWORK], 0, 1);
+	px4_sem_init(&g_work[USRWORK].wake, 0, 0);
 #endif
 
 	// Create high priority worker thread
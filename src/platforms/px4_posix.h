@@ -85,6 +85,8 @@ typedef struct pollfd px4_pollfd_struct_t;
 
 typedef short pollevent_t;
 
+struct px4_waitset;
+
 typedef struct {
 	/* This part of the struct is POSIX-like */
 	int		fd;       /* The descriptor being polled */
@@ -92,10 +94,31 @@ typedef struct {
 	pollevent_t 	revents;  /* The output event flags */
 
 	/* Required for PX4 compatibility */
-	px4_sem_t   *sem;  	/* Pointer to semaphore used to post output event */
+	struct px4_waitset *waitset;	/* Wait set to wake up on an output event */
 	void   *priv;     	/* For use by drivers */
 } px4_pollfd_struct_t;
 
+/**
+ * Persistent set of file descriptors to wait on.
+ *
+ * Descriptors added with px4_waitset_add() stay registered with their driver
+ * until they are removed, so px4_waitset_wait() can be called in a loop
+ * without the setup and teardown px4_poll() does on every call. A wait set
+ * belongs to one thread; drivers only ever call px4_waitset_notify() on it.
+ */
+typedef struct px4_waitset {
+	volatile int	wakeups;	/* Notification counter, the futex word on Linux */
+	volatile int	sleeping;	/* Nonzero while the owner is blocked in a wait */
+#ifndef __PX4_LINUX
+	px4_sem_t	sem;		/* Wakeup semaphore where futexes are not available */
+#endif
+	px4_sem_t	*poll_sem;	/* Per call semaphore of px4_poll() after px4_poll_use_semaphore(true) */
+	px4_pollfd_struct_t *fds;	/* Registered descriptors, fd < 0 marks a free slot */
+	pollevent_t	*revents;	/* Events reported by the last wait */
+	unsigned	count;		/* Number of slots in use, including free ones */
+	unsigned	capacity;	/* Number of allocated slots */
+} px4_waitset_t;
+
 __BEGIN_DECLS
 
 __EXPORT int 		px4_open(const char *path, int flags, ...);
@@ -104,6 +127,15 @@ __EXPORT ssize_t	px4_read(int fd, void *buffer, size_t buflen);
 __EXPORT ssize_t	px4_write(int fd, const void *buffer, size_t buflen);
 __EXPORT int		px4_ioctl(int fd, int cmd, unsigned long arg);
 __EXPORT int		px4_poll(px4_pollfd_struct_t *fds, nfds_t nfds, int timeout);
+
+__EXPORT int		px4_waitset_init(px4_waitset_t *ws, unsigned capacity);
+__EXPORT void		px4_waitset_deinit(px4_waitset_t *ws);
+__EXPORT int		px4_waitset_add(px4_waitset_t *ws, int fd, pollevent_t events);
+__EXPORT int		px4_waitset_remove(px4_waitset_t *ws, int fd);
+__EXPORT int		px4_waitset_wait(px4_waitset_t *ws, int timeout);
+__EXPORT pollevent_t	px4_waitset_revents(const px4_waitset_t *ws, int index);
+__EXPORT void		px4_waitset_notify(px4_waitset_t *ws);
+__EXPORT void		px4_poll_use_semaphore(bool enable);
 __EXPORT int		px4_fsync(int fd);
 __EXPORT int		px4_access(const char *pathname, int mode);
 __EXPORT unsigned long	px4_getpid(void);
@@ -112,6 +144,7 @@ __EXPORT void		px4_enable_sim_lockstep(void);
 __EXPORT void		px4_sim_start_delay(void);
 __EXPORT void		px4_sim_stop_delay(void);
 __EXPORT bool		px4_sim_delay_enabled(void);
+__EXPORT void		px4_sim_delay_wait(void);
 
 __END_DECLS
 #else
@@ -0,0 +1,120 @@
+/****************************************************************************
+ *
+ *   Copyright (c) 2016 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file px4_trace.h
+ *
+ * Event tracer for POSIX builds.
+ *
+ * Every thread records timestamped events into its own ring buffer, without
+ * locking. The rings can be dumped as Chrome trace JSON, which chrome://tracing
+ * and Perfetto open. On other platforms the trace points compile to nothing.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Event types.
+ */
+enum px4_trace_type {
+	PX4_TRACE_PUBLISH,	/**< topic published, name is the topic, arg the generation */
+	PX4_TRACE_COPY,		/**< topic copied, name is the topic, arg the generation */
+	PX4_TRACE_POLL_WAKEUP,	/**< poll returned, name is the first ready device or NULL on timeout */
+	PX4_TRACE_WORK_BEGIN,	/**< work queue item started, arg is the worker */
+	PX4_TRACE_WORK_END,	/**< work queue item finished */
+	PX4_TRACE_SPAN_BEGIN,	/**< perf_begin, name is the counter, arg the handle */
+	PX4_TRACE_SPAN_END	/**< perf_end, name is the counter, arg the handle */
+};
+
+#if defined(__PX4_POSIX) && !defined(__PX4_QURT)
+
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+/** true while tracing, only read through PX4_TRACE() */
+__EXPORT extern bool px4_trace_enabled;
+
+/**
+ * Record an event into the ring of the calling thread.
+ *
+ * @param type		enum px4_trace_type
+ * @param name		Name of the event, has to stay valid until the trace is dumped.
+ * @param arg		Event specific argument.
+ */
+__EXPORT void px4_trace_record(uint8_t type, const char *name, uintptr_t arg);
+
+/**
+ * Start a new trace, discarding all recorded events.
+ *
+ * @param ring_size	Events per thread, rounded up to a power of two. Only used
+ *			for threads that did not record anything yet.
+ */
+__EXPORT void px4_trace_start(unsigned ring_size);
+
+/**
+ * Stop recording events.
+ */
+__EXPORT void px4_trace_stop(void);
+
+/**
+ * Write the events of all threads as Chrome trace JSON.
+ *
+ * Can be called while tracing, events overwritten during the dump are dropped.
+ *
+ * @param fd		File descriptor to write to.
+ * @return		The number of events written, or -1 on a write error.
+ */
+__EXPORT int px4_trace_dump(int fd);
+
+/**
+ * Print the number of threads and events recorded.
+ */
+__EXPORT void px4_trace_status(void);
+
+__END_DECLS
+
+#define PX4_TRACE(type, name, arg) do { \
+		if (__builtin_expect(__atomic_load_n(&px4_trace_enabled, __ATOMIC_RELAXED), 0)) { \
+			px4_trace_record((type), (name), (uintptr_t)(arg)); \
+		} \
+	} while (0)
+
+#else
+
+#define PX4_TRACE(type, name, arg)
+
+#endif
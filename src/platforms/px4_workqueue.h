@@ -46,6 +46,7 @@
 #include <stdint.h>
 #include <queue.h>
 #include <px4_platform_types.h>
+#include <px4_sem.h>
 
 #ifdef __PX4_QURT
 #include <dspal_types.h>
@@ -57,9 +58,14 @@ __BEGIN_DECLS
 #define LPWORK 1
 #define NWORKERS 2
 
+struct work_s;
+
 struct wqueue_s {
-	pid_t             pid; /* The task ID of the worker thread */
-	struct dq_queue_s q;   /* The queue of pending work */
+	pid_t             pid;      /* The task ID of the worker thread */
+	struct work_s   **heap;     /* Pending work, min-heap on the due time */
+	unsigned          count;    /* Number of pending work items */
+	unsigned          capacity; /* Allocated size of the heap */
+	px4_sem_t         wake;     /* Posted when work is queued ahead of the earliest */
 };
 
 extern struct wqueue_s g_work[NWORKERS];
@@ -69,11 +75,12 @@ extern struct wqueue_s g_work[NWORKERS];
 typedef void (*worker_t)(void *arg);
 
 struct work_s {
-	struct dq_entry_s dq;  /* Implements a doubly linked list */
 	worker_t  worker;      /* Work callback */
 	void *arg;             /* Callback argument */
 	uint64_t  qtime;       /* Time work queued */
 	uint32_t  delay;       /* Delay until work performed */
+	uint64_t  due;         /* Absolute time the work is due (usec) */
+	unsigned  index;       /* Position in the heap while queued */
 };
 
 /****************************************************************************
@@ -110,7 +117,8 @@ void work_queues_init(void);
  *            is invoked. Zero means to perform the work immediately.
  *
  * Returned Value:
- *   Zero on success, a negated errno on failure
+ *   Zero on success, a negated errno on failure (-ENOMEM if the queue
+ *   could not grow)
  *
  ****************************************************************************/
 
@@ -52,6 +52,7 @@
 #include <sys/stat.h>
 
 #include <arch/board/board.h>
+#include <drivers/drv_hrt.h>
 
 #include "systemlib/systemlib.h"
 #include "systemlib/param/param.h"
@@ -78,6 +79,7 @@ static int	do_set(const char *name, const char *val, bool fail_on_not_found);
 static int	do_compare(const char *name, char *vals[], unsigned comparisons, enum COMPARE_OPERATOR cmd_op);
 static int 	do_reset(const char *excludes[], int num_excludes);
 static int	do_reset_nostart(const char *excludes[], int num_excludes);
+static int	do_bench(unsigned save_load_count);
 
 int
 param_main(int argc, char *argv[])
@@ -202,6 +204,22 @@ param_main(int argc, char *argv[])
 			}
 		}
 
+		if (!strcmp(argv[1], "bench")) {
+			/* the save and load round trip changes live parameters for a moment, only run it on request */
+			unsigned save_load_count = 0;
+
+			if (argc >= 3 && !strcmp(argv[2], "-s")) {
+				save_load_count = (argc >= 4) ? strtoul(argv[3], NULL, 10) : 1000;
+
+				if (save_load_count == 0) {
+					warnx("usage: param bench [-s <number of parameters>]");
+					return 1;
+				}
+			}
+
+			return do_bench(save_load_count);
+		}
+
 		if (!strcmp(argv[1], "index")) {
 			if (argc >= 3) {
 				return do_show_index(argv[2], false);
@@ -213,7 +231,7 @@ param_main(int argc, char *argv[])
 		}
 	}
 
-	warnx("expected a command, try 'load', 'import', 'show', 'set', 'compare',\n'index', 'index_used', 'greater', 'select', 'save', or 'reset' ");
+	warnx("expected a command, try 'load', 'import', 'show', 'set', 'compare',\n'index', 'index_used', 'greater', 'select', 'save', 'reset' or 'bench' ");
 	return 1;
 }
 
@@ -652,3 +670,188 @@ do_reset_nostart(const char *excludes[], int num_excludes)
 
 	return 0;
 }
+
+#if !defined(FLASH_BASED_PARAMS) && !defined(__PX4_QURT)
+/**
+ * Change up to count int32 and float parameters that are at their default, so there is a
+ * known number of changed parameters to save.
+ *
+ * @return the parameters changed, to hand to do_bench_restore(), or NULL
+ */
+static param_t *
+do_bench_change(unsigned count, unsigned *changed)
+{
+	param_t *bench = malloc(count * sizeof(param_t));
+
+	if (bench == NULL) {
+		return NULL;
+	}
+
+	*changed = 0;
+
+	for (unsigned i = 0; i < param_count() && *changed < count; i++) {
+		param_t param = param_for_index(i);
+		param_type_t type = param_type(param);
+		union param_value_u value;
+
+		if ((type != PARAM_TYPE_INT32 && type != PARAM_TYPE_FLOAT) || !param_value_is_default(param)
+		    || param_get(param, &value) != 0) {
+			continue;
+		}
+
+		if (type == PARAM_TYPE_INT32) {
+			value.i++;
+
+		} else {
+			value.f += 1.0f;
+		}
+
+		/* nobody is told about these values, they are reset right after the bench */
+		if (param_set_no_notification(param, &value) == 0) {
+			bench[(*changed)++] = param;
+		}
+	}
+
+	return bench;
+}
+
+static void
+do_bench_restore(param_t *bench, unsigned changed)
+{
+	for (unsigned i = 0; i < changed; i++) {
+		param_reset(bench[i]);
+	}
+
+	free(bench);
+}
+
+static int
+do_bench_save_load(const char *format, bool image, unsigned changed)
+{
+	const char *bench_file = PX4_ROOTFSDIR"/fs/microsd/param_bench";
+	int fd = open(bench_file, O_WRONLY | O_CREAT | O_TRUNC, PX4_O_MODE_666);
+
+	if (fd < 0) {
+		warn("opening '%s' failed", bench_file);
+		return 1;
+	}
+
+	hrt_abstime start = hrt_absolute_time();
+	int result = image ? param_export_image(fd) : param_export(fd, false);
+	fsync(fd);
+	hrt_abstime save_time = hrt_elapsed_time(&start);
+	close(fd);
+
+	if (result == 1) {
+		PX4_INFO("%s: not supported for these parameters", format);
+		result = 0;
+
+	} else if (result == 0) {
+		fd = open(bench_file, O_RDONLY);
+
+		if (fd < 0) {
+			warn("open failed '%s'", bench_file);
+			result = 1;
+
+		} else {
+			/* import rather than load, which would reset all parameters to their defaults first */
+			start = hrt_absolute_time();
+			result = param_import(fd);
+			hrt_abstime load_time = hrt_elapsed_time(&start);
+			close(fd);
+
+			PX4_INFO("%s: %u changed, save %llu us, load %llu us", format, changed,
+				 (unsigned long long)save_time, (unsigned long long)load_time);
+		}
+	}
+
+	(void)unlink(bench_file);
+
+	if (result != 0) {
+		warnx("%s save/load failed", format);
+		return 1;
+	}
+
+	return 0;
+}
+#endif
+
+static int
+do_bench(unsigned save_load_count)
+{
+	unsigned count = param_count();
+	unsigned found = 0;
+	uint8_t value[16];
+
+	if (count == 0) {
+		warnx("no parameters");
+		return 1;
+	}
+
+	/* look up every parameter by name, like the modules do at boot, without marking them used */
+	hrt_abstime start = hrt_absolute_time();
+
+	for (unsigned i = 0; i < count; i++) {
+		if (param_find_no_notification(param_name(param_for_index(i))) == param_for_index(i)) {
+			found++;
+		}
+	}
+
+	hrt_abstime find_time = hrt_elapsed_time(&start);
+
+	start = hrt_absolute_time();
+
+	for (unsigned i = 0; i < count; i++) {
+		param_t param = param_for_index(i);
+
+		if (param_size(param) <= sizeof(value)) {
+			param_get(param, value);
+		}
+	}
+
+	hrt_abstime get_time = hrt_elapsed_time(&start);
+
+	PX4_INFO("param_find: %u of %u found, %.3f us per call, %llu us total",
+		 found, count, (double)find_time / count, (unsigned long long)find_time);
+	PX4_INFO("param_get:  %.3f us per call, %llu us total", (double)get_time / count, (unsigned long long)get_time);
+
+	int result = (found == count) ? 0 : 1;
+
+	if (save_load_count == 0) {
+		return result;
+	}
+
+#if !defined(FLASH_BASED_PARAMS) && !defined(__PX4_QURT)
+
+	/* change the requested number of parameters, save all changed parameters in both formats to a
+	 * scratch file and import them again, then reset the parameters the bench changed */
+	unsigned bench_changed;
+	param_t *bench = do_bench_change(save_load_count, &bench_changed);
+
+	if (bench == NULL) {
+		warnx("out of memory");
+		return 1;
+	}
+
+	if (bench_changed < save_load_count) {
+		PX4_INFO("only %u parameters at their default to change", bench_changed);
+	}
+
+	unsigned changed = 0;
+
+	for (unsigned i = 0; i < count; i++) {
+		if (!param_value_is_default(param_for_index(i))) {
+			changed++;
+		}
+	}
+
+	if (do_bench_save_load("BSON ", false, changed) || do_bench_save_load("image", true, changed)) {
+		result = 1;
+	}
+
+	do_bench_restore(bench, bench_changed);
+
+#endif
+
+	return result;
+}
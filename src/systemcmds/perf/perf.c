@@ -37,6 +37,8 @@
 
 
 #include <px4_config.h>
+#include <px4_defines.h>
+#include <px4_workqueue.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <string.h>
@@ -48,10 +50,34 @@
  * Definitions
  ****************************************************************************/
 
+#define PERF_EXPORT_INTERVAL_US	1000000
+
 /****************************************************************************
  * Private Data
  ****************************************************************************/
 
+static struct work_s perf_export_work;
+static volatile bool perf_export_running = false;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static void perf_export_cycle(void *arg)
+{
+	if (!perf_export_running) {
+		return;
+	}
+
+	if (perf_export_shm() != PX4_OK) {
+		PX4_ERR("export failed");
+		perf_export_running = false;
+		return;
+	}
+
+	work_queue(LPWORK, &perf_export_work, perf_export_cycle, NULL, USEC2TICK(PERF_EXPORT_INTERVAL_US));
+}
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -73,9 +99,34 @@ int perf_main(int argc, char *argv[])
 			perf_print_latency(1 /* stdout */);
 			fflush(stdout);
 			return 0;
+
+		} else if (strcmp(argv[1], "percentiles") == 0) {
+			perf_print_percentiles(1 /* stdout */);
+			fflush(stdout);
+			return 0;
+
+		} else if (strcmp(argv[1], "export") == 0) {
+			if (argc > 2 && strcmp(argv[2], "stop") == 0) {
+				perf_export_running = false;
+				work_cancel(LPWORK, &perf_export_work);
+				return 0;
+			}
+
+			/* write the first snapshot right away, so errors are reported here */
+			if (perf_export_shm() != PX4_OK) {
+				printf("export to shared memory %s failed\n", PERF_EXPORT_SHM_NAME);
+				return -1;
+			}
+
+			if (!perf_export_running) {
+				perf_export_running = true;
+				work_queue(LPWORK, &perf_export_work, perf_export_cycle, NULL, USEC2TICK(PERF_EXPORT_INTERVAL_US));
+			}
+
+			return 0;
 		}
 
-		printf("Usage: perf [reset | latency]\n");
+		printf("Usage: perf [reset | latency | percentiles | export [stop]]\n");
 		return -1;
 	}
 
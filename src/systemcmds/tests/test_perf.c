@@ -34,6 +34,8 @@
 #include <px4_config.h>
 #include <px4_posix.h>
 
+#include <string.h>
+
 #include <systemlib/perf_counter.h>
 
 #include "tests.h"
@@ -65,5 +67,43 @@ test_perf(int argc, char *argv[])
 	perf_free(cc);
 	perf_free(ec);
 
+	perf_counter_t hc = perf_alloc(PC_HISTOGRAM, "test_histogram");
+
+	if (hc == NULL) {
+		printf("perf: histogram alloc failed\n");
+		return 1;
+	}
+
+	/* 99 fast events and one slow one */
+	for (int i = 0; i < 99; i++) {
+		perf_set_elapsed(hc, 100);
+	}
+
+	perf_set_elapsed(hc, 10000);
+	perf_set_elapsed(hc, -1);
+
+	struct perf_counter_snapshot_s snapshot = {};
+	unsigned count = perf_snapshot(NULL, 0);
+
+	/* the newest counter is first */
+	if (count == 0 || perf_snapshot(&snapshot, 1) != count || strcmp(snapshot.name, "test_histogram") != 0) {
+		printf("perf: histogram snapshot failed\n");
+		perf_free(hc);
+		return 1;
+	}
+
+	printf("perf: expect 100 events, 1 overrun, p50 and p99 103us, p99.9 and max 10000us\n");
+	perf_print_counter(hc);
+
+	bool ok = snapshot.event_count == 100 && snapshot.overruns == 1 && snapshot.min == 100 && snapshot.max == 10000
+		  && snapshot.p50 >= 100 && snapshot.p50 <= 100 + 100 / 8 && snapshot.p99 == snapshot.p50 && snapshot.p999 == 10000;
+
+	perf_free(hc);
+
+	if (!ok) {
+		printf("perf: histogram percentiles wrong\n");
+		return 1;
+	}
+
 	return OK;
 }
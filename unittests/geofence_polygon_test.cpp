@@ -0,0 +1,243 @@
+#include <navigator/geofence_polygon.h>
+#include <geo/geo.h>
+
+#include <math.h>
+#include <stdint.h>
+
+#include "gtest/gtest.h"
+
+/*
+ * The edge index of GeofencePolygon has to give the same answer as counting
+ * the crossings with all edges. The polygons are given in the projection plane
+ * and converted to the lat/lon that init() takes, the reference projects the
+ * vertices back like init() does.
+ */
+struct _test_polygon {
+	map_projection_reference_s ref;
+	unsigned count;
+	float lat[256];
+	float lon[256];
+	float x[256];
+	float y[256];
+	float min_x, max_x, min_y, max_y;
+};
+
+static void _make_polygon(_test_polygon &p, const float *x, const float *y, unsigned count)
+{
+	map_projection_init(&p.ref, 47.397742, 8.545594);
+	p.count = count;
+	p.min_x = p.min_y = INFINITY;
+	p.max_x = p.max_y = -INFINITY;
+
+	for (unsigned i = 0; i < count; i++) {
+		double lat, lon;
+		map_projection_reproject(&p.ref, x[i], y[i], &lat, &lon);
+		p.lat[i] = lat;
+		p.lon[i] = lon;
+		map_projection_project(&p.ref, p.lat[i], p.lon[i], &p.x[i], &p.y[i]);
+
+		p.min_x = fminf(p.min_x, p.x[i]);
+		p.max_x = fmaxf(p.max_x, p.x[i]);
+		p.min_y = fminf(p.min_y, p.y[i]);
+		p.max_y = fmaxf(p.max_y, p.y[i]);
+	}
+}
+
+/* a ray to +y, an edge counts if it spans the point in x (half open) and lies beyond it */
+static bool _brute_force_inside(const _test_polygon &p, float x, float y)
+{
+	bool inside = false;
+
+	for (unsigned i = 0, j = p.count - 1; i < p.count; j = i++) {
+		if ((p.x[i] >= x) != (p.x[j] >= x) &&
+		    (y <= (p.y[j] - p.y[i]) * (x - p.x[i]) / (p.x[j] - p.x[i]) + p.y[i])) {
+			inside = !inside;
+		}
+	}
+
+	/* outside the bounding box is outside */
+	return inside && x >= p.min_x && x <= p.max_x && y >= p.min_y && y <= p.max_y;
+}
+
+/* distance from a point to the closest edge */
+static float _edge_distance(const _test_polygon &p, float x, float y)
+{
+	float distance = INFINITY;
+
+	for (unsigned i = 0, j = p.count - 1; i < p.count; j = i++) {
+		float edge_x = p.x[i] - p.x[j];
+		float edge_y = p.y[i] - p.y[j];
+		float t = ((x - p.x[j]) * edge_x + (y - p.y[j]) * edge_y) / (edge_x * edge_x + edge_y * edge_y);
+		t = fminf(fmaxf(t, 0.f), 1.f);
+		distance = fminf(distance, hypotf(x - p.x[j] - t * edge_x, y - p.y[j] - t * edge_y));
+	}
+
+	return distance;
+}
+
+static uint32_t _random_seed = 1;
+
+static float _random(float min, float max)
+{
+	_random_seed = _random_seed * 1664525u + 1013904223u;
+	return min + (max - min) * (float)(_random_seed >> 8) / (float)(1u << 24);
+}
+
+/*
+ * Compare random points in and around the bounding box, points on the lines
+ * of the finest grid the index can use (so on every cell boundary of the grid
+ * it picked) and points right next to every vertex.
+ * @return number of mismatches
+ */
+static unsigned _compare(const _test_polygon &p, const GeofencePolygon &polygon)
+{
+	unsigned mismatches = 0;
+	const float margin_x = (p.max_x - p.min_x) * 0.1f;
+	const float margin_y = (p.max_y - p.min_y) * 0.1f;
+
+	for (unsigned k = 0; k < 20000; k++) {
+		float x = _random(p.min_x - margin_x, p.max_x + margin_x);
+		float y = _random(p.min_y - margin_y, p.max_y + margin_y);
+
+		if (polygon.inside(x, y) != _brute_force_inside(p, x, y)) {
+			ADD_FAILURE() << "random point " << x << ", " << y;
+			mismatches++;
+		}
+	}
+
+	/* the grid has a power of two cells per axis, at most 64 */
+	const unsigned lines = 64;
+
+	for (unsigned a = 0; a <= lines; a++) {
+		float line_x = p.min_x + (p.max_x - p.min_x) * a / lines;
+		float line_y = p.min_y + (p.max_y - p.min_y) * a / lines;
+
+		for (unsigned b = 0; b <= lines; b++) {
+			float y = p.min_y + (p.max_y - p.min_y) * b / lines;
+			float random_x = _random(p.min_x, p.max_x);
+			float random_y = _random(p.min_y, p.max_y);
+
+			/* grid corners, then points on a horizontal and a vertical boundary */
+			const float points[3][2] = {{line_x, y}, {line_x, random_y}, {random_x, line_y}};
+
+			for (const auto &point : points) {
+				if (polygon.inside(point[0], point[1]) != _brute_force_inside(p, point[0], point[1])) {
+					ADD_FAILURE() << "point on a cell boundary " << point[0] << ", " << point[1];
+					mismatches++;
+				}
+			}
+		}
+	}
+
+	/* on an edge the answer may go either way, a cm next to a vertex it must not */
+	for (unsigned i = 0; i < p.count; i++) {
+		polygon.inside(p.x[i], p.y[i]);
+
+		for (int dx = -1; dx <= 1; dx++) {
+			for (int dy = -1; dy <= 1; dy++) {
+				float x = p.x[i] + dx * 0.01f;
+				float y = p.y[i] + dy * 0.01f;
+
+				if (_edge_distance(p, x, y) > 0.001f && polygon.inside(x, y) != _brute_force_inside(p, x, y)) {
+					ADD_FAILURE() << "point next to vertex " << i << ": " << x << ", " << y;
+					mismatches++;
+				}
+			}
+		}
+	}
+
+	return mismatches;
+}
+
+static void _star(float *x, float *y, unsigned count, float outer, float inner)
+{
+	for (unsigned i = 0; i < count; i++) {
+		float angle = 2.f * M_PI_F * i / count;
+		float radius = (i & 1) ? inner : outer;
+		x[i] = radius * cosf(angle);
+		y[i] = radius * sinf(angle);
+	}
+}
+
+TEST(GeofencePolygonTest, ConvexMatchesBruteForce)
+{
+	const unsigned sizes[] = {3, 4, 17, 200};
+
+	for (unsigned size : sizes) {
+		float x[256], y[256];
+		_star(x, y, size, 1000.f, 1000.f);
+
+		_test_polygon p;
+		_make_polygon(p, x, y, size);
+
+		GeofencePolygon polygon;
+		ASSERT_TRUE(polygon.init(p.ref, p.lat, p.lon, p.count, false)) << size << " vertices";
+		EXPECT_EQ(size, polygon.vertexCount());
+		EXPECT_FALSE(polygon.isExclusion());
+		EXPECT_EQ(0u, _compare(p, polygon)) << size << " vertices";
+	}
+}
+
+TEST(GeofencePolygonTest, ConcaveMatchesBruteForce)
+{
+	/* a star with sharp spikes, many edges per cell */
+	float x[256], y[256];
+	_star(x, y, 256, 1000.f, 150.f);
+
+	_test_polygon p;
+	_make_polygon(p, x, y, 256);
+
+	GeofencePolygon polygon;
+	ASSERT_TRUE(polygon.init(p.ref, p.lat, p.lon, p.count, false));
+	EXPECT_EQ(0u, _compare(p, polygon));
+
+	/* a U shape, the cells in the notch have their center outside */
+	const float ux[] = {0.f, 0.f, 800.f, 800.f, 200.f, 200.f, 800.f, 800.f};
+	const float uy[] = {0.f, 1000.f, 1000.f, 700.f, 700.f, 300.f, 300.f, 0.f};
+	_make_polygon(p, ux, uy, 8);
+
+	ASSERT_TRUE(polygon.init(p.ref, p.lat, p.lon, p.count, false));
+	EXPECT_EQ(0u, _compare(p, polygon));
+}
+
+TEST(GeofencePolygonTest, ExclusionMatchesBruteForce)
+{
+	/* long thin edges, which make the index fall back to a coarser grid */
+	float x[64], y[64];
+
+	for (unsigned i = 0; i < 64; i++) {
+		x[i] = (i & 1) ? 2000.f : 0.f;
+		y[i] = i * 30.f;
+	}
+
+	x[63] = -500.f;
+
+	_test_polygon p;
+	_make_polygon(p, x, y, 64);
+
+	GeofencePolygon polygon;
+	ASSERT_TRUE(polygon.init(p.ref, p.lat, p.lon, p.count, true));
+	EXPECT_TRUE(polygon.isExclusion());
+	EXPECT_EQ(0u, _compare(p, polygon));
+}
+
+TEST(GeofencePolygonTest, ClosingVertexAndInvalid)
+{
+	float x[5], y[5];
+	_star(x, y, 4, 500.f, 500.f);
+	x[4] = x[0];
+	y[4] = y[0];
+
+	_test_polygon p;
+	_make_polygon(p, x, y, 5);
+
+	/* an explicit closing vertex is dropped */
+	GeofencePolygon polygon;
+	ASSERT_TRUE(polygon.init(p.ref, p.lat, p.lon, 5, false));
+	EXPECT_EQ(4u, polygon.vertexCount());
+	p.count = 4;
+	EXPECT_EQ(0u, _compare(p, polygon));
+
+	EXPECT_FALSE(polygon.init(p.ref, p.lat, p.lon, 2, false));
+	EXPECT_FALSE(polygon.inside(0.f, 0.f));
+}
@@ -0,0 +1,445 @@
+#include <systemlib/mixer/mixer.h>
+#include <px4iofirmware/protocol.h>
+
+#include <float.h>
+#include <math.h>
+#include <time.h>
+
+#include "gtest/gtest.h"
+
+#include "mixer_multirotor.generated.h"
+#include "MixerStaticQuadXVtol.generated.h"
+#include "MixerStaticHexaX.generated.h"
+#include "MixerStaticQ.generated.h"
+
+/*
+ * The multirotor mix as it was before the scales were stored as rows. The new
+ * implementation has to produce the same outputs and saturation flags.
+ */
+static float _constrain(float val, float min, float max)
+{
+	return (val < min) ? min : ((val > max) ? max : val);
+}
+
+static unsigned _reference_mix(const MultirotorMixer::RotorMatrix &rotors, float idle_speed,
+			       float roll, float pitch, float yaw, float thrust, float *outputs, uint16_t *status_reg)
+{
+	const float *roll_scale = rotors.roll_scale;
+	const float *pitch_scale = rotors.pitch_scale;
+	const float *yaw_scale = rotors.yaw_scale;
+	const float *out_scale = rotors.out_scale;
+	float _idle_speed = -1.0f + idle_speed * 2.0f;
+
+	roll = _constrain(roll, -1.0f, 1.0f);
+	pitch = _constrain(pitch, -1.0f, 1.0f);
+	yaw = _constrain(yaw, -1.0f, 1.0f);
+	thrust = _constrain(thrust, 0.0f, 1.0f);
+	float min_out = 1.0f;
+	float max_out = 0.0f;
+
+	*status_reg = 0;
+
+	float thrust_increase_factor = 1.5f;
+	float thrust_decrease_factor = 0.6f;
+
+	for (unsigned i = 0; i < rotors.rotor_count; i++) {
+		float out = roll * roll_scale[i] + pitch * pitch_scale[i] + thrust;
+		out *= out_scale[i];
+
+		if (out < min_out) {
+			min_out = out;
+		}
+
+		if (out > max_out) {
+			max_out = out;
+		}
+
+		outputs[i] = out;
+	}
+
+	float boost = 0.0f;
+	float roll_pitch_scale = 1.0f;
+
+	if (min_out < 0.0f && max_out < 1.0f && -min_out <= 1.0f - max_out) {
+		float max_thrust_diff = thrust * thrust_increase_factor - thrust;
+
+		if (max_thrust_diff >= -min_out) {
+			boost = -min_out;
+
+		} else {
+			boost = max_thrust_diff;
+			roll_pitch_scale = (thrust + boost) / (thrust - min_out);
+		}
+
+	} else if (max_out > 1.0f && min_out > 0.0f && min_out >= max_out - 1.0f) {
+		float max_thrust_diff = thrust - thrust_decrease_factor * thrust;
+
+		if (max_thrust_diff >= max_out - 1.0f) {
+			boost = -(max_out - 1.0f);
+
+		} else {
+			boost = -max_thrust_diff;
+			roll_pitch_scale = (1 - (thrust + boost)) / (max_out - thrust);
+		}
+
+	} else if (min_out < 0.0f && max_out < 1.0f && -min_out > 1.0f - max_out) {
+		float max_thrust_diff = thrust * thrust_increase_factor - thrust;
+		boost = _constrain(-min_out - (1.0f - max_out) / 2.0f, 0.0f, max_thrust_diff);
+		roll_pitch_scale = (thrust + boost) / (thrust - min_out);
+
+	} else if (max_out > 1.0f && min_out > 0.0f && min_out < max_out - 1.0f) {
+		float max_thrust_diff = thrust - thrust_decrease_factor * thrust;
+		boost = _constrain(-(max_out - 1.0f - min_out) / 2.0f, -max_thrust_diff, 0.0f);
+		roll_pitch_scale = (1 - (thrust + boost)) / (max_out - thrust);
+
+	} else if (min_out < 0.0f && max_out > 1.0f) {
+		boost = _constrain(-(max_out - 1.0f + min_out) / 2.0f, thrust_decrease_factor * thrust - thrust,
+				   thrust_increase_factor * thrust - thrust);
+		roll_pitch_scale = (thrust + boost) / (thrust - min_out);
+	}
+
+	if (min_out < 0.0f) {
+		*status_reg |= PX4IO_P_STATUS_MIXER_LOWER_LIMIT;
+	}
+
+	if (max_out > 1.0f) {
+		*status_reg |= PX4IO_P_STATUS_MIXER_UPPER_LIMIT;
+	}
+
+	for (unsigned i = 0; i < rotors.rotor_count; i++) {
+		float out = (roll * roll_scale[i] + pitch * pitch_scale[i]) * roll_pitch_scale +
+			    yaw * yaw_scale[i] + thrust + boost;
+
+		out *= out_scale[i];
+
+		if (out < 0.0f) {
+			if (fabsf(yaw_scale[i]) <= FLT_EPSILON) {
+				yaw = 0.0f;
+
+			} else {
+				yaw = -((roll * roll_scale[i] + pitch * pitch_scale[i]) *
+					roll_pitch_scale + thrust + boost) / yaw_scale[i];
+			}
+
+			*status_reg |= PX4IO_P_STATUS_MIXER_YAW_LIMIT;
+
+		} else if (out > 1.0f) {
+			float thrust_reduction = fminf(0.15f, out - 1.0f);
+			thrust -= thrust_reduction;
+
+			if (fabsf(yaw_scale[i]) <= FLT_EPSILON) {
+				yaw = 0.0f;
+
+			} else {
+				yaw = (1.0f - ((roll * roll_scale[i] + pitch * pitch_scale[i]) *
+					       roll_pitch_scale + thrust + boost)) / yaw_scale[i];
+			}
+
+			*status_reg |= PX4IO_P_STATUS_MIXER_YAW_LIMIT;
+		}
+	}
+
+	for (unsigned i = 0; i < rotors.rotor_count; i++) {
+		outputs[i] = (roll * roll_scale[i] + pitch * pitch_scale[i]) * roll_pitch_scale +
+			     yaw * yaw_scale[i] + thrust + boost;
+
+		outputs[i] = _constrain(_idle_speed + (outputs[i] * (1.0f - _idle_speed)), _idle_speed, 1.0f);
+	}
+
+	return rotors.rotor_count;
+}
+
+/*
+ * Control inputs on a grid that covers hover, saturation in every direction and
+ * the corners, as rows of roll, pitch, yaw and thrust.
+ */
+static unsigned _control_grid(float *controls, unsigned max_count)
+{
+	static const float attitude[] = { -1.0f, -0.7f, -0.3f, -0.05f, 0.0f, 0.1f, 0.45f, 0.8f, 1.0f };
+	static const float thrust[] = { 0.0f, 0.02f, 0.2f, 0.5f, 0.75f, 0.95f, 1.0f };
+	const unsigned na = sizeof(attitude) / sizeof(attitude[0]);
+	const unsigned nt = sizeof(thrust) / sizeof(thrust[0]);
+	unsigned count = 0;
+
+	for (unsigned r = 0; r < na; r++) {
+		for (unsigned p = 0; p < na; p++) {
+			for (unsigned y = 0; y < na; y++) {
+				for (unsigned t = 0; t < nt && count < max_count; t++) {
+					controls[count * 4 + 0] = attitude[r];
+					controls[count * 4 + 1] = attitude[p];
+					controls[count * 4 + 2] = attitude[y];
+					controls[count * 4 + 3] = thrust[t];
+					count++;
+				}
+			}
+		}
+	}
+
+	return count;
+}
+
+static const unsigned _max_controls = 9 * 9 * 9 * 7;
+static float _controls[_max_controls * 4];
+static float _current[4];
+
+static int _control_callback(uintptr_t handle, uint8_t control_group, uint8_t control_index, float &control)
+{
+	control = (control_group == 0 && control_index < 4) ? _current[control_index] : 0.0f;
+	return 0;
+}
+
+/* group 0 from _current, the other groups derived from it so every input differs */
+static int _group_callback(uintptr_t handle, uint8_t control_group, uint8_t control_index, float &control)
+{
+	control = _current[control_index % 4] * (1.0f - 0.3f * control_group) + 0.01f * control_index;
+	return 0;
+}
+
+static double _elapsed_s(const struct timespec &start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) * 1e-9;
+}
+
+TEST(MixerTest, MultirotorGolden)
+{
+	const unsigned count = _control_grid(_controls, _max_controls);
+	const float idle_speeds[] = { 0.0f, 0.1f };
+
+	for (unsigned g = 0; g < (unsigned)MultirotorGeometry::MAX_GEOMETRY; g++) {
+		for (float idle_speed : idle_speeds) {
+			MultirotorMixer mixer(_control_callback, 0, (MultirotorGeometry)g, 1.0f, 1.0f, 1.0f, idle_speed);
+			const MultirotorMixer::RotorMatrix &rotors = _config_index[g];
+
+			ASSERT_EQ(rotors.rotor_count, mixer.rotor_count());
+
+			for (unsigned c = 0; c < count; c++) {
+				float expected[MULTIROTOR_MIXER_MAX_ROTORS];
+				float outputs[MULTIROTOR_MIXER_MAX_ROTORS];
+				uint16_t expected_status;
+				uint16_t status;
+				const float *control = &_controls[c * 4];
+
+				_reference_mix(rotors, idle_speed, control[0], control[1], control[2], control[3], expected,
+					       &expected_status);
+
+				memcpy(_current, control, sizeof(_current));
+				ASSERT_EQ(rotors.rotor_count, mixer.mix(outputs, MULTIROTOR_MIXER_MAX_ROTORS, &status));
+
+				ASSERT_EQ(expected_status, status) << "geometry " << g << " control " << c;
+
+				for (unsigned i = 0; i < rotors.rotor_count; i++) {
+					ASSERT_NEAR(expected[i], outputs[i], 1e-5f) << "geometry " << g << " control " << c << " rotor " << i;
+				}
+			}
+		}
+	}
+}
+
+TEST(MixerTest, MultirotorBatch)
+{
+	const unsigned count = _control_grid(_controls, _max_controls);
+	static float batch[_max_controls * MULTIROTOR_MIXER_MAX_ROTORS];
+	static uint16_t batch_status[_max_controls];
+
+	MultirotorMixer mixer(_control_callback, 0, MultirotorGeometry::HEX_X, 1.0f, 1.0f, 1.0f, 0.1f);
+
+	ASSERT_EQ(6u, mixer.mix_batch(_controls, count, batch, batch_status));
+
+	for (unsigned c = 0; c < count; c++) {
+		float outputs[MULTIROTOR_MIXER_MAX_ROTORS];
+		uint16_t status;
+
+		memcpy(_current, &_controls[c * 4], sizeof(_current));
+		mixer.mix(outputs, MULTIROTOR_MIXER_MAX_ROTORS, &status);
+
+		ASSERT_EQ(status, batch_status[c]);
+
+		for (unsigned i = 0; i < 6; i++) {
+			ASSERT_EQ(outputs[i], batch[c * 6 + i]);
+		}
+	}
+}
+
+TEST(MixerTest, MultirotorAllocationSearch)
+{
+	const unsigned count = _control_grid(_controls, _max_controls);
+
+	for (unsigned g = 0; g < (unsigned)MultirotorGeometry::MAX_GEOMETRY; g++) {
+		MultirotorMixer clip(_control_callback, 0, (MultirotorGeometry)g, 1.0f, 1.0f, 1.0f, 0.0f);
+		MultirotorMixer search(_control_callback, 0, (MultirotorGeometry)g, 1.0f, 1.0f, 1.0f, 0.0f);
+		search.set_allocation(MultirotorMixer::Allocation::SEARCH);
+		const unsigned rotor_count = clip.rotor_count();
+
+		for (unsigned c = 0; c < count; c++) {
+			float clip_outputs[MULTIROTOR_MIXER_MAX_ROTORS];
+			float search_outputs[MULTIROTOR_MIXER_MAX_ROTORS];
+			uint16_t clip_status;
+			uint16_t search_status;
+
+			memcpy(_current, &_controls[c * 4], sizeof(_current));
+			clip.mix(clip_outputs, MULTIROTOR_MIXER_MAX_ROTORS, &clip_status);
+			search.mix(search_outputs, MULTIROTOR_MIXER_MAX_ROTORS, &search_status);
+
+			/* the same saturation is reported, the outputs only differ if yaw saturates */
+			ASSERT_EQ(clip_status, search_status);
+
+			for (unsigned i = 0; i < rotor_count; i++) {
+				ASSERT_TRUE(search_outputs[i] >= -1.0f && search_outputs[i] <= 1.0f);
+
+				if (!(clip_status & PX4IO_P_STATUS_MIXER_YAW_LIMIT)) {
+					ASSERT_EQ(clip_outputs[i], search_outputs[i]);
+				}
+			}
+		}
+	}
+
+	/* full yaw at hover on a quad: the search keeps thrust and gets more yaw */
+	MultirotorMixer clip(_control_callback, 0, MultirotorGeometry::QUAD_X, 1.0f, 1.0f, 1.0f, 0.0f);
+	MultirotorMixer search(_control_callback, 0, MultirotorGeometry::QUAD_X, 1.0f, 1.0f, 1.0f, 0.0f);
+	search.set_allocation(MultirotorMixer::Allocation::SEARCH);
+	const MultirotorMixer::RotorMatrix &rotors = _config_index[(unsigned)MultirotorGeometry::QUAD_X];
+
+	float clip_outputs[4];
+	float search_outputs[4];
+	_current[0] = 0.0f;
+	_current[1] = 0.0f;
+	_current[2] = 1.0f;
+	_current[3] = 0.5f;
+	clip.mix(clip_outputs, 4, nullptr);
+	search.mix(search_outputs, 4, nullptr);
+
+	float clip_yaw = 0.0f;
+	float search_yaw = 0.0f;
+	float search_thrust = 0.0f;
+
+	for (unsigned i = 0; i < 4; i++) {
+		/* back from the output range to [0, 1] */
+		clip_yaw += 0.5f * (clip_outputs[i] + 1.0f) * rotors.yaw_scale[i];
+		search_yaw += 0.5f * (search_outputs[i] + 1.0f) * rotors.yaw_scale[i];
+		search_thrust += 0.5f * (search_outputs[i] + 1.0f) / 4;
+	}
+
+	EXPECT_GT(search_yaw, clip_yaw);
+	EXPECT_NEAR(0.5f, search_thrust, 1e-3f);
+}
+
+static void _benchmark(const char *name, const float *controls, unsigned count)
+{
+	static float outputs[_max_controls * MULTIROTOR_MIXER_MAX_ROTORS];
+	static uint16_t status[_max_controls];
+	const unsigned repeat = 50;
+	const MultirotorGeometry geometries[] = { MultirotorGeometry::QUAD_X, MultirotorGeometry::HEX_X, MultirotorGeometry::OCTA_X };
+
+	for (MultirotorGeometry geometry : geometries) {
+		MultirotorMixer mixer(_control_callback, 0, geometry, 1.0f, 1.0f, 1.0f, 0.1f);
+		const MultirotorMixer::RotorMatrix &rotors = _config_index[(unsigned)geometry];
+		const unsigned rotor_count = rotors.rotor_count;
+		float sum = 0.0f;
+
+		struct timespec start;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		for (unsigned r = 0; r < repeat; r++) {
+			for (unsigned c = 0; c < count; c++) {
+				const float *control = &controls[c * 4];
+				_reference_mix(rotors, 0.1f, control[0], control[1], control[2], control[3],
+					       &outputs[c * rotor_count], &status[c]);
+			}
+
+			sum += outputs[r % count];
+		}
+
+		double reference = _elapsed_s(start);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		for (unsigned r = 0; r < repeat; r++) {
+			for (unsigned c = 0; c < count; c++) {
+				memcpy(_current, &controls[c * 4], sizeof(_current));
+				mixer.mix(&outputs[c * rotor_count], rotor_count, &status[c]);
+			}
+
+			sum += outputs[r % count];
+		}
+
+		double single = _elapsed_s(start);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		for (unsigned r = 0; r < repeat; r++) {
+			mixer.mix_batch(controls, count, outputs, status);
+			sum += outputs[r % count];
+		}
+
+		double batch = _elapsed_s(start);
+
+		EXPECT_TRUE(PX4_ISFINITE(sum));
+		printf("%s, %u rotors: reference %.1f ns, mix %.1f ns, mix_batch %.1f ns\n", name, rotor_count,
+		       reference / (repeat * count) * 1e9, single / (repeat * count) * 1e9, batch / (repeat * count) * 1e9);
+	}
+}
+
+TEST(MixerTest, MultirotorBenchmark)
+{
+	/* the grid saturates most of the time */
+	_benchmark("grid", _controls, _control_grid(_controls, _max_controls));
+
+	/* small attitude corrections around hover, as in flight */
+	for (unsigned c = 0; c < _max_controls; c++) {
+		_controls[c * 4 + 0] = 0.2f * sinf(c * 0.1f);
+		_controls[c * 4 + 1] = 0.2f * cosf(c * 0.13f);
+		_controls[c * 4 + 2] = 0.1f * sinf(c * 0.07f);
+		_controls[c * 4 + 3] = 0.5f + 0.2f * sinf(c * 0.05f);
+	}
+
+	_benchmark("hover", _controls, _max_controls);
+}
+
+/*
+ * A mixer compiled in by mixer_static.py has to match the one loaded from the
+ * same file at runtime bit for bit, including when the outputs run out.
+ */
+template<class Static>
+static void _check_static(const char *path)
+{
+	static char buf[2048];
+	ASSERT_EQ(0, load_mixer_file(path, buf, sizeof(buf))) << path;
+
+	unsigned buflen = strlen(buf);
+	MixerGroup group(_group_callback, 0);
+	ASSERT_EQ(0, group.load_from_buf(buf, buflen)) << path;
+
+	Static compiled(_group_callback, 0);
+	uint32_t groups = 0;
+	const uint32_t compiled_groups = Static::groups_required;
+	group.groups_required(groups);
+	ASSERT_EQ(groups, compiled_groups) << path;
+
+	const unsigned count = _control_grid(_controls, _max_controls);
+	const unsigned spaces[] = { 16, 3 };
+
+	for (unsigned space : spaces) {
+		for (unsigned c = 0; c < count; c++) {
+			float expected[16];
+			float outputs[16];
+			uint16_t expected_status = 0;
+			uint16_t status = 0;
+
+			memcpy(_current, &_controls[c * 4], sizeof(_current));
+			unsigned expected_count = group.mix(expected, space, &expected_status);
+
+			ASSERT_EQ(expected_count, compiled.mix(outputs, space, &status)) << path;
+			ASSERT_EQ(expected_status, status) << path << " control " << c;
+			ASSERT_EQ(0, memcmp(expected, outputs, expected_count * sizeof(float))) << path << " control " << c;
+		}
+	}
+}
+
+TEST(MixerTest, StaticMatchesParsed)
+{
+	_check_static<MixerStaticQuadXVtol>("ROMFS/px4fmu_common/mixers/quad_x_vtol.main.mix");
+	_check_static<MixerStaticHexaX>("ROMFS/px4fmu_common/mixers/hexa_x.main.mix");
+	_check_static<MixerStaticQ>("ROMFS/px4fmu_common/mixers/Q.main.mix");
+}
@@ -1,6 +1,10 @@
 #include <systemlib/visibility.h>
 #include <systemlib/param/param.h>
 
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
 #include "gtest/gtest.h"
 
 /*
@@ -152,3 +156,226 @@ TEST(ParamTest, ResetAllExcludesWildcard)
 	_assert_parameter_int_value((param_t)2, 50);
 	_assert_parameter_int_value((param_t)3, 50);
 }
+
+/*
+ * A table sorted by name like the generated one, which param_find binary searches
+ */
+static const char *sorted_names[] = {"ATT_W", "BAT_N", "MC_PITCH", "MC_ROLL", "RC2_X", "RC_X"};
+static const unsigned sorted_count = sizeof(sorted_names) / sizeof(sorted_names[0]);
+
+void _add_sorted_parameters()
+{
+	for (unsigned i = 0; i < sorted_count; i++) {
+		struct param_info_s info = {
+			sorted_names[i],
+			PARAM_TYPE_INT32
+		};
+		info.val.i = (int32_t)i;
+		param_array[i] = info;
+	}
+
+	param_info_base = (struct param_info_s *) &param_array[0];
+	param_info_limit = (struct param_info_s *) &param_array[sorted_count];
+
+	param_reset_all();
+}
+
+TEST(ParamTest, SortedFindHit)
+{
+	_add_sorted_parameters();
+
+	for (unsigned i = 1; i < sorted_count; i++) {
+		ASSERT_LT(strcmp(sorted_names[i - 1], sorted_names[i]), 0) << "test table is not sorted";
+	}
+
+	/* every entry, including the first and the last one. The used flags are never cleared, so
+	 * earlier tests may have set some */
+	for (unsigned i = 0; i < sorted_count; i++) {
+		bool used = param_used((param_t)i);
+		EXPECT_EQ((param_t)i, param_find_no_notification(sorted_names[i])) << sorted_names[i];
+		EXPECT_EQ(used, param_used((param_t)i)) << "param_find_no_notification marked " << sorted_names[i] << " used";
+	}
+
+	EXPECT_EQ((param_t)0, param_find("ATT_W"));
+	EXPECT_TRUE(param_used((param_t)0));
+	EXPECT_EQ((param_t)(sorted_count - 1), param_find("RC_X"));
+	EXPECT_TRUE(param_used((param_t)(sorted_count - 1)));
+
+	_assert_parameter_int_value(param_find("MC_ROLL"), 3);
+}
+
+TEST(ParamTest, SortedFindMiss)
+{
+	_add_sorted_parameters();
+
+	/* before the first, after the last, between two entries and prefixes of entries */
+	const char *missing[] = {"AAA", "ZZZ", "MC_P", "MC_PITCH_", "MC_QQ", "RC", "RC3_X", ""};
+
+	for (unsigned i = 0; i < sizeof(missing) / sizeof(missing[0]); i++) {
+		EXPECT_EQ(PARAM_INVALID, param_find_no_notification(missing[i])) << "found '" << missing[i] << "'";
+	}
+}
+
+TEST(ParamTest, SortedChangedInsertOrder)
+{
+	_add_sorted_parameters();
+
+	/* changed values are kept ordered by handle, insert at the end, the front and in between */
+	const unsigned order[] = {2, 5, 0, 3, 1, 4};
+	bool changed[sorted_count] = {};
+
+	for (unsigned k = 0; k < sorted_count; k++) {
+		int32_t value = 100 + order[k];
+		ASSERT_EQ(0, param_set((param_t)order[k], &value));
+		changed[order[k]] = true;
+
+		for (unsigned i = 0; i < sorted_count; i++) {
+			_assert_parameter_int_value((param_t)i, changed[i] ? 100 + i : i);
+			EXPECT_EQ(!changed[i], param_value_is_default((param_t)i)) << "after inserting " << order[k];
+		}
+	}
+
+	/* remove some in between and the ends, then insert them again */
+	param_reset((param_t)0);
+	param_reset((param_t)3);
+	param_reset((param_t)5);
+
+	for (unsigned i = 0; i < sorted_count; i++) {
+		_assert_parameter_int_value((param_t)i, (i == 0 || i == 3 || i == 5) ? i : 100 + i);
+	}
+
+	for (unsigned i = 0; i < sorted_count; i += 2) {
+		int32_t value = 200 + i;
+		ASSERT_EQ(0, param_set((param_t)i, &value));
+	}
+
+	for (unsigned i = 0; i < sorted_count; i++) {
+		_assert_parameter_int_value((param_t)i, (i % 2 == 0) ? 200 + i : (i == 3 || i == 5) ? i : 100 + i);
+	}
+
+	param_reset_all();
+}
+
+/*
+ * Readers calling param_get while a writer keeps inserting and erasing modified
+ * values. Every value set for a parameter encodes the parameter, so a reader
+ * picking up the value of a neighbour in the modified values array notices.
+ */
+static const int32_t concurrent_defaults[] = {2, 4, 8, 16};
+static const int concurrent_readers = 8;
+static const double concurrent_duration_s = 0.5;
+
+struct concurrent_reader_s {
+	pthread_t thread;
+	unsigned long reads;
+	unsigned long errors;
+};
+
+static volatile bool concurrent_done;
+
+static bool _concurrent_value_valid(param_t param, int32_t value)
+{
+	return value == concurrent_defaults[param] || value / 1000 == (int32_t)param + 1;
+}
+
+static void *_concurrent_reader(void *arg)
+{
+	struct concurrent_reader_s *reader = (struct concurrent_reader_s *)arg;
+
+	while (!__atomic_load_n(&concurrent_done, __ATOMIC_ACQUIRE)) {
+		for (param_t param = 0; param < 4; param++) {
+			int32_t value;
+
+			if (param_get(param, &value) != 0 || !_concurrent_value_valid(param, value)) {
+				reader->errors++;
+			}
+
+			reader->reads++;
+		}
+	}
+
+	return nullptr;
+}
+
+static double _elapsed_s(const struct timespec &start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) * 1e-9;
+}
+
+TEST(ParamTest, ConcurrentReadersOneWriter)
+{
+	_add_parameters();
+	param_reset_all();
+
+	uint32_t generation = param_generation();
+
+	struct concurrent_reader_s readers[concurrent_readers] = {};
+	concurrent_done = false;
+
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (int i = 0; i < concurrent_readers; i++) {
+		ASSERT_EQ(0, pthread_create(&readers[i].thread, nullptr, _concurrent_reader, &readers[i]));
+	}
+
+	unsigned long writes;
+
+	for (writes = 0; _elapsed_s(start) < concurrent_duration_s; writes++) {
+		param_t param = (param_t)(writes % 4);
+
+		if ((writes / 4) % 3 == 2) {
+			param_reset(param);
+
+		} else {
+			int32_t value = ((int32_t)param + 1) * 1000 + writes % 1000;
+			param_set(param, &value);
+		}
+	}
+
+	__atomic_store_n(&concurrent_done, true, __ATOMIC_RELEASE);
+
+	unsigned long reads = 0;
+
+	for (int i = 0; i < concurrent_readers; i++) {
+		pthread_join(readers[i].thread, nullptr);
+		EXPECT_EQ(0ul, readers[i].errors) << "reader " << i << " got a torn value";
+		reads += readers[i].reads;
+	}
+
+	double elapsed = _elapsed_s(start);
+
+	EXPECT_NE(generation, param_generation()) << "generation did not advance";
+
+	printf("%d readers: %lu param_get in %.3f s (%.1f M/s) during %lu writes\n",
+	       concurrent_readers, reads, elapsed, reads / elapsed * 1e-6, writes);
+
+	param_reset_all();
+}
+
+TEST(ParamTest, GetBenchmark)
+{
+	_add_parameters();
+	_set_all_int_parameters_to(50);
+
+	const int iterations = 1000000;
+	int32_t value = 0;
+	int32_t sum = 0;
+
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (int i = 0; i < iterations; i++) {
+		param_get((param_t)(i % 4), &value);
+		sum += value;
+	}
+
+	double elapsed = _elapsed_s(start);
+
+	ASSERT_EQ(50 * iterations, sum);
+	printf("param_get: %.1f ns\n", elapsed / iterations * 1e9);
+
+	param_reset_all();
+}